@@ -1,71 +1,69 @@
 #include "analyser.h"
+#include "ir/ir.h"
 
 #include <climits>
 #include <stack>
 
 namespace cc0 {
-	
-	// 当前层级，每多一层嵌套{}, ++;
-	// 函数声明不用++, 只有遇到函数参数之后的{, 才++
-	static int32_t current_level = 0;
-	// 当前函数下标(函数表的大小)  .F0的0, .F1的1
-	static int32_t current_func_index = 0;
-	// func_current_level++ 在param声明之前，在compound之后--
-	static int32_t current_func_level = 0;
-	// 指令下标 from 0 ~ n-1
-	static int32_t current_instruction_index = 0;
-	// 变量声明的下标
-	static int32_t current_var_index = 0;
-	
-	std::pair<std::vector<Instruction>, std::optional<CompilationError>> Analyser::Analyse() {
+
+	std::pair<Program, std::optional<CompilationError>> Analyser::Analyse() {
 		auto err = analyseProgram();
 		//
 		if (err.has_value())
-			return std::make_pair(std::vector<Instruction>(), err);
+			return std::make_pair(Program(), err);
 		else
-			return std::make_pair(_instructions, std::optional<CompilationError>());
+			return std::make_pair(concatSections(), std::optional<CompilationError>());
 		// return std::make_pair(_instructions, err);
 	}
 
 	// <C0-program> ::= {<variable-declaration>}{<function-definition>}
+	// 每一段单独生成, 常量表和函数表最后由 concatSections() 一次性拼接
 	std::optional<CompilationError> Analyser::analyseProgram() {
-		_instructions.emplace_back(0, Operation::PSTART, 0, 0);
 		auto err = analyseVariableDeclarationMulti();
 		if(err.has_value()) return err;
-		_instructions.emplace_back(0, Operation::PFUNCTION, 0, 0);
-		int32_t functableIndex = _instructions.size();
+		if (_instructions.size() > (std::size_t)Instruction::MaxIndex)
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrFunctionTooLong);
+		_startSection = std::move(_instructions);
+		_instructions.clear();
 		err = analyseFunctionDefinitionMulti();
 		if(err.has_value())  return err;
-		bool inclmain = false;
-		for (int i=_functionsTable.size()-1; i>=0;i--){
-			if(_functionsTable[i].getFuncName()=="main"){
-				inclmain = true;
-				break;
-			}
-		}
-		if ( ! inclmain)
+		if ( ! _relocatable && ! isFunction(_interner.Intern("main")))
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedMain);
-		// 函数表
+		return {};
+	}
+
+	// .constants: {SAVECONST} .start: {指令} .functions: {SAVEFUNCTION} {PFI {指令}}
+	// 第 i 个常量是第 i 个函数的函数名
+	Program Analyser::concatSections() {
 		int32_t funcSize = _functionsTable.size();
-		for (int i=funcSize-1; i>=0; i--){
-			Instruction tmpInstr(_functionsTable[i].getOffset(), Operation::SAVEFUNCTION, _functionsTable[i].getParamsNum(), _functionsTable[i].getOffset());
-			auto it = _instructions.begin()+functableIndex;
-			_instructions.insert(it, tmpInstr);
-		}
+		std::size_t total = 3 + 2 * funcSize + _startSection.size();
+		for (auto& section : _functionSections)
+			total += section.size();
+		Program result;
+		auto& code = result.instructions;
+		code.reserve(total);
+		result.constants.reserve(funcSize);
+		result.relocatable = _relocatable;
 		// 常量表
-		std::string tmps = "S"; 
-		for (int i=funcSize-1; i>=0; i--){
-			std::string tmpfuncname = _functionsTable[i].getFuncName();
-			Instruction tmpInstr(_functionsTable[i].getOffset(), Operation::SAVECONST, 0, 0);
-			tmpInstr.SetConstType("S");
-			tmpInstr.SetConstType(tmpfuncname);
-			auto it = _instructions.begin();
-			_instructions.insert(it, tmpInstr);
+		code.emplace_back(0, Operation::PCONSTANTS, 0, 0);
+		for (int i=0; i<funcSize; i++){
+			code.emplace_back(_functionsTable[i].getOffset(), Operation::SAVECONST, (int32_t)result.constants.size(), 0);
+			result.constants.push_back(_interner.Name(_functionsTable[i].getFuncName()));
 		}
-		auto it = _instructions.begin();
-		Instruction tmpInstr(0, Operation::PCONSTANTS, 0, 0);
-		_instructions.insert(it, tmpInstr);
-		return {};
+		code.emplace_back(0, Operation::PSTART, 0, 0);
+		code.insert(code.end(), _startSection.begin(), _startSection.end());
+		// 函数表
+		code.emplace_back(0, Operation::PFUNCTION, 0, 0);
+		for (int i=0; i<funcSize; i++){
+			code.emplace_back(_functionsTable[i].getOffset(), Operation::SAVEFUNCTION, _functionsTable[i].getParamSlots(), _functionsTable[i].getFrameSize());
+			if (_functionsTable[i].isImported())
+				result.imports[i] = _functionsTable[i].getRetType() != C0Type::TYPE_VOID;
+		}
+		for (auto& section : _functionSections)
+			code.insert(code.end(), section.begin(), section.end());
+		std::vector<Instruction>().swap(_startSection);
+		std::vector<std::vector<Instruction>>().swap(_functionSections);
+		return result;
 	}
 
 	// {<variable-declaration>}
@@ -85,12 +83,12 @@ namespace cc0 {
 			}
 			// <type-specifier>
 			if(next.value().GetType() == TokenType::SPECIFIER){
-				std::string str = next.value().GetValueString();
-				if(str == "int"){
+				auto type = next.value().GetC0Type();
+				if(type == C0Type::TYPE_INT){
 					///
-				}else if( str == "char" || str == "double" ){
+				}else if( type == C0Type::TYPE_CHAR || type == C0Type::TYPE_DOUBLE ){
 					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrUnimplemented);
-				}else if(str == "void"){
+				}else if(type == C0Type::TYPE_VOID){
 					if (isConst)
 						return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrConstVoid);
 					unreadToken();
@@ -139,7 +137,6 @@ namespace cc0 {
 	std::optional<CompilationError> Analyser::analyseInitDeclaratorList(int32_t isConst) {
 		auto err = analyseInitDeclarator(isConst);
 		if (err.has_value()) return err;
-		current_var_index++;
 		while (true){
 			// ','
 			auto next = nextToken();
@@ -148,7 +145,6 @@ namespace cc0 {
 			else if (next.value().GetType() == TokenType::COMMA){
 				err = analyseInitDeclarator(isConst);
 				if (err.has_value()) return err;
-				current_var_index++;
 			}else {
 				unreadToken();
 				return {};
@@ -157,39 +153,83 @@ namespace cc0 {
 		return {};
 	}
 
-	// <init-declarator> ::= <identifier>[<initializer>]
+	// <init-declarator> ::= <identifier>['['<integer-literal>']'][<initializer>]
 	// <initializer> ::= '='<expression>   
 	std::optional<CompilationError> Analyser::analyseInitDeclarator(int32_t isConst) {
 		// <identifier>
 		auto next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedIdentifier);
-		if (isDeclaredSameLevel(next.value().GetValueString(), current_func_level))
+		if (isDeclaredSameLevel(next.value().GetSymbol(), _current_func_level))
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrDuplicateDeclaration);
-		C0Var tmpvar(next.value().GetValueString(), "int", current_func_level, current_var_index);
-		// [<initializer>]
-		// 		[ '='<expression>  ]
+		C0Var tmpvar(next.value().GetSymbol(), C0Type::TYPE_INT, _current_func_level, _current_var_index);
 		next = nextToken();
 		if( ! next.has_value() )
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrEOF);
+		// ['['<integer-literal>']']
+		// 数组直接占用栈帧中连续的size个槽位
+		else if (next.value().GetType() == TokenType::LEFT_SQUARE_BRACKET){
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::UNSIGNED_INTEGER
+				|| std::any_cast<std::int32_t>(next.value().GetValue()) <= 0)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArraySize);
+			int32_t size = std::any_cast<std::int32_t>(next.value().GetValue());
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_SQUARE_BRACKET)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightSquareBracket);
+			tmpvar.setSize(size);
+			_instructions.emplace_back(_current_instruction_index++, Operation::SNEW, size, 0);
+			// [ '='<expression> ]  所有元素填充为同一个值
+			next = nextToken();
+			if ( ! next.has_value())
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrEOF);
+			else if (next.value().GetType() == TokenType::EQUAL_SIGN){
+				_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, 0, _current_var_index);
+				_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, size, 0);
+				auto err = analyseExpression();
+				if (err.has_value()) return err;
+				_instructions.emplace_back(_current_instruction_index++, Operation::IAFILL, 0, 0);
+				if (isConst)
+					tmpvar.setConst();
+			}
+			else {
+				if (isConst)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrConstantNeedValue);
+				unreadToken();
+			}
+			if (_current_func_level == 0)
+				addGlobalVariable(&tmpvar);
+			else 
+				addVariable(&tmpvar);
+			_current_var_index += size;
+			return {};
+		}
+		// [<initializer>]
+		// 		[ '='<expression>  ]
 		else if( next.value().GetType() == TokenType::EQUAL_SIGN){
 			// <expression>
+			std::size_t exprindex = _instructions.size();
 			auto err = analyseExpression();
 			if (err.has_value()) return err;
 			tmpvar.setInitialized();
-			if (isConst)
+			if (isConst) {
 				tmpvar.setConst();
+				// 槽位照常占用, 使用处不再读它
+				if (auto value = constantFrom(exprindex); value.has_value())
+					tmpvar.setValue(value.value());
+			}
 		}
 		else {
 			if (isConst)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrConstantNeedValue);
-			_instructions.emplace_back(current_instruction_index++, Operation::SNEW, 1, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::SNEW, 1, 0);
 			unreadToken();	//unrd '='
 		}
-		if (current_func_level == 0)
+		if (_current_func_level == 0)
 			addGlobalVariable(&tmpvar);
 		else 
 			addVariable(&tmpvar);
+		_current_var_index++;
 		return {};
 	}
 
@@ -203,6 +243,7 @@ namespace cc0 {
 	// <additive-expression> ::= <multiplicative-expression>{<additive-operator><multiplicative-expression>}
 	std::optional<CompilationError> Analyser::analyseAdditiveExpression() {
 		auto prefix = 1; // 1 => '+'; -1 => '-'
+		std::size_t lhs = _instructions.size();
 		// <multiplicative-expression>
 		auto err = analyseMultiplicativeExpression();
 		if (err.has_value()) return err;
@@ -216,17 +257,35 @@ namespace cc0 {
 				prefix = 1;
 			}else if (next.value().GetType() == TokenType::MINUS_SIGN) {
 				prefix = -1;
+			}else if (next.value().GetType() == TokenType::PLUS_PLUS || next.value().GetType() == TokenType::MINUS_MINUS) {
+				// a--2 以前是 a - (-2), 现在 -- 是一个记号; 后面跟着操作数时提示写成 a - -2
+				auto operand = nextToken();
+				if (operand.has_value()) {
+					switch (operand.value().GetType()) {
+					case TokenType::UNSIGNED_INTEGER:
+					case TokenType::IDENTIFIER:
+					case TokenType::LEFT_BRACKET:
+					case TokenType::PLUS_SIGN:
+					case TokenType::MINUS_SIGN:
+					case TokenType::SPAWN:
+					case TokenType::JOIN:
+						return std::make_optional<CompilationError>(next.value().GetStartPos(), ErrorCode::ErrIncrementBeforeOperand);
+					default:
+						unreadToken();
+					}
+				}
+				unreadToken();
+				return {};
 			}else {
 				unreadToken();
 				return {};
 			}
 			// <multiplicative-expression>
+			std::size_t rhs = _instructions.size();
 			err = analyseMultiplicativeExpression();
 			if (err.has_value()) return err;
-			if (prefix == -1)
-				_instructions.emplace_back(current_instruction_index++, Operation::ISUB, 0, 0);
-			else
-				_instructions.emplace_back(current_instruction_index++, Operation::IADD, 0, 0);
+			err = emitBinary(prefix == -1 ? Operation::ISUB : Operation::IADD, lhs, rhs);
+			if (err.has_value()) return err;
 		}
 		return {};
 	}
@@ -234,6 +293,7 @@ namespace cc0 {
 	// <multiplicative-expression> ::= 
 	// 		<cast-expression>{<multiplicative-operator><cast-expression>}
 	std::optional<CompilationError> Analyser::analyseMultiplicativeExpression() {
+		std::size_t lhs = _instructions.size();
 		// <cast-expression>
 		auto err = analyseCastExpression();
 		if(err.has_value()) return err;
@@ -253,13 +313,12 @@ namespace cc0 {
 				break;
 			}
 			// <cast-expression>
+			std::size_t rhs = _instructions.size();
 			err = analyseCastExpression();
 			if(err.has_value())
 				return err;
-			if (prefixMul == -1)
-				_instructions.emplace_back(current_instruction_index++, Operation::IDIV, 0, 0);
-			else 
-				_instructions.emplace_back(current_instruction_index++, Operation::IMUL, 0, 0);
+			err = emitBinary(prefixMul == -1 ? Operation::IDIV : Operation::IMUL, lhs, rhs);
+			if (err.has_value()) return err;
 		}
 		return {};
 	}
@@ -301,18 +360,26 @@ namespace cc0 {
 			unreadToken();
 		}
 		// <primary-expression>
+		std::size_t exprindex = _instructions.size();
 		auto err = analysePrimaryExpression();
 		if (err.has_value()) return err;
-		if (prefix == -1)
-			_instructions.emplace_back(current_instruction_index++, Operation::INEG, 0, 0);
+		if (prefix == -1) {
+			if (auto value = constantFrom(exprindex); value.has_value())
+				_instructions.back().SetX(static_cast<int32_t>(0u - static_cast<uint32_t>(value.value())));
+			else
+				_instructions.emplace_back(_current_instruction_index++, Operation::INEG, 0, 0);
+		}
 		return {};
 	}
 
 	// <primary-expression>
 	//		 '('<expression>')' 
     // 		|<identifier>
+    // 		|<identifier><array-subscript>
     // 		|<integer-literal>
     // 		|<function-call>
+    // 		|'spawn'<function-call>
+    // 		|'join' '('<expression>')'
 	std::optional<CompilationError> Analyser::analysePrimaryExpression() {
 		auto next = nextToken();
 		if( ! next.has_value() )
@@ -328,21 +395,31 @@ namespace cc0 {
 		// |<identifier>
 		// |<function-call>
 		else if (next.value().GetType() == TokenType::IDENTIFIER ) {
-			auto identiName = next.value().GetValueString();
-			if (isVariable(identiName, current_func_level)){
-				C0Var * ptmpvar = getVar(identiName, current_func_level);
+			auto identiName = next.value().GetSymbol();
+			if (isVariable(identiName, _current_func_level)){
+				C0Var * ptmpvar = getVar(identiName, _current_func_level);
 				if ( ! ptmpvar->isInitialized())
 					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNotInitialized);
+				if (ptmpvar->isArray()){
+					auto err = analyseArraySubscript(ptmpvar);
+					if (err.has_value()) return err;
+					_instructions.emplace_back(_current_instruction_index++, Operation::IALOAD, 0, 0);
+					return {};
+				}
+				if (ptmpvar->hasValue()) {
+					_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, ptmpvar->getValue(), 0);
+					return {};
+				}
 				// 计算层次差
 				int32_t level_diff = 0;
-				if (ptmpvar->getLevel() != current_func_level) 
+				if (ptmpvar->getLevel() != _current_func_level) 
 					level_diff = 1;
-				_instructions.emplace_back(current_instruction_index++, Operation::LOADA, level_diff, ptmpvar->getOffset());
-				_instructions.emplace_back(current_instruction_index++, Operation::ILOAD, 0, 0);
+				_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, level_diff, ptmpvar->getOffset());
+				_instructions.emplace_back(_current_instruction_index++, Operation::ILOAD, 0, 0);
 			}else if (isFunction(identiName)){
 				C0Function * pfunc = getFunc(identiName);
 				// 检查函数返回值
-				if(pfunc->getRetType() == "void")
+				if(pfunc->getRetType() == C0Type::TYPE_VOID)
 					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrExpressionNeedValue);
 				unreadToken();
 				auto err = analyseFunctionCall();
@@ -351,9 +428,32 @@ namespace cc0 {
 			else
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidIdentifier);
 		}
+		// |'spawn'<function-call>
+		// 任务句柄是int, void函数也可以spawn
+		else if (next.value().GetType() == TokenType::SPAWN) {
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER || ! isFunction(next.value().GetSymbol()))
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidIdentifier);
+			unreadToken();
+			auto err = analyseFunctionCall(Operation::ISPAWN);
+			if (err.has_value()) return err;
+		}
+		// |'join' '('<expression>')'
+		// void函数的结果为0
+		else if (next.value().GetType() == TokenType::JOIN) {
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::LEFT_BRACKET)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedLeftBracket);
+			auto err = analyseExpression();
+			if (err.has_value()) return err;
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_BRACKET)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBracket);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IJOIN, 0, 0);
+		}
 		// |<integer-literal>
 		else if (next.value().GetType() == TokenType::UNSIGNED_INTEGER) {
-			_instructions.emplace_back(current_instruction_index++, Operation::IPUSH, std::any_cast<std::int32_t>(next.value().GetValue()), 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, std::any_cast<std::int32_t>(next.value().GetValue()), 0);
 		}
 		else 
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrIncompleteExpression);
@@ -366,54 +466,96 @@ namespace cc0 {
 	std::optional<CompilationError> Analyser::analyseFunctionDefinitionMulti(){
 		while (true) {
 			auto next = nextToken();
-			std::string tmptype;
+			C0Type tmptype;
 			if ( ! next.has_value())
 				return {};
 			else if (next.value().GetType() != TokenType::SPECIFIER)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedTypeSpecifier);
-			else if (next.value().GetValueString() == "void")
-				tmptype = "void";
-			else if (next.value().GetValueString() == "int")
-				tmptype = "int";
+			else if (next.value().GetC0Type() == C0Type::TYPE_VOID)
+				tmptype = C0Type::TYPE_VOID;
+			else if (next.value().GetC0Type() == C0Type::TYPE_INT)
+				tmptype = C0Type::TYPE_INT;
 			else 
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedTypeSpecifier);
 			// <identifier>
 			next = nextToken();
 			if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedIdentifier);
-			if (isDeclaredSameLevel(next.value().GetValueString(), 0))
-				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrDuplicateDeclaration);
-			C0Function tmpfunc(next.value().GetValueString(), tmptype, current_func_index);
-			addFunction(&tmpfunc);
-			current_var_index = 0;
+			// 前面已经声明过的函数沿用声明的那一项, 调用已经用了它的下标
+			std::optional<std::vector<C0Var>> declared;
+			if (isDeclaredSameLevel(next.value().GetSymbol(), 0)){
+				C0Function * pfunc = getFunc(next.value().GetSymbol());
+				if (pfunc == nullptr || ! pfunc->isImported())
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrDuplicateDeclaration);
+				if (pfunc->getRetType() != tmptype)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrConflictingDeclaration);
+				_current_func_index = pfunc->getOffset();
+				declared.emplace();
+				declared.value().swap(*pfunc->getParamsList());
+			}
+			else {
+				_current_func_index = static_cast<int32_t>(_functionsTable.size());
+				C0Function tmpfunc(next.value().GetSymbol(), tmptype, _current_func_index);
+				addFunction(&tmpfunc);
+			}
+			_current_var_index = 0;
 			// 符号表中的层级+1，函数层级对应+1，符号表层级的递增在analyseCompoundStatement()函数中完成
-			current_func_level++;
+			_current_func_level++;
 			// <parameter-clause>
 			auto err = analyseParameterClause();
 			if (err.has_value()) return err;
+			// 参数的个数和是否为数组要与声明一致
+			if (declared.has_value()){
+				auto& params = *_functionsTable[_current_func_index].getParamsList();
+				bool same = params.size() == declared.value().size();
+				for (std::size_t i = 0; same && i < params.size(); i++)
+					same = params[i].isArray() == declared.value()[i].isArray();
+				if ( ! same)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrConflictingDeclaration);
+			}
+			// <函数声明> ::= <type-specifier><identifier><parameter-clause>';'
+			// 只有函数表中的一项, 没有函数体. 定义在后面或别的文件中, 由链接器按名字找到定义
+			next = nextToken();
+			if (next.has_value() && next.value().GetType() == TokenType::SEMICOLON) {
+				if ( ! _relocatable)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrFunctionWithoutBody);
+				_functionsTable[_current_func_index].setImported(true);
+				crushVar(1);
+				_current_func_level--;
+				continue;
+			}
+			_functionsTable[_current_func_index].setImported(false);
+			if (next.has_value())
+				unreadToken();
 			// 指令下标重置为0
-			current_instruction_index = 0;
-			_instructions.emplace_back(0, Operation::PFI, current_func_index, 0);
+			_current_instruction_index = 0;
+			_instructions.emplace_back(0, Operation::PFI, _current_func_index, 0);
+			_reachable = true;
 			// 变量声明的下标从参数表长度开始
-			current_var_index = _functionsTable[current_func_index].getParamsNum();
+			_current_var_index = _functionsTable[_current_func_index].getParamSlots();
 			// <compound-statement>
 			err = analyseCompoundStatement();
 			if (err.has_value()) return err;
+			_functionsTable[_current_func_index].setFrameSize(_current_var_index);
 			crushVar(1);
-			current_func_index++;
-			current_func_level--;
-			if( ! checkReturnTree(0))
+			_current_func_level--;
+			// 函数体的控制流图上能走到末尾的路径返回默认值
+			if (ControlFlowGraph(_instructions, 1, _instructions.size()).ExitReachable())
 				// return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedReturn);
 			{
-				if (tmptype == "int"){
-					_instructions.emplace_back(current_instruction_index++, Operation::IPUSH, 0, 0);
-					_instructions.emplace_back(current_instruction_index++, Operation::IRET, 0, 0);
+				if (tmptype == C0Type::TYPE_INT){
+					_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, 0, 0);
+					_instructions.emplace_back(_current_instruction_index++, Operation::IRET, 0, 0);
 				}
 				else {
-					_instructions.emplace_back(current_instruction_index++, Operation::RET, 0, 0);
+					_instructions.emplace_back(_current_instruction_index++, Operation::RET, 0, 0);
 				}
 			}
-			crushReturnTree();
+			if (_current_instruction_index > Instruction::MaxIndex)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrFunctionTooLong);
+			// 函数体是单独的一段
+			_functionSections.push_back(std::move(_instructions));
+			_instructions.clear();
 		}
 		return {};
 	}
@@ -447,7 +589,7 @@ namespace cc0 {
 	std::optional<CompilationError> Analyser::analyseParameterDeclarationList(){
 		auto err = analyseParameterDeclaration();
 		if (err.has_value()) return err;
-		current_var_index++;
+		_current_var_index++;
 		while (true){
 			// ','
 			auto next = nextToken();
@@ -456,7 +598,7 @@ namespace cc0 {
 			else if (next.value().GetType() == TokenType::COMMA){
 				err = analyseParameterDeclaration();
 				if (err.has_value()) return err;
-				current_var_index++;
+				_current_var_index++;
 			}else {
 				unreadToken();
 				return {};
@@ -466,7 +608,7 @@ namespace cc0 {
 	}
 
 	// <parameter-declaration>
-	// 		[<const-qualifier>]<type-specifier><identifier>
+	// 		[<const-qualifier>]<type-specifier><identifier>['['']']
 	std::optional<CompilationError> Analyser::analyseParameterDeclaration(){
 		auto next = nextToken();
 		auto isConst = 0;
@@ -481,12 +623,12 @@ namespace cc0 {
 		if( ! next.has_value())
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedTypeSpecifier);
 		else if(next.value().GetType() == TokenType::SPECIFIER){
-			std::string str = next.value().GetValueString();
-			if(str == "int"){
+			auto type = next.value().GetC0Type();
+			if(type == C0Type::TYPE_INT){
 				///
-			}else if( str == "char" || str == "double" ){
+			}else if( type == C0Type::TYPE_CHAR || type == C0Type::TYPE_DOUBLE ){
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrUnimplemented);
-			}else if(str == "void"){
+			}else if(type == C0Type::TYPE_VOID){
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrVoidInVar);
 			}else 
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedTypeSpecifier);
@@ -496,15 +638,28 @@ namespace cc0 {
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedIdentifier);
-		std::string tmpParaName = next.value().GetValueString();
-		if (isDeclaredSameLevel(tmpParaName, current_func_level))
+		Symbol tmpParaName = next.value().GetSymbol();
+		if (isDeclaredSameLevel(tmpParaName, _current_func_level))
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrDuplicateDeclaration);
-		C0Var tmpparam(tmpParaName, "int", 1, current_var_index);
+		C0Var tmpparam(tmpParaName, C0Type::TYPE_INT, 1, _current_var_index);
+		// ['['']'] 数组参数按地址传递, 下一个 slot 是长度
+		next = nextToken();
+		if ( ! next.has_value())
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrEOF);
+		else if (next.value().GetType() == TokenType::LEFT_SQUARE_BRACKET){
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_SQUARE_BRACKET)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightSquareBracket);
+			tmpparam.setSize(-1);
+			_current_var_index++;
+		}
+		else
+			unreadToken();
 		tmpparam.setInitialized();
 		if (isConst)
 			tmpparam.setConst();
 		// 加入函数的参数表
-		_functionsTable[current_func_index].getParamsList()->push_back(tmpparam);
+		_functionsTable[_current_func_index].getParamsList()->push_back(tmpparam);
 		// 加入局部变量表
 		addVariable(&tmpparam);
 		return {};
@@ -517,7 +672,7 @@ namespace cc0 {
 		auto next = nextToken();
 		if( ! next.has_value() || next.value().GetType() != TokenType::LEFT_BRACE)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedLeftBrace);
-		current_level++;
+		_current_level++;
 		// {<variable-declaration>}
 		auto err = analyseVariableDeclarationMulti();
 		if (err.has_value()) return err;
@@ -529,7 +684,7 @@ namespace cc0 {
 		if( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_BRACE)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBrace);
 		crushVar(1);
-		current_level--;
+		_current_level--;
 		return {};
 	}
 
@@ -542,24 +697,24 @@ namespace cc0 {
 	//		|<jump-statement>				return
 	//		|<print-statement>				print
 	//		|<scan-statement>				scan
-	//		|<assignment-expression>';'		<identifier>
+	//		|<assignment-expression>';'		<identifier>|'++'|'--'
 	//		|<function-call>';'				<identifier>
+	//		|<expression>';'				spawn|join
 	//		|';'							;
 	std::optional<CompilationError> Analyser::analyseStatementSeq(){
 		while (true){
 			auto next = nextToken();
 			if ( ! next.has_value()) return {};
 			auto ttype = next.value().GetType();
-			auto tvalue = next.value().GetValueString();
 			if (ttype == TokenType::LEFT_BRACE){
-				current_level++;
+				_current_level++;
 				auto err = analyseStatementSeq();
 				if (err.has_value()) return err;
 				next = nextToken();
 				if ( ! next.has_value() || next.value().GetType()!= TokenType::RIGHT_BRACE)
 					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBrace);
-				// crushVar(current_level);
-				current_level--;
+				// crushVar(_current_level);
+				_current_level--;
 			}else if (ttype == TokenType::IF){
 				unreadToken();
 				auto err = analyseConditionStatement();
@@ -581,8 +736,9 @@ namespace cc0 {
 				auto err = analyseScanStatement();
 				if (err.has_value()) return err;
 			}else if (ttype == TokenType::IDENTIFIER){
+				auto tvalue = next.value().GetSymbol();
 				// var 
-				if (isVariable(tvalue, current_func_level)){
+				if (isVariable(tvalue, _current_func_level)){
 					unreadToken();
 					auto err = analyseAssignmentExpression();
 					if (err.has_value()) return err;
@@ -592,14 +748,35 @@ namespace cc0 {
 					unreadToken();
 					auto err = analyseFunctionCall();
 					if (err.has_value()) return err; 
+					// 丢弃返回值, 否则语句前后的栈高度不同, 循环头的栈高度就与路径有关
+					if (getFunc(tvalue)->getRetType() != C0Type::TYPE_VOID)
+						_instructions.emplace_back(_current_instruction_index++, Operation::POP, 0, 0);
 				}
 				else return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidIdentifier);
 				// ;
 				next = nextToken();
 				if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
 					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
+			}else if (ttype == TokenType::PLUS_PLUS || ttype == TokenType::MINUS_MINUS){
+				unreadToken();
+				auto err = analyseAssignmentExpression();
+				if (err.has_value()) return err;
+				// ;
+				next = nextToken();
+				if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
+			}else if (ttype == TokenType::SPAWN || ttype == TokenType::JOIN){
+				// 丢弃句柄或结果
+				unreadToken();
+				auto err = analyseExpression();
+				if (err.has_value()) return err;
+				_instructions.emplace_back(_current_instruction_index++, Operation::POP, 0, 0);
+				// ;
+				next = nextToken();
+				if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
 			}else if (ttype == TokenType::SEMICOLON){
-				_instructions.emplace_back(current_instruction_index++, Operation::NOP, 0, 0);
+				_instructions.emplace_back(_current_instruction_index++, Operation::NOP, 0, 0);
 			}else {
 				unreadToken();
 				return {};
@@ -612,16 +789,15 @@ namespace cc0 {
 		auto next = nextToken();
 		if ( ! next.has_value()) return {};
 		auto ttype = next.value().GetType();
-		auto tvalue = next.value().GetValueString();
 		if (ttype == TokenType::LEFT_BRACE){
-			current_level++;
+			_current_level++;
 			auto err = analyseStatementSeq();
 			if (err.has_value()) return err;
 			next = nextToken();
 			if ( ! next.has_value() || next.value().GetType()!= TokenType::RIGHT_BRACE)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBrace);
-			// crushVar(current_level);
-			current_level--;
+			// crushVar(_current_level);
+			_current_level--;
 		}else if (ttype == TokenType::IF){
 			unreadToken();
 			auto err = analyseConditionStatement();
@@ -643,8 +819,9 @@ namespace cc0 {
 			auto err = analyseScanStatement();
 			if (err.has_value()) return err;
 		}else if (ttype == TokenType::IDENTIFIER){
+			auto tvalue = next.value().GetSymbol();
 			// var 
-			if (isVariable(tvalue,current_func_level)){
+			if (isVariable(tvalue,_current_func_level)){
 				unreadToken();
 				auto err = analyseAssignmentExpression();
 				if (err.has_value()) return err;
@@ -654,14 +831,35 @@ namespace cc0 {
 				unreadToken();
 				auto err = analyseFunctionCall();
 				if (err.has_value()) return err; 
+				// 丢弃返回值, 否则语句前后的栈高度不同, 循环头的栈高度就与路径有关
+				if (getFunc(tvalue)->getRetType() != C0Type::TYPE_VOID)
+					_instructions.emplace_back(_current_instruction_index++, Operation::POP, 0, 0);
 			}
 			else return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidIdentifier);
 			// ;
 			next = nextToken();
 			if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
+		}else if (ttype == TokenType::PLUS_PLUS || ttype == TokenType::MINUS_MINUS){
+			unreadToken();
+			auto err = analyseAssignmentExpression();
+			if (err.has_value()) return err;
+			// ;
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
+		}else if (ttype == TokenType::SPAWN || ttype == TokenType::JOIN){
+			// 丢弃句柄或结果
+			unreadToken();
+			auto err = analyseExpression();
+			if (err.has_value()) return err;
+			_instructions.emplace_back(_current_instruction_index++, Operation::POP, 0, 0);
+			// ;
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
 		}else if (ttype == TokenType::SEMICOLON){
-			_instructions.emplace_back(current_instruction_index++, Operation::NOP, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::NOP, 0, 0);
 		}else {
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidStatement);
 		}
@@ -678,55 +876,205 @@ namespace cc0 {
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::LEFT_BRACKET)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedLeftBracket);
-		Operation tmpop;
-		auto err = analyseCondition(tmpop);
+		// 条件为假时跳到 else 或 if 之后
+		std::vector<std::size_t> jumps;
+		auto err = analyseCondition(false, jumps);
 		if (err.has_value()) return err;
 		// ')'
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_BRACKET)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBracket);
-		int32_t ifindex = _instructions.size();
-		_instructions.emplace_back(current_instruction_index++, tmpop, 0, 0);
-		inReturnLeaf();
+		// 条件跳转的目标和它本身一样可达
+		bool jcondReachable = _reachable;
 		// <statement>
 		err = analyseStatement();
 		if (err.has_value()) return err;
 		// 'else'
 		next = nextToken();
 		if( ! next.has_value() || next.value().GetType() != TokenType::ELSE){
-			outReturnLeaf();
 			unreadToken();
 			// 跳到if{}之后
-			_instructions[ifindex].SetX(current_instruction_index);
+			patchJumps(jumps);
+			_reachable = _reachable || jcondReachable;
 			return {};
 		}
-		// 设置if最后的跳出点, 如果条件分支已经有return语句，就不用jmp
-		bool needjmp = false;
+		// 设置if最后的跳出点, 如果条件分支的所有路径都已经return，就不用jmp
+		bool needjmp = _reachable;
 		int32_t before_else_jmp_index = _instructions.size();
-		if (!checkPreReturnNode()){
-			needjmp = true;
-			_instructions.emplace_back(current_instruction_index++, Operation::JMP, 0, 0);	
+		if (needjmp){
+			_instructions.emplace_back(_current_instruction_index++, Operation::JMP, 0, 0);	
 		}
 		// 跳到else{}内部
-		_instructions[ifindex].SetX(current_instruction_index);
-		// 移动return节点
-		moveReturnLeaf();
+		patchJumps(jumps);
+		_reachable = jcondReachable;
 		// <statement>
 		err = analyseStatement();
 		if (err.has_value()) return err;
 		// 设置if最后的跳出点
 		if (needjmp)
-			_instructions[before_else_jmp_index].SetX(current_instruction_index);
-		outReturnLeaf();
+			_instructions[before_else_jmp_index].SetX(_current_instruction_index);
+		_reachable = _reachable || needjmp;
 		return {};
 	}
 
 	// <condition>
-	// 		<expression>[<relational-operator><expression>]
-	std::optional<CompilationError> Analyser::analyseCondition(Operation& tmpop){
-		auto err = analyseExpression();
+	// 		<and-condition>{'||'<and-condition>}
+	// 短路求值: 除了最后一项, 每一项为真时整个条件为真, 不再计算后面的项
+	std::optional<CompilationError> Analyser::analyseCondition(bool jumpIf, std::vector<std::size_t>& jumps){
+		// 条件为真时跳到条件之后 (jumpIf 为假时)
+		std::vector<std::size_t> shortcut;
+		while (nextLogicalOperatorIs(TokenType::OR_OR)) {
+			auto err = analyseAndCondition(true, jumpIf ? jumps : shortcut);
+			if (err.has_value()) return err;
+			// '||'
+			auto next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::OR_OR)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrIncompleteExpression);
+		}
+		auto err = analyseAndCondition(jumpIf, jumps);
 		if (err.has_value()) return err;
+		patchJumps(shortcut);
+		return {};
+	}
+
+	// <and-condition>
+	// 		<unary-condition>{'&&'<unary-condition>}
+	// 除了最后一项, 每一项为假时整个条件为假
+	std::optional<CompilationError> Analyser::analyseAndCondition(bool jumpIf, std::vector<std::size_t>& jumps){
+		// 条件为假时跳到条件之后 (jumpIf 为真时)
+		std::vector<std::size_t> shortcut;
+		while (nextLogicalOperatorIs(TokenType::AND_AND)) {
+			auto err = analyseUnaryCondition(false, jumpIf ? shortcut : jumps);
+			if (err.has_value()) return err;
+			// '&&'
+			auto next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::AND_AND)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrIncompleteExpression);
+		}
+		auto err = analyseUnaryCondition(jumpIf, jumps);
+		if (err.has_value()) return err;
+		patchJumps(shortcut);
+		return {};
+	}
+
+	// <unary-condition>
+	// 		'!'<unary-condition>
+	// 		|'('<condition>')'
+	// 		|<relational-condition>
+	// ! 作用于整个比较, !a < b 即 !(a < b); 取反不生成指令, 只交换跳转的条件
+	std::optional<CompilationError> Analyser::analyseUnaryCondition(bool jumpIf, std::vector<std::size_t>& jumps){
+		auto next = nextToken();
+		if ( ! next.has_value())
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrEOF);
+		if (next.value().GetType() == TokenType::EXCLAMATION)
+			return analyseUnaryCondition( ! jumpIf, jumps);
+		if (next.value().GetType() == TokenType::LEFT_BRACKET && isConditionGroup()){
+			auto err = analyseCondition(jumpIf, jumps);
+			if (err.has_value()) return err;
+			// ')'
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_BRACKET)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBracket);
+			return {};
+		}
+		unreadToken();
+		Operation op;
+		auto err = analyseRelationalCondition(op);
+		if (err.has_value()) return err;
+		jumps.push_back(_instructions.size());
+		_instructions.emplace_back(_current_instruction_index++, jumpIf ? ir::InvertBranch(op) : op, 0, 0);
+		return {};
+	}
+
+	bool Analyser::nextLogicalOperatorIs(TokenType op) const {
+		int32_t depth = 0;
+		for (auto i = _offset; i < _tokens.size(); i++) {
+			auto type = _tokens[i].GetType();
+			if (type == TokenType::LEFT_BRACKET || type == TokenType::LEFT_SQUARE_BRACKET)
+				depth++;
+			else if (type == TokenType::RIGHT_BRACKET || type == TokenType::RIGHT_SQUARE_BRACKET) {
+				if (depth == 0)
+					return false;
+				depth--;
+			}
+			// 条件不会越过这些 token
+			else if (type == TokenType::SEMICOLON || type == TokenType::LEFT_BRACE || type == TokenType::RIGHT_BRACE)
+				return false;
+			else if (depth == 0 && (type == TokenType::AND_AND || type == TokenType::OR_OR)) {
+				if (type == op)
+					return true;
+				if (op == TokenType::AND_AND)
+					return false;
+			}
+		}
+		return false;
+	}
+
+	// 表达式中不会出现比较, 逻辑运算符和 !
+	bool Analyser::isConditionGroup() const {
+		int32_t depth = 0;
+		for (auto i = _offset; i < _tokens.size(); i++) {
+			switch (_tokens[i].GetType()) {
+			case TokenType::LEFT_BRACKET:
+				depth++;
+				break;
+			case TokenType::RIGHT_BRACKET:
+				if (depth == 0)
+					return false;
+				depth--;
+				break;
+			case TokenType::SEMICOLON:
+			case TokenType::LEFT_BRACE:
+			case TokenType::RIGHT_BRACE:
+				return false;
+			case TokenType::EQUAL_EQUAL:
+			case TokenType::NOT_EQUAL:
+			case TokenType::LESS_OR_EQUAL:
+			case TokenType::GREATER_OR_EQUAL:
+			case TokenType::LEFT_ANGLE_BRACKET:
+			case TokenType::RIGHT_ANGLE_BRACKET:
+			case TokenType::AND_AND:
+			case TokenType::OR_OR:
+			case TokenType::EXCLAMATION:
+				return true;
+			default:
+				break;
+			}
+		}
+		return false;
+	}
+
+	void Analyser::patchJumps(const std::vector<std::size_t>& jumps) {
+		for (auto i : jumps)
+			_instructions[i].SetX(_current_instruction_index);
+	}
+
+	// <relational-condition>
+	// 		<expression>[<relational-operator><expression>]
+	// 		|<identifier><relational-operator><identifier>	整个数组按字典序比较
+	std::optional<CompilationError> Analyser::analyseRelationalCondition(Operation& tmpop){
+		// 预读: 没有下标的数组名
+		C0Var * plhs = nullptr;
 		auto next = nextToken();
+		if (next.has_value()){
+			if (next.value().GetType() == TokenType::IDENTIFIER && isVariable(next.value().GetSymbol(), _current_func_level)
+				&& getVar(next.value().GetSymbol(), _current_func_level)->isArray()){
+				auto peek = nextToken();
+				if (peek.has_value() && peek.value().GetType() != TokenType::LEFT_SQUARE_BRACKET)
+					plhs = getVar(next.value().GetSymbol(), _current_func_level);
+				if (peek.has_value())
+					unreadToken();
+			}
+			if (plhs == nullptr)
+				unreadToken();
+		}
+		if (plhs != nullptr)
+			loadArrayBase(plhs);
+		else{
+			auto err = analyseExpression();
+			if (err.has_value()) return err;
+		}
+		next = nextToken();
 		if ( ! next.has_value())
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrEOF);
 		else if (next.value().GetType() == TokenType::EQUAL_EQUAL)
@@ -742,13 +1090,31 @@ namespace cc0 {
 		else if (next.value().GetType() == TokenType::RIGHT_ANGLE_BRACKET)
 			tmpop = Operation::JLE;
 		else {
+			if (plhs != nullptr)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
 			unreadToken();
 			tmpop = Operation::JE;
 			return {};
 		}
-		err = analyseExpression();
+		if (plhs != nullptr){
+			next = nextToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER || ! isVariable(next.value().GetSymbol(), _current_func_level))
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+			C0Var * prhs = getVar(next.value().GetSymbol(), _current_func_level);
+			int32_t count = plhs->getSize() > 0 ? plhs->getSize() : prhs->getSize();
+			if ( ! prhs->isArray() || count <= 0 
+				|| (plhs->getSize() > 0 && prhs->getSize() > 0 && plhs->getSize() != prhs->getSize()))
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+			loadArrayBase(prhs);
+			checkArrayLength(plhs, count);
+			checkArrayLength(prhs, count);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, count, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IACMP, 0, 0);
+			return {};
+		}
+		auto err = analyseExpression();
 		if (err.has_value()) return err;
-		_instructions.emplace_back(current_instruction_index++, Operation::ICMP, 0, 0);	
+		_instructions.emplace_back(_current_instruction_index++, Operation::ICMP, 0, 0);	
 		return {};
 	}
 
@@ -764,24 +1130,23 @@ namespace cc0 {
 		if ( ! next.has_value() || next.value().GetType() != TokenType::LEFT_BRACKET)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedLeftBracket);
 		// 标记jmp类指令坐标
-		int32_t while_index = current_instruction_index;
-		// <condition>
-		Operation tmpop;
-		auto err = analyseCondition(tmpop);
+		int32_t while_index = _current_instruction_index;
+		// <condition>, 为假时跳出循环
+		std::vector<std::size_t> jumps;
+		auto err = analyseCondition(false, jumps);
 		if (err.has_value()) return err;
 		// ')'
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_BRACKET)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBracket);
-		// 设置jcond跳出点
-		int32_t jcond_global_index = _instructions.size();
-		_instructions.emplace_back(current_instruction_index++, tmpop, 0, 0);
+		bool jcondReachable = _reachable;
 		err = analyseStatement();
 		if (err.has_value()) return err;
 		// 设置continue点
-		_instructions.emplace_back(current_instruction_index++, Operation::JMP, while_index, 0);
+		_instructions.emplace_back(_current_instruction_index++, Operation::JMP, while_index, 0);
 		// 设置jmp跳出点
-		_instructions[jcond_global_index].SetX(current_instruction_index);
+		patchJumps(jumps);
+		_reachable = jcondReachable;
 		return {};
 	}
 
@@ -792,20 +1157,20 @@ namespace cc0 {
 		auto next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::RETURN)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidStatement);
-		std::string rettype = _functionsTable[current_func_index].getRetType();
-		if (rettype == "int"){
+		C0Type rettype = _functionsTable[_current_func_index].getRetType();
+		if (rettype == C0Type::TYPE_INT){
 			auto err = analyseExpression();
 			if (err.has_value()) return err;
 		}
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
-		if (rettype == "int"){
-			_instructions.emplace_back(current_instruction_index++, Operation::IRET, 0, 0);
+		if (rettype == C0Type::TYPE_INT){
+			_instructions.emplace_back(_current_instruction_index++, Operation::IRET, 0, 0);
 		}
 		else 
-			_instructions.emplace_back(current_instruction_index++, Operation::RET, 0, 0);
-		addReturnNode();
+			_instructions.emplace_back(_current_instruction_index++, Operation::RET, 0, 0);
+		_reachable = false;
 		return {};
 	}
 
@@ -828,13 +1193,13 @@ namespace cc0 {
 			next = nextToken();
 			if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
 				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
-			_instructions.emplace_back(current_instruction_index++, Operation::PRINTL, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::PRINTL, 0, 0);
 			return {};
 		}else unreadToken();
 		// <printable> {',' <printable>}
 		auto err = analyseExpression();
 		if (err.has_value()) return err;
-		_instructions.emplace_back(current_instruction_index++, Operation::IPRINT, 0, 0);
+		_instructions.emplace_back(_current_instruction_index++, Operation::IPRINT, 0, 0);
 		while (true) {
 			next = nextToken();
 			if ( ! next.has_value() )
@@ -844,11 +1209,11 @@ namespace cc0 {
 				break;
 			}
 			// 输出空格
-			_instructions.emplace_back(current_instruction_index++, Operation::BIPUSH, 32, 0);
-			_instructions.emplace_back(current_instruction_index++, Operation::CPRINT, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::BIPUSH, 32, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::CPRINT, 0, 0);
 			err = analyseExpression();
 			if (err.has_value()) return err;
-			_instructions.emplace_back(current_instruction_index++, Operation::IPRINT, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IPRINT, 0, 0);
 		}
 		// ')'
 		next = nextToken();
@@ -858,12 +1223,12 @@ namespace cc0 {
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::SEMICOLON)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNoSemicolon);
-		_instructions.emplace_back(current_instruction_index++, Operation::PRINTL, 0, 0);
+		_instructions.emplace_back(_current_instruction_index++, Operation::PRINTL, 0, 0);
 		return {};
 	}
 
 	// <scan-statement> ::= 
-    // 		'scan' '(' <identifier> ')' ';'
+    // 		'scan' '(' <identifier>[<array-subscript>] ')' ';'
 	std::optional<CompilationError> Analyser::analyseScanStatement(){
 		auto next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::SCAN)
@@ -874,17 +1239,25 @@ namespace cc0 {
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedIdentifier);
-		if ( ! isVariable(next.value().GetValueString(), current_func_level))
+		if ( ! isVariable(next.value().GetSymbol(), _current_func_level))
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidIdentifier);
-		C0Var * ptmpvar = getVar(next.value().GetValueString(), current_func_level);
+		C0Var * ptmpvar = getVar(next.value().GetSymbol(), _current_func_level);
 		if (ptmpvar->isConst())
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrAssignToConstant);
-		int32_t level_diff = 0;
-		if (ptmpvar->getLevel() != current_func_level) 
-			level_diff = 1;
-		_instructions.emplace_back(current_instruction_index++, Operation::LOADA, level_diff, ptmpvar->getOffset());
-		_instructions.emplace_back(current_instruction_index++, Operation::ISCAN, 0, 0);
-		_instructions.emplace_back(current_instruction_index++, Operation::ISTORE, 0, 0);
+		if (ptmpvar->isArray()){
+			auto err = analyseArraySubscript(ptmpvar);
+			if (err.has_value()) return err;
+			_instructions.emplace_back(_current_instruction_index++, Operation::ISCAN, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IASTORE, 0, 0);
+		}
+		else {
+			int32_t level_diff = 0;
+			if (ptmpvar->getLevel() != _current_func_level) 
+				level_diff = 1;
+			_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, level_diff, ptmpvar->getOffset());
+			_instructions.emplace_back(_current_instruction_index++, Operation::ISCAN, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::ISTORE, 0, 0);
+		}
 		if ( ! ptmpvar->isInitialized())
 			ptmpvar->setInitialized();
 		// ')'
@@ -899,67 +1272,316 @@ namespace cc0 {
 	}
 
 	// <assignment-expression>
-	// 		<identifier><assignment-operator><expression>
+	// 		<lvalue><assignment-operator><expression>
+	// 		|<lvalue>('++'|'--')
+	// 		|('++'|'--')<lvalue>
+	// 		|<array-assignment>
+	// <lvalue> ::= <identifier>[<array-subscript>]
+	// <assignment-operator> ::= '='|'+='|'-='|'*='|'/='
 	std::optional<CompilationError> Analyser::analyseAssignmentExpression(){
-		// <identifier>
+		// ['++'|'--']
 		auto next = nextToken();
-		if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER || !isVariable(next.value().GetValueString(),current_func_level) )
+		int32_t step = 0; // 1 => '++'; -1 => '--'
+		if (next.has_value() && next.value().GetType() == TokenType::PLUS_PLUS){
+			step = 1;
+			next = nextToken();
+		}else if (next.has_value() && next.value().GetType() == TokenType::MINUS_MINUS){
+			step = -1;
+			next = nextToken();
+		}
+		// <identifier>
+		if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER || !isVariable(next.value().GetSymbol(),_current_func_level) )
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedIdentifier);
-		C0Var * pvar = getVar(next.value().GetValueString(),current_func_level);
+		C0Var * pvar = getVar(next.value().GetSymbol(),_current_func_level);
 		if (pvar->isConst())
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrAssignToConstant);
-		// var addr 加载指令
 		// 计算层次差
 		int32_t level_diff = 0;
-		if (pvar->getLevel() != current_func_level) 
+		if (pvar->getLevel() != _current_func_level) 
 			level_diff = 1;
-		_instructions.emplace_back(current_instruction_index++, Operation::LOADA, level_diff, pvar->getOffset());
+		// [<array-subscript>]  之后栈上是 array, index
+		bool element = false;
+		if (pvar->isArray()){
+			next = nextToken();
+			if (next.has_value())
+				unreadToken();
+			if ( ! next.has_value() || next.value().GetType() != TokenType::LEFT_SQUARE_BRACKET){
+				if (step != 0)
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+				return analyseArrayAssignment(pvar);
+			}
+			auto err = analyseArraySubscript(pvar);
+			if (err.has_value()) return err;
+			element = true;
+		}
 		// <assignment-operator>
+		auto optype = TokenType::PLUS_EQUAL;
+		if (step == 0){
+			next = nextToken();
+			if ( ! next.has_value())
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidAssignment);
+			optype = next.value().GetType();
+			if (optype == TokenType::PLUS_PLUS){
+				step = 1;
+				optype = TokenType::PLUS_EQUAL;
+			}else if (optype == TokenType::MINUS_MINUS){
+				step = -1;
+				optype = TokenType::PLUS_EQUAL;
+			}
+			// '='
+			else if (optype == TokenType::EQUAL_SIGN){
+				// var addr 加载指令
+				if ( ! element)
+					_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, level_diff, pvar->getOffset());
+				// <expression>
+				auto err = analyseExpression();
+				if (err.has_value()) return err;
+				if ( ! pvar->isInitialized())
+					pvar->setInitialized();
+				_instructions.emplace_back(_current_instruction_index++, element ? Operation::IASTORE : Operation::ISTORE, 0, 0);
+				return {};
+			}
+			else if (optype != TokenType::PLUS_EQUAL && optype != TokenType::MINUS_EQUAL
+				&& optype != TokenType::MULTIPLICATION_EQUAL && optype != TokenType::DIVISION_EQUAL)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidAssignment);
+		}
+		// 复合赋值要读旧值
+		if ( ! pvar->isInitialized())
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNotInitialized);
+		// 当前函数的局部变量: 用iinc/iincs原地更新栈帧中的槽位
+		if ( ! element && level_diff == 0 && (optype == TokenType::PLUS_EQUAL || optype == TokenType::MINUS_EQUAL)){
+			if (step != 0){
+				_instructions.emplace_back(_current_instruction_index++, Operation::IINC, pvar->getOffset(), step);
+				return {};
+			}
+			std::size_t exprindex = _instructions.size();
+			auto err = analyseExpression();
+			if (err.has_value()) return err;
+			// 右边只有一个立即数, 直接放进iinc
+			if (_instructions.size() == exprindex+1 && _instructions.back().GetOperation() == Operation::IPUSH){
+				int32_t value = _instructions.back().GetX();
+				_instructions.pop_back();
+				_current_instruction_index--;
+				if (optype == TokenType::MINUS_EQUAL)
+					value = (int32_t)(0u - (uint32_t)value);
+				_instructions.emplace_back(_current_instruction_index++, Operation::IINC, pvar->getOffset(), value);
+				return {};
+			}
+			if (optype == TokenType::MINUS_EQUAL)
+				_instructions.emplace_back(_current_instruction_index++, Operation::INEG, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IINCS, pvar->getOffset(), 0);
+			return {};
+		}
+		// 其余情况: 地址只加载一次, dup后读旧值, 运算后写回
+		if (element){
+			_instructions.emplace_back(_current_instruction_index++, Operation::DUP2, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IALOAD, 0, 0);
+		}
+		else {
+			_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, level_diff, pvar->getOffset());
+			_instructions.emplace_back(_current_instruction_index++, Operation::DUP, 0, 0);
+			_instructions.emplace_back(_current_instruction_index++, Operation::ILOAD, 0, 0);
+		}
+		if (step != 0)
+			_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, step, 0);
+		else {
+			std::size_t exprindex = _instructions.size();
+			auto err = analyseExpression();
+			if (err.has_value()) return err;
+			// 与 '/' 一样, 除数是常量 0 时报错
+			auto value = constantFrom(exprindex);
+			if (optype == TokenType::DIVISION_EQUAL && value.has_value() && value.value() == 0)
+				return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrDivisionByZero);
+		}
+		if (optype == TokenType::PLUS_EQUAL)
+			_instructions.emplace_back(_current_instruction_index++, Operation::IADD, 0, 0);
+		else if (optype == TokenType::MINUS_EQUAL)
+			_instructions.emplace_back(_current_instruction_index++, Operation::ISUB, 0, 0);
+		else if (optype == TokenType::MULTIPLICATION_EQUAL)
+			_instructions.emplace_back(_current_instruction_index++, Operation::IMUL, 0, 0);
+		else
+			_instructions.emplace_back(_current_instruction_index++, Operation::IDIV, 0, 0);
+		_instructions.emplace_back(_current_instruction_index++, element ? Operation::IASTORE : Operation::ISTORE, 0, 0);
+		return {};
+	}
+
+	// <array-assignment>
+	// 		<identifier>'='<identifier>		整个数组复制
+	// 		|<identifier>'='<expression>	所有元素填充为同一个值
+	std::optional<CompilationError> Analyser::analyseArrayAssignment(C0Var* pvar){
 		// '='
-		next = nextToken();
+		auto next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::EQUAL_SIGN)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidAssignment);
+		// <identifier>, 后面不是'['
+		next = nextToken();
+		if (next.has_value() && next.value().GetType() == TokenType::IDENTIFIER && isVariable(next.value().GetSymbol(), _current_func_level)
+			&& getVar(next.value().GetSymbol(), _current_func_level)->isArray()){
+			C0Var * psrc = getVar(next.value().GetSymbol(), _current_func_level);
+			auto peek = nextToken();
+			if (peek.has_value())
+				unreadToken();
+			if ( ! peek.has_value() || peek.value().GetType() != TokenType::LEFT_SQUARE_BRACKET){
+				int32_t count = pvar->getSize() > 0 ? pvar->getSize() : psrc->getSize();
+				if (count <= 0 || (pvar->getSize() > 0 && psrc->getSize() > 0 && pvar->getSize() != psrc->getSize()))
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+				checkArrayLength(pvar, count);
+				checkArrayLength(psrc, count);
+				loadArrayBase(pvar);
+				loadArrayBase(psrc);
+				_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, count, 0);
+				_instructions.emplace_back(_current_instruction_index++, Operation::IACOPY, 0, 0);
+				return {};
+			}
+		}
+		if (next.has_value())
+			unreadToken();
 		// <expression>
+		if (pvar->getSize() <= 0)
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+		loadArrayBase(pvar);
+		_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, pvar->getSize(), 0);
 		auto err = analyseExpression();
 		if (err.has_value()) return err;
-		if ( ! pvar->isInitialized())
-			pvar->setInitialized();
-		_instructions.emplace_back(current_instruction_index++, Operation::ISTORE, 0, 0);
+		_instructions.emplace_back(_current_instruction_index++, Operation::IAFILL, 0, 0);
 		return {};
 	}
 
+	// <array-subscript> ::= '['<expression>']'
+	// 栈上留下 array, index
+	std::optional<CompilationError> Analyser::analyseArraySubscript(C0Var* pvar){
+		// '['
+		auto next = nextToken();
+		if ( ! next.has_value() || next.value().GetType() != TokenType::LEFT_SQUARE_BRACKET)
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+		loadArrayBase(pvar);
+		// <expression>
+		std::size_t exprindex = _instructions.size();
+		auto err = analyseExpression();
+		if (err.has_value()) return err;
+		// 常量下标在编译期检查越界, 其余的在运行时检查
+		auto index = constantFrom(exprindex);
+		if (index.has_value() && (index.value() < 0 || (pvar->getSize() > 0 && index.value() >= pvar->getSize())))
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrArrayIndexOutOfRange);
+		if ( ! index.has_value() || pvar->getSize() < 0){
+			loadArrayLength(pvar);
+			_instructions.emplace_back(_current_instruction_index++, Operation::IACHK, 0, 0);
+		}
+		// ']'
+		next = nextToken();
+		if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_SQUARE_BRACKET)
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightSquareBracket);
+		return {};
+	}
+
+	std::optional<int32_t> Analyser::constantFrom(std::size_t begin){
+		if (_instructions.size() != begin + 1 || _instructions.back().GetOperation() != Operation::IPUSH)
+			return {};
+		return _instructions.back().GetX();
+	}
+
+	std::optional<CompilationError> Analyser::emitBinary(Operation op, std::size_t lhs, std::size_t rhs){
+		auto r = constantFrom(rhs);
+		if (op == Operation::IDIV && r.has_value() && r.value() == 0)
+			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrDivisionByZero);
+		// 左操作数的代码是 [lhs, rhs), 右操作数的代码是 [rhs, 段尾)
+		bool fold = r.has_value() && rhs == lhs + 1 && _instructions[lhs].GetOperation() == Operation::IPUSH;
+		// INT_MIN / -1 留到运行时
+		if (fold && op == Operation::IDIV && _instructions[lhs].GetX() == INT32_MIN && r.value() == -1)
+			fold = false;
+		if ( ! fold){
+			_instructions.emplace_back(_current_instruction_index++, op, 0, 0);
+			return {};
+		}
+		int64_t a = _instructions[lhs].GetX(), b = r.value(), v = 0;
+		switch (op) {
+		case Operation::IADD: v = a + b; break;
+		case Operation::ISUB: v = a - b; break;
+		case Operation::IMUL: v = a * b; break;
+		case Operation::IDIV: v = a / b; break;
+		default: DieAndPrint("folding a non-arithmetic operation"); break;
+		}
+		// 溢出时按 32 位补码回绕
+		_instructions.pop_back();
+		_current_instruction_index--;
+		_instructions.back().SetX(static_cast<int32_t>(static_cast<uint32_t>(v)));
+		return {};
+	}
+
+	void Analyser::loadArrayBase(C0Var* pvar){
+		int32_t level_diff = 0;
+		if (pvar->getLevel() != _current_func_level) 
+			level_diff = 1;
+		_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, level_diff, pvar->getOffset());
+		// 数组参数的槽位里存的是首地址
+		if (pvar->getSize() < 0)
+			_instructions.emplace_back(_current_instruction_index++, Operation::ALOAD, 0, 0);
+	}
+
+	void Analyser::loadArrayLength(C0Var* pvar){
+		if (pvar->getSize() > 0){
+			_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, pvar->getSize(), 0);
+			return;
+		}
+		// 参数都在当前函数的栈帧中
+		_instructions.emplace_back(_current_instruction_index++, Operation::LOADA, 0, pvar->getOffset() + 1);
+		_instructions.emplace_back(_current_instruction_index++, Operation::ILOAD, 0, 0);
+	}
+
+	// 最后一个元素 count-1 在范围内, 不检查多余的元素
+	void Analyser::checkArrayLength(C0Var* pvar, int32_t count){
+		if (pvar->getSize() > 0)
+			return;
+		_instructions.emplace_back(_current_instruction_index++, Operation::IPUSH, count - 1, 0);
+		loadArrayLength(pvar);
+		_instructions.emplace_back(_current_instruction_index++, Operation::IACHK, 0, 0);
+		_instructions.emplace_back(_current_instruction_index++, Operation::POP, 0, 0);
+	}
+
 	// <function-call>
 	// 		<identifier> '(' [<expression-list>] ')'
-	std::optional<CompilationError> Analyser::analyseFunctionCall(){
+	// op为CALL或ISPAWN
+	std::optional<CompilationError> Analyser::analyseFunctionCall(Operation op){
 		// <identifier> 
 		// 父调用函数检查过是函数标识符了
 		auto next = nextToken();
-		C0Function * pfunc = getFunc(next.value().GetValueString());
-		auto paramsNum = (*pfunc).getParamsNum();
+		C0Function * pfunc = getFunc(next.value().GetSymbol());
 		// '(' 
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::LEFT_BRACKET)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedLeftBracket);
 		// [<expression-list>] 
-		auto err = analyseExpressionList(paramsNum);
+		auto err = analyseExpressionList(pfunc);
 		if (err.has_value()) return err;
 		// ')'
 		next = nextToken();
 		if ( ! next.has_value() || next.value().GetType() != TokenType::RIGHT_BRACKET)
 			return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrNeedRightBracket);
-		// call
-		_instructions.emplace_back(current_instruction_index++, Operation::CALL, pfunc->getOffset(), 0);
+		// call | spawn
+		_instructions.emplace_back(_current_instruction_index++, op, pfunc->getOffset(), 0);
 		return {};
 	}
 
 	// <expression-list>
 	// 		<expression>{','<expression>}
-	std::optional<CompilationError> Analyser::analyseExpressionList(int32_t paraNum) {
+	// 数组参数对应的实参是没有下标的数组名
+	std::optional<CompilationError> Analyser::analyseExpressionList(C0Function* pfunc) {
+		int32_t paraNum = pfunc->getParamsNum();
 		if (paraNum==0)
 			return {};
-		for(;paraNum>0;paraNum--) {
-			auto err = analyseExpression();
-			if (err.has_value()) return err;
+		for(int32_t i = 0;paraNum>0;paraNum--, i++) {
+			if ((*pfunc->getParamsList())[i].isArray()){
+				auto next = nextToken();
+				if ( ! next.has_value() || next.value().GetType() != TokenType::IDENTIFIER || ! isVariable(next.value().GetSymbol(), _current_func_level)
+					|| ! getVar(next.value().GetSymbol(), _current_func_level)->isArray())
+					return std::make_optional<CompilationError>(_current_pos, ErrorCode::ErrInvalidArrayUse);
+				loadArrayBase(getVar(next.value().GetSymbol(), _current_func_level));
+				loadArrayLength(getVar(next.value().GetSymbol(), _current_func_level));
+			}
+			else{
+				auto err = analyseExpression();
+				if (err.has_value()) return err;
+			}
 			if (paraNum == 1)
 				break;
 			// ','
@@ -987,7 +1609,7 @@ namespace cc0 {
 	}
 
 	void Analyser::addGlobalVariable(C0Var* pc0var) {
-		_globalVariablesTable.push_back(*pc0var);
+		_globalVariablesTable.add(pc0var->getName(), *pc0var, 0);
 	}
 
 	// void Analyser::addGlobalConstant(C0Var& c0var) {
@@ -995,11 +1617,11 @@ namespace cc0 {
 	// }
 
 	void Analyser::addFunction(C0Function* pfunc) {
-		_functionsTable.push_back(*pfunc);
+		_functionsTable.add(pfunc->getFuncName(), *pfunc, 0);
 	}
 
 	void Analyser::addVariable(C0Var* pc0var) {
-		_variablesTable.push_back(*pc0var);
+		_variablesTable.add(pc0var->getName(), *pc0var, pc0var->getLevel());
 	}
 
 	// bool Analyser::isDeclared(const std::string& s, int32_t level) {
@@ -1012,19 +1634,12 @@ namespace cc0 {
 	// }
 
 	// 同级作用域下变量是否已经声明
-	bool Analyser::isDeclaredSameLevel(const std::string& s, int32_t level) {
+	bool Analyser::isDeclaredSameLevel(Symbol s, int32_t level) {
 		if (level < 0)
 			return false;
 		else if (level == 0)
 			return (isFunction(s)||isGlobalVariable(s));
-		int len = _variablesTable.size();
-		for (int i=len-1; i>=0; i--){
-			if (_variablesTable[i].getLevel() < level)
-				return false;
-			else if (s == _variablesTable[i].getName() )
-				return true;
-		}
-		return false;
+		return _variablesTable.findFrom(s, level) != nullptr;
 	}
 
 	// bool Analyser::isGlobalConstant(const std::string&s) {
@@ -1036,122 +1651,38 @@ namespace cc0 {
 	// 	return false;
 	// }
 
-	bool Analyser::isFunction(const std::string&s) {
-		int len = _functionsTable.size();
-		for (int i = 0; i<len; i++){
-			if (s == _functionsTable[i].getFuncName() )
-				return true;
-		}
-		return false;
+	bool Analyser::isFunction(Symbol s) {
+		return _functionsTable.find(s) != nullptr;
 	}
 
-	bool Analyser::isGlobalVariable(const std::string&s) {
-		int len = _globalVariablesTable.size();
-		for (int i = 0; i<len; i++){
-			if (s == _globalVariablesTable[i].getName() )
-				return true;
-		}
-		return false;
+	bool Analyser::isGlobalVariable(Symbol s) {
+		return _globalVariablesTable.find(s) != nullptr;
 	}
 
-	bool Analyser::isVariable(const std::string&s, int32_t level) {
-		int len = _variablesTable.size();
-		for (int i=len-1; i>=0; i--){
-			if (_variablesTable[i].getLevel() < level)
-				break;
-			else if (s == _variablesTable[i].getName() )
-				return true;
-		}
-		return isGlobalVariable(s);
+	bool Analyser::isVariable(Symbol s, int32_t level) {
+		return getVar(s, level) != nullptr;
 	}
 
-	C0Var* Analyser::getVar(const std::string& s,int32_t level){
-		int32_t len = _variablesTable.size();
-		C0Var * pVar;
-		for (int i=len-1; i>=0; i--){
-			if (_variablesTable[i].getLevel()<level)
-				break;
-			else if (s == _variablesTable[i].getName())
-				return &_variablesTable[i];
-		}
-		pVar = getGlobalVar(s);
+	// 先找level层及更内层的局部变量, 再找全局变量
+	C0Var* Analyser::getVar(Symbol s, int32_t level){
+		C0Var * pVar = _variablesTable.findFrom(s, level);
+		if (pVar == nullptr)
+			pVar = getGlobalVar(s);
 		return pVar;
 	}
 
-	C0Var * Analyser::getGlobalVar(const std::string& s){
-		int32_t len = _globalVariablesTable.size();
-		for (int i=len-1; i>=0; i--){
-			if (s == _globalVariablesTable[i].getName())
-				return &_globalVariablesTable[i];
-		}
-		return nullptr;
+	C0Var * Analyser::getGlobalVar(Symbol s){
+		return _globalVariablesTable.find(s);
 	}
 
-	C0Function* Analyser::getFunc(const std::string& s){
-		int32_t len = _functionsTable.size();
-		for (int i=0; i<len; i++){
-			if (s == _functionsTable[i].getFuncName())
-				return &_functionsTable[i];
-		}
-		return nullptr;
+	C0Function* Analyser::getFunc(Symbol s){
+		return _functionsTable.find(s);
 	}
 
+	// 删除level层及更内层的变量, 被遮住的同名变量重新可见
 	void Analyser::crushVar(int32_t level){
 		if (level <= 0)
 			return;
-		while(true){
-			if (!_variablesTable.empty() && _variablesTable.back().getLevel() == level) 
-				_variablesTable.pop_back();
-			else 
-				break;
-		}
-		return ;
-	}
-
-	// 清除return树
-	void Analyser::crushReturnTree(){
-		while( ! _returnTree.empty()){
-			_returnTree.pop_back();
-		}
-		_preReturnIndex = 0;
-	}
-	// 设置returnIndex的节点为true,如果之前有元素未初始化,则初始化为false
-	void Analyser::addReturnNode(){
-		extendReturnTree();
-		_returnTree[_preReturnIndex] = true;
-	}
-	void Analyser::extendReturnTree(){
-		int32_t tmpsize = _returnTree.size();
-		while(tmpsize<=_preReturnIndex){
-			_returnTree.push_back(false);
-			tmpsize++;
-		}
-	}
-	// returnTree生长叶子
-	void Analyser::inReturnLeaf(){
-		_preReturnIndex = _preReturnIndex*2+1;
-		extendReturnTree();
-	}
-	// 左叶子变右叶子
-	void Analyser::moveReturnLeaf(){
-		_preReturnIndex = _preReturnIndex+1;
-		extendReturnTree();
-	}
-	// 退出叶子
-	void Analyser::outReturnLeaf(){
-		_preReturnIndex = (_preReturnIndex-1)/2;
-	}
-
-	bool Analyser::checkReturnTree(int32_t givenIndex){
-		if ( ((int32_t)(_returnTree.size()))<=givenIndex)
-			return false;
-		else
-			return _returnTree[givenIndex] || 
-				(checkReturnTree(givenIndex*2+1) && checkReturnTree(givenIndex*2+2));
-	}
-
-	bool Analyser::checkPreReturnNode(){
-		return _returnTree[_preReturnIndex] || 
-			(checkReturnTree(_preReturnIndex*2+1) && checkReturnTree(_preReturnIndex*2+2));
+		_variablesTable.crush(level);
 	}
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "error/error.h"
 #include "instruction/instruction.h"
 #include "tokenizer/token.h"
+#include "analyser/symbol_table.hpp"
+#include "ir/cfg.h"
 
 #include <vector>
 #include <optional>
@@ -32,34 +34,46 @@ namespace cc0 {
 		friend void swap(C0Var& lhs, C0Var& rhs);
 
 		////这里强行让变量初始化，因为我未能解决函数调用它之后的函数导致的先后顺序即变量赋值和使用的顺序
-		C0Var(const std::string& name, const std::string& type, const int32_t& level, const int32_t& offset)
-			: _name(name), _type(type), _level(level), _offset(offset), _isInitialized(1), _isConst(0) {}
+		C0Var(Symbol name, C0Type type, const int32_t& level, const int32_t& offset)
+			: _name(name), _type(type), _level(level), _offset(offset), _isInitialized(1), _isConst(0), _hasValue(false), _value(0) {}
+		C0Var(const C0Var&) = default;
 		C0Var& operator=(C0Var t) { swap(*this, t); return *this; }
 
-		std::string getName() const { return _name; }
-		std::string getType() const { return _type; }
+		Symbol getName() const { return _name; }
+		C0Type getType() const { return _type; }
 		int32_t getLevel() const { return _level; }
 		int32_t getOffset() const { return _offset; }
 		int32_t isInitialized() const { return _isInitialized; }
 		int32_t isConst() const { return _isConst; }
+		// 0: 普通变量; >0: 数组长度; -1: 数组参数(槽位里存首地址,长度未知)
+		int32_t getSize() const { return _size; }
+		bool isArray() const { return _size != 0; }
+		// 初始值是常量表达式的 const 变量, 使用处直接压入这个值
+		bool hasValue() const { return _hasValue; }
+		int32_t getValue() const { return _value; }
 		// std::string getValueString() const { return _valueString; };
 		
-		void setName(const std::string& name) {this->_name = name; }
-		void setType(const std::string& type) {this->_type = type; }
+		void setName(Symbol name) {this->_name = name; }
+		void setType(C0Type type) {this->_type = type; }
 		void setLevel(int32_t level) {this->_level = level;}
 		void setOffset(int32_t offset) {this->_offset = offset;}
 		void setInitialized() {this->_isInitialized = 1;}
 		void setConst() {this->_isConst = 1;}
+		void setSize(int32_t size) {this->_size = size;}
+		void setValue(int32_t value) {this->_hasValue = true; this->_value = value;}
 		// void setValueString(const std::string& valuestr) {  _valueString = valuestr; }
 
 		
 	private:
-		std::string _name;
-		std::string _type;
+		Symbol _name;
+		C0Type _type;
 		int32_t _level;	//所在层级
 		int32_t _offset;	//在对应层级下的偏移
 		int32_t _isInitialized = 0;
 		int32_t _isConst = 0; // 1 == const
+		int32_t _size = 0;
+		bool _hasValue;
+		int32_t _value;
 		// std::string _valueString;
 	};
 
@@ -71,6 +85,9 @@ namespace cc0 {
 		swap(lhs._offset, rhs._offset);
 		swap(lhs._isInitialized, rhs._isInitialized);
 		swap(lhs._isConst, rhs._isConst);
+		swap(lhs._size, rhs._size);
+		swap(lhs._hasValue, rhs._hasValue);
+		swap(lhs._value, rhs._value);
 		// swap(lhs._valueString, rhs._valueString);
 	}
 
@@ -84,25 +101,40 @@ namespace cc0 {
 	public:
 		friend void swap(C0Function& lhs, C0Function& rhs);
 
-		C0Function(const std::string& name, const std::string& type, int32_t offset)
+		C0Function(Symbol name, C0Type type, int32_t offset)
 			: _funcName(name), _paramsList({}), _varList({}), _retType(type), _offset(offset) {}
+		C0Function(const C0Function&) = default;
 		C0Function& operator=(C0Function t) { swap(*this, t); return *this; }
 
-		std::string getFuncName() const { return _funcName; }
-		std::string getRetType() const { return _retType; }
+		Symbol getFuncName() const { return _funcName; }
+		C0Type getRetType() const { return _retType; }
 		std::int32_t getOffset() const { return _offset; }
 		std::int32_t getParamsNum() {return _paramsList.size(); }
+		// 参数占用的 slot 数, 数组参数占首地址和长度两个 slot
+		std::int32_t getParamSlots() const {
+			std::int32_t slots = 0;
+			for (auto& param : _paramsList)
+				slots += param.isArray() ? 2 : 1;
+			return slots;
+		}
 		std::vector<C0Var> * getParamsList() {return &_paramsList; }
+		std::int32_t getFrameSize() const { return _frameSize; }
+		// 只有声明, 定义在后面或别的文件中
+		bool isImported() const { return _imported; }
 
-		void setFuncName(const std::string& funcname) {this->_funcName = funcname; }
-		void setRetType(const std::string& rettype) {this->_retType = rettype; }
+		void setFuncName(Symbol funcname) {this->_funcName = funcname; }
+		void setRetType(C0Type rettype) {this->_retType = rettype; }
 		void setOffset(int32_t offset) {this->_offset = offset;}
+		void setFrameSize(int32_t frameSize) {this->_frameSize = frameSize;}
+		void setImported(bool imported) {this->_imported = imported;}
 	private:
-		std::string _funcName;
+		Symbol _funcName;
 		std::vector<C0Var> _paramsList;
 		std::vector<C0Var> _varList;
-		std::string _retType;
+		C0Type _retType;
 		int32_t _offset;	//from 0 ~ n-1
+		int32_t _frameSize = 0;	//参数和局部变量占用的slot数
+		bool _imported = false;
 		//需要入口地址吗
 	};
 
@@ -113,6 +145,8 @@ namespace cc0 {
 		swap(lhs._varList, rhs._varList);
 		swap(lhs._retType, rhs._retType);
 		swap(lhs._offset, rhs._offset);
+		swap(lhs._frameSize, rhs._frameSize);
+		swap(lhs._imported, rhs._imported);
 	}
 
 	class Analyser final {
@@ -122,24 +156,29 @@ namespace cc0 {
 		using uint32_t = std::uint32_t;
 		using int32_t = std::int32_t;
 	public:
-		Analyser(std::vector<Token> v)
-			: _tokens(std::move(v)), _offset(0), _instructions({}), _current_pos(0, 0), 
-			_functionsTable({}), _globalVariablesTable({}), _variablesTable({}), _returnTree(), _preReturnIndex(0){}
+		// relocatable: 分离编译的单元, 可以只声明函数 (定义在别的文件中), 不要求有 main
+		Analyser(std::vector<Token> v, Interner& interner, bool relocatable = false)
+			: _tokens(std::move(v)), _interner(interner), _relocatable(relocatable), _offset(0), _instructions({}), _startSection({}), _functionSections({}), _current_pos(0, 0), 
+			_functionsTable(), _globalVariablesTable(), _variablesTable(), 
+			_current_level(0), _current_func_index(0), _current_func_level(0), _current_instruction_index(0), _current_var_index(0), _reachable(true) {}
 		Analyser(Analyser&&) = delete;
 		Analyser(const Analyser&) = delete;
 		Analyser& operator=(Analyser) = delete;
 
 		// 唯一接口
-		std::pair<std::vector<Instruction>, std::optional<CompilationError>> Analyse();
+		// 结果从分析器中移出, 只能调用一次
+		std::pair<Program, std::optional<CompilationError>> Analyse();
 	private:
 		// 所有的递归子程序
 		// <程序>
 		std::optional<CompilationError> analyseProgram();
+		// 拼接常量表, .start, 函数表和各函数体
+		Program concatSections();
 		// <多重变量声明>::={<变量声明>}
 		std::optional<CompilationError> analyseVariableDeclarationMulti();
 		// <变量声明>
 		std::optional<CompilationError> analyseVariableDeclaration();
-		// <多重函数定义>::={<函数定义>}
+		// <多重函数定义>::={<函数定义>|<函数声明>}
 		std::optional<CompilationError> analyseFunctionDefinitionMulti();
 		// <函数定义>
 		std::optional<CompilationError> analyseFunctionDefinition();
@@ -166,9 +205,9 @@ namespace cc0 {
 		// <基本表达式><primary-expression>
 		std::optional<CompilationError> analysePrimaryExpression();
 		// <函数调用><function-call>
-		std::optional<CompilationError> analyseFunctionCall();
+		std::optional<CompilationError> analyseFunctionCall(Operation op = Operation::CALL);
 		// <表达式列表><expression-list>
-		std::optional<CompilationError> analyseExpressionList(int32_t);
+		std::optional<CompilationError> analyseExpressionList(C0Function*);
 		// <参数从句><parameter-clause>
 		std::optional<CompilationError> analyseParameterClause();
 		// <参数声明表><parameter-declaration-list>
@@ -184,7 +223,20 @@ namespace cc0 {
 		// <condition-statement>
 		std::optional<CompilationError> analyseConditionStatement();
 		// <condition>
-		std::optional<CompilationError> analyseCondition(Operation&);
+		// 条件的值为 jumpIf 时跳转, 否则顺序执行; 跳转指令在 _instructions 中的下标加入 jumps, 目标由调用者回填
+		std::optional<CompilationError> analyseCondition(bool jumpIf, std::vector<std::size_t>& jumps);
+		// <and-condition>
+		std::optional<CompilationError> analyseAndCondition(bool jumpIf, std::vector<std::size_t>& jumps);
+		// <unary-condition>
+		std::optional<CompilationError> analyseUnaryCondition(bool jumpIf, std::vector<std::size_t>& jumps);
+		// <relational-condition>, 生成比较, 返回条件为假时的跳转
+		std::optional<CompilationError> analyseRelationalCondition(Operation&);
+		// 当前括号内接下来的逻辑运算符是否是 op, 找 && 时遇到 || 即停止
+		bool nextLogicalOperatorIs(TokenType op) const;
+		// 刚读过的 '(' 开始的是括起来的条件而不是表达式
+		bool isConditionGroup() const;
+		// 把 jumps 中的跳转指向下一条指令
+		void patchJumps(const std::vector<std::size_t>& jumps);
 		// <loop-statement>
 		std::optional<CompilationError> analyseLoopStatement();
 		// <return-statement>
@@ -195,6 +247,22 @@ namespace cc0 {
 		std::optional<CompilationError> analyseScanStatement();
 		// <assignment-expression>
 		std::optional<CompilationError> analyseAssignmentExpression();
+		// <array-assignment>
+		std::optional<CompilationError> analyseArrayAssignment(C0Var*);
+		// <array-subscript>
+		std::optional<CompilationError> analyseArraySubscript(C0Var*);
+		// 数组首地址
+		void loadArrayBase(C0Var*);
+		// 数组长度, 数组参数的长度在首地址的下一个 slot
+		void loadArrayLength(C0Var*);
+		// 整个数组的运算访问 count 个元素, 长度未知的数组参数在运行时检查
+		void checkArrayLength(C0Var*, int32_t count);
+		// 常量折叠
+		// 从 begin 到段尾是否只有一条压入常量的指令
+		std::optional<int32_t> constantFrom(std::size_t begin);
+		// 生成 lhs op rhs, lhs 和 rhs 是两个操作数代码的开头;
+		// 两个操作数都是常量时折叠为一条 ipush, 除数是常量 0 时报错
+		std::optional<CompilationError> emitBinary(Operation op, std::size_t lhs, std::size_t rhs);
 		
 		// Token 缓冲区相关操作
 
@@ -206,11 +274,11 @@ namespace cc0 {
 		// 下面是符号表相关操作
 
 		// bool isDeclared(const std::string&,int32_t);
-		bool isDeclaredSameLevel(const std::string&, int32_t);
+		bool isDeclaredSameLevel(Symbol, int32_t);
 		// bool isGlobalConstant(const std::string&);
-		bool isGlobalVariable(const std::string&);
-		bool isFunction(const std::string&);
-		bool isVariable(const std::string&,int32_t);
+		bool isGlobalVariable(Symbol);
+		bool isFunction(Symbol);
+		bool isVariable(Symbol, int32_t);
 		void addGlobalVariable(C0Var*);
 		// void addGlobalConstant(C0Var&);
 		void addVariable(C0Var*);
@@ -220,35 +288,46 @@ namespace cc0 {
 		void crushVar(int32_t);
 
 		// 获取变量/常量
-		C0Var* getVar(const std::string&, int32_t);
-		C0Var* getGlobalVar(const std::string&);
+		C0Var* getVar(Symbol, int32_t);
+		C0Var* getGlobalVar(Symbol);
 		// 获取函数
-		C0Function* getFunc(const std::string&);
-		// 清除return树
-		void crushReturnTree();
-		// 设置returnIndex的节点为true,如果之前有元素未初始化,则初始化为false
-		void addReturnNode();
-		void extendReturnTree();
-		void inReturnLeaf();
-		void outReturnLeaf();
-		void moveReturnLeaf();
-		bool checkReturnTree(int32_t);
-		bool checkPreReturnNode();
+		C0Function* getFunc(Symbol);
 
 	private:
 		std::vector<Token> _tokens;
+		// 与 Tokenizer 共用, 只在输出函数名时取回字符串
+		Interner& _interner;
+		bool _relocatable;
 		std::size_t _offset;
+		// 正在生成的段: .start 或当前函数体, 跳转下标都在段内
 		std::vector<Instruction> _instructions;
+		std::vector<Instruction> _startSection;
+		// 按函数下标, 每段以 PFI 开头
+		std::vector<std::vector<Instruction>> _functionSections;
 		std::pair<uint64_t, uint64_t> _current_pos;
-		std::vector<cc0::C0Function> _functionsTable;
-		std::vector<cc0::C0Var> _globalVariablesTable;
+		// 按函数下标顺序存放
+		SymbolTable<cc0::C0Function> _functionsTable;
+		SymbolTable<cc0::C0Var> _globalVariablesTable;
 		// 不包含全局常量,全局变量和函数, level from 1 ~ n-1
-		std::vector<cc0::C0Var> _variablesTable;
-
-		std::vector<bool> _returnTree;
-		int32_t _preReturnIndex;
+		SymbolTable<cc0::C0Var> _variablesTable;
 
 		// 下一个 token 在栈的偏移
 		int32_t _nextTokenIndex;	
+
+		// 编译状态都在实例里, 不同的 Analyser 可以在不同线程中同时使用
+		// 当前层级，每多一层嵌套{}, ++;
+		// 函数声明不用++, 只有遇到函数参数之后的{, 才++
+		int32_t _current_level;
+		// 当前函数下标(函数表的大小)  .F0的0, .F1的1
+		int32_t _current_func_index;
+		// func_current_level++ 在param声明之前，在compound之后--
+		int32_t _current_func_level;
+		// 指令下标 from 0 ~ n-1
+		int32_t _current_instruction_index;
+		// 变量声明的下标
+		int32_t _current_var_index;
+		// 下一条指令是否可达, 随指令的生成沿控制流向前传递, 只用于决定 if-else 是否需要 jmp;
+		// 函数末尾是否需要默认的 return 由函数体的控制流图决定
+		bool _reachable;
 	};
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "tokenizer/interner.h"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstddef> // for std::size_t
+
+namespace cc0 {
+
+	// 分层符号表
+	// 名字的编号直接索引到最内层的定义, 同名的外层定义挂在它后面, 删除内层时恢复.
+	// 表项按加入的顺序存放在 deque 里, 加入和删除都只发生在尾部, 所以返回的指针一直有效,
+	// 直到这一项所在的层被删除.
+	template <typename T>
+	class SymbolTable final {
+	private:
+		using int32_t = std::int32_t;
+
+		struct Entry {
+			Symbol name;
+			T value;
+			int32_t level;
+			Entry* shadowed;	// 被它遮住的同名定义
+		};
+	public:
+		SymbolTable() = default;
+		SymbolTable(const SymbolTable&) = delete;
+		SymbolTable& operator=(const SymbolTable&) = delete;
+
+		// 在level层加入name, level不能小于已有的层
+		T* add(Symbol name, const T& value, int32_t level) {
+			if (name >= _index.size())
+				_index.resize(name + 1, nullptr);
+			auto& slot = _index[name];
+			_entries.push_back(Entry{ name, value, level, slot });
+			slot = &_entries.back();
+			return &slot->value;
+		}
+
+		// 最内层的name, 没有则为nullptr
+		T* find(Symbol name) {
+			if (name >= _index.size() || _index[name] == nullptr)
+				return nullptr;
+			return &_index[name]->value;
+		}
+
+		// level层及更内层的name
+		T* findFrom(Symbol name, int32_t level) {
+			if (name >= _index.size() || _index[name] == nullptr || _index[name]->level < level)
+				return nullptr;
+			return &_index[name]->value;
+		}
+
+		// 删除level层及更内层的所有名字, 代价与删除的项数成正比
+		void crush(int32_t level) {
+			while (!_entries.empty() && _entries.back().level >= level) {
+				auto& entry = _entries.back();
+				_index[entry.name] = entry.shadowed;
+				_entries.pop_back();
+			}
+		}
+
+		// 按加入的顺序访问
+		std::size_t size() const { return _entries.size(); }
+		T& operator[](std::size_t i) { return _entries[i].value; }
+		const T& operator[](std::size_t i) const { return _entries[i].value; }
+	private:
+		std::deque<Entry> _entries;
+		// 按编号索引的最内层定义
+		std::vector<Entry*> _index;
+	};
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# 统计程序在 VM 中执行的跳转指令数: 比较两个优化级别下执行的跳转和其中跳转了的次数
+# 用法: bench/jumps.sh <cc0> [-O0|-O1|-O2 [-O0|-O1|-O2]] [程序 ...]
+# 默认比较 -O0 和 -O2, 不给程序时统计 testcase/ 和 bench/ 下的所有程序.
+# 次数从 -fprofile-generate 写出的 profile 得到: 每个跳转指令的执行次数, 和 `j <ip> <count>` 行中跳转了的次数.
+# .start 中的指令不计. 两个级别的输出 (不算运行时错误的调用栈) 不一致时退出码为 1
+set -e
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2 [-O0|-O1|-O2]] [program ...]}
+shift
+before=-O0
+after=-O2
+case "$1" in -O*) before=$1; shift ;; esac
+case "$1" in -O*) after=$1; shift ;; esac
+dir=$(dirname "$0")/..
+[ $# -gt 0 ] || set -- "$dir"/testcase/c[0-9] "$dir"/testcase/*.c0 "$dir"/bench/*.c0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# 读输入的程序都从这里读
+input='20\n3\n5\n1\n2\n-3\n'
+
+# count <程序.s0> <profile>: 打印 "执行的跳转/跳转了的次数"
+count() {
+	awk '
+	FNR == 1 { file++ }
+	# .s0: 记下每个函数中跳转指令的下标
+	file == 1 && /^\.F[0-9]+:$/ { f = substr($1, 3, length($1) - 3); next }
+	file == 1 && f != "" && $2 ~ /^j/ { jump[f, $1] = 1; next }
+	# profile: 从 <ip> 到下一个 <ip> 行之前的指令都执行了 <count> 次
+	function close_run(end,   ip) {
+		for (ip = from; ip < end; ip++)
+			if ((f, ip) in jump)
+				all += times
+		times = 0
+	}
+	file == 2 && /^\.F/ { close_run(size); f = substr($1, 3); size = $3; from = 0; next }
+	file == 2 && $1 == "j" { taken += $3; next }
+	file == 2 { close_run($1); from = $1; times = $2 }
+	END { close_run(size); printf "%d/%d\n", all, taken }
+	' "$1" "$2"
+}
+
+status=0
+printf '%-16s %20s %20s\n' program "$before all/taken" "$after all/taken"
+for src in "$@"; do
+	name=$(basename "$src" .c0)
+	for level in $before $after; do
+		"$cc0" -s $level "$src" -o "$work/$name$level.s0"
+		printf "$input" | "$cc0" --run "$work/$name$level.s0" -fprofile-generate "$work/$name$level.prof" \
+			> "$work/$name$level.out" 2>&1 || true
+	done
+	printf '%-16s %20s %20s\n' "$name" \
+		"$(count "$work/$name$before.s0" "$work/$name$before.prof")" \
+		"$(count "$work/$name$after.s0" "$work/$name$after.prof")"
+	# 运行时错误的调用栈中的指令下标随优化改变, 不比较
+	if [ "$(grep -v '^ *function \|^called by ' "$work/$name$before.out")" != "$(grep -v '^ *function \|^called by ' "$work/$name$after.out")" ]; then
+		echo "$name: output at $after differs from $before" >&2
+		status=1
+	fi
+done
+exit $status
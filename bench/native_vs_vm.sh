@@ -0,0 +1,43 @@
+#!/bin/sh
+# 比较同一个程序在 VM 中解释执行, 翻译为 C (-a) 和 x86-64 汇编 (-n) 编译后运行的时间
+# 用法: bench/native_vs_vm.sh <cc0> [-O0|-O1|-O2] [程序.c0 ...]
+# 不给程序时运行 bench/ 下所有的 .c0. 输出不一致时退出码为 1
+set -e
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2] [program.c0 ...]}
+shift
+level=-O2
+case "$1" in -O*) level=$1; shift ;; esac
+[ $# -gt 0 ] || set -- "$(dirname "$0")"/*.c0
+cc=${CC:-cc}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# 运行一次, 输出写入 $out, 打印用时的毫秒数
+run() {
+	start=$(date +%s%N)
+	"$@" > "$out" 2>&1 || true
+	end=$(date +%s%N)
+	echo $(( (end - start) / 1000000 ))
+}
+
+status=0
+printf '%-16s %10s %10s %10s\n' program "vm(ms)" "aot(ms)" "native(ms)"
+for src in "$@"; do
+	name=$(basename "$src" .c0)
+	"$cc0" -c $level "$src" -o "$work/$name.o0"
+	"$cc0" -a $level "$src" -o "$work/$name.c"
+	"$cc0" -n $level "$src" -o "$work/$name.s"
+	$cc -O2 "$work/$name.c" -o "$work/$name.aot" -pthread
+	$cc "$work/$name.s" -o "$work/$name.native" -pthread
+	out=$work/vm.out; vm=$(run "$cc0" --run "$work/$name.o0")
+	out=$work/aot.out; aot=$(run "$work/$name.aot")
+	out=$work/native.out; native=$(run "$work/$name.native")
+	printf '%-16s %10s %10s %10s\n' "$name" "$vm" "$aot" "$native"
+	for other in aot native; do
+		if ! cmp -s "$work/vm.out" "$work/$other.out"; then
+			echo "$name: $other output differs from the VM" >&2
+			status=1
+		fi
+	done
+done
+exit $status
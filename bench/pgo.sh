@@ -0,0 +1,48 @@
+#!/bin/sh
+# 比较 -O2 和 -O2 -fprofile-use 编译的程序在 VM 中运行的时间和执行的跳转数
+# 用法: bench/pgo.sh <cc0> [程序.c0 ...]
+# 不给程序时运行 bench/ 下所有的 .c0. 每个程序先用 -O0 的程序训练, 再用同样的输入运行.
+# 时间取 3 次中最短的. 跳转数是运行中跳转了的条件跳转和 jmp 的次数. 输出不一致时退出码为 1
+set -e
+cc0=${1:?usage: $0 <cc0> [program.c0 ...]}
+shift
+[ $# -gt 0 ] || set -- "$(dirname "$0")"/*.c0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# 运行 3 次, 输出写入 $out, 打印最短用时的毫秒数
+run() {
+	best=
+	for i in 1 2 3; do
+		start=$(date +%s%N)
+		"$@" > "$out" 2>&1 || true
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then best=$ms; fi
+	done
+	echo "$best"
+}
+
+# 运行一次 $1, 打印 profile 中跳转了的次数之和
+jumps() {
+	"$cc0" --run "$1" -fprofile-generate "$work/jumps.prof" > /dev/null 2>&1 || true
+	awk '$1 == "j" { n += $3 } END { print n + 0 }' "$work/jumps.prof"
+}
+
+status=0
+printf '%-16s %10s %10s %12s %12s\n' program "O2(ms)" "pgo(ms)" "O2 jumps" "pgo jumps"
+for src in "$@"; do
+	name=$(basename "$src" .c0)
+	"$cc0" -c -O0 "$src" -o "$work/$name.train.o0"
+	"$cc0" --run "$work/$name.train.o0" -fprofile-generate "$work/$name.prof" > /dev/null 2>&1 || true
+	"$cc0" -c -O2 "$src" -o "$work/$name.o0"
+	"$cc0" -c -O2 -fprofile-use "$work/$name.prof" "$src" -o "$work/$name.pgo.o0"
+	out=$work/o2.out; o2=$(run "$cc0" --run "$work/$name.o0")
+	out=$work/pgo.out; pgo=$(run "$cc0" --run "$work/$name.pgo.o0")
+	printf '%-16s %10s %10s %12s %12s\n' "$name" "$o2" "$pgo" "$(jumps "$work/$name.o0")" "$(jumps "$work/$name.pgo.o0")"
+	if ! cmp -s "$work/o2.out" "$work/pgo.out"; then
+		echo "$name: output with the profile differs from -O2" >&2
+		status=1
+	fi
+done
+exit $status
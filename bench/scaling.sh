@@ -0,0 +1,46 @@
+#!/bin/sh
+# 生成有 n 个函数的程序, 测量编译的用时, 检查编译时间随程序规模的增长
+# 用法: bench/scaling.sh <cc0> [-O0|-O1|-O2] [n ...]
+# 默认 n 为 1250 2500 5000 10000. 线性时每行的用时约为上一行的两倍, 二次时约为四倍.
+# 编译出的程序在 VM 中的输出不对时退出码为 1
+set -e
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2] [n ...]}
+shift
+level=-O0
+case "$1" in -O*) level=$1; shift ;; esac
+[ $# -gt 0 ] || set -- 1250 2500 5000 10000
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# f0 .. f(n-1): 每个函数调用前一个, 有局部变量, 分支和循环, main 打印 f(n-1)(0)
+generate() {
+	awk -v n="$1" 'BEGIN {
+		print "int g = 0;"
+		print "int f0(int x) { return x; }"
+		for (i = 1; i < n; i++) {
+			printf "int f%d(int x) {\n", i
+			print "\tint i = 0;"
+			print "\tint s = 0;"
+			printf "\twhile (i < %d) { s = s + i; i = i + 1; }\n", i % 4
+			printf "\tif (s > x) { g = g + 1; }\n"
+			printf "\treturn f%d(x) + 1;\n", i - 1
+			print "}"
+		}
+		printf "int main() { print(f%d(0)); return 0; }\n", n - 1
+	}' > "$2"
+}
+
+status=0
+printf '%-10s %12s\n' functions "compile(ms)"
+for n in "$@"; do
+	generate "$n" "$work/scale.c0"
+	start=$(date +%s%N)
+	"$cc0" -c $level "$work/scale.c0" -o "$work/scale.o0"
+	end=$(date +%s%N)
+	printf '%-10s %12s\n' "$n" $(( (end - start) / 1000000 ))
+	if [ "$("$cc0" --run "$work/scale.o0")" != "$((n - 1))" ]; then
+		echo "$n: wrong output" >&2
+		status=1
+	fi
+done
+exit $status
@@ -0,0 +1,61 @@
+#!/bin/sh
+# 比较同一个分治程序在 VM 中用 spawn/join 并行和顺序执行的时间
+# 用法: bench/spawn.sh <cc0> [-O0|-O1|-O2] [n ...]
+# 默认 n 为 27 30 32, 计算 fib(n). 加速比应随核数增长, 单核时约为 1.
+# -a 和 -n 在 join 时顺序执行任务, 所以只测 VM. 输出不一致时退出码为 1
+set -e
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2] [n ...]}
+shift
+level=-O2
+case "$1" in -O*) level=$1; shift ;; esac
+[ $# -gt 0 ] || set -- 27 30 32
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# 顺序版本和并行版本只有 main 调用的函数不同
+generate() {
+	cat <<EOF
+int fib(int n) {
+	if (n < 2) return n;
+	return fib(n - 1) + fib(n - 2);
+}
+int pfib(int n) {
+	int a, b;
+	if (n < 20) return fib(n);
+	a = spawn pfib(n - 1);
+	b = pfib(n - 2);
+	return join(a) + b;
+}
+int main() {
+	print($1($2));
+	return 0;
+}
+EOF
+}
+
+# 运行一次, 输出写入 $out, 打印用时的毫秒数
+run() {
+	start=$(date +%s%N)
+	"$@" > "$out" 2>&1 || true
+	end=$(date +%s%N)
+	echo $(( (end - start) / 1000000 ))
+}
+
+status=0
+echo "cores: $(nproc 2>/dev/null || echo '?')"
+printf '%-6s %14s %14s %8s\n' n "sequential(ms)" "spawn(ms)" speedup
+for n in "$@"; do
+	generate fib "$n" > "$work/seq.c0"
+	generate pfib "$n" > "$work/par.c0"
+	"$cc0" -c $level "$work/seq.c0" -o "$work/seq.o0"
+	"$cc0" -c $level "$work/par.c0" -o "$work/par.o0"
+	out=$work/seq.out; seq=$(run "$cc0" --run "$work/seq.o0")
+	out=$work/par.out; par=$(run "$cc0" --run "$work/par.o0")
+	printf '%-6s %14s %14s %8s\n' "$n" "$seq" "$par" \
+		"$(awk -v s="$seq" -v p="$par" 'BEGIN { printf "%.2f", (p > 0 ? s / p : 0) }')"
+	if ! cmp -s "$work/seq.out" "$work/par.out"; then
+		echo "$n: spawn output differs from the sequential one" >&2
+		status=1
+	fi
+done
+exit $status
@@ -0,0 +1,139 @@
+#include "codegen/vm_file.h"
+#include "src/exception.h"
+#include "src/util/print.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace cc0 {
+
+	namespace {
+
+		vm::OpCode opCodeOf(Operation op) {
+			switch (op) {
+			case NOP: return vm::OpCode::nop;
+			case BIPUSH: return vm::OpCode::bipush;
+			case IPUSH: return vm::OpCode::ipush;
+			case POP: return vm::OpCode::pop;
+			case POP2: return vm::OpCode::pop2;
+			case POPN: return vm::OpCode::popn;
+			case DUP: return vm::OpCode::dup;
+			case DUP2: return vm::OpCode::dup2;
+			case LOADC: return vm::OpCode::loadc;
+			case LOADA: return vm::OpCode::loada;
+			case NEW: return vm::OpCode::_new;
+			case SNEW: return vm::OpCode::snew;
+			case IINC: return vm::OpCode::iinc;
+			case IINCS: return vm::OpCode::iincs;
+			case ILOAD: return vm::OpCode::iload;
+			case ALOAD: return vm::OpCode::aload;
+			case IALOAD: return vm::OpCode::iaload;
+			case AALOAD: return vm::OpCode::aaload;
+			case ISTORE: return vm::OpCode::istore;
+			case ASTORE: return vm::OpCode::astore;
+			case IASTORE: return vm::OpCode::iastore;
+			case AASTORE: return vm::OpCode::aastore;
+			case IAFILL: return vm::OpCode::iafill;
+			case IACOPY: return vm::OpCode::iacopy;
+			case IACMP: return vm::OpCode::iacmp;
+			case IACHK: return vm::OpCode::iachk;
+			case IADD: return vm::OpCode::iadd;
+			case ISUB: return vm::OpCode::isub;
+			case IMUL: return vm::OpCode::imul;
+			case IDIV: return vm::OpCode::idiv;
+			case INEG: return vm::OpCode::ineg;
+			case ICMP: return vm::OpCode::icmp;
+			case JMP: return vm::OpCode::jmp;
+			case JE: return vm::OpCode::je;
+			case JNE: return vm::OpCode::jne;
+			case JL: return vm::OpCode::jl;
+			case JGE: return vm::OpCode::jge;
+			case JG: return vm::OpCode::jg;
+			case JLE: return vm::OpCode::jle;
+			case CALL: return vm::OpCode::call;
+			case ISPAWN: return vm::OpCode::spawn;
+			case IJOIN: return vm::OpCode::join;
+			case RET: return vm::OpCode::ret;
+			case IRET: return vm::OpCode::iret;
+			case IPRINT: return vm::OpCode::iprint;
+			case CPRINT: return vm::OpCode::cprint;
+			case PRINTL: return vm::OpCode::printl;
+			case ISCAN: return vm::OpCode::iscan;
+			default:
+				throw InvalidFile(strfmt("no such opcode: {}", static_cast<int>(op)));
+			}
+		}
+
+		// 参数按 .o0 中的个数取, 其余为 0, 与文本汇编器一致
+		vm::Instruction lower(const Instruction& ins) {
+			vm::Instruction rtv{ opCodeOf(ins.GetOperation()), 0, 0 };
+			if (auto it = vm::paramSizeOfOpCode.find(rtv.op); it != vm::paramSizeOfOpCode.end()) {
+				rtv.x = static_cast<vm::u4>(ins.GetX());
+				if (it->second.size() == 2)
+					rtv.y = static_cast<vm::u4>(ins.GetY());
+			}
+			return rtv;
+		}
+	}
+
+	File LowerToFile(const Program& program) {
+		std::vector<vm::Constant> constants;
+		std::vector<vm::Instruction> start;
+		std::vector<vm::Function> functions;
+		// 当前段: .start 或 .F{i}
+		std::vector<vm::Instruction>* section = nullptr;
+		const auto checkSection = [&]() {
+			if (section != nullptr && section->size() > U2_MAX)
+				throw InvalidFile("too many instructions");
+		};
+		for (auto& ins : program.instructions) {
+			switch (ins.GetOperation()) {
+			case PCONSTANTS:
+			case PFUNCTION:
+				checkSection();
+				section = nullptr;
+				break;
+			case PSTART:
+				section = &start;
+				break;
+			case SAVECONST: {
+				// 常量池里只有函数名
+				auto& value = program.constants.at(ins.GetX());
+				if (value.length() > UINT16_MAX)
+					throw InvalidFile("too long the string constant");
+				constants.push_back(vm::Constant{ vm::Constant::Type::STRING, value });
+			} break;
+			case SAVEFUNCTION: {
+				// 名字是同一下标的常量, 层级为 1
+				vm::Function function;
+				function.nameIndex = static_cast<vm::u2>(ins.GetIndex());
+				if (ins.GetX() > U2_MAX)
+					throw InvalidFile("too many parameters");
+				function.paramSize = static_cast<vm::u2>(ins.GetX());
+				function.level = 1;
+				function.frameSize = static_cast<vm::u4>(ins.GetY());
+				functions.push_back(std::move(function));
+			} break;
+			case PFI:
+				checkSection();
+				section = &functions.at(ins.GetX()).instructions;
+				break;
+			default:
+				if (section == nullptr)
+					throw InvalidFile("instruction outside of .start and functions");
+				section->push_back(lower(ins));
+				break;
+			}
+		}
+		checkSection();
+		if (constants.size() > U2_MAX)
+			throw InvalidFile("too many constants");
+		if (functions.size() > U2_MAX)
+			throw InvalidFile("too many functions");
+
+		File file{ 0x00000002, std::move(constants), std::move(start), std::move(functions) };
+		file.compute_stack_depth();
+		return file;
+	}
+}
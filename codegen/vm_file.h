@@ -0,0 +1,13 @@
+#pragma once
+
+#include "instruction/instruction.h"
+#include "src/file.h"
+
+namespace cc0 {
+
+	// 把分析器的输出直接降为 VM 的 File, 不经过 .s0 文本:
+	//     output_binary() 得到 .o0, vm::translateToC() 得到 C 源程序
+	// 结果与把 fmt::format("{}", program) 交给 File::parse_file_text() 相同,
+	// 超出 .o0 格式范围时同样抛出 InvalidFile
+	File LowerToFile(const Program& program);
+}
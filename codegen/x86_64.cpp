@@ -0,0 +1,1308 @@
+#include "x86_64.h"
+#include "error/error.h"
+
+#include <algorithm>
+#include <climits>
+#include <sstream>
+
+namespace cc0 {
+
+	namespace {
+
+		template <typename... Args>
+		std::string cat(const Args&... args) {
+			std::ostringstream ss;
+			(ss << ... << args);
+			return ss.str();
+		}
+
+		// 汇编中的字符串字面量
+		std::string quote(const std::string& s) {
+			std::string r = "\"";
+			for (char ch : s) {
+				if (ch == '"' || ch == '\\')
+					r += '\\';
+				if (ch == '\n')
+					r += "\\n";
+				else
+					r += ch;
+			}
+			return r + "\"";
+		}
+
+		// 条件跳转对应的 x86 跳转指令, 比较对象为 (l, r) 或 (cond, 0)
+		const char* jumpOf(Operation op) {
+			switch (op) {
+			case Operation::JE:  return "je";
+			case Operation::JNE: return "jne";
+			case Operation::JL:  return "jl";
+			case Operation::JGE: return "jge";
+			case Operation::JG:  return "jg";
+			case Operation::JLE: return "jle";
+			default: return nullptr;
+			}
+		}
+
+		bool holds(Operation op, int32_t cond) {
+			switch (op) {
+			case Operation::JE:  return cond == 0;
+			case Operation::JNE: return cond != 0;
+			case Operation::JL:  return cond < 0;
+			case Operation::JGE: return cond >= 0;
+			case Operation::JG:  return cond > 0;
+			case Operation::JLE: return cond <= 0;
+			default: return false;
+			}
+		}
+
+		// 可能出错的指令, 出错时调用栈里要显示它
+		bool mayFail(Operation op) {
+			switch (op) {
+			case Operation::ILOAD:
+			case Operation::ALOAD:
+			case Operation::ISTORE:
+			case Operation::IALOAD:
+			case Operation::IASTORE:
+			case Operation::IAFILL:
+			case Operation::IACOPY:
+			case Operation::IACMP:
+			case Operation::IACHK:
+			case Operation::IDIV:
+			case Operation::CALL:
+			case Operation::ISPAWN:
+			case Operation::IJOIN:
+			case Operation::ISCAN:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// 与汇编器无关的运行时: 入口, 任务, 输入输出和错误报告
+		// 栈帧 -8(%rbp) 为函数下标(.start 为 -1, 任务的起点为 -2), -4(%rbp) 为出错或调用时的指令下标
+		const char* const runtime = R"(	.text
+	.globl main
+	.type main, @function
+main:
+	pushq %rbp
+	movq %rsp, %rbp
+	subq $80, %rsp
+	leaq -64(%rbp), %rdi
+	call pthread_attr_init@PLT
+	leaq -64(%rbp), %rdi
+	movl $0x40000000, %esi
+	call pthread_attr_setstacksize@PLT
+	testl %eax, %eax
+	jnz .Lmain_direct
+	leaq -72(%rbp), %rdi
+	leaq -64(%rbp), %rsi
+	leaq rt_thread(%rip), %rdx
+	movl $0x40000000, %ecx
+	call pthread_create@PLT
+	testl %eax, %eax
+	jnz .Lmain_direct
+	movq -72(%rbp), %rdi
+	xorl %esi, %esi
+	call pthread_join@PLT
+	jmp .Lmain_exit
+.Lmain_direct:
+	movl $0x800000, %edi
+	call rt_thread
+.Lmain_exit:
+	movq stdout@GOTPCREL(%rip), %rax
+	movq (%rax), %rdi
+	call fflush@PLT
+	xorl %eax, %eax
+	leave
+	ret
+	.size main, .-main
+
+# every call is a native call, so the program runs on a thread with a large stack
+# %rdi: bytes of stack the thread may use
+rt_thread:
+	pushq %rbp
+	movq %rsp, %rbp
+	movq %rsp, %rax
+	subq %rdi, %rax
+	addq $0x100000, %rax
+	movq %rax, rt_stackLimit(%rip)
+	call rt_start
+	xorl %eax, %eax
+	popq %rbp
+	ret
+
+# %rdx: address, %rcx: slots
+# returns if the slots lie in the globals or in the frame of a function on the chain of %rbp,
+# only %r8-%r11 are changed
+rt_check:
+	movq %rbp, %r8
+	leaq (%rdx,%rcx,8), %r9
+.Lcheck_frame:
+	movslq -8(%r8), %r10
+	cmpq $-1, %r10
+	je .Lcheck_globals
+	jl .Lcheck_up
+	leaq rt_frameBytes(%rip), %r11
+	movq (%r11,%r10,8), %r11
+	leaq -8(%r8), %r10
+	cmpq %r10, %r9
+	ja .Lcheck_up
+	subq %r11, %r10
+	cmpq %r10, %rdx
+	jae .Lcheck_ok
+.Lcheck_up:
+	movq (%r8), %r8
+	jmp .Lcheck_frame
+.Lcheck_globals:
+	leaq rt_globals(%rip), %r10
+	cmpq %r10, %rdx
+	jb .Lcheck_fail
+	leaq rt_globalsEnd(%rip), %r10
+	cmpq %r10, %r9
+	ja .Lcheck_fail
+.Lcheck_ok:
+	ret
+.Lcheck_fail:
+	leaq rt_msgMemory(%rip), %rdi
+	jmp rt_fail
+
+# %rdi: message, %rbp: frame of the failing instruction
+# prints what VM::run prints, a task adds its own stack trace to the message
+rt_fail:
+	movq %rdi, %r12
+	movq %rbp, %r13
+	andq $-16, %rsp
+	movq stdout@GOTPCREL(%rip), %rax
+	movq (%rax), %rdi
+	call fflush@PLT
+	movq stderr@GOTPCREL(%rip), %rax
+	movq (%rax), %rdi
+	leaq rt_strError(%rip), %rsi
+	movq %r12, %rdx
+	xorl %eax, %eax
+	call fprintf@PLT
+.Lfail_segment:
+	movq %r13, %r14
+.Lfail_bottom:
+	cmpl $0, -8(%r14)
+	jl .Lfail_found
+	movq (%r14), %r14
+	jmp .Lfail_bottom
+.Lfail_found:
+	leaq rt_strOccurred(%rip), %rdi
+	leaq rt_strInTask(%rip), %rax
+	cmpl $-2, -8(%r14)
+	cmove %rax, %rdi
+	call rt_puts
+	movq %r13, %rdi
+	call rt_site
+	movq (%rax), %rdi
+	call rt_puts
+.Lfail_callers:
+	cmpq %r13, %r14
+	je .Lfail_next
+	movq (%r13), %r13
+	movq %r13, %rdi
+	call rt_site
+	movq 8(%rax), %rdi
+	call rt_puts
+	jmp .Lfail_callers
+.Lfail_next:
+	cmpl $-1, -8(%r14)
+	je .Lfail_exit
+	movq (%r14), %r13
+	jmp .Lfail_segment
+.Lfail_exit:
+	leaq rt_strNewline(%rip), %rdi
+	call rt_puts
+	movl $1, %edi
+	call exit@PLT
+
+# %rdi: frame -> %rax: its lines in a stack trace
+rt_site:
+	movslq -8(%rdi), %rax
+	movslq -4(%rdi), %rcx
+	leaq rt_siteTables(%rip), %rdx
+	movq 16(%rdx,%rax,8), %rdx
+	movq (%rdx,%rcx,8), %rax
+	ret
+
+rt_puts:
+	subq $8, %rsp
+	movq stderr@GOTPCREL(%rip), %rax
+	movq (%rax), %rsi
+	call fputs@PLT
+	addq $8, %rsp
+	ret
+
+# %edi: value
+rt_iprint:
+	subq $8, %rsp
+	movl %edi, %esi
+	leaq rt_fmtInt(%rip), %rdi
+	xorl %eax, %eax
+	call printf@PLT
+	addq $8, %rsp
+	ret
+
+# -> %eax, fails at the frame of the caller
+rt_scan:
+	subq $24, %rsp
+	movq stdout@GOTPCREL(%rip), %rax
+	movq (%rax), %rdi
+	call fflush@PLT
+	leaq rt_fmtInt(%rip), %rdi
+	leaq 12(%rsp), %rsi
+	xorl %eax, %eax
+	call scanf@PLT
+	cmpl $1, %eax
+	jne .Lscan_fail
+	movl 12(%rsp), %eax
+	addq $24, %rsp
+	ret
+.Lscan_fail:
+	leaq rt_msgIO(%rip), %rdi
+	jmp rt_fail
+
+# %rdi: lhs, %rsi: rhs, %rcx: slots (> 0) -> %eax: -1, 0 or 1
+rt_iacmp:
+	movl (%rdi), %eax
+	cmpl (%rsi), %eax
+	jne .Liacmp_diff
+	addq $8, %rdi
+	addq $8, %rsi
+	decq %rcx
+	jnz rt_iacmp
+	xorl %eax, %eax
+	ret
+.Liacmp_diff:
+	setg %al
+	movzbl %al, %eax
+	leal -1(%rax,%rax), %eax
+	ret
+
+# tasks are {function, parameters, joined} of 24 bytes, the handle is the index plus 1
+# %edi: function, %rsi: parameters, %edx: slots of parameters -> %eax: handle
+rt_spawn:
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	movl %edi, %ebx
+	movq %rsi, %r12
+	movslq %edx, %r13
+	movq rt_tasksCount(%rip), %rax
+	cmpq rt_tasksCapacity(%rip), %rax
+	jne .Lspawn_room
+	leaq 16(%rax,%rax), %rsi
+	movq %rsi, rt_tasksCapacity(%rip)
+	imulq $24, %rsi
+	movq rt_tasks(%rip), %rdi
+	call realloc@PLT
+	movq %rax, rt_tasks(%rip)
+.Lspawn_room:
+	leaq 8(,%r13,8), %rdi
+	call malloc@PLT
+	movq %rax, %rdi
+	movq %r12, %rsi
+	leaq (,%r13,8), %rdx
+	call memcpy@PLT
+	movq rt_tasksCount(%rip), %rcx
+	imulq $24, %rcx, %rdx
+	addq rt_tasks(%rip), %rdx
+	movq %rbx, (%rdx)
+	movq %rax, 8(%rdx)
+	movq $0, 16(%rdx)
+	leaq 1(%rcx), %rax
+	movq %rax, rt_tasksCount(%rip)
+	popq %r13
+	popq %r12
+	popq %rbx
+	ret
+
+# %edi: handle -> %eax: result of the task, which runs right here as the .start of the task
+rt_join:
+	pushq %rbp
+	movq %rsp, %rbp
+	subq $32, %rsp
+	movq %rbx, -16(%rbp)
+	movslq %edi, %rbx
+	cmpq $1, %rbx
+	jl .Ljoin_fail
+	cmpq rt_tasksCount(%rip), %rbx
+	jg .Ljoin_fail
+	imulq $24, %rbx, %rax
+	addq rt_tasks(%rip), %rax
+	cmpq $0, -8(%rax)
+	jne .Ljoin_fail
+	movq $1, -8(%rax)
+	movq -24(%rax), %rcx
+	movl $-2, -8(%rbp)
+	movl %ecx, -4(%rbp)
+	movq -16(%rax), %rdi
+	leaq rt_functions(%rip), %rax
+	call *(%rax,%rcx,8)
+	movl %eax, -24(%rbp)
+	imulq $24, %rbx, %rax
+	addq rt_tasks(%rip), %rax
+	movq -16(%rax), %rdi
+	movq $0, -16(%rax)
+	call free@PLT
+	movl -24(%rbp), %eax
+	movq -16(%rbp), %rbx
+	leave
+	ret
+.Ljoin_fail:
+	movq (%rbp), %rbp
+	leaq rt_msgHandle(%rip), %rdi
+	jmp rt_fail
+
+# joins every task which has not been joined yet
+rt_drain:
+	pushq %rbx
+	movl $1, %ebx
+.Ldrain_next:
+	cmpq rt_tasksCount(%rip), %rbx
+	jg .Ldrain_done
+	imulq $24, %rbx, %rax
+	addq rt_tasks(%rip), %rax
+	cmpq $0, -8(%rax)
+	jne .Ldrain_joined
+	movl %ebx, %edi
+	call rt_join
+.Ldrain_joined:
+	incq %rbx
+	jmp .Ldrain_next
+.Ldrain_done:
+	popq %rbx
+	ret
+)";
+
+		const char* const runtimeStrings = R"(	.section .rodata
+rt_fmtInt:
+	.string "%d"
+rt_strError:
+	.string "runtime error: %s"
+rt_strInTask:
+	.string " in spawned task\n"
+rt_strOccurred:
+	.string " !\noccurred at:\n"
+rt_strNewline:
+	.string "\n"
+rt_msgStack:
+	.string "stack overflow"
+rt_msgDivide:
+	.string "divide integer by zero"
+rt_msgOverflow:
+	.string "integer division overflow"
+rt_msgMemory:
+	.string "tried to access unexistent memory"
+rt_msgLength:
+	.string "negative array length"
+rt_msgIndex:
+	.string "array index out of range"
+rt_msgHandle:
+	.string "invalid task handle"
+rt_msgIO:
+	.string "I/O error"
+)";
+	}
+
+	std::optional<CompilationError> X86Generator::Generate(std::ostream& out) {
+		_out = &out;
+		splitUnits();
+		for (auto& unit : _units)
+			if (auto err = computeDepth(unit); err.has_value())
+				return err;
+		*_out << "# generated by cc0, build with: cc <this file> -o <program> -pthread\n";
+		*_out << runtime << "\n";
+		for (auto& unit : _units)
+			outputUnit(unit);
+		outputData();
+		*_out << "\t.section .note.GNU-stack,\"\",@progbits\n";
+		return {};
+	}
+
+	// .constants: {SAVECONST} .start: {指令} .functions: {SAVEFUNCTION} {.F{i}: {指令}}
+	void X86Generator::splitUnits() {
+		std::vector<std::string> names;
+		std::size_t i = 0;
+		if (_instructions.empty() || _instructions[i].GetOperation() != Operation::PCONSTANTS)
+			DieAndPrint("instructions without .constants");
+		for (++i; i < _instructions.size() && _instructions[i].GetOperation() == Operation::SAVECONST; ++i) {
+			names.resize(std::max<std::size_t>(names.size(), _instructions[i].GetIndex() + 1));
+			names[_instructions[i].GetIndex()] = _constants.at(_instructions[i].GetX());
+		}
+		if (i == _instructions.size() || _instructions[i].GetOperation() != Operation::PSTART)
+			DieAndPrint("instructions without .start");
+		Unit start{-1, "__START__", 0, false, {}, {}, {}, 0};
+		for (++i; i < _instructions.size() && _instructions[i].GetOperation() != Operation::PFUNCTION; ++i)
+			start.code.push_back(_instructions[i]);
+		_units.push_back(start);
+		if (i == _instructions.size())
+			DieAndPrint("instructions without .functions");
+		for (++i; i < _instructions.size() && _instructions[i].GetOperation() == Operation::SAVEFUNCTION; ++i) {
+			auto index = _instructions[i].GetIndex();
+			if (index < 0 || index >= static_cast<int32_t>(names.size()))
+				DieAndPrint("function without name");
+			_units.resize(std::max<std::size_t>(_units.size(), index + 2), Unit{0, "", 0, false, {}, {}, {}, 0});
+			_units[index + 1].index = index;
+			_units[index + 1].name = names[index];
+			_units[index + 1].params = _instructions[i].GetX();
+		}
+		Unit* current = nullptr;
+		for (; i < _instructions.size(); ++i) {
+			auto& ins = _instructions[i];
+			if (ins.GetOperation() == Operation::PFI) {
+				if (ins.GetX() < 0 || ins.GetX() + 1 >= static_cast<int32_t>(_units.size()))
+					DieAndPrint("code of an undeclared function");
+				current = &_units[ins.GetX() + 1];
+				continue;
+			}
+			if (current == nullptr)
+				DieAndPrint("code outside of functions");
+			current->code.push_back(ins);
+			if (ins.GetOperation() == Operation::IRET)
+				current->returnsValue = true;
+		}
+		// 与 VM 一样, .start 最后为 main 的参数分配空间并调用 main
+		int32_t mainIndex = -1;
+		for (std::size_t f = 1; f < _units.size(); ++f)
+			if (_units[f].name == "main")
+				mainIndex = _units[f].index;
+		if (mainIndex < 0)
+			DieAndPrint("main not found");
+		auto& code = _units[0].code;
+		code.emplace_back(static_cast<int32_t>(code.size()), Operation::SNEW, _units[mainIndex + 1].params, 0);
+		code.emplace_back(static_cast<int32_t>(code.size()), Operation::CALL, mainIndex, 0);
+	}
+
+	int32_t X86Generator::stackEffect(const Unit& unit, const Instruction& ins) {
+		switch (ins.GetOperation()) {
+		case Operation::NOP:
+		case Operation::IINC:
+		case Operation::ILOAD:
+		case Operation::ALOAD:
+		case Operation::INEG:
+		case Operation::JMP:
+		case Operation::IJOIN:
+		case Operation::PRINTL:
+			return 0;
+		case Operation::BIPUSH:
+		case Operation::IPUSH:
+		case Operation::DUP:
+		case Operation::LOADA:
+		case Operation::ISCAN:
+			return 1;
+		case Operation::DUP2:
+			return 2;
+		case Operation::SNEW:
+			return ins.GetX();
+		case Operation::POPN:
+			return -ins.GetX();
+		case Operation::POP:
+		case Operation::IINCS:
+		case Operation::IALOAD:
+		case Operation::IADD:
+		case Operation::ISUB:
+		case Operation::IMUL:
+		case Operation::IDIV:
+		case Operation::ICMP:
+		case Operation::IACHK:
+		case Operation::JE:
+		case Operation::JNE:
+		case Operation::JL:
+		case Operation::JGE:
+		case Operation::JG:
+		case Operation::JLE:
+		case Operation::IPRINT:
+		case Operation::CPRINT:
+			return -1;
+		case Operation::POP2:
+		case Operation::ISTORE:
+		case Operation::IACMP:
+			return -2;
+		case Operation::IASTORE:
+		case Operation::IAFILL:
+		case Operation::IACOPY:
+			return -3;
+		case Operation::CALL:
+		case Operation::ISPAWN: {
+			if (ins.GetX() < 0 || ins.GetX() + 1 >= static_cast<int32_t>(_units.size()))
+				DieAndPrint("call of an undeclared function");
+			auto& callee = _units[ins.GetX() + 1];
+			bool value = ins.GetOperation() == Operation::ISPAWN || callee.returnsValue;
+			return -callee.params + (value ? 1 : 0);
+		}
+		default:
+			DieAndPrint(cat("instruction ", ins.GetOperation(), " in ", unit.name, " has no native code"));
+			return 0;
+		}
+	}
+
+	// 分析器生成的代码在每条指令处的栈高度与路径无关, 手写的 .s0 可以不是这样
+	std::optional<CompilationError> X86Generator::computeDepth(Unit& unit) {
+		auto& code = unit.code;
+		int32_t size = code.size();
+		unit.depth.assign(size, -1);
+		unit.target.assign(size, false);
+		for (auto& ins : code)
+			if (jumpOf(ins.GetOperation()) != nullptr || ins.GetOperation() == Operation::JMP) {
+				if (ins.GetX() < 0 || ins.GetX() >= size)
+					DieAndPrint("jump out of function");
+				unit.target[ins.GetX()] = true;
+			}
+		unit.maxDepth = unit.params;
+		std::vector<std::pair<int32_t, int32_t>> worklist = { { 0, unit.params } };
+		while (!worklist.empty()) {
+			auto [k, h] = worklist.back();
+			worklist.pop_back();
+			for (; k < size; ++k) {
+				if (unit.depth[k] != -1) {
+					if (unit.depth[k] != h)
+						return std::make_optional<CompilationError>(0, 0, ErrorCode::ErrNativeStackHeight);
+					break;
+				}
+				unit.depth[k] = h;
+				auto op = code[k].GetOperation();
+				if (op == Operation::RET || op == Operation::IRET)
+					break;
+				h += stackEffect(unit, code[k]);
+				if (h < 0)
+					DieAndPrint(cat("stack underflow in ", unit.name));
+				unit.maxDepth = std::max(unit.maxDepth, h);
+				if (op == Operation::JMP) {
+					worklist.emplace_back(code[k].GetX(), h);
+					break;
+				}
+				if (jumpOf(op) != nullptr)
+					worklist.emplace_back(code[k].GetX(), h);
+			}
+		}
+		return {};
+	}
+
+	std::string X86Generator::slot(const Unit& unit, int32_t k) {
+		if (unit.index < 0)
+			return cat("rt_globals+", 8 * static_cast<int64_t>(k), "(%rip)");
+		return cat(8 * static_cast<int64_t>(k), "(%rsp)");
+	}
+
+	std::string X86Generator::addrOf(const Unit& unit, const Value& v, int32_t extra) {
+		int64_t offset = 8 * (static_cast<int64_t>(v.value) + extra);
+		if (v.global || unit.index < 0)
+			return cat("rt_globals+", offset, "(%rip)");
+		return cat(offset, "(%rsp)");
+	}
+
+	// int 操作数
+	std::string X86Generator::source(const Unit& unit, std::size_t k) {
+		auto& v = _stack[k];
+		switch (v.kind) {
+		case Value::CONST: return cat("$", v.value);
+		case Value::REG: return "%eax";
+		case Value::MEM: return slot(unit, k);
+		default:
+			DieAndPrint("address used as an integer");
+			return "";
+		}
+	}
+
+	void X86Generator::materialize(const Unit& unit, std::size_t k) {
+		auto& v = _stack[k];
+		switch (v.kind) {
+		case Value::CONST:
+			emit(cat("movl $", v.value, ", ", slot(unit, k)));
+			break;
+		case Value::ADDR:
+			emit(cat("leaq ", addrOf(unit, v, 0), ", %r11"));
+			emit(cat("movq %r11, ", slot(unit, k)));
+			break;
+		case Value::REG:
+			emit(cat("movq %rax, ", slot(unit, k)));
+			break;
+		case Value::MEM:
+			break;
+		}
+		v = Value{Value::MEM, 0, false};
+	}
+
+	// 跳转, 标号, 调用和访存之前模拟栈必须全部写回栈帧
+	void X86Generator::flush(const Unit& unit) {
+		for (std::size_t k = 0; k < _stack.size(); ++k)
+			materialize(unit, k);
+	}
+
+	// 只有栈顶可以留在 %eax 里
+	void X86Generator::push(const Unit& unit, Value v) {
+		if (!_stack.empty() && _stack.back().kind == Value::REG)
+			materialize(unit, _stack.size() - 1);
+		_stack.push_back(v);
+	}
+
+	X86Generator::Value X86Generator::pop() {
+		auto v = _stack.back();
+		_stack.pop_back();
+		return v;
+	}
+
+	void X86Generator::emit(const std::string& line) {
+		*_out << '\t' << line << '\n';
+	}
+
+	std::string X86Generator::label(const Unit& unit, int32_t k) {
+		if (unit.index < 0)
+			return cat(".LS_", k);
+		return cat(".L", unit.index, "_", k);
+	}
+
+	// 出错时跳到冷路径, 记下指令下标后报告错误
+	std::string X86Generator::trap(const Unit& unit, std::size_t pc, const std::string& message) {
+		auto name = cat(unit.index < 0 ? std::string("S") : std::to_string(unit.index), "_", _stubs.size());
+		_stubs.push_back(cat(".LT", name, ":\n",
+			"\tmovl $", pc, ", -4(%rbp)\n",
+			"\tleaq ", message, "(%rip), %rdi\n",
+			"\tjmp rt_fail\n"));
+		return ".LT" + name;
+	}
+
+	// 地址已在 %rdx, 检查一个 slot. 本函数栈帧内的地址在这里就能确定, 其余的交给 rt_check
+	void X86Generator::checkAddress(const Unit& unit, std::size_t pc) {
+		if (unit.index < 0) {
+			emit(cat("movl $", pc, ", -4(%rbp)"));
+			emit("movl $1, %ecx");
+			emit("call rt_check");
+			return;
+		}
+		auto name = cat(unit.index, "_", _stubs.size());
+		emit("cmpq %rsp, %rdx");
+		emit(cat("jb .LC", name));
+		emit("leaq -8(%rbp), %r8");
+		emit("cmpq %r8, %rdx");
+		emit(cat("jae .LC", name));
+		*_out << ".LB" << name << ":\n";
+		_stubs.push_back(cat(".LC", name, ":\n",
+			"\tmovl $", pc, ", -4(%rbp)\n",
+			"\tmovl $1, %ecx\n",
+			"\tcall rt_check\n",
+			"\tjmp .LB", name, "\n"));
+	}
+
+	// base 为数组首地址在模拟栈中的位置, indexed 时其上为下标
+	// 地址静态可知且在栈帧内时返回内存操作数, 否则把地址算到 %rdx 并返回 "(%rdx)", 检查由调用者完成
+	std::string X86Generator::elementAddress(const Unit& unit, std::size_t base, int32_t indexed) {
+		auto& b = _stack[base];
+		if (b.kind == Value::ADDR) {
+			int64_t offset = b.value;
+			if (indexed && _stack[base + 1].kind == Value::CONST)
+				offset += _stack[base + 1].value;
+			int32_t limit = b.global || unit.index < 0 ? _units[0].maxDepth : _frameSlots;
+			if ((!indexed || _stack[base + 1].kind == Value::CONST) && 0 <= offset && offset < limit)
+				return addrOf(unit, Value{Value::ADDR, static_cast<int32_t>(offset), b.global}, 0);
+			emit(cat("leaq ", addrOf(unit, b, 0), ", %rdx"));
+		}
+		else if (b.kind == Value::REG)
+			emit("movq %rax, %rdx");
+		else if (b.kind == Value::MEM)
+			emit(cat("movq ", slot(unit, base), ", %rdx"));
+		else
+			DieAndPrint("integer used as an address");
+		if (indexed) {
+			auto& i = _stack[base + 1];
+			if (i.kind == Value::CONST)
+				emit(cat("movq $", i.value, ", %rcx"));
+			else if (i.kind == Value::REG)
+				emit("movslq %eax, %rcx");
+			else
+				emit(cat("movslq ", slot(unit, base + 1), ", %rcx"));
+			emit("leaq (%rdx,%rcx,8), %rdx");
+		}
+		return "";
+	}
+
+	// 与 VM 打印指令的格式一致, 只用于调用栈
+	std::string X86Generator::textOf(const Instruction& ins) {
+		switch (ins.GetOperation()) {
+		case Operation::ILOAD:   return "iload";
+		case Operation::ALOAD:   return "aload";
+		case Operation::ISTORE:  return "istore";
+		case Operation::IALOAD:  return "iaload";
+		case Operation::IASTORE: return "iastore";
+		case Operation::IAFILL:  return "iafill";
+		case Operation::IACOPY:  return "iacopy";
+		case Operation::IACMP:   return "iacmp";
+		case Operation::IACHK:   return "iachk";
+		case Operation::IDIV:    return "idiv";
+		case Operation::IJOIN:   return "join";
+		case Operation::ISCAN:   return "iscan";
+		case Operation::CALL:    return cat("call ", ins.GetX());
+		case Operation::ISPAWN:  return cat("spawn ", ins.GetX());
+		default:                 return "";
+		}
+	}
+
+	void X86Generator::outputUnit(const Unit& unit) {
+		_stack.clear();
+		_stubs.clear();
+		// slot 区从 %rsp 开始到 -8(%rbp) 为止, 保证 %rsp 16 字节对齐
+		_frameSlots = unit.maxDepth | 1;
+		*_out << "\n";
+		if (unit.index < 0) {
+			*_out << "rt_start:\n";
+			emit("pushq %rbp");
+			emit("movq %rsp, %rbp");
+			emit("subq $16, %rsp");
+			emit("movl $-1, -8(%rbp)");
+		}
+		else {
+			*_out << "# " << unit.name << "\n";
+			*_out << "\t.type c0_" << unit.name << ", @function\n";
+			*_out << "c0_" << unit.name << ":\n";
+			emit("pushq %rbp");
+			emit("movq %rsp, %rbp");
+			emit(cat("subq $", 8 + 8 * static_cast<int64_t>(_frameSlots), ", %rsp"));
+			emit("cmpq rt_stackLimit(%rip), %rsp");
+			emit(cat("jb .LO", unit.index));
+			emit(cat("movl $", unit.index, ", -8(%rbp)"));
+			// 参数由调用者放在 %rdi 指向的 slot 中
+			for (int32_t j = 0; j < unit.params; ++j) {
+				emit(cat("movq ", 8 * j, "(%rdi), %rax"));
+				emit(cat("movq %rax, ", slot(unit, j)));
+				_stack.push_back(Value{Value::MEM, 0, false});
+			}
+		}
+		bool reachable = true;
+		for (std::size_t k = 0; k < unit.code.size(); ++k) {
+			if (unit.depth[k] < 0) {
+				reachable = false;
+				continue;
+			}
+			if (unit.target[k]) {
+				if (reachable)
+					flush(unit);
+				_stack.assign(unit.depth[k], Value{Value::MEM, 0, false});
+				*_out << label(unit, k) << ":\n";
+				reachable = true;
+			}
+			if (!reachable)
+				continue;
+			if (static_cast<int32_t>(_stack.size()) != unit.depth[k])
+				DieAndPrint(cat("stack height mismatch in ", unit.name));
+			auto op = unit.code[k].GetOperation();
+			outputInstruction(unit, k);
+			if (op == Operation::JMP || op == Operation::RET || op == Operation::IRET) {
+				reachable = false;
+				_stack.clear();
+			}
+		}
+		if (unit.index < 0) {
+			// main 返回后等待没被 join 的任务, 出错时显示为 .start 结束
+			emit(cat("movl $", unit.code.size(), ", -4(%rbp)"));
+			emit("call rt_drain");
+			emit("leave");
+			emit("ret");
+		}
+		else {
+			*_out << ".LO" << unit.index << ":\n";
+			emit("movq (%rbp), %rbp");
+			emit("leaq rt_msgStack(%rip), %rdi");
+			emit("jmp rt_fail");
+		}
+		for (auto& stub : _stubs)
+			*_out << stub;
+		if (unit.index >= 0)
+			*_out << "\t.size c0_" << unit.name << ", .-c0_" << unit.name << "\n";
+	}
+
+	void X86Generator::outputInstruction(const Unit& unit, std::size_t& k) {
+		auto& ins = unit.code[k];
+		auto op = ins.GetOperation();
+		std::size_t top = _stack.size();
+		switch (op) {
+		case Operation::NOP:
+			break;
+		case Operation::BIPUSH:
+		case Operation::IPUSH:
+			push(unit, Value{Value::CONST, ins.GetX(), false});
+			break;
+		case Operation::POP:
+		case Operation::POP2:
+		case Operation::POPN: {
+			int32_t n = op == Operation::POP ? 1 : op == Operation::POP2 ? 2 : ins.GetX();
+			for (int32_t j = 0; j < n; ++j)
+				pop();
+			break;
+		}
+		case Operation::DUP:
+		case Operation::DUP2: {
+			std::size_t n = op == Operation::DUP ? 1 : 2;
+			if (_stack.back().kind == Value::REG)
+				materialize(unit, top - 1);
+			for (std::size_t j = top - n; j < top; ++j) {
+				auto v = _stack[j];
+				if (v.kind == Value::MEM) {
+					emit(cat("movq ", slot(unit, j), ", %r11"));
+					emit(cat("movq %r11, ", slot(unit, _stack.size())));
+				}
+				push(unit, v);
+			}
+			break;
+		}
+		case Operation::LOADA:
+			if (ins.GetX() > 1 || (unit.index < 0 && ins.GetX() != 0))
+				DieAndPrint("loada out of the static chain");
+			push(unit, Value{Value::ADDR, ins.GetY(), ins.GetX() == 1});
+			break;
+		case Operation::SNEW: {
+			// 新的 slot 清零
+			if (top > 0 && _stack.back().kind == Value::REG)
+				materialize(unit, top - 1);
+			int32_t n = ins.GetX();
+			if (n <= 8)
+				for (int32_t j = 0; j < n; ++j)
+					emit(cat("movq $0, ", slot(unit, top + j)));
+			else {
+				emit(cat("leaq ", slot(unit, top), ", %rdi"));
+				emit(cat("movl $", n, ", %ecx"));
+				emit("xorl %eax, %eax");
+				emit("rep stosq");
+			}
+			for (int32_t j = 0; j < n; ++j)
+				_stack.push_back(Value{Value::MEM, 0, false});
+			break;
+		}
+		case Operation::IINC:
+			flush(unit);
+			emit(cat("addl $", ins.GetY(), ", ", slot(unit, ins.GetX())));
+			break;
+		case Operation::IINCS: {
+			auto v = _stack.back();
+			if (v.kind == Value::MEM)
+				emit(cat("movl ", slot(unit, top - 1), ", %ecx"));
+			std::string value = v.kind == Value::CONST ? cat("$", v.value) : v.kind == Value::REG ? "%eax" : "%ecx";
+			pop();
+			flush(unit);
+			emit(cat("addl ", value, ", ", slot(unit, ins.GetX())));
+			break;
+		}
+		case Operation::ILOAD:
+		case Operation::ALOAD: {
+			auto mem = elementAddress(unit, top - 1, 0);
+			pop();
+			flush(unit);
+			if (mem.empty()) {
+				checkAddress(unit, k);
+				mem = "(%rdx)";
+			}
+			emit(op == Operation::ILOAD ? cat("movl ", mem, ", %eax") : cat("movq ", mem, ", %rax"));
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::ISTORE:
+		case Operation::IASTORE: {
+			std::size_t base = op == Operation::ISTORE ? top - 2 : top - 3;
+			auto mem = elementAddress(unit, base, op == Operation::IASTORE);
+			auto v = _stack.back();
+			std::string value = "%eax";
+			if (v.kind == Value::CONST && !mem.empty())
+				value = cat("$", v.value);
+			else if (v.kind != Value::REG)
+				emit(cat("movl ", source(unit, top - 1), ", %eax"));
+			_stack.resize(base);
+			flush(unit);
+			if (mem.empty()) {
+				checkAddress(unit, k);
+				mem = "(%rdx)";
+			}
+			emit(cat("movl ", value, ", ", mem));
+			break;
+		}
+		case Operation::IALOAD: {
+			auto mem = elementAddress(unit, top - 2, 1);
+			_stack.resize(top - 2);
+			flush(unit);
+			if (mem.empty()) {
+				checkAddress(unit, k);
+				mem = "(%rdx)";
+			}
+			emit(cat("movl ", mem, ", %eax"));
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::IAFILL:
+		case Operation::IACOPY:
+		case Operation::IACMP: {
+			// ..., array, count, value | ..., dst, src, count | ..., lhs, rhs, count
+			std::size_t countAt = op == Operation::IAFILL ? top - 2 : top - 1;
+			std::size_t first = top - 3;
+			std::size_t second = op == Operation::IAFILL ? top - 1 : top - 2;
+			auto count = _stack[countAt];
+			const auto loadAddress = [&](std::size_t at, const char* reg) {
+				auto& a = _stack[at];
+				if (a.kind == Value::ADDR)
+					emit(cat("leaq ", addrOf(unit, a, 0), ", ", reg));
+				else if (a.kind == Value::REG)
+					emit(cat("movq %rax, ", reg));
+				else if (a.kind == Value::MEM)
+					emit(cat("movq ", slot(unit, at), ", ", reg));
+				else
+					DieAndPrint("integer used as an address");
+			};
+			if (op == Operation::IAFILL) {
+				auto& v = _stack[second];
+				if (v.kind == Value::CONST)
+					emit(cat("movq $", v.value, ", %rax"));
+				else if (v.kind == Value::REG)
+					emit("cltq");
+				else
+					emit(cat("movslq ", slot(unit, second), ", %rax"));
+			}
+			else
+				loadAddress(second, "%rsi");
+			loadAddress(first, "%rdi");
+			if (count.kind != Value::CONST)
+				emit(cat("movslq ", source(unit, countAt), ", %rcx"));
+			_stack.resize(first);
+			flush(unit);
+			auto skip = cat(".LK", unit.index < 0 ? std::string("S") : std::to_string(unit.index), "_", k);
+			if (count.kind == Value::CONST) {
+				if (count.value < 0) {
+					emit(cat("jmp ", trap(unit, k, "rt_msgLength")));
+					if (op == Operation::IACMP)
+						push(unit, Value{Value::CONST, 0, false});
+					break;
+				}
+				if (count.value == 0) {
+					if (op == Operation::IACMP)
+						push(unit, Value{Value::CONST, 0, false});
+					break;
+				}
+				emit(cat("movl $", count.value, ", %ecx"));
+			}
+			else {
+				emit("testq %rcx, %rcx");
+				emit(cat("js ", trap(unit, k, "rt_msgLength")));
+				if (op == Operation::IACMP)
+					emit("movl $0, %eax");
+				emit(cat("jz ", skip));
+			}
+			emit(cat("movl $", k, ", -4(%rbp)"));
+			emit("movq %rdi, %rdx");
+			emit("call rt_check");
+			if (op != Operation::IAFILL) {
+				emit("movq %rsi, %rdx");
+				emit("call rt_check");
+			}
+			if (op == Operation::IAFILL)
+				emit("rep stosq");
+			else if (op == Operation::IACOPY) {
+				emit("leaq (,%rcx,8), %rdx");
+				emit("call memmove@PLT");
+			}
+			else
+				emit("call rt_iacmp");
+			*_out << skip << ":\n";
+			if (op == Operation::IACMP)
+				push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::IACHK: {
+			// 下标留在原处, 只弹出长度
+			auto index = _stack[top - 2], length = _stack[top - 1];
+			if (index.kind == Value::CONST && length.kind == Value::CONST) {
+				if (index.value < 0 || index.value >= length.value)
+					emit(cat("jmp ", trap(unit, k, "rt_msgIndex")));
+			}
+			else {
+				auto fail = trap(unit, k, "rt_msgIndex");
+				emit(cat("movl ", source(unit, top - 1), ", %ecx"));
+				emit(cat("movl ", source(unit, top - 2), ", %r8d"));
+				emit("testl %r8d, %r8d");
+				emit(cat("js ", fail));
+				emit("cmpl %ecx, %r8d");
+				emit(cat("jge ", fail));
+			}
+			_stack.resize(top - 1);
+			break;
+		}
+		case Operation::IADD:
+		case Operation::ISUB:
+		case Operation::IMUL: {
+			auto l = _stack[top - 2], r = _stack[top - 1];
+			const char* name = op == Operation::IADD ? "addl" : op == Operation::ISUB ? "subl" : "imull";
+			if (l.kind == Value::CONST && r.kind == Value::CONST) {
+				// 按 32 位补码回绕
+				uint32_t a = l.value, b = r.value;
+				uint32_t c = op == Operation::IADD ? a + b : op == Operation::ISUB ? a - b : a * b;
+				_stack.resize(top - 2);
+				push(unit, Value{Value::CONST, static_cast<int32_t>(c), false});
+				break;
+			}
+			if (r.kind == Value::REG) {
+				if (op == Operation::ISUB) {
+					emit("movl %eax, %ecx");
+					emit(cat("movl ", source(unit, top - 2), ", %eax"));
+					emit("subl %ecx, %eax");
+				}
+				else
+					emit(cat(name, " ", source(unit, top - 2), ", %eax"));
+			}
+			else {
+				emit(cat("movl ", source(unit, top - 2), ", %eax"));
+				emit(cat(name, " ", source(unit, top - 1), ", %eax"));
+			}
+			_stack.resize(top - 2);
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::IDIV: {
+			auto l = _stack[top - 2], r = _stack[top - 1];
+			if (r.kind == Value::CONST) {
+				if (r.value == 0)
+					emit(cat("jmp ", trap(unit, k, "rt_msgDivide")));
+				else if (l.kind == Value::CONST && l.value == INT_MIN && r.value == -1)
+					emit(cat("jmp ", trap(unit, k, "rt_msgOverflow")));
+				else if (l.kind == Value::CONST) {
+					_stack.resize(top - 2);
+					push(unit, Value{Value::CONST, l.value / r.value, false});
+					break;
+				}
+				else if (r.value == -1) {
+					emit(cat("movl ", source(unit, top - 2), ", %eax"));
+					emit("cmpl $-2147483648, %eax");
+					emit(cat("je ", trap(unit, k, "rt_msgOverflow")));
+					emit("negl %eax");
+				}
+				else {
+					emit(cat("movl ", source(unit, top - 2), ", %eax"));
+					emit(cat("movl $", r.value, ", %ecx"));
+					emit("cltd");
+					emit("idivl %ecx");
+				}
+			}
+			else {
+				// INT_MIN / -1 在 x86 上会触发异常, 与 VM 一样先检查并报告
+				emit(cat("movl ", source(unit, top - 1), ", %ecx"));
+				emit(cat("movl ", source(unit, top - 2), ", %eax"));
+				emit("testl %ecx, %ecx");
+				emit(cat("jz ", trap(unit, k, "rt_msgDivide")));
+				emit("cmpl $-1, %ecx");
+				emit("je 1f");
+				emit("cltd");
+				emit("idivl %ecx");
+				emit("jmp 2f");
+				*_out << "1:\n";
+				emit("cmpl $-2147483648, %eax");
+				emit(cat("je ", trap(unit, k, "rt_msgOverflow")));
+				emit("negl %eax");
+				*_out << "2:\n";
+			}
+			_stack.resize(top - 2);
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::INEG: {
+			auto v = _stack.back();
+			pop();
+			if (v.kind == Value::CONST) {
+				push(unit, Value{Value::CONST, static_cast<int32_t>(0u - static_cast<uint32_t>(v.value)), false});
+				break;
+			}
+			if (v.kind == Value::MEM)
+				emit(cat("movl ", slot(unit, top - 1), ", %eax"));
+			emit("negl %eax");
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::ICMP: {
+			auto l = _stack[top - 2], r = _stack[top - 1];
+			// 紧跟的条件跳转不是跳转目标时, 直接用比较结果跳转
+			bool fused = k + 1 < unit.code.size() && !unit.target[k + 1] && jumpOf(unit.code[k + 1].GetOperation()) != nullptr;
+			if (l.kind == Value::CONST && r.kind == Value::CONST) {
+				int32_t c = l.value > r.value ? 1 : l.value < r.value ? -1 : 0;
+				_stack.resize(top - 2);
+				if (!fused) {
+					push(unit, Value{Value::CONST, c, false});
+					break;
+				}
+				auto& jump = unit.code[++k];
+				flush(unit);
+				if (holds(jump.GetOperation(), c))
+					emit(cat("jmp ", label(unit, jump.GetX())));
+				break;
+			}
+			emit(cat("movl ", source(unit, top - 2), ", %ecx"));
+			auto rhs = source(unit, top - 1);
+			_stack.resize(top - 2);
+			if (fused) {
+				auto& jump = unit.code[++k];
+				flush(unit);
+				emit(cat("cmpl ", rhs, ", %ecx"));
+				emit(cat(jumpOf(jump.GetOperation()), " ", label(unit, jump.GetX())));
+				break;
+			}
+			emit(cat("cmpl ", rhs, ", %ecx"));
+			emit("setg %al");
+			emit("setl %cl");
+			emit("movzbl %al, %eax");
+			emit("movzbl %cl, %ecx");
+			emit("subl %ecx, %eax");
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::JMP:
+			flush(unit);
+			emit(cat("jmp ", label(unit, ins.GetX())));
+			break;
+		case Operation::JE:
+		case Operation::JNE:
+		case Operation::JL:
+		case Operation::JGE:
+		case Operation::JG:
+		case Operation::JLE: {
+			auto v = _stack.back();
+			auto cond = source(unit, top - 1);
+			pop();
+			flush(unit);
+			if (v.kind == Value::CONST) {
+				if (holds(op, v.value))
+					emit(cat("jmp ", label(unit, ins.GetX())));
+				break;
+			}
+			emit(v.kind == Value::REG ? "testl %eax, %eax" : cat("cmpl $0, ", cond));
+			emit(cat(jumpOf(op), " ", label(unit, ins.GetX())));
+			break;
+		}
+		case Operation::CALL:
+		case Operation::ISPAWN: {
+			auto& callee = _units[ins.GetX() + 1];
+			flush(unit);
+			_stack.resize(top - callee.params);
+			emit(cat("movl $", k, ", -4(%rbp)"));
+			if (op == Operation::CALL) {
+				emit(cat("leaq ", slot(unit, _stack.size()), ", %rdi"));
+				emit(cat("call c0_", callee.name));
+			}
+			else {
+				emit(cat("movl $", callee.index, ", %edi"));
+				emit(cat("leaq ", slot(unit, _stack.size()), ", %rsi"));
+				emit(cat("movl $", callee.params, ", %edx"));
+				emit("call rt_spawn");
+			}
+			if (op == Operation::ISPAWN || callee.returnsValue)
+				push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::IJOIN: {
+			emit(cat("movl ", source(unit, top - 1), ", %edi"));
+			pop();
+			flush(unit);
+			emit(cat("movl $", k, ", -4(%rbp)"));
+			emit("call rt_join");
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		}
+		case Operation::RET:
+			if (unit.index < 0)
+				DieAndPrint("ret in .start");
+			// join 一个无返回值的任务得到 0
+			emit("xorl %eax, %eax");
+			emit("leave");
+			emit("ret");
+			break;
+		case Operation::IRET:
+			if (unit.index < 0)
+				DieAndPrint("ret in .start");
+			if (_stack.back().kind != Value::REG)
+				emit(cat("movl ", source(unit, top - 1), ", %eax"));
+			emit("leave");
+			emit("ret");
+			break;
+		case Operation::IPRINT:
+		case Operation::CPRINT:
+			emit(cat("movl ", source(unit, top - 1), ", %edi"));
+			pop();
+			emit(op == Operation::IPRINT ? "call rt_iprint" : "call putchar@PLT");
+			break;
+		case Operation::PRINTL:
+			if (top > 0 && _stack.back().kind == Value::REG)
+				materialize(unit, top - 1);
+			emit("movl $10, %edi");
+			emit("call putchar@PLT");
+			break;
+		case Operation::ISCAN:
+			if (top > 0 && _stack.back().kind == Value::REG)
+				materialize(unit, top - 1);
+			emit(cat("movl $", k, ", -4(%rbp)"));
+			emit("call rt_scan");
+			push(unit, Value{Value::REG, 0, false});
+			break;
+		default:
+			DieAndPrint(cat("instruction ", op, " has no native code"));
+		}
+	}
+
+	// 调用栈用到的文字, 栈帧大小, 函数表和全局变量
+	void X86Generator::outputData() {
+		*_out << "\n" << runtimeStrings;
+		std::ostringstream tables;
+		tables << "\t.section .data.rel.ro,\"aw\"\n\t.p2align 3\n";
+		const auto site = [&](const std::string& name, const std::string& first, const std::string& called) {
+			*_out << ".LSf" << name << ":\n\t.string " << quote(first) << "\n";
+			*_out << ".LSc" << name << ":\n\t.string " << quote(called) << "\n";
+			tables << ".LR" << name << ":\n\t.quad .LSf" << name << ", .LSc" << name << "\n";
+			return ".LR" + name;
+		};
+		std::vector<std::string> siteTables = { "rt_sitesT" };
+		for (auto& unit : _units) {
+			auto tag = unit.index < 0 ? std::string("S") : std::to_string(unit.index);
+			std::vector<std::string> records;
+			for (std::size_t pc = 0; pc < unit.code.size(); ++pc) {
+				auto& ins = unit.code[pc];
+				if (!mayFail(ins.GetOperation()) || unit.depth[pc] < 0) {
+					records.push_back("0");
+					continue;
+				}
+				auto where = cat(" at instruction ", pc, " : ", textOf(ins));
+				if (unit.index < 0)
+					records.push_back(site(cat(tag, "_", pc), "          function __START__" + where, "\ncalled by .start" + where));
+				else
+					records.push_back(site(cat(tag, "_", pc), "          function " + unit.name + where, "\ncalled by function " + unit.name + where));
+			}
+			if (unit.index < 0)
+				records.push_back(site(cat(tag, "_", unit.code.size()),
+					"          control reaches the end of function __START__ without return",
+					"\ncalled by .start at instruction " + std::to_string(unit.code.size())));
+			tables << "rt_sites" << tag << ":\n";
+			for (auto& r : records)
+				tables << "\t.quad " << r << "\n";
+			siteTables.push_back("rt_sites" + tag);
+		}
+		// 任务的起点相当于只有一条 call 的 .start
+		std::vector<std::string> taskRecords;
+		for (std::size_t f = 1; f < _units.size(); ++f) {
+			auto where = cat(" at instruction 0 : call ", _units[f].index);
+			taskRecords.push_back(site(cat("T_", _units[f].index), "          function __START__" + where, "\ncalled by .start" + where));
+		}
+		tables << "rt_sitesT:\n";
+		for (auto& r : taskRecords)
+			tables << "\t.quad " << r << "\n";
+		tables << "rt_siteTables:\n";
+		for (auto& t : siteTables)
+			tables << "\t.quad " << t << "\n";
+		tables << "rt_functions:\n";
+		for (std::size_t f = 1; f < _units.size(); ++f)
+			tables << "\t.quad c0_" << _units[f].name << "\n";
+
+		*_out << "\t.p2align 3\nrt_frameBytes:\n";
+		for (std::size_t f = 1; f < _units.size(); ++f)
+			*_out << "\t.quad " << 8 * static_cast<int64_t>(_units[f].maxDepth | 1) << "\n";
+		*_out << tables.str();
+		*_out << "\t.bss\n\t.p2align 4\n";
+		*_out << "rt_globals:\n\t.zero " << 8 * static_cast<int64_t>(std::max(_units[0].maxDepth, 1)) << "\n";
+		*_out << "rt_globalsEnd:\n";
+		*_out << "rt_stackLimit:\n\t.zero 8\n";
+		*_out << "rt_tasks:\n\t.zero 8\n";
+		*_out << "rt_tasksCount:\n\t.zero 8\n";
+		*_out << "rt_tasksCapacity:\n\t.zero 8\n";
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "error/error.h"
+#include "instruction/instruction.h"
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <optional>
+#include <cstdint>
+#include <cstddef> // for std::size_t
+
+namespace cc0 {
+
+	// x86-64 后端: 直接把分析器输出的指令流翻译为 GNU as 汇编(AT&T 语法),
+	// 生成的文件自带运行时, 由系统的 C 编译器汇编并链接为 ELF 可执行文件:
+	//     cc0 -n prog.c0 -o prog.s && cc prog.s -o prog -pthread
+	// 每个 slot 占 8 字节. 函数的参数、局部变量和操作数栈都在机器栈的栈帧里,
+	// 每条指令执行前的栈高度是静态确定的, 所以栈上的第 k 个 slot 就是 k*8(%rsp);
+	// .start 的栈帧(全局变量)放在 .bss. 运行时错误的信息和调用栈与 VM 相同,
+	// spawn 出的任务由 join 它(或程序结束时)的线程执行.
+	class X86Generator final {
+	private:
+		using int32_t = std::int32_t;
+		using int64_t = std::int64_t;
+	public:
+		X86Generator(Program p)
+			: _instructions(std::move(p.instructions)), _constants(std::move(p.constants)), _units({}), _out(nullptr), _stack({}), _stubs({}) {}
+		X86Generator(X86Generator&&) = delete;
+		X86Generator(const X86Generator&) = delete;
+		X86Generator& operator=(X86Generator) = delete;
+
+		// 唯一接口
+		// 不能翻译的程序 (栈高度与路径有关) 返回错误, 这时不输出任何内容
+		std::optional<CompilationError> Generate(std::ostream& out);
+	private:
+		// .start 或一个函数
+		struct Unit {
+			int32_t index;	// .start 为 -1
+			std::string name;
+			int32_t params;
+			bool returnsValue;
+			std::vector<Instruction> code;
+			std::vector<int32_t> depth;	// 每条指令执行前的栈高度, -1 为不可达
+			std::vector<bool> target;	// 是否为跳转目标
+			int32_t maxDepth;
+		};
+		// 模拟栈上的一项: 值暂时不写入栈帧, 直到必须落地
+		struct Value {
+			enum Kind { MEM, CONST, ADDR, REG } kind;
+			int32_t value;	// CONST 的值 | ADDR 的偏移
+			bool global;	// ADDR 是否指向 .start 的栈帧
+		};
+
+		// 拆分指令流, 计算每条指令的栈高度
+		void splitUnits();
+		std::optional<CompilationError> computeDepth(Unit&);
+		int32_t stackEffect(const Unit&, const Instruction&);
+
+		void outputUnit(const Unit&);
+		void outputInstruction(const Unit&, std::size_t&);
+		void outputData();
+
+		// 栈帧中的 slot
+		std::string slot(const Unit&, int32_t);
+		std::string addrOf(const Unit&, const Value&, int32_t);
+		std::string source(const Unit&, std::size_t);
+		void materialize(const Unit&, std::size_t);
+		void flush(const Unit&);
+		void push(const Unit&, Value);
+		Value pop();
+		// 把动态地址算到 %rdx, 静态可确定时返回内存操作数
+		std::string elementAddress(const Unit&, std::size_t, int32_t);
+		void checkAddress(const Unit&, std::size_t);
+		std::string trap(const Unit&, std::size_t, const std::string&);
+		std::string label(const Unit&, int32_t);
+		std::string textOf(const Instruction&);
+		void emit(const std::string&);
+
+	private:
+		std::vector<Instruction> _instructions;
+		std::vector<std::string> _constants;
+		std::vector<Unit> _units;	// _units[0] 为 .start, _units[i+1] 为 .F{i}
+		std::ostream* _out;
+		std::vector<Value> _stack;
+		std::vector<std::string> _stubs;	// 当前函数尾部的冷路径
+		int32_t _frameSlots = 0;	// 当前函数栈帧的 slot 数
+	};
+}
@@ -0,0 +1,62 @@
+#include "compiler/compiler.h"
+#include "tokenizer/tokenizer.h"
+#include "analyser/analyser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+namespace cc0 {
+
+	CompileResult Compile(std::istream& input, bool relocatable) {
+		CompileResult result;
+		// 标识符只在这次编译中有效
+		Interner interner;
+		Tokenizer tkz(input, interner);
+		auto tokens = tkz.AllTokens();
+		if (tokens.second.has_value()) {
+			result.error = tokens.second;
+			result.stage = CompileResult::TOKENIZE;
+			return result;
+		}
+		Analyser analyser(std::move(tokens.first), interner, relocatable);
+		auto p = analyser.Analyse();
+		if (p.second.has_value()) {
+			result.error = p.second;
+			result.stage = CompileResult::ANALYSE;
+			return result;
+		}
+		result.program = std::move(p.first);
+		return result;
+	}
+
+	CompileResult Compile(const std::string& source, bool relocatable) {
+		std::istringstream input(source);
+		return Compile(input, relocatable);
+	}
+
+	std::vector<CompileResult> CompileAll(const std::vector<std::string>& sources, std::size_t threads, bool relocatable,
+		const std::function<void(std::size_t, CompileResult&)>& finish) {
+		std::vector<CompileResult> results(sources.size());
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, sources.size());
+		// 每个线程领取下一个还没编译的源程序, 各自写入自己的结果
+		std::atomic<std::size_t> next(0);
+		auto worker = [&]() {
+			for (std::size_t i = next++; i < sources.size(); i = next++) {
+				results[i] = Compile(sources[i], relocatable);
+				if (finish)
+					finish(i, results[i]);
+			}
+		};
+		std::vector<std::thread> pool;
+		for (std::size_t i = 1; i < threads; i++)
+			pool.emplace_back(worker);
+		worker();
+		for (auto& t : pool)
+			t.join();
+		return results;
+	}
+}
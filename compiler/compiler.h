@@ -0,0 +1,37 @@
+#pragma once
+
+#include "error/error.h"
+#include "instruction/instruction.h"
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <functional>
+#include <iostream>
+#include <cstddef> // for std::size_t
+
+namespace cc0 {
+
+	// 一次编译(词法分析 + 语法分析)的结果
+	struct CompileResult {
+		// 出错的阶段
+		enum Stage { NONE, TOKENIZE, ANALYSE };
+
+		Program program;
+		std::optional<CompilationError> error;
+		Stage stage = NONE;
+
+		bool ok() const { return !error.has_value(); }
+	};
+
+	// 编译一个源程序. 每次编译都有自己的 Tokenizer 和 Analyser, 不同线程可以同时调用
+	// relocatable 时编译为分离编译的单元, 见 Program::relocatable
+	CompileResult Compile(std::istream& input, bool relocatable = false);
+	CompileResult Compile(const std::string& source, bool relocatable = false);
+
+	// 用 threads 个线程并行编译多个源程序, 结果与 sources 一一对应
+	// threads 为 0 时使用硬件线程数. 给出 finish 时, 编译第 i 个源程序的线程接着调用 finish(i, 结果),
+	// 后续的处理 (优化, 输出) 也并行进行
+	std::vector<CompileResult> CompileAll(const std::vector<std::string>& sources, std::size_t threads = 0, bool relocatable = false,
+		const std::function<void(std::size_t, CompileResult&)>& finish = {});
+}
@@ -11,7 +11,7 @@ namespace cc0 {
 		std::cout << "Exception: " <<  condition << "\n";
 		std::cout << "The program should not reach here.\n";
 		std::cout << "Please check your program carefully.\n";
-		std::cout << "If you believe it's not your fault, please report this to TAs.\n";
+		std::cout << "If you believe it's not your fault, please report this to TAs.\n" << std::flush;
 		std::abort();
 		// or *((int*)114514) = 19260817;
 	}
@@ -50,7 +50,17 @@ namespace cc0 {
 		ErrConstVoid,				// const void xxx
 		ErrExpressionNeedValue,		// 表达式需要值
 		ErrNeedMain,				// 缺少main函数
-		ErrNeedReturn
+		ErrNeedReturn,
+		ErrInvalidArraySize,		// int a[0]
+		ErrNeedRightSquareBracket,	// need ']'
+		ErrArrayIndexOutOfRange,	// 常量下标越界
+		ErrInvalidArrayUse,			// 数组没有下标|长度不一致
+		ErrFunctionTooLong,			// 函数的指令数超过指令下标的范围
+		ErrDivisionByZero,			// 除数是常量0
+		ErrFunctionWithoutBody,		// 不分离编译时只有声明的函数
+		ErrNativeStackHeight,		// 栈高度与路径有关, x86-64 后端无法静态确定 slot 的位置
+		ErrConflictingDeclaration,	// 函数的定义与前面的声明的返回类型或参数不一致
+		ErrIncrementBeforeOperand	// a--2 | a++2: ++/-- 后面跟着操作数
 	};
 
 	class CompilationError final{
@@ -110,6 +110,36 @@ namespace fmt {
 			case cc0::ErrNeedReturn:
 				name = "Function need return statement.";
 				break;
+			case cc0::ErrInvalidArraySize:
+				name = "Array size must be a positive integer literal.";
+				break;
+			case cc0::ErrNeedRightSquareBracket:
+				name = "Need ']' here.";
+				break;
+			case cc0::ErrArrayIndexOutOfRange:
+				name = "Array index is out of range.";
+				break;
+			case cc0::ErrInvalidArrayUse:
+				name = "Invalid use of array, e.g. missing '[' or arrays of different length.";
+				break;
+			case cc0::ErrFunctionTooLong:
+				name = "The function has too many instructions.";
+				break;
+			case cc0::ErrDivisionByZero:
+				name = "Division by a constant zero.";
+				break;
+			case cc0::ErrFunctionWithoutBody:
+				name = "A function without body can only be declared in a file compiled with --object.";
+				break;
+			case cc0::ErrNativeStackHeight:
+				name = "The stack height of a function depends on the path taken, which native code does not support.";
+				break;
+			case cc0::ErrConflictingDeclaration:
+				name = "The function does not match its earlier declaration.";
+				break;
+			case cc0::ErrIncrementBeforeOperand:
+				name = "'++' or '--' cannot be followed by an operand here; write '- -' or '+ +' for two signs, e.g. a - -2.";
+				break;
 			case cc0::ErrUnknown:
 				name = "unknown error.";
 				break;
@@ -255,6 +285,12 @@ namespace fmt {
 			case cc0::SCAN:
 				name = "Scan";
 				break;
+			case cc0::SPAWN:
+				name = "Spawn";
+				break;
+			case cc0::JOIN:
+				name = "Join";
+				break;
 			case cc0::NOT_EQUAL:
 				name = "NotEqual";
 				break;
@@ -267,6 +303,24 @@ namespace fmt {
 			case cc0::GREATER_OR_EQUAL:
 				name = "GreaterOrEqual";
 				break;
+			case cc0::PLUS_PLUS:
+				name = "PlusPlus";
+				break;
+			case cc0::MINUS_MINUS:
+				name = "MinusMinus";
+				break;
+			case cc0::PLUS_EQUAL:
+				name = "PlusEqual";
+				break;
+			case cc0::MINUS_EQUAL:
+				name = "MinusEqual";
+				break;
+			case cc0::MULTIPLICATION_EQUAL:
+				name = "MultiplicationEqual";
+				break;
+			case cc0::DIVISION_EQUAL:
+				name = "DivisionEqual";
+				break;
 			default:
 				name = "unknowntoken";
 				break;
@@ -322,6 +376,12 @@ namespace fmt {
 			case cc0::SNEW:
 				name = "snew";
 				break;
+			case cc0::IINC:
+				name = "iinc";
+				break;
+			case cc0::IINCS:
+				name = "iincs";
+				break;
 			case cc0::ILOAD:
 				name = "iload";
 				break;
@@ -346,6 +406,18 @@ namespace fmt {
 			case cc0::AASTORE:
 				name = "aastore";
 				break;
+			case cc0::IAFILL:
+				name = "iafill";
+				break;
+			case cc0::IACOPY:
+				name = "iacopy";
+				break;
+			case cc0::IACMP:
+				name = "iacmp";
+				break;
+			case cc0::IACHK:
+				name = "iachk";
+				break;
 			case cc0::IADD:
 				name = "iadd";
 				break;
@@ -415,6 +487,12 @@ namespace fmt {
 			case cc0::CALL:
 				name = "call";
 				break;
+			case cc0::ISPAWN:
+				name = "spawn";
+				break;
+			case cc0::IJOIN:
+				name = "join";
+				break;
 			case cc0::RET:
 				name = "ret";
 				break;
@@ -474,9 +552,9 @@ namespace fmt {
 			std::string name;
 			switch (p.GetOperation())
 			{
-			// 保存常量表
+			// 保存常量表, 常量的值在 Program::constants 中
 			case cc0::SAVECONST:
-				return format_to(ctx.out(), "{} S \"{}\"", p.GetIndex(), p.GetConstType() );
+				return format_to(ctx.out(), "{} S constants[{}]", p.GetIndex(), p.GetX() );
 			// .F0:    .F1:    .F17:    ...
 			case cc0::PFI:
 				return format_to(ctx.out(), ".F{}:", p.GetX() );
@@ -485,7 +563,8 @@ namespace fmt {
 			case cc0::PFUNCTION:
 				return format_to(ctx.out(), "{}", p.GetOperation() );
 			case cc0::SAVEFUNCTION:
-				return format_to(ctx.out(), "{} {} {} 1", p.GetIndex(), p.GetIndex(), p.GetX());
+				// {index} {name_index} {param_size} {level} {frame_size}
+				return format_to(ctx.out(), "{} {} {} 1 {}", p.GetIndex(), p.GetIndex(), p.GetX(), p.GetY());
 			case cc0::NOP:
 			case cc0::POP:
 			case cc0::POP2:
@@ -500,12 +579,17 @@ namespace fmt {
 			case cc0::ASTORE:
 			case cc0::IASTORE:	// array
 			case cc0::AASTORE:
+			case cc0::IAFILL:
+			case cc0::IACOPY:
+			case cc0::IACMP:
+			case cc0::IACHK:
 			case cc0::IADD:
 			case cc0::ISUB:
 			case cc0::IMUL:
 			case cc0::IDIV:
 			case cc0::INEG:		// a = -a
 			case cc0::ICMP:		// pop r: pop l: push sign(l-r);  1|-1|0
+			case cc0::IJOIN:		// pop handle: push result
 			case cc0::RET:
 			case cc0::IRET:
 			// case cc0::ARET:
@@ -520,6 +604,7 @@ namespace fmt {
 			case cc0::POPN:
 			case cc0::LOADC:		// load constant_index(2)
 			case cc0::SNEW:		// snew count(4)					
+			case cc0::IINCS:	// iincs offset(4)
 			case cc0::JMP:		
 			case cc0::JE:
 			case cc0::JNE:
@@ -528,11 +613,32 @@ namespace fmt {
 			case cc0::JG:
 			case cc0::JLE:
 			case cc0::CALL:		
+			case cc0::ISPAWN:	// spawn index(2)
 				return format_to(ctx.out(), "{} {} {}", p.GetIndex(), p.GetOperation(), p.GetX());
 			case cc0::LOADA:		// loada level_diff(2), offset(4)
+			case cc0::IINC:		// iinc offset(4), value(4)
 				return format_to(ctx.out(), "{} {} {}, {}", p.GetIndex(), p.GetOperation(), p.GetX(), p.GetY());
 			}
 			return format_to(ctx.out(), "nop");
 		}
 	};
+
+	// 整个程序的 .s0 文本, 每行一条指令, SAVECONST 从常量池取回字符串
+	template<>
+	struct formatter<cc0::Program> {
+		template <typename ParseContext>
+		constexpr auto parse(ParseContext &ctx) { return ctx.begin(); }
+
+		template <typename FormatContext>
+		auto format(const cc0::Program &p, FormatContext &ctx) {
+			auto out = ctx.out();
+			for (auto& it : p.instructions) {
+				if (it.GetOperation() == cc0::SAVECONST)
+					out = format_to(out, "{} S \"{}\"\n", it.GetIndex(), p.constants.at(it.GetX()));
+				else
+					out = format_to(out, "{}\n", it);
+			}
+			return out;
+		}
+	};
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #pragma once
 
 #include <cstdint>
-#include <utility>
+#include <map>
 #include <string>
-#include <any>
+#include <vector>
+#include <type_traits>
 
 namespace cc0 {
 
@@ -21,6 +22,8 @@ namespace cc0 {
 		LOADA,		// loada level_diff(2), offset(4)
 		NEW,		// pop (int)count, new (count) slot
 		SNEW,		// snew count(4)
+		IINC,		// iinc offset(4), value(4)
+		IINCS,		// iincs offset(4)
 		ILOAD,
 		ALOAD,
 		IALOAD,		// array
@@ -29,6 +32,10 @@ namespace cc0 {
 		ASTORE,
 		IASTORE,	// array
 		AASTORE,
+		IAFILL,		// ..., array, count, value
+		IACOPY,		// ..., dst, src, count
+		IACMP,		// ..., lhs, rhs, count
+		IACHK,		// ..., index, length -> ..., index
 		IADD,
 		// DADD,
 		ISUB,
@@ -53,6 +60,8 @@ namespace cc0 {
 		JG,
 		JLE,
 		CALL,		// call index(2)
+		ISPAWN,		// spawn index(2)
+		IJOIN,
 		RET,
 		IRET,
 		// ARET,
@@ -72,62 +81,46 @@ namespace cc0 {
 		SAVEFUNCTION
 	};
 	
+	// 一条指令, 12 字节且可以按位复制
+	// 字符串常量不放在指令里, SAVECONST 的 x 是 Program::constants 中的下标
 	class Instruction final {
 	private:
-		using uint64_t = std::uint64_t;
+		using uint32_t = std::uint32_t;
 		using int32_t = std::int32_t;
 	public:
-		friend void swap(Instruction& lhs, Instruction& rhs);
-	public:
-		// 常量池指令
-		// Instruction(int32_t index, Operation opr, std::any constType, std::any stringValue) : 
-		// 	_index(index), _opr(opr), _nameindex(-1), _x(0), _y(0), _constType(std::move(constType)), _stringValue(std::move(stringValue))  {} 
+		// 段内下标最多 24 位
+		static constexpr int32_t MaxIndex = (1 << 24) - 1;
+
 		// 常规指令
-		Instruction(int32_t index, Operation opr, int32_t x, int32_t y) : 
-			_index(index), _opr(opr), _x(x), _y(y)  {} 
-		// 函数表指令
-		// Instruction(int32_t index, int32_t nameindex, int32_t x, int32_t y) : 
-		// 	_type((int32_t)2), _index(index), _opr(opr),_nameindex(nameindex), _x(x), _y(y), _stringValue(" "), _constType(" ")  {} 
+		Instruction(int32_t index, Operation opr, int32_t x, int32_t y) :
+			_x(x), _y(y), _opr(static_cast<uint32_t>(opr)), _index(static_cast<uint32_t>(index)) {}
 		Instruction() : Instruction(0, Operation::NOP, 0, 0){}
-		Instruction(const Instruction& i) { _index = i._index; _opr = i._opr; _x = i._x; _y = i._y;_constType = i._constType;_stringValue=i._stringValue;}
-		Instruction(Instruction&& i) :Instruction() { swap(*this, i); }
-		Instruction& operator=(Instruction i) { swap(*this, i); return *this; }
-		bool operator==(const Instruction& i) const { return _index == i._index && _opr == i._opr && _x == i._x && _y == i._y&& _constType == i._constType&&_stringValue==i._stringValue;}
+		bool operator==(const Instruction& i) const { return _index == i._index && _opr == i._opr && _x == i._x && _y == i._y; }
 
 		void SetX(int32_t x){ _x = x; }
 		void SetY(int32_t y){ _y = y; }
-		void SetConstType(std::string contsType){_constType = contsType ;}
-		void SetStringValue(std::string stringValue){ _stringValue = stringValue;}
-		int32_t GetIndex() const { return _index; }
-		Operation GetOperation() const { return _opr; }
-		// int32_t GetNameindex() const { return _nameindex; }
+		int32_t GetIndex() const { return static_cast<int32_t>(_index); }
+		Operation GetOperation() const { return static_cast<Operation>(_opr); }
 		int32_t GetX() const { return _x; }
 		int32_t GetY() const { return _y; }
-		std::string GetConstType() const { 
-			return _constType;
-		}
-		std::string GetStringValue() const { 
-			return _stringValue;
-		}
-		
+
 	private:
-		// _type=0:常规指令;=1:常量池;=2:函数表
-		// int32_t _type ;
-		int32_t _index ;
-		Operation _opr;
 		int32_t _x ;
 		int32_t _y ;
-		std::string _constType ;//常量池中，常量的类型
-		std::string _stringValue;//字符串的值
+		uint32_t _opr : 8;
+		uint32_t _index : 24;
 	};
 
-	inline void swap(Instruction& lhs, Instruction& rhs) {
-		using std::swap;
-		swap(lhs._index, rhs._index);
-		swap(lhs._opr, rhs._opr);
-		swap(lhs._x, rhs._x);
-		swap(lhs._y, rhs._y);
-		swap(lhs._constType, rhs._constType);
-		swap(lhs._stringValue, rhs._stringValue);
-	}
+	static_assert(sizeof(Instruction) == 12, "cc0::Instruction should stay 12 bytes");
+	static_assert(std::is_trivially_copyable<Instruction>::value, "cc0::Instruction should be trivially copyable");
+
+	// 分析器的输出: 指令序列和它引用的字符串常量
+	struct Program {
+		std::vector<Instruction> instructions;
+		std::vector<std::string> constants;
+		// 分离编译的单元, 所有函数都可能被别的文件调用, 不要求有 main
+		bool relocatable = false;
+		// 只有声明, 在别的文件中定义的函数: 函数下标 -> 是否有返回值. 它们有 SAVEFUNCTION, 没有函数体
+		std::map<std::int32_t, bool> imports;
+	};
 }
\ No newline at end of file
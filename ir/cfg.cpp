@@ -0,0 +1,79 @@
+#include "ir/cfg.h"
+#include "ir/ir.h"
+
+namespace cc0 {
+
+	ControlFlowGraph::ControlFlowGraph(const std::vector<Instruction>& code, std::size_t begin, std::size_t end)
+		: _blocks(), _blockOf(), _reachable(), _exitReachable(false) {
+		build(code, begin, end);
+		computeReachable();
+	}
+
+	void ControlFlowGraph::build(const std::vector<Instruction>& code, std::size_t begin, std::size_t end) {
+		int32_t size = end > begin ? static_cast<int32_t>(end - begin) : 0;
+		if (size == 0)
+			return;
+		int32_t base = code[begin].GetIndex();
+		// 目标不在这一段内的跳转通向出口
+		const auto target = [&](const Instruction& ins) {
+			int32_t t = ins.GetX() - base;
+			return (t >= 0 && t < size) ? t : -1;
+		};
+		std::vector<bool> leader(size, false);
+		leader[0] = true;
+		for (int32_t k = 0; k < size; k++) {
+			auto& ins = code[begin + k];
+			if (ir::IsJump(ins.GetOperation()) && target(ins) >= 0)
+				leader[target(ins)] = true;
+			if ((ir::IsJump(ins.GetOperation()) || ir::IsReturn(ins.GetOperation())) && k + 1 < size)
+				leader[k + 1] = true;
+		}
+		_blockOf.assign(size, 0);
+		for (int32_t k = 0; k < size; k++) {
+			if (leader[k])
+				_blocks.push_back(Block{ k, k, {}, {}, false });
+			_blocks.back().end = k + 1;
+			_blockOf[k] = static_cast<int32_t>(_blocks.size()) - 1;
+		}
+		const auto edge = [&](int32_t from, int32_t to) {
+			if (to < 0 || to >= size) {
+				_blocks[from].exits = true;
+				return;
+			}
+			_blocks[from].successors.push_back(_blockOf[to]);
+			_blocks[_blockOf[to]].predecessors.push_back(from);
+		};
+		for (int32_t b = 0; b < static_cast<int32_t>(_blocks.size()); b++) {
+			auto& last = code[begin + _blocks[b].end - 1];
+			auto op = last.GetOperation();
+			if (ir::IsReturn(op))
+				continue;
+			if (ir::IsJump(op))
+				edge(b, target(last));
+			if (op != Operation::JMP)
+				edge(b, _blocks[b].end);
+		}
+	}
+
+	// 从入口出发的一次遍历, 与块数和边数成线性
+	void ControlFlowGraph::computeReachable() {
+		_reachable.assign(_blocks.size(), false);
+		if (_blocks.empty()) {
+			_exitReachable = true;
+			return;
+		}
+		std::vector<int32_t> worklist = { 0 };
+		_reachable[0] = true;
+		while (!worklist.empty()) {
+			auto b = worklist.back();
+			worklist.pop_back();
+			if (_blocks[b].exits)
+				_exitReachable = true;
+			for (auto s : _blocks[b].successors)
+				if (!_reachable[s]) {
+					_reachable[s] = true;
+					worklist.push_back(s);
+				}
+		}
+	}
+}
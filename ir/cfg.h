@@ -0,0 +1,46 @@
+#pragma once
+
+#include "instruction/instruction.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef> // for std::size_t
+
+namespace cc0 {
+
+	// 一段指令的控制流图
+	// 基本块从段首, 跳转目标, 以及跳转和返回之后的指令开始.
+	// 出口(执行越过段的最后一条指令, 或跳出这一段)不单独成块, 用 Block::exits 表示.
+	class ControlFlowGraph final {
+	private:
+		using int32_t = std::int32_t;
+	public:
+		struct Block {
+			int32_t begin;	// [begin, end), 相对段首的位置
+			int32_t end;
+			std::vector<int32_t> successors;	// 块下标
+			std::vector<int32_t> predecessors;
+			bool exits;	// 有一条边通向出口
+		};
+
+		// code[begin, end) 中跳转的目标是指令下标, 段首指令的下标为 code[begin].GetIndex()
+		ControlFlowGraph(const std::vector<Instruction>& code, std::size_t begin, std::size_t end);
+		ControlFlowGraph(const std::vector<Instruction>& code) : ControlFlowGraph(code, 0, code.size()) {}
+
+		const std::vector<Block>& Blocks() const { return _blocks; }
+		// 指令所在的块
+		int32_t BlockOf(int32_t position) const { return _blockOf[position]; }
+		// 从入口可达的块
+		const std::vector<bool>& Reachable() const { return _reachable; }
+		// 是否有从入口到出口的路径, 没有则所有路径都以返回结束
+		bool ExitReachable() const { return _exitReachable; }
+	private:
+		void build(const std::vector<Instruction>&, std::size_t, std::size_t);
+		void computeReachable();
+	private:
+		std::vector<Block> _blocks;
+		std::vector<int32_t> _blockOf;
+		std::vector<bool> _reachable;
+		bool _exitReachable;
+	};
+}
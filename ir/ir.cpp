@@ -0,0 +1,525 @@
+#include "ir/ir.h"
+#include "ir/cfg.h"
+#include "error/error.h"
+
+#include <algorithm>
+
+namespace cc0 {
+
+	namespace ir {
+
+		bool IsJump(Operation op) {
+			return op == Operation::JMP || IsBranch(op);
+		}
+
+		bool IsBranch(Operation op) {
+			switch (op) {
+			case Operation::JE:
+			case Operation::JNE:
+			case Operation::JL:
+			case Operation::JGE:
+			case Operation::JG:
+			case Operation::JLE:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		Operation InvertBranch(Operation op) {
+			switch (op) {
+			case Operation::JE: return Operation::JNE;
+			case Operation::JNE: return Operation::JE;
+			case Operation::JL: return Operation::JGE;
+			case Operation::JGE: return Operation::JL;
+			case Operation::JG: return Operation::JLE;
+			case Operation::JLE: return Operation::JG;
+			default:
+				DieAndPrint("not a conditional jump");
+				return op;
+			}
+		}
+
+		bool IsReturn(Operation op) {
+			return op == Operation::RET || op == Operation::IRET;
+		}
+
+		bool IsTerminator(Operation op) {
+			return op == Operation::JMP || IsReturn(op);
+		}
+
+		std::optional<Slot> SlotOf(const Instruction& ins) {
+			if (ins.GetOperation() != Operation::LOADA)
+				return {};
+			return Slot{ ins.GetX(), ins.GetY() };
+		}
+	}
+
+	const Instruction* BasicBlock::Terminator() const {
+		if (code.empty())
+			return nullptr;
+		auto op = code.back().GetOperation();
+		if (ir::IsJump(op) || ir::IsReturn(op))
+			return &code.back();
+		return nullptr;
+	}
+
+	std::vector<std::int32_t> BasicBlock::Successors() const {
+		std::vector<std::int32_t> rtv;
+		if (auto t = Terminator(); t != nullptr && ir::IsJump(t->GetOperation()))
+			rtv.push_back(t->GetX());
+		if (next >= 0 && std::find(rtv.begin(), rtv.end(), next) == rtv.end())
+			rtv.push_back(next);
+		return rtv;
+	}
+
+	std::int32_t IRFunction::AddBlock() {
+		blocks.emplace_back();
+		return static_cast<std::int32_t>(blocks.size()) - 1;
+	}
+
+	std::int32_t IRFunction::SplitEntry() {
+		auto entry = layout.front();
+		auto preds = Predecessors();
+		if (preds[entry].empty())
+			return entry;
+		auto b = AddBlock();
+		blocks[b].next = entry;
+		layout.insert(layout.begin(), b);
+		return b;
+	}
+
+	std::vector<std::vector<std::int32_t>> IRFunction::Predecessors() const {
+		std::vector<std::vector<std::int32_t>> rtv(blocks.size());
+		for (auto b : layout)
+			for (auto s : blocks[b].Successors())
+				rtv[s].push_back(b);
+		return rtv;
+	}
+
+	std::vector<bool> IRFunction::Reachable() const {
+		std::vector<bool> rtv(blocks.size(), false);
+		if (layout.empty())
+			return rtv;
+		std::vector<std::int32_t> worklist = { layout.front() };
+		rtv[layout.front()] = true;
+		while (!worklist.empty()) {
+			auto b = worklist.back();
+			worklist.pop_back();
+			for (auto s : blocks[b].Successors())
+				if (!rtv[s]) {
+					rtv[s] = true;
+					worklist.push_back(s);
+				}
+		}
+		return rtv;
+	}
+
+	// Cooper, Harvey, Kennedy: 按逆后序迭代求交, 直到不再变化
+	std::vector<std::int32_t> IRFunction::Dominators() const {
+		std::vector<std::int32_t> rtv(blocks.size(), -1);
+		if (layout.empty())
+			return rtv;
+		auto entry = layout.front();
+		// 后序
+		std::vector<std::int32_t> order;
+		std::vector<bool> visited(blocks.size(), false);
+		std::vector<std::pair<std::int32_t, std::size_t>> dfs = { { entry, 0 } };
+		visited[entry] = true;
+		while (!dfs.empty()) {
+			auto b = dfs.back().first;
+			auto successors = blocks[b].Successors();
+			if (dfs.back().second < successors.size()) {
+				auto s = successors[dfs.back().second++];
+				if (!visited[s]) {
+					visited[s] = true;
+					dfs.emplace_back(s, 0);
+				}
+				continue;
+			}
+			order.push_back(b);
+			dfs.pop_back();
+		}
+		std::vector<std::int32_t> number(blocks.size(), -1);
+		for (std::size_t i = 0; i < order.size(); i++)
+			number[order[i]] = static_cast<std::int32_t>(i);
+		auto preds = Predecessors();
+		rtv[entry] = entry;
+		for (bool changed = true; changed; ) {
+			changed = false;
+			for (auto it = order.rbegin(); it != order.rend(); ++it) {
+				auto b = *it;
+				if (b == entry)
+					continue;
+				std::int32_t idom = -1;
+				for (auto p : preds[b]) {
+					if (rtv[p] < 0)
+						continue;
+					if (idom < 0) {
+						idom = p;
+						continue;
+					}
+					auto x = p;
+					while (x != idom) {
+						while (number[x] < number[idom])
+							x = rtv[x];
+						while (number[idom] < number[x])
+							idom = rtv[idom];
+					}
+				}
+				if (idom != rtv[b]) {
+					rtv[b] = idom;
+					changed = true;
+				}
+			}
+		}
+		rtv[entry] = -1;
+		return rtv;
+	}
+
+	std::vector<Loop> IRFunction::Loops() const {
+		auto idom = Dominators();
+		auto preds = Predecessors();
+		const auto dominates = [&](std::int32_t a, std::int32_t b) {
+			for (; b >= 0; b = idom[b])
+				if (b == a)
+					return true;
+			return false;
+		};
+		const auto reachable = [&](std::int32_t b) { return b == layout.front() || idom[b] >= 0; };
+		std::vector<Loop> rtv;
+		for (auto h : layout) {
+			if (!reachable(h))
+				continue;
+			Loop loop{ h, std::vector<bool>(blocks.size(), false), 1 };
+			loop.body[h] = true;
+			std::vector<std::int32_t> worklist;
+			for (auto p : preds[h])
+				if (dominates(h, p) && !loop.body[p]) {
+					loop.body[p] = true;
+					loop.size++;
+					worklist.push_back(p);
+				}
+			if (worklist.empty() && std::find(preds[h].begin(), preds[h].end(), h) == preds[h].end())
+				continue;
+			while (!worklist.empty()) {
+				auto b = worklist.back();
+				worklist.pop_back();
+				for (auto p : preds[b])
+					if (!loop.body[p] && reachable(p)) {
+						loop.body[p] = true;
+						loop.size++;
+						worklist.push_back(p);
+					}
+			}
+			rtv.push_back(std::move(loop));
+		}
+		// 嵌套的循环的块是外层循环的块的子集
+		std::stable_sort(rtv.begin(), rtv.end(), [](const Loop& a, const Loop& b) { return a.size > b.size; });
+		return rtv;
+	}
+
+	void IRFunction::CompactLayout() {
+		layout.erase(std::remove_if(layout.begin(), layout.end(), [&](std::int32_t b) { return blocks[b].dead; }), layout.end());
+	}
+
+	std::size_t IRFunction::Size() const {
+		std::size_t rtv = 0;
+		for (auto b : layout)
+			rtv += blocks[b].code.size();
+		return rtv;
+	}
+
+	std::pair<std::int32_t, std::int32_t> IRModule::StackEffect(const Instruction& ins) const {
+		switch (ins.GetOperation()) {
+		case Operation::NOP:
+		case Operation::IINC:
+		case Operation::JMP:
+		case Operation::RET:
+		case Operation::PRINTL:
+			return { 0, 0 };
+		case Operation::BIPUSH:
+		case Operation::IPUSH:
+		case Operation::LOADC:
+		case Operation::LOADA:
+		case Operation::ISCAN:
+			return { 0, 1 };
+		case Operation::POP:
+		case Operation::IINCS:
+		case Operation::JE:
+		case Operation::JNE:
+		case Operation::JL:
+		case Operation::JGE:
+		case Operation::JG:
+		case Operation::JLE:
+		case Operation::IRET:
+		case Operation::IPRINT:
+		case Operation::CPRINT:
+			return { 1, 0 };
+		case Operation::POP2:
+		case Operation::ISTORE:
+		case Operation::ASTORE:
+			return { 2, 0 };
+		case Operation::POPN:
+			return { ins.GetX(), 0 };
+		case Operation::SNEW:
+			return { 0, ins.GetX() };
+		case Operation::DUP:
+			return { 1, 2 };
+		case Operation::DUP2:
+			return { 2, 4 };
+		case Operation::NEW:
+		case Operation::ILOAD:
+		case Operation::ALOAD:
+		case Operation::INEG:
+		case Operation::IJOIN:
+			return { 1, 1 };
+		case Operation::IALOAD:
+		case Operation::AALOAD:
+		case Operation::IADD:
+		case Operation::ISUB:
+		case Operation::IMUL:
+		case Operation::IDIV:
+		case Operation::ICMP:
+		case Operation::IACHK:
+			return { 2, 1 };
+		case Operation::IASTORE:
+		case Operation::AASTORE:
+		case Operation::IAFILL:
+		case Operation::IACOPY:
+			return { 3, 0 };
+		case Operation::IACMP:
+			return { 3, 1 };
+		case Operation::CALL:
+		case Operation::ISPAWN: {
+			if (ins.GetX() < 0 || ins.GetX() >= static_cast<std::int32_t>(functions.size()))
+				DieAndPrint("call of an undeclared function");
+			auto& callee = functions[ins.GetX()];
+			bool value = ins.GetOperation() == Operation::ISPAWN || callee.returnsValue;
+			return { callee.params, value ? 1 : 0 };
+		}
+		default:
+			DieAndPrint("no stack effect for this instruction");
+			return { 0, 0 };
+		}
+	}
+
+	namespace {
+
+		// 每个块入口处的栈高度, 取第一次到达时的高度; 有块从不同的路径到达时高度不同则 balanced 为 false
+		std::vector<std::int32_t> entryDepths(const IRModule& m, const IRFunction& f, bool& balanced) {
+			std::vector<std::int32_t> rtv(f.blocks.size(), -1);
+			balanced = true;
+			if (f.layout.empty())
+				return rtv;
+			std::vector<std::int32_t> worklist = { f.layout.front() };
+			rtv[f.layout.front()] = f.params;
+			while (!worklist.empty()) {
+				auto b = worklist.back();
+				worklist.pop_back();
+				auto h = rtv[b];
+				for (auto& ins : f.blocks[b].code) {
+					auto e = m.StackEffect(ins);
+					h += e.second - e.first;
+				}
+				// 条件跳转弹出条件之后才分支, 两个后继的高度相同
+				for (auto s : f.blocks[b].Successors()) {
+					if (rtv[s] < 0) {
+						rtv[s] = h;
+						worklist.push_back(s);
+					}
+					else if (rtv[s] != h)
+						balanced = false;
+				}
+			}
+			return rtv;
+		}
+	}
+
+	// 分析器生成的代码在每个块入口处的栈高度与路径无关, Lift 把不是这样的函数标为 unbalanced
+	std::vector<std::int32_t> IRModule::EntryDepths(const IRFunction& f) const {
+		bool balanced = true;
+		auto rtv = entryDepths(*this, f, balanced);
+		if (!balanced)
+			DieAndPrint("the stack height at the entry of a block depends on the path");
+		return rtv;
+	}
+
+	std::size_t IRModule::Size() const {
+		std::size_t rtv = start.Size();
+		for (auto& f : functions)
+			rtv += f.Size();
+		return rtv;
+	}
+
+	BlockValues::BlockValues(const IRModule& m, const BasicBlock& block, std::int32_t entryDepth) {
+		std::vector<Value> stack;
+		for (std::int32_t i = 0; i < entryDepth; i++)
+			stack.push_back(Value{ -1, i });
+		operands.resize(block.code.size());
+		for (std::int32_t k = 0; k < static_cast<std::int32_t>(block.code.size()); k++) {
+			auto& ins = block.code[k];
+			auto effect = m.StackEffect(ins);
+			if (effect.first > static_cast<std::int32_t>(stack.size()))
+				DieAndPrint("stack underflow in the IR");
+			operands[k].assign(stack.end() - effect.first, stack.end());
+			stack.resize(stack.size() - effect.first);
+			// dup 压入的是同一个值
+			if (ins.GetOperation() == Operation::DUP || ins.GetOperation() == Operation::DUP2) {
+				for (int time = 0; time < 2; time++)
+					stack.insert(stack.end(), operands[k].begin(), operands[k].end());
+				continue;
+			}
+			for (std::int32_t r = 0; r < effect.second; r++)
+				stack.push_back(Value{ k, r });
+		}
+		exitStack = std::move(stack);
+	}
+
+	namespace {
+
+		// 一段指令(段内跳转目标是指令下标)切成基本块
+		void liftSection(IRFunction& f, const std::vector<Instruction>& code) {
+			if (code.empty()) {
+				f.layout.push_back(f.AddBlock());
+				return;
+			}
+			ControlFlowGraph cfg(code);
+			for (auto& b : cfg.Blocks()) {
+				auto id = f.AddBlock();
+				auto& block = f.blocks[id];
+				block.code.assign(code.begin() + b.begin, code.begin() + b.end);
+				auto& last = block.code.back();
+				if (ir::IsJump(last.GetOperation()))
+					last.SetX(cfg.BlockOf(last.GetX()));
+				if (!ir::IsTerminator(last.GetOperation()) && b.end < static_cast<std::int32_t>(code.size()))
+					block.next = cfg.BlockOf(b.end);
+				f.layout.push_back(id);
+			}
+		}
+
+		void lowerSection(const IRFunction& f, std::vector<Instruction>& out) {
+			std::int32_t size = f.layout.size();
+			// 需要在块尾补 jmp 的块
+			std::vector<bool> jump(size, false);
+			std::vector<std::int32_t> start(f.blocks.size(), -1);
+			std::int32_t index = 0;
+			for (std::int32_t i = 0; i < size; i++) {
+				auto& block = f.blocks[f.layout[i]];
+				auto t = block.Terminator();
+				bool ends = t != nullptr && ir::IsTerminator(t->GetOperation());
+				if (!ends && block.next < 0 && i + 1 < size)
+					DieAndPrint("a block falling out of the function is not the last one");
+				jump[i] = !ends && block.next >= 0 && (i + 1 == size || f.layout[i + 1] != block.next);
+				start[f.layout[i]] = index;
+				index += block.code.size() + (jump[i] ? 1 : 0);
+			}
+			if (index > Instruction::MaxIndex + 1)
+				DieAndPrint("the optimised function is too long");
+			const auto target = [&](std::int32_t b) {
+				if (b < 0 || b >= static_cast<std::int32_t>(f.blocks.size()) || start[b] < 0)
+					DieAndPrint("jump to a block not in the layout");
+				return start[b];
+			};
+			index = 0;
+			for (std::int32_t i = 0; i < size; i++) {
+				auto& block = f.blocks[f.layout[i]];
+				for (auto& ins : block.code) {
+					if (ir::IsJump(ins.GetOperation()))
+						out.emplace_back(index++, ins.GetOperation(), target(ins.GetX()), ins.GetY());
+					else
+						out.emplace_back(index++, ins.GetOperation(), ins.GetX(), ins.GetY());
+				}
+				if (jump[i])
+					out.emplace_back(index++, Operation::JMP, target(block.next), 0);
+			}
+		}
+	}
+
+	// Program 的布局见 Analyser::concatSections()
+	IRModule Lift(const Program& p) {
+		IRModule m;
+		m.relocatable = p.relocatable;
+		std::vector<Instruction> start;
+		std::vector<std::vector<Instruction>> bodies;
+		std::vector<Instruction>* section = nullptr;
+		for (auto& ins : p.instructions) {
+			switch (ins.GetOperation()) {
+			case Operation::PCONSTANTS:
+			case Operation::PFUNCTION:
+				section = nullptr;
+				break;
+			case Operation::PSTART:
+				section = &start;
+				break;
+			case Operation::SAVECONST:
+				break;
+			case Operation::SAVEFUNCTION: {
+				IRFunction f;
+				f.index = static_cast<std::int32_t>(m.functions.size());
+				f.name = p.constants.at(ins.GetIndex());
+				f.params = ins.GetX();
+				f.frameSize = ins.GetY();
+				m.functions.push_back(std::move(f));
+				bodies.emplace_back();
+			} break;
+			case Operation::PFI:
+				section = &bodies.at(ins.GetX());
+				break;
+			default:
+				if (section == nullptr)
+					DieAndPrint("instruction outside of .start and functions");
+				section->push_back(ins);
+				break;
+			}
+		}
+		liftSection(m.start, start);
+		for (std::size_t i = 0; i < m.functions.size(); i++) {
+			auto& f = m.functions[i];
+			if (auto it = p.imports.find(f.index); it != p.imports.end()) {
+				f.imported = true;
+				f.returnsValue = it->second;
+			}
+			for (auto& ins : bodies[i])
+				if (ins.GetOperation() == Operation::IRET)
+					f.returnsValue = true;
+			liftSection(f, bodies[i]);
+		}
+		// 被调用者的 returnsValue 都知道了才能算栈高度
+		bool balanced = true;
+		entryDepths(m, m.start, balanced);
+		m.start.unbalanced = !balanced;
+		for (auto& f : m.functions) {
+			entryDepths(m, f, balanced);
+			f.unbalanced = !balanced;
+		}
+		return m;
+	}
+
+	Program Lower(const IRModule& m) {
+		Program p;
+		p.relocatable = m.relocatable;
+		auto& code = p.instructions;
+		std::int32_t size = m.functions.size();
+		code.reserve(3 + 2 * size + m.Size());
+		code.emplace_back(0, Operation::PCONSTANTS, 0, 0);
+		for (std::int32_t i = 0; i < size; i++) {
+			code.emplace_back(i, Operation::SAVECONST, i, 0);
+			p.constants.push_back(m.functions[i].name);
+		}
+		code.emplace_back(0, Operation::PSTART, 0, 0);
+		lowerSection(m.start, code);
+		code.emplace_back(0, Operation::PFUNCTION, 0, 0);
+		for (std::int32_t i = 0; i < size; i++)
+			code.emplace_back(i, Operation::SAVEFUNCTION, m.functions[i].params, m.functions[i].frameSize);
+		for (std::int32_t i = 0; i < size; i++) {
+			if (m.functions[i].imported) {
+				p.imports[i] = m.functions[i].returnsValue;
+				continue;
+			}
+			code.emplace_back(0, Operation::PFI, i, 0);
+			lowerSection(m.functions[i], code);
+		}
+		return p;
+	}
+}
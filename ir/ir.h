@@ -0,0 +1,134 @@
+#pragma once
+
+#include "instruction/instruction.h"
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <optional>
+#include <cstdint>
+
+// 分析器和 .s0/.o0/x86 输出之间的中间表示
+// 仍然是 VM 的栈式指令, 但按基本块组织, 控制流是显式的:
+//     跳转的 X 是目标块号, 顺序执行的后继记在 BasicBlock::next 里,
+//     块的输出顺序由 IRFunction::layout 决定, 降回指令流时才补上需要的 jmp.
+// 局部变量和全局变量是栈帧里的 Slot (loada 0, k / loada 1, k);
+// 临时值是操作数栈上的项, 块内每个操作数由哪条指令产生见 BlockValues.
+namespace cc0 {
+
+	namespace ir {
+
+		bool IsJump(Operation);	// JMP 和条件跳转
+		bool IsBranch(Operation);	// 条件跳转
+		// 条件相反的条件跳转, 如 je <-> jne
+		Operation InvertBranch(Operation);
+		bool IsReturn(Operation);
+		// 执行后不会顺序到达下一条指令
+		bool IsTerminator(Operation);
+
+		// loada 指向的位置: level 0 为当前函数的栈帧, level 1 为 .start 的全局变量
+		struct Slot {
+			std::int32_t level;
+			std::int32_t offset;
+
+			bool operator==(const Slot& s) const { return level == s.level && offset == s.offset; }
+			bool operator!=(const Slot& s) const { return !(*this == s); }
+		};
+		std::optional<Slot> SlotOf(const Instruction&);
+	}
+
+	struct BasicBlock {
+		// 以跳转结尾时, 跳转的 X 是目标块号
+		std::vector<Instruction> code;
+		// 执行完 code 后顺序到达的块, 以 jmp/ret/iret 结尾时为 -1;
+		// 不以它们结尾且为 -1 表示落出函数末尾, 这样的块只能排在最后
+		std::int32_t next = -1;
+		// 已删除的块不在 layout 中, 块号保持不变
+		bool dead = false;
+		// 有 profile 时训练运行中执行这个块的次数, 和以条件跳转结尾时跳转的次数, 不知道时为 -1
+		std::int64_t count = -1;
+		std::int64_t taken = -1;
+
+		const Instruction* Terminator() const;
+		// 跳转目标, 再加上 next
+		std::vector<std::int32_t> Successors() const;
+	};
+
+	// 自然循环: 回边 (到支配它的块的边) 的目标是循环头,
+	// 循环体是不经过循环头就能到达回边起点的块, 同一个循环头的回边合并为一个循环
+	struct Loop {
+		std::int32_t header;
+		// 按块号, 包括循环头
+		std::vector<bool> body;
+		std::int32_t size;
+	};
+
+	// .start 或一个函数
+	struct IRFunction {
+		std::int32_t index = -1;	// .start 为 -1
+		std::string name;
+		std::int32_t params = 0;
+		std::int32_t frameSize = 0;
+		bool returnsValue = false;
+		// 在别的文件中定义, 只有一个空块, 不能内联, 调用它可能再调用回这个文件
+		bool imported = false;
+		// 块入口处的栈高度与走到它的路径有关 (Lift 时发现), 所有的遍都不处理它, 也不内联它
+		bool unbalanced = false;
+		// Lift 得到的入口为 blocks[0], 之后的遍可能在前面加入口块 (见 SplitEntry)
+		std::vector<BasicBlock> blocks;
+		// 输出顺序, 第一个总是入口
+		std::vector<std::int32_t> layout;
+
+		std::int32_t AddBlock();
+		// 入口块有前驱 (是循环头) 时在它前面加一个新的入口块, 返回入口块号.
+		// 在函数开头只执行一次的指令 (如分配临时 slot 的 snew) 放在这个块里
+		std::int32_t SplitEntry();
+		// 按块号的前驱, 只统计 layout 中的块
+		std::vector<std::vector<std::int32_t>> Predecessors() const;
+		// 从入口可达的块
+		std::vector<bool> Reachable() const;
+		// 每个块的直接支配者, 入口和不可达的块为 -1
+		std::vector<std::int32_t> Dominators() const;
+		// 外层的循环在内层的之前
+		std::vector<Loop> Loops() const;
+		// 把 layout 中已删除的块去掉
+		void CompactLayout();
+		std::size_t Size() const;
+	};
+
+	struct IRModule {
+		IRFunction start;
+		// 按函数下标, 常量表就是按这个顺序排列的函数名
+		std::vector<IRFunction> functions;
+		// 见 Program::relocatable
+		bool relocatable = false;
+
+		// 指令弹出和压入的 slot 数
+		std::pair<std::int32_t, std::int32_t> StackEffect(const Instruction&) const;
+		// 每个块入口处的栈高度, 不可达的块为 -1; 不能用于 unbalanced 的函数
+		std::vector<std::int32_t> EntryDepths(const IRFunction&) const;
+		std::size_t Size() const;
+	};
+
+	// 块内的数据流: 每条指令的操作数由哪条指令产生
+	struct BlockValues {
+		struct Value {
+			// 产生它的指令在块内的下标, -1 表示块入口时已经在栈上
+			std::int32_t def;
+			// def >= 0 时为这条指令压入的第几个值, 否则为它在栈上的位置
+			std::int32_t result;
+
+			bool operator==(const Value& v) const { return def == v.def && result == v.result; }
+		};
+		// operands[k] 为第 k 条指令弹出的值, 从栈底一侧到栈顶
+		std::vector<std::vector<Value>> operands;
+		// 块结束时的栈
+		std::vector<Value> exitStack;
+
+		BlockValues(const IRModule&, const BasicBlock&, std::int32_t entryDepth);
+	};
+
+	// Program 与 IRModule 互相转换, 不优化时 Lower(Lift(p)) 与 p 相同
+	IRModule Lift(const Program&);
+	Program Lower(const IRModule&);
+}
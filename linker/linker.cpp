@@ -0,0 +1,127 @@
+#include "linker/linker.h"
+#include "src/exception.h"
+#include "src/util/print.hpp"
+
+#include <map>
+#include <string>
+#include <variant>
+
+namespace cc0 {
+
+	namespace {
+
+		const std::string& nameOf(const ObjectFile& object, const vm::Function& function) {
+			return std::get<vm::str_t>(object.file.constants.at(function.nameIndex).value);
+		}
+
+		// 没有 ret/iret 的函数 (不返回) 看不出有无返回值
+		bool returnKnown(const vm::Function& function) {
+			for (auto& ins : function.instructions)
+				if (ins.op == vm::OpCode::ret || ins.op == vm::OpCode::iret)
+					return true;
+			return false;
+		}
+	}
+
+	File Link(const std::vector<ObjectFile>& objects) {
+		// 函数名 -> 定义
+		struct Definition {
+			vm::u2 index;	// 链接后的下标
+			bool returnsValue;
+		};
+		std::map<std::string, Definition> definitions;
+		std::vector<vm::Function> functions;
+		for (auto& object : objects) {
+			for (std::size_t i = 0; i < object.file.functions.size(); i++) {
+				if (object.symbols[i].imported)
+					continue;
+				auto& name = nameOf(object, object.file.functions[i]);
+				if (functions.size() >= U2_MAX)
+					throw InvalidFile("too many functions");
+				if (!definitions.emplace(name, Definition{ static_cast<vm::u2>(functions.size()), object.symbols[i].returnsValue }).second)
+					throw InvalidFile(strfmt("duplicate definition of function {}", name));
+				functions.push_back(object.file.functions[i]);
+			}
+		}
+		if (definitions.count("main") == 0)
+			throw InvalidFile("undefined function main");
+
+		std::vector<vm::Constant> constants;
+		std::map<std::string, vm::u2> constantIndex;
+		const auto constant = [&](const vm::Constant& c) -> vm::u2 {
+			auto& value = std::get<vm::str_t>(c.value);
+			auto it = constantIndex.find(value);
+			if (it != constantIndex.end())
+				return it->second;
+			if (constants.size() >= U2_MAX)
+				throw InvalidFile("too many constants");
+			constants.push_back(c);
+			return constantIndex[value] = static_cast<vm::u2>(constants.size() - 1);
+		};
+
+		std::vector<vm::Instruction> start;
+		// 前面的文件的全局变量占用的 slot 数
+		vm::u4 globals = 0;
+		// 这个文件的第一个函数在 functions 中的下标
+		std::size_t first = 0;
+		for (auto& object : objects) {
+			// 文件中的函数下标 -> 链接后的下标
+			std::vector<vm::u2> index;
+			std::size_t defined = first;
+			for (std::size_t i = 0; i < object.file.functions.size(); i++) {
+				auto& function = object.file.functions[i];
+				if (!object.symbols[i].imported) {
+					index.push_back(static_cast<vm::u2>(defined++));
+					continue;
+				}
+				auto& name = nameOf(object, function);
+				auto it = definitions.find(name);
+				if (it == definitions.end())
+					throw InvalidFile(strfmt("undefined function {}", name));
+				auto& definition = functions[it->second.index];
+				if (definition.paramSize != function.paramSize || (returnKnown(definition) && it->second.returnsValue != object.symbols[i].returnsValue))
+					throw InvalidFile(strfmt("conflicting declarations of function {}", name));
+				index.push_back(it->second.index);
+			}
+
+			const auto relocate = [&](vm::Instruction& ins, ObjectFile::RelocationKind kind, vm::u4 base) {
+				switch (kind) {
+				case ObjectFile::RelocationKind::FUNCTION:
+					ins.x = index.at(ins.x);
+					break;
+				case ObjectFile::RelocationKind::CONSTANT:
+					ins.x = constant(object.file.constants.at(ins.x));
+					break;
+				case ObjectFile::RelocationKind::GLOBAL:
+					if (ins.op == vm::OpCode::loada)
+						ins.y += globals;
+					else
+						ins.x += globals;
+					break;
+				case ObjectFile::RelocationKind::JUMP:
+					ins.x += base;
+					break;
+				}
+			};
+			auto base = static_cast<vm::u4>(start.size());
+			start.insert(start.end(), object.file.start.begin(), object.file.start.end());
+			if (start.size() > U2_MAX)
+				throw InvalidFile("too many instructions");
+			for (std::size_t i = 0, k = first; i < object.file.functions.size(); i++)
+				if (!object.symbols[i].imported)
+					functions[k++].nameIndex = constant(object.file.constants.at(object.file.functions[i].nameIndex));
+			for (auto& r : object.relocations) {
+				if (r.function < 0)
+					relocate(start.at(base + r.ip), r.kind, base);
+				else if (!object.symbols.at(r.function).imported)
+					relocate(functions.at(index.at(r.function)).instructions.at(r.ip), r.kind, base);
+			}
+			globals += object.globals;
+			first = defined;
+		}
+
+		File file{ 0x00000002, std::move(constants), std::move(start), std::move(functions) };
+		file.compute_stack_depth();
+		return file;
+	}
+}
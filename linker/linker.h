@@ -0,0 +1,15 @@
+#pragma once
+
+#include "linker/object.h"
+#include "src/file.h"
+
+#include <vector>
+
+namespace cc0 {
+
+	// 把分离编译的单元合并为一个可以运行的 File:
+	//     定义了的函数按文件的顺序编号, 声明按名字找到定义, 参数个数和有无返回值必须一致;
+	//     相同的常量只保留一个; 各文件的 .start 按顺序拼接, 全局变量的 slot 依次排在前面的文件之后.
+	// 重复定义, 找不到定义, 声明不一致, 没有 main 或超出 .o0 格式范围时抛出 InvalidFile
+	File Link(const std::vector<ObjectFile>& objects);
+}
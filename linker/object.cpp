@@ -0,0 +1,217 @@
+#include "linker/object.h"
+#include "codegen/vm_file.h"
+#include "ir/ir.h"
+#include "error/error.h"
+#include "src/exception.h"
+
+#include <iterator>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+
+namespace cc0 {
+
+	namespace {
+
+		using Kind = ObjectFile::RelocationKind;
+
+		const std::uint32_t Magic = 0x43304F01;	// "C0O\1"
+		const std::uint16_t StartSection = 0xffff;
+
+		class Writer final {
+		public:
+			Writer(std::ostream& out) : _out(out) {}
+
+			void Put(std::uint64_t value, int bytes) {
+				for (int i = bytes - 1; i >= 0; i--)
+					_out.put(static_cast<char>((value >> (8 * i)) & 0xff));
+			}
+			void PutCode(const std::vector<vm::Instruction>& code) {
+				Put(code.size(), 2);
+				for (auto& ins : code) {
+					Put(static_cast<std::uint8_t>(ins.op), 1);
+					Put(ins.x, 4);
+					Put(ins.y, 4);
+				}
+			}
+		private:
+			std::ostream& _out;
+		};
+
+		class Reader final {
+		public:
+			Reader(std::istream& in) : _buffer(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()) {}
+
+			std::uint32_t Get(int bytes) {
+				if (_pos + bytes > _buffer.size())
+					throw InvalidFile("incomplete object file");
+				std::uint32_t rtv = 0;
+				for (int i = 0; i < bytes; i++)
+					rtv = (rtv << 8) | static_cast<unsigned char>(_buffer[_pos++]);
+				return rtv;
+			}
+			std::string GetString(std::size_t length) {
+				if (_pos + length > _buffer.size())
+					throw InvalidFile("incomplete object file");
+				_pos += length;
+				return _buffer.substr(_pos - length, length);
+			}
+			std::vector<vm::Instruction> GetCode() {
+				std::vector<vm::Instruction> code(Get(2));
+				for (auto& ins : code) {
+					ins.op = static_cast<vm::OpCode>(Get(1));
+					if (vm::nameOfOpCode.count(ins.op) == 0)
+						throw InvalidFile("invalid object file: invalid opcode");
+					ins.x = Get(4);
+					ins.y = Get(4);
+				}
+				return code;
+			}
+			bool AtEnd() const { return _pos == _buffer.size(); }
+		private:
+			std::string _buffer;
+			std::size_t _pos = 0;
+		};
+
+		// 需要链接器改写的操作数
+		std::optional<Kind> relocationOf(const vm::Instruction& ins, bool start) {
+			switch (ins.op) {
+			case vm::OpCode::call:
+			case vm::OpCode::spawn:
+				return Kind::FUNCTION;
+			case vm::OpCode::loadc:
+				return Kind::CONSTANT;
+			case vm::OpCode::loada:
+				// 没有嵌套的函数, 函数中层级差为 1 的就是 .start 的栈帧
+				if (ins.x == (start ? 0u : 1u))
+					return Kind::GLOBAL;
+				return {};
+			case vm::OpCode::iinc:
+			case vm::OpCode::iincs:
+				if (start)
+					return Kind::GLOBAL;
+				return {};
+			case vm::OpCode::jmp:
+			case vm::OpCode::je:
+			case vm::OpCode::jne:
+			case vm::OpCode::jl:
+			case vm::OpCode::jge:
+			case vm::OpCode::jg:
+			case vm::OpCode::jle:
+				if (start)
+					return Kind::JUMP;
+				return {};
+			default:
+				return {};
+			}
+		}
+	}
+
+	void ObjectFile::Write(std::ostream& out) const {
+		Writer w(out);
+		w.Put(Magic, 4);
+		w.Put(globals, 4);
+		w.Put(file.constants.size(), 2);
+		for (auto& constant : file.constants) {
+			// 编译器只生成函数名
+			if (constant.type != vm::Constant::Type::STRING)
+				throw InvalidFile("non-string constant in an object file");
+			auto& value = std::get<vm::str_t>(constant.value);
+			w.Put(value.size(), 2);
+			out.write(value.data(), value.size());
+		}
+		w.PutCode(file.start);
+		w.Put(file.functions.size(), 2);
+		for (std::size_t i = 0; i < file.functions.size(); i++) {
+			auto& function = file.functions[i];
+			w.Put(function.nameIndex, 2);
+			w.Put(function.paramSize, 2);
+			w.Put(function.frameSize, 4);
+			w.Put((symbols[i].imported ? 1 : 0) | (symbols[i].returnsValue ? 2 : 0), 1);
+			w.PutCode(function.instructions);
+		}
+		w.Put(relocations.size(), 4);
+		for (auto& r : relocations) {
+			w.Put(static_cast<std::uint8_t>(r.kind), 1);
+			w.Put(r.function < 0 ? StartSection : r.function, 2);
+			w.Put(r.ip, 2);
+		}
+	}
+
+	ObjectFile ObjectFile::Read(std::istream& in) {
+		Reader r(in);
+		ObjectFile object;
+		if (r.Get(4) != Magic)
+			throw InvalidFile("invalid object file: invalid magic");
+		object.globals = r.Get(4);
+		for (auto size = r.Get(2); size > 0; size--)
+			object.file.constants.push_back(vm::Constant{ vm::Constant::Type::STRING, r.GetString(r.Get(2)) });
+		object.file.start = r.GetCode();
+		for (auto size = r.Get(2); size > 0; size--) {
+			vm::Function function;
+			function.nameIndex = r.Get(2);
+			function.paramSize = r.Get(2);
+			function.level = 1;
+			function.frameSize = r.Get(4);
+			auto flags = r.Get(1);
+			function.instructions = r.GetCode();
+			if (function.nameIndex >= object.file.constants.size() || flags > 3 || ((flags & 1) && !function.instructions.empty()))
+				throw InvalidFile("invalid object file: invalid function");
+			object.file.functions.push_back(std::move(function));
+			object.symbols.push_back(Symbol{ (flags & 1) != 0, (flags & 2) != 0 });
+		}
+		for (auto size = r.Get(4); size > 0; size--) {
+			Relocation relocation;
+			auto kind = r.Get(1);
+			auto function = r.Get(2);
+			relocation.ip = r.Get(2);
+			if (kind > static_cast<std::uint8_t>(Kind::JUMP))
+				throw InvalidFile("invalid object file: invalid relocation");
+			relocation.kind = static_cast<Kind>(kind);
+			relocation.function = function == StartSection ? -1 : static_cast<std::int32_t>(function);
+			if (relocation.function >= static_cast<std::int32_t>(object.file.functions.size()))
+				throw InvalidFile("invalid object file: invalid relocation");
+			auto& code = relocation.function < 0 ? object.file.start : object.file.functions[relocation.function].instructions;
+			if (relocation.ip >= static_cast<std::int32_t>(code.size()))
+				throw InvalidFile("invalid object file: invalid relocation");
+			object.relocations.push_back(relocation);
+		}
+		if (!r.AtEnd())
+			throw InvalidFile("invalid object file: trailing content");
+		return object;
+	}
+
+	ObjectFile LowerToObject(const Program& program) {
+		if (!program.relocatable)
+			DieAndPrint("lowering a program not compiled as an object");
+		ObjectFile object;
+		object.file = LowerToFile(program);
+		auto m = Lift(program);
+		for (auto b : m.start.layout)
+			for (auto& ins : m.start.blocks[b].code) {
+				auto effect = m.StackEffect(ins);
+				object.globals += effect.second - effect.first;
+			}
+		auto& functions = object.file.functions;
+		for (std::size_t i = 0; i < functions.size(); i++) {
+			auto it = program.imports.find(static_cast<std::int32_t>(i));
+			bool returnsValue = false;
+			for (auto& ins : functions[i].instructions)
+				returnsValue = returnsValue || ins.op == vm::OpCode::iret;
+			if (it != program.imports.end())
+				object.symbols.push_back(ObjectFile::Symbol{ true, it->second });
+			else
+				object.symbols.push_back(ObjectFile::Symbol{ false, returnsValue });
+		}
+		const auto scan = [&](const std::vector<vm::Instruction>& code, std::int32_t function) {
+			for (std::size_t ip = 0; ip < code.size(); ip++)
+				if (auto kind = relocationOf(code[ip], function < 0); kind.has_value())
+					object.relocations.push_back(ObjectFile::Relocation{ kind.value(), function, static_cast<std::int32_t>(ip) });
+		};
+		scan(object.file.start, -1);
+		for (std::size_t i = 0; i < functions.size(); i++)
+			scan(functions[i].instructions, static_cast<std::int32_t>(i));
+		return object;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "instruction/instruction.h"
+#include "src/file.h"
+
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+namespace cc0 {
+
+	// 分离编译的单元 (.co): 一个文件的 File, 加上链接需要的符号和重定位.
+	// 函数按在这个文件中的下标排列, 只有声明的函数没有指令;
+	// 常量, 函数和全局变量的编号都从 0 开始, 由链接器改写为在整个程序中的编号
+	struct ObjectFile {
+		// 与 functions 一一对应, 名字是 nameIndex 处的常量
+		struct Symbol {
+			bool imported;		// 只有声明, 由链接器按名字找到定义
+			bool returnsValue;	// 定义了的函数为函数体中是否有 iret
+		};
+		enum class RelocationKind : std::uint8_t {
+			FUNCTION,	// call/spawn 的函数下标
+			CONSTANT,	// loadc 的常量下标
+			GLOBAL,		// .start 中的 loada 0,k 和 iinc/iincs, 函数中的 loada 1,k 的 slot
+			JUMP,		// .start 中的跳转, .start 拼接在其他文件的 .start 之后
+		};
+		struct Relocation {
+			RelocationKind kind;
+			std::int32_t function;	// -1 为 .start
+			std::int32_t ip;
+		};
+
+		File file{ 0x00000002, {}, {}, {} };
+		// .start 压入的 slot 数, 即全局变量 (和优化遍分配的临时 slot) 占用的 slot 数
+		std::int32_t globals = 0;
+		std::vector<Symbol> symbols;
+		std::vector<Relocation> relocations;
+
+		// 大端序的二进制格式, 格式不对时抛出 InvalidFile:
+		//     magic u4 ("C0O\1"), globals u4,
+		//     constants u2 {u2 length, bytes},
+		//     .start u2 {instruction},
+		//     functions u2 {nameIndex u2, paramSize u2, frameSize u4, flags u1, u2 {instruction}},
+		//     relocations u4 {kind u1, function u2 (0xffff 为 .start), ip u2}
+		// 指令都是 op u1, x u4, y u4
+		void Write(std::ostream& out) const;
+		static ObjectFile Read(std::istream& in);
+	};
+
+	// 把 relocatable 的分析结果 (经过优化遍) 降为 ObjectFile, 超出 .o0 格式范围时抛出 InvalidFile
+	ObjectFile LowerToObject(const Program& program);
+}
@@ -1,5 +1,8 @@
 #include "./src/vm.h"
 #include "./src/file.h"
+#include "./src/aot.h"
+#include "./src/peephole.h"
+#include "./src/profile.h"
 #include "./src/exception.h"
 #include "./src/util/print.hpp"
 #include "argparse.hpp"
@@ -7,6 +10,12 @@
 
 #include "tokenizer/tokenizer.h"
 #include "analyser/analyser.h"
+#include "codegen/x86_64.h"
+#include "codegen/vm_file.h"
+#include "compiler/compiler.h"
+#include "linker/object.h"
+#include "linker/linker.h"
+#include "optimizer/pass_manager.h"
 #include "fmts.hpp"
 
 #include <iostream>
@@ -14,9 +23,14 @@
 #include <memory>
 #include <string>
 #include <exception>
+#include <sstream>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <iterator>
 
-std::vector<cc0::Token> _tokenize(std::istream& input) {
-	cc0::Tokenizer tkz(input);
+std::vector<cc0::Token> _tokenize(std::istream& input, cc0::Interner& interner) {
+	cc0::Tokenizer tkz(input, interner);
 	auto p = tkz.AllTokens();
 	if (p.second.has_value()) {
 		fmt::print(stderr, "Tokenization error: {}\n", p.second.value());
@@ -26,29 +40,74 @@ std::vector<cc0::Token> _tokenize(std::istream& input) {
 }
 
 void Tokenize(std::istream& input, std::ostream& output) {
-	auto v = _tokenize(input);
+	cc0::Interner interner;
+	auto v = _tokenize(input, interner);
 	for (auto& it : v)
 		output << fmt::format("{}\n", it);
 	return;
 }
 
+// 由 -O0/-O1/-O2, --enable-passes, --disable-passes 决定
+cc0::OptimizeOptions _optimize;
+bool _pass_stats = false;
+
+cc0::Program _compile(std::istream& input) {
+	auto result = cc0::Compile(input);
+	if (result.stage == cc0::CompileResult::TOKENIZE) {
+		fmt::print(stderr, "Tokenization error: {}\n", result.error.value());
+		exit(2);
+	}
+	if (result.stage == cc0::CompileResult::ANALYSE) {
+		fmt::print(stderr, "Syntactic analysis error: {}\n", result.error.value());
+		exit(2);
+	}
+	cc0::PassManager pm(_optimize);
+	auto p = pm.Run(std::move(result.program));
+	if (_pass_stats) {
+		for (auto& r : pm.Reports()) {
+			fmt::print(stderr, "{}: {} -> {} instructions\n", r.name, r.before, r.after);
+			for (auto& c : r.stats.Counters())
+				fmt::print(stderr, "    {}: {}\n", c.first, c.second);
+		}
+	}
+	return p;
+}
+
+// 逗号分隔的遍名
+std::set<std::string> _pass_list(const std::string& list) {
+	std::set<std::string> rtv;
+	auto names = cc0::PassNames();
+	std::istringstream ss(list);
+	std::string name;
+	while (std::getline(ss, name, ',')) {
+		if (name.empty())
+			continue;
+		if (std::find(names.begin(), names.end(), name) == names.end()) {
+			fmt::print(stderr, "Unknown optimisation pass {}.\n", name);
+			exit(2);
+		}
+		rtv.insert(name);
+	}
+	return rtv;
+}
+
 void Analyse(std::istream& input, std::ostream& output){
-	auto tks = _tokenize(input);
-	cc0::Analyser analyser(tks);
-	auto p = analyser.Analyse();
-	if (p.second.has_value()) {
-		fmt::print(stderr, "Syntactic analysis error: {}\n", p.second.value());
+	output << fmt::format("{}", _compile(input));
+	return;
+}
+
+void GenerateX86(std::istream& input, std::ostream& output){
+	auto err = cc0::X86Generator(_compile(input)).Generate(output);
+	if (err.has_value()) {
+		fmt::print(stderr, "Native code generation error: {}\n", err.value());
 		exit(2);
 	}
-	auto v = p.first;
-	for (auto& it : v)
-		output << fmt::format("{}\n", it);
 	return;
 }
 
-void assemble_text(std::ifstream* in, std::ofstream* out ) {
+void assemble_binary(const cc0::Program& p, std::ofstream* out) {
     try {
-        File f = File::parse_file_text(*in);
+        File f = cc0::LowerToFile(p);
         // f.output_text(std::cout);
         f.output_binary(*out);
     }
@@ -57,10 +116,178 @@ void assemble_text(std::ifstream* in, std::ofstream* out ) {
     }
 }
 
+void translate_c(const cc0::Program& p, std::ofstream* out) {
+    try {
+        File f = cc0::LowerToFile(p);
+        vm::translateToC(f, *out);
+    }
+    catch (const std::exception& e) {
+        println(std::cerr, e.what());
+    }
+}
+
+bool _is_text(const std::string& name) {
+	return name.size() >= 3 && name.compare(name.size() - 3, 3, ".s0") == 0;
+}
+
+// .s0 为文本, 其余为二进制
+File _read_file(const std::string& input_file) {
+	std::ifstream in(input_file, _is_text(input_file) ? std::ios::in : std::ios::binary | std::ios::in);
+	if (!in) {
+		fmt::print(stderr, "Fail to open {} for reading.\n", input_file);
+		exit(2);
+	}
+	return _is_text(input_file) ? File::parse_file_text(in) : File::parse_file_binary(in);
+}
+
+// .o0/.s0 -> .o0/.s0, 不经过编译器, 文件可以来自别的工具链
+void optimize_file(const std::string& input_file, const std::string& output_file) {
+	try {
+		File f = _read_file(input_file);
+		auto reports = vm::peephole(f);
+		std::ofstream out(output_file, _is_text(output_file) ? std::ios::out | std::ios::trunc : std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!out) {
+			fmt::print(stderr, "Fail to open {} for writing.\n", output_file);
+			exit(2);
+		}
+		if (_is_text(output_file))
+			f.output_text(out);
+		else
+			f.output_binary(out);
+		for (auto& r : reports)
+			fmt::print(stderr, "{}: {} -> {} instructions\n", r.name, r.before, r.after);
+	}
+	catch (const std::exception& e) {
+		println(std::cerr, e.what());
+		exit(2);
+	}
+}
+
+// 在虚拟机中运行 .o0/.s0, profile_file 不为空时写出这次运行的 profile
+void run_file(const std::string& input_file, const std::string& profile_file) {
+	try {
+		auto vm = vm::VM::make_vm(_read_file(input_file));
+		if (!profile_file.empty())
+			vm->enableProfile();
+		auto ok = vm->start();
+		// 出错的运行也写出已收集的 profile
+		if (!profile_file.empty()) {
+			std::ofstream out(profile_file, std::ios::out | std::ios::trunc);
+			if (!out) {
+				fmt::print(stderr, "Fail to open {} for writing.\n", profile_file);
+				exit(2);
+			}
+			vm->profile()->output(out);
+		}
+		// 与 -a 生成的程序的运行时错误一致
+		if (!ok)
+			exit(1);
+	}
+	catch (const std::exception& e) {
+		println(std::cerr, e.what());
+		exit(2);
+	}
+}
+
+// 逗号分隔的输入文件
+std::vector<std::string> _input_list(const std::string& list) {
+	std::vector<std::string> rtv;
+	std::istringstream ss(list);
+	std::string name;
+	while (std::getline(ss, name, ','))
+		if (!name.empty())
+			rtv.push_back(name);
+	return rtv;
+}
+
+// a.c0 -> a.co
+std::string _object_name(const std::string& input_file) {
+	auto name = input_file;
+	if (name.size() >= 3 && name.compare(name.size() - 3, 3, ".c0") == 0)
+		name.resize(name.size() - 3);
+	return name + ".co";
+}
+
+// 把一个源文件的编译结果优化后写为 .co, 返回错误信息, 成功时为空
+std::string _write_object(const std::string& input_file, cc0::CompileResult& result, const std::string& output_file) {
+	if (result.stage == cc0::CompileResult::TOKENIZE)
+		return fmt::format("{}: Tokenization error: {}\n", input_file, result.error.value());
+	if (result.stage == cc0::CompileResult::ANALYSE)
+		return fmt::format("{}: Syntactic analysis error: {}\n", input_file, result.error.value());
+	cc0::PassManager pm(_optimize);
+	auto p = pm.Run(std::move(result.program));
+	try {
+		auto object = cc0::LowerToObject(p);
+		std::ofstream out(output_file, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!out)
+			return fmt::format("Fail to open {} for writing.\n", output_file);
+		object.Write(out);
+	}
+	catch (const std::exception& e) {
+		return fmt::format("{}: {}\n", input_file, e.what());
+	}
+	return "";
+}
+
+// 分离编译: 每个源文件各自编译为 .co, 最多 jobs 个文件同时编译, 0 为硬件线程数
+void compile_objects(const std::vector<std::string>& input_files, const std::vector<std::string>& output_files, std::size_t jobs) {
+	std::vector<std::string> sources;
+	for (auto& input_file : input_files) {
+		std::ifstream in(input_file, std::ios::in);
+		if (!in) {
+			fmt::print(stderr, "Fail to open {} for reading.\n", input_file);
+			exit(2);
+		}
+		sources.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	std::vector<std::string> errors(input_files.size());
+	cc0::CompileAll(sources, jobs, true, [&](std::size_t i, cc0::CompileResult& result) {
+		errors[i] = _write_object(input_files[i], result, output_files[i]);
+		// 写出后就不再需要, 及早释放
+		result.program = cc0::Program();
+	});
+	bool failed = false;
+	for (auto& e : errors) {
+		fmt::print(stderr, "{}", e);
+		failed = failed || !e.empty();
+	}
+	if (failed)
+		exit(2);
+}
+
+// .co -> .o0/.s0
+void link_objects(const std::vector<std::string>& input_files, const std::string& output_file) {
+	try {
+		std::vector<cc0::ObjectFile> objects;
+		for (auto& input_file : input_files) {
+			std::ifstream in(input_file, std::ios::binary | std::ios::in);
+			if (!in) {
+				fmt::print(stderr, "Fail to open {} for reading.\n", input_file);
+				exit(2);
+			}
+			objects.push_back(cc0::ObjectFile::Read(in));
+		}
+		File f = cc0::Link(objects);
+		std::ofstream out(output_file, _is_text(output_file) ? std::ios::out | std::ios::trunc : std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!out) {
+			fmt::print(stderr, "Fail to open {} for writing.\n", output_file);
+			exit(2);
+		}
+		if (_is_text(output_file))
+			f.output_text(out);
+		else
+			f.output_binary(out);
+	}
+	catch (const std::exception& e) {
+		println(std::cerr, e.what());
+		exit(2);
+	}
+}
+
 int main(int argc, char** argv) {
 	argparse::ArgumentParser program("cc0");
 	program.add_argument("input")
-		.help("speicify the file to be compiled.");
+		.help("speicify the file to be compiled, or comma-separated files with --object and --link.");
 	program.add_argument("-t")
 		.default_value(false)
 		.implicit_value(true)
@@ -73,6 +300,68 @@ int main(int argc, char** argv) {
 		.default_value(false)
 		.implicit_value(true)
 		.help("assemble the text input file into the binary file.");
+	program.add_argument("-a")
+		.default_value(false)
+		.implicit_value(true)
+		.help("translate the input file into a C source file, to be compiled by a C compiler.");
+	program.add_argument("-n")
+		.default_value(false)
+		.implicit_value(true)
+		.help("generate x86-64 assembly for the GNU assembler, to be linked into an ELF executable by a C compiler.");
+	program.add_argument("--optimize")
+		.default_value(false)
+		.implicit_value(true)
+		.help("run the peephole optimiser over the input .o0 (or .s0) file instead of compiling it.");
+	program.add_argument("--run")
+		.default_value(false)
+		.implicit_value(true)
+		.help("run the input .o0 (or .s0) file in the VM instead of compiling it.");
+	program.add_argument("--object")
+		.default_value(false)
+		.implicit_value(true)
+		.help("compile each input into a relocatable object <input>.co (or -o for a single input), in which functions may be only declared.");
+	program.add_argument("--link")
+		.default_value(false)
+		.implicit_value(true)
+		.help("link the input .co files into one .o0 (or .s0) file.");
+	program.add_argument("-j")
+		.default_value(std::string("1"))
+		.help("with --object, compile this many files at the same time (0 for one per hardware thread).");
+	program.add_argument("-fprofile-generate")
+		.default_value(std::string(""))
+		.help("with --run, write the execution counts of the run to this file.");
+	program.add_argument("-fprofile-use")
+		.default_value(std::string(""))
+		.help("optimise with the counts written by -fprofile-generate for an -O0 build of the same source.");
+	program.add_argument("--emit-s0")
+		.default_value(false)
+		.implicit_value(true)
+		.help("with -c or -a, also write the text assembly to <input>.s0 for debugging.");
+	program.add_argument("-O0")
+		.default_value(false)
+		.implicit_value(true)
+		.help("do not optimise (default).");
+	program.add_argument("-O1")
+		.default_value(false)
+		.implicit_value(true)
+		.help("run the cheap optimisation passes.");
+	program.add_argument("-O2")
+		.default_value(false)
+		.implicit_value(true)
+		.help("run all optimisation passes.");
+	program.add_argument("--enable-passes")
+		.default_value(std::string(""))
+		.help("comma-separated optimisation passes to run regardless of the -O level.");
+	program.add_argument("--disable-passes")
+		.default_value(std::string(""))
+		.help("comma-separated optimisation passes not to run.");
+	program.add_argument("-finline-limit")
+		.default_value(std::string(""))
+		.help("inline functions of at most this many instructions at -O2 (default 20, 0 disables inlining).");
+	program.add_argument("--pass-stats")
+		.default_value(false)
+		.implicit_value(true)
+		.help("print the statistics of every optimisation pass run to stderr.");
 	program.add_argument("-o", "--output")
 		.required()
 		.default_value(std::string("-"))
@@ -87,8 +376,94 @@ int main(int argc, char** argv) {
 		exit(2);
 	}
 
+	if (program["-O2"] == true)
+		_optimize.level = 2;
+	else if (program["-O1"] == true)
+		_optimize.level = 1;
+	_optimize.enabled = _pass_list(program.get<std::string>("--enable-passes"));
+	_optimize.disabled = _pass_list(program.get<std::string>("--disable-passes"));
+	_pass_stats = program["--pass-stats"] == true;
+	if (auto limit = program.get<std::string>("-finline-limit"); !limit.empty()) {
+		try {
+			_optimize.inlineLimit = std::stoi(limit);
+		}
+		catch (const std::exception&) {
+			fmt::print(stderr, "Invalid inline limit {}.\n", limit);
+			exit(2);
+		}
+	}
+
+	if (auto profile = program.get<std::string>("-fprofile-use"); !profile.empty()) {
+		std::ifstream in(profile);
+		if (!in) {
+			fmt::print(stderr, "Fail to open {} for reading.\n", profile);
+			exit(2);
+		}
+		try {
+			_optimize.profile = std::make_shared<const vm::Profile>(vm::Profile::parse(in));
+		}
+		catch (const std::exception& e) {
+			fmt::print(stderr, "{}\n", e.what());
+			exit(2);
+		}
+	}
+
 	auto input_file = program.get<std::string>("input");
 	auto output_file = program.get<std::string>("--output");
+	if (program["--optimize"] == true) {
+		if (program["-t"] == true || program["-s"] == true || program["-c"] == true || program["-a"] == true || program["-n"] == true)
+			exit(2);
+		if (input_file == output_file)
+			output_file += ".o0";
+		optimize_file(input_file, output_file);
+		return 0;
+	}
+	if (program["--run"] == true) {
+		if (program["-t"] == true || program["-s"] == true || program["-c"] == true || program["-a"] == true || program["-n"] == true)
+			exit(2);
+		run_file(input_file, program.get<std::string>("-fprofile-generate"));
+		return 0;
+	}
+	if (program["--object"] == true || program["--link"] == true) {
+		if (program["-t"] == true || program["-s"] == true || program["-c"] == true || program["-a"] == true || program["-n"] == true || (program["--object"] == true && program["--link"] == true))
+			exit(2);
+		auto input_files = _input_list(input_file);
+		if (input_files.empty()) {
+			fmt::print(stderr, "Please give input file.\n");
+			exit(2);
+		}
+		if (program["--link"] == true) {
+			if (output_file == "-") {
+				fmt::print(stderr, "Please give output file.\n");
+				exit(2);
+			}
+			link_objects(input_files, output_file);
+			return 0;
+		}
+		std::size_t jobs = 1;
+		try {
+			auto n = std::stoi(program.get<std::string>("-j"));
+			if (n < 0)
+				throw std::out_of_range("-j");
+			jobs = n;
+		}
+		catch (const std::exception&) {
+			fmt::print(stderr, "Invalid number of jobs {}.\n", program.get<std::string>("-j"));
+			exit(2);
+		}
+		std::vector<std::string> output_files;
+		for (auto& name : input_files)
+			output_files.push_back(_object_name(name));
+		if (output_file != "-") {
+			if (input_files.size() != 1) {
+				fmt::print(stderr, "-o can only be given with a single input.\n");
+				exit(2);
+			}
+			output_files[0] = output_file;
+		}
+		compile_objects(input_files, output_files, jobs);
+		return 0;
+	}
 	std::ifstream* input;// std::istream* input;
 	std::ofstream* output;// std::ostream* output;
 	std::ifstream inf;
@@ -113,47 +488,57 @@ int main(int argc, char** argv) {
 	// else
 	// 	output = &std::cout;
 
-	// assemble -> binary
-	if (program["-c"]==true){
-		if(program["-t"]==true || program["-s"]==true)
-			exit(2);
-		std::ifstream mid_inf;
-		std::ofstream mid_outf;
-		std::ostream* mid_output; //记得关闭
-		std::ifstream* mid_input; //记得在关闭后打开
-		// 打开输出到的中间文件
-		std::string mid_file = input_file + ".s0";
-		if (mid_file == output_file)
-			mid_file += ".mid";
-		mid_outf.open(mid_file, std::ios::out | std::ios::trunc);
-		if (!mid_outf) {
-			fmt::print(stderr, "Fail to open {} for mid-writing.\n", mid_file);
-			exit(2);
-		}
-		mid_output = &mid_outf;
-		Analyse(*input, *mid_output);
-		// 关闭中间文件的输出流，打开中间文件的输入流
-		mid_outf.close();
-		mid_inf.open(mid_file, std::ios::in);
-		if (!mid_inf){
-			fmt::print(stderr, "Fail to open {} for mid-reading.\n", mid_file);
-			exit(2);
-		}
-		mid_input = &mid_inf;
+	// assemble -> binary | C
+	if (program["-c"]==true || program["-a"]==true){
+		if(program["-t"]==true || program["-s"]==true || program["-n"]==true || (program["-c"]==true && program["-a"]==true))
+			exit(2);
+		bool aot = program["-a"]==true;
+		// 分析结果直接降为 File, 不再经过中间文件
+		auto p = _compile(*input);
+		// 调试用: 同时输出 .s0
+		if (program["--emit-s0"] == true) {
+			std::string mid_file = input_file + ".s0";
+			if (mid_file == output_file)
+				mid_file += ".mid";
+			std::ofstream mid_outf(mid_file, std::ios::out | std::ios::trunc);
+			if (!mid_outf) {
+				fmt::print(stderr, "Fail to open {} for mid-writing.\n", mid_file);
+				exit(2);
+			}
+			mid_outf << fmt::format("{}", p);
+		}
 		
 		// 打开输出文件
 		if (input_file == output_file)
-			output_file += ".o0";
-		outf.open(output_file, std::ios::binary | std::ios::out | std::ios::trunc);
+			output_file += aot ? ".c" : ".o0";
+		outf.open(output_file, aot ? std::ios::out | std::ios::trunc : std::ios::binary | std::ios::out | std::ios::trunc);
 		if (!outf){
 			outf.close();
 			fmt::print(stderr, "Fail to open {} for writing.\n", output_file);
 			exit(2);
 		}
 		output = &outf;
-		assemble_text(mid_input, output);
+		if (aot)
+			translate_c(p, output);
+		else
+			assemble_binary(p, output);
 	}
 
+	// native -> x86-64 assembly
+	else if (program["-n"] == true) {
+		if (program["-t"] == true || program["-s"] == true)
+			exit(2);
+		if (input_file == output_file)
+			output_file += ".s";
+		outf.open(output_file, std::ios::out | std::ios::trunc);
+		if (!outf) {
+			fmt::print(stderr, "Fail to open {} for writing.\n", output_file);
+			exit(2);
+		}
+		output = &outf;
+
+		GenerateX86(*input, *output);
+	}
 	else if (program["-t"] == true && program["-s"] == true) {
 		fmt::print(stderr, "You can only perform tokenization or syntactic analysis at one time.");
 		exit(2);
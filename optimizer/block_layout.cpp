@@ -0,0 +1,136 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 重新排列块, 让顺序执行的一边是更可能执行的后继:
+		//     结尾的 jmp 都换成 next, 由 Lower 在后继不紧跟着时补上;
+		//     从入口开始, 每个块后面接它更可能去的还没有放下的后继, 接不下去时从原来的顺序中下一个没有放下的块开始.
+		// 条件跳转的两个后继中, 有 profile 时训练运行中更常去的一边更可能; 否则回边 (回到循环头) 比离开循环的边更可能,
+		// 留在循环里的边比离开循环的边更可能, 不直接返回的块比直接返回的块更可能, 其余的保持原来的 next.
+		// 条件跳转的目标紧跟在后面时把条件取反, 让它顺序执行
+		class BlockLayoutPass final : public Pass {
+		public:
+			const char* Name() const override { return "block-layout"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				bool changed = runOn(m.start, stats);
+				for (auto& f : m.functions)
+					changed = runOn(f, stats) || changed;
+				return changed;
+			}
+		private:
+			// 块 b 更可能去的后继, 没有后继时为 -1
+			static int32_t likely(const IRFunction& f, int32_t b, const std::vector<int32_t>& idom, const std::vector<int32_t>& depth) {
+				auto& block = f.blocks[b];
+				auto t = block.Terminator();
+				if (t == nullptr || !ir::IsBranch(t->GetOperation()))
+					return block.next;
+				auto taken = t->GetX();
+				if (block.count > 0 && block.taken >= 0 && 2 * block.taken != block.count)
+					return 2 * block.taken > block.count ? taken : block.next;
+				auto dominates = [&](int32_t a, int32_t x) {
+					for (; x >= 0; x = idom[x])
+						if (x == a)
+							return true;
+					return false;
+				};
+				// 回边
+				if (dominates(taken, b) != dominates(block.next, b))
+					return dominates(taken, b) ? taken : block.next;
+				// 离开循环的边到达嵌套层数更少的块
+				if (depth[taken] != depth[block.next])
+					return depth[taken] > depth[block.next] ? taken : block.next;
+				// 提前返回的一边, 如递归的终止条件
+				const auto returns = [&](int32_t x) {
+					auto t = f.blocks[x].Terminator();
+					return t != nullptr && ir::IsReturn(t->GetOperation());
+				};
+				if (returns(taken) != returns(block.next))
+					return returns(taken) ? block.next : taken;
+				return block.next;
+			}
+
+			bool runOn(IRFunction& f, PassStatistics& stats) {
+				if (f.unbalanced)
+					return false;
+				auto& blocks = f.blocks;
+				auto idom = f.Dominators();
+				// 每个块所在的循环层数
+				std::vector<int32_t> depth(blocks.size(), 0);
+				for (auto& loop : f.Loops())
+					for (std::size_t b = 0; b < blocks.size(); b++)
+						if (loop.body[b])
+							depth[b]++;
+
+				bool changed = false;
+				for (auto b : f.layout) {
+					auto& code = blocks[b].code;
+					if (!code.empty() && code.back().GetOperation() == Operation::JMP) {
+						blocks[b].next = code.back().GetX();
+						code.pop_back();
+						changed = true;
+					}
+				}
+
+				std::vector<int32_t> layout;
+				layout.reserve(f.layout.size());
+				std::vector<bool> placed(blocks.size(), false);
+				// 落出函数末尾的块要留在最后
+				std::vector<int32_t> last;
+				for (auto b : f.layout)
+					if (blocks[b].Terminator() == nullptr && blocks[b].next < 0) {
+						placed[b] = true;
+						last.push_back(b);
+					}
+				for (auto start : f.layout) {
+					for (auto b = start; b >= 0 && !placed[b]; ) {
+						placed[b] = true;
+						layout.push_back(b);
+						auto next = likely(f, b, idom, depth);
+						if (next >= 0 && placed[next]) {
+							next = -1;
+							for (auto s : blocks[b].Successors())
+								if (!placed[s])
+									next = s;
+						}
+						b = next;
+					}
+				}
+				layout.insert(layout.end(), last.begin(), last.end());
+				if (layout != f.layout) {
+					f.layout.swap(layout);
+					stats.Add("layouts changed");
+					changed = true;
+				}
+
+				for (std::size_t i = 0; i < f.layout.size(); i++) {
+					auto& block = blocks[f.layout[i]];
+					auto t = block.Terminator();
+					if (t == nullptr || !ir::IsBranch(t->GetOperation()) || i + 1 == f.layout.size())
+						continue;
+					auto follower = f.layout[i + 1];
+					if (t->GetX() != follower || block.next == follower)
+						continue;
+					auto& branch = block.code.back();
+					branch = Instruction(0, ir::InvertBranch(branch.GetOperation()), block.next, 0);
+					block.next = follower;
+					if (block.count >= 0 && block.taken >= 0)
+						block.taken = block.count - block.taken;
+					stats.Add("branches inverted");
+					changed = true;
+				}
+				return changed;
+			}
+		};
+	}
+
+	std::unique_ptr<Pass> CreateBlockLayoutPass() {
+		return std::make_unique<BlockLayoutPass>();
+	}
+}
@@ -0,0 +1,340 @@
+#include "optimizer/passes.h"
+
+#include <map>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+		using int64_t = std::int64_t;
+
+		// 抽象栈上的一项. 栈帧的第 k 个 slot 就是栈上的第 k 项, 所以局部变量也在这里
+		struct Abstract {
+			enum Kind { UNKNOWN, CONST, ADDR } kind;
+			int32_t value;	// CONST 的值 | ADDR 的偏移
+			int32_t level;	// ADDR 的层级
+			// 单独压入它且没有副作用的指令在输出中的下标, 没有则为 -1;
+			// 只有这条指令还在输出末尾时才能把它删掉
+			int32_t pos;
+		};
+
+		int32_t wrap(int64_t v) {
+			return static_cast<int32_t>(static_cast<std::uint32_t>(v));
+		}
+
+		// 条件跳转是否跳转
+		bool holds(Operation op, int32_t v) {
+			switch (op) {
+			case Operation::JE:  return v == 0;
+			case Operation::JNE: return v != 0;
+			case Operation::JL:  return v < 0;
+			case Operation::JGE: return v >= 0;
+			case Operation::JG:  return v > 0;
+			case Operation::JLE: return v <= 0;
+			default: return false;
+			}
+		}
+
+		// 两个常量的运算, 除以 0 和 INT_MIN / -1 留到运行时
+		bool evaluate(Operation op, int32_t a, int32_t b, int32_t& v) {
+			switch (op) {
+			case Operation::IADD: v = wrap(int64_t(a) + b); return true;
+			case Operation::ISUB: v = wrap(int64_t(a) - b); return true;
+			case Operation::IMUL: v = wrap(int64_t(a) * b); return true;
+			case Operation::IDIV:
+				if (b == 0 || (a == INT32_MIN && b == -1))
+					return false;
+				v = a / b;
+				return true;
+			case Operation::ICMP: v = a < b ? -1 : (a > b ? 1 : 0); return true;
+			default: return false;
+			}
+		}
+
+		// 在每个基本块内跟踪栈帧 slot 和全局变量的常量值:
+		//     读已知值的变量改为 ipush, 常量运算折叠, 条件已知的跳转改为 jmp 或删除
+		// 状态不跨越块的边界
+		class ConstPropPass final : public Pass {
+		public:
+			const char* Name() const override { return "const-prop"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				_module = &m;
+				_stats = &stats;
+				bool changed = runOn(m.start);
+				for (auto& f : m.functions)
+					changed = runOn(f) || changed;
+				return changed;
+			}
+		private:
+			bool runOn(IRFunction& f) {
+				if (f.unbalanced)
+					return false;
+				auto depths = _module->EntryDepths(f);
+				bool changed = false;
+				for (auto b : f.layout)
+					if (depths[b] >= 0)
+						changed = runOn(f.blocks[b], depths[b]) || changed;
+				return changed;
+			}
+
+			bool runOn(BasicBlock& block, int32_t depth);
+
+			// 栈顶 n 项都是常量, 且依次由输出末尾的 n 条指令单独压入
+			bool constTail(std::size_t n) const {
+				if (_stack.size() < n || _out.size() < n)
+					return false;
+				for (std::size_t i = 0; i < n; i++) {
+					auto& a = _stack[_stack.size() - n + i];
+					if (a.kind != Abstract::CONST || a.pos != static_cast<int32_t>(_out.size() - n + i))
+						return false;
+				}
+				return true;
+			}
+			// 删掉栈顶 n 项和压入它们的指令
+			void drop(std::size_t n) {
+				_out.resize(_out.size() - n);
+				_stack.resize(_stack.size() - n);
+			}
+			void pushConst(int32_t v) {
+				_out.emplace_back(0, Operation::IPUSH, v, 0);
+				_stack.push_back(Abstract{ Abstract::CONST, v, 0, static_cast<int32_t>(_out.size()) - 1 });
+			}
+			void emit(const Instruction& ins, int32_t pops, int32_t pushes) {
+				_out.push_back(ins);
+				_stack.resize(_stack.size() - pops);
+				for (int32_t i = 0; i < pushes; i++)
+					_stack.push_back(Abstract{ Abstract::UNKNOWN, 0, 0, -1 });
+			}
+			// addr 指向的变量的已知值
+			bool load(const Abstract& addr, int32_t& v) const {
+				if (addr.kind != Abstract::ADDR)
+					return false;
+				if (addr.level == 0) {
+					if (addr.value < 0 || addr.value >= static_cast<int32_t>(_stack.size()) || _stack[addr.value].kind != Abstract::CONST)
+						return false;
+					v = _stack[addr.value].value;
+					return true;
+				}
+				auto it = _globals.find(addr.value);
+				if (addr.level != 1 || it == _globals.end())
+					return false;
+				v = it->second;
+				return true;
+			}
+			// 写入 addr 指向的变量, 地址未知时忘掉所有变量的值
+			void store(const Abstract& addr, bool known, int32_t v) {
+				Abstract value{ known ? Abstract::CONST : Abstract::UNKNOWN, v, 0, -1 };
+				if (addr.kind != Abstract::ADDR) {
+					for (auto& a : _stack)
+						if (a.kind == Abstract::CONST)
+							a = Abstract{ Abstract::UNKNOWN, 0, 0, -1 };
+					_globals.clear();
+				}
+				else if (addr.level == 0) {
+					if (addr.value >= 0 && addr.value < static_cast<int32_t>(_stack.size()))
+						_stack[addr.value] = value;
+				}
+				else if (known)
+					_globals[addr.value] = v;
+				else
+					_globals.erase(addr.value);
+			}
+		private:
+			IRModule* _module = nullptr;
+			PassStatistics* _stats = nullptr;
+			std::vector<Abstract> _stack;
+			// 已知值的全局变量 (loada 1, k)
+			std::map<int32_t, int32_t> _globals;
+			std::vector<Instruction> _out;
+		};
+
+		bool ConstPropPass::runOn(BasicBlock& block, int32_t depth) {
+			_stack.assign(depth, Abstract{ Abstract::UNKNOWN, 0, 0, -1 });
+			_globals.clear();
+			_out.clear();
+			_out.reserve(block.code.size());
+			bool changed = false;
+			for (auto& ins : block.code) {
+				auto op = ins.GetOperation();
+				auto effect = _module->StackEffect(ins);
+				switch (op) {
+				case Operation::IPUSH:
+				case Operation::BIPUSH:
+					_out.push_back(ins);
+					_stack.push_back(Abstract{ Abstract::CONST, ins.GetX(), 0, static_cast<int32_t>(_out.size()) - 1 });
+					break;
+				case Operation::LOADA:
+					_out.push_back(ins);
+					_stack.push_back(Abstract{ Abstract::ADDR, ins.GetY(), ins.GetX(), static_cast<int32_t>(_out.size()) - 1 });
+					break;
+				case Operation::ILOAD: {
+					auto addr = _stack.back();
+					int32_t v;
+					if (load(addr, v) && addr.pos == static_cast<int32_t>(_out.size()) - 1) {
+						drop(1);
+						pushConst(v);
+						_stats->Add("loads replaced");
+						changed = true;
+						break;
+					}
+					bool known = load(addr, v);
+					emit(ins, 1, 1);
+					if (known)
+						_stack.back() = Abstract{ Abstract::CONST, v, 0, -1 };
+				} break;
+				case Operation::ISTORE: {
+					auto addr = _stack[_stack.size() - 2];
+					auto value = _stack.back();
+					emit(ins, 2, 0);
+					store(addr, value.kind == Abstract::CONST, value.value);
+				} break;
+				case Operation::IINC: {
+					int32_t v = 0;
+					Abstract addr{ Abstract::ADDR, ins.GetX(), 0, -1 };
+					bool known = load(addr, v);
+					emit(ins, 0, 0);
+					store(addr, known, wrap(int64_t(v) + ins.GetY()));
+				} break;
+				case Operation::IINCS: {
+					// ipush c; iincs k  =>  iinc k, c
+					if (constTail(1)) {
+						auto c = _stack.back().value;
+						drop(1);
+						Abstract addr{ Abstract::ADDR, ins.GetX(), 0, -1 };
+						int32_t v = 0;
+						bool known = load(addr, v);
+						emit(Instruction(0, Operation::IINC, ins.GetX(), c), 0, 0);
+						store(addr, known, wrap(int64_t(v) + c));
+						_stats->Add("iincs to iinc");
+						changed = true;
+						break;
+					}
+					emit(ins, 1, 0);
+					store(Abstract{ Abstract::ADDR, ins.GetX(), 0, -1 }, false, 0);
+				} break;
+				case Operation::IADD:
+				case Operation::ISUB:
+				case Operation::IMUL:
+				case Operation::IDIV:
+				case Operation::ICMP: {
+					auto lhs = _stack[_stack.size() - 2];
+					auto rhs = _stack.back();
+					int32_t v;
+					bool known = lhs.kind == Abstract::CONST && rhs.kind == Abstract::CONST && evaluate(op, lhs.value, rhs.value, v);
+					if (known && constTail(2)) {
+						drop(2);
+						pushConst(v);
+						_stats->Add("operations folded");
+						changed = true;
+						break;
+					}
+					// x + 0, x - 0, x * 1, x / 1
+					if (constTail(1) && op != Operation::ICMP
+						&& ((rhs.value == 0 && (op == Operation::IADD || op == Operation::ISUB))
+							|| (rhs.value == 1 && (op == Operation::IMUL || op == Operation::IDIV)))) {
+						drop(1);
+						_stats->Add("identities removed");
+						changed = true;
+						break;
+					}
+					emit(ins, 2, 1);
+					if (known)
+						_stack.back() = Abstract{ Abstract::CONST, v, 0, -1 };
+				} break;
+				case Operation::IACHK: {
+					// 已知在范围内的下标不用检查
+					auto index = _stack[_stack.size() - 2];
+					auto length = _stack.back();
+					if (index.kind == Abstract::CONST && length.kind == Abstract::CONST
+						&& index.value >= 0 && index.value < length.value && constTail(1)) {
+						drop(1);
+						_stats->Add("bounds checks removed");
+						changed = true;
+						break;
+					}
+					emit(ins, 2, 1);
+					// 检查通过时的值就是下标
+					if (index.kind == Abstract::CONST)
+						_stack.back() = Abstract{ Abstract::CONST, index.value, 0, -1 };
+				} break;
+				case Operation::INEG: {
+					auto a = _stack.back();
+					if (constTail(1)) {
+						drop(1);
+						pushConst(wrap(-int64_t(a.value)));
+						_stats->Add("operations folded");
+						changed = true;
+						break;
+					}
+					emit(ins, 1, 1);
+					if (a.kind == Abstract::CONST)
+						_stack.back() = Abstract{ Abstract::CONST, wrap(-int64_t(a.value)), 0, -1 };
+				} break;
+				case Operation::JE:
+				case Operation::JNE:
+				case Operation::JL:
+				case Operation::JGE:
+				case Operation::JG:
+				case Operation::JLE: {
+					if (constTail(1)) {
+						auto v = _stack.back().value;
+						drop(1);
+						if (holds(op, v)) {
+							_out.emplace_back(0, Operation::JMP, ins.GetX(), 0);
+							block.next = -1;
+						}
+						_stats->Add("branches folded");
+						changed = true;
+						break;
+					}
+					emit(ins, 1, 0);
+				} break;
+				case Operation::POP:
+					// 压入后马上弹出
+					if (_stack.back().kind != Abstract::UNKNOWN && _stack.back().pos == static_cast<int32_t>(_out.size()) - 1) {
+						drop(1);
+						_stats->Add("pushes removed");
+						changed = true;
+						break;
+					}
+					emit(ins, 1, 0);
+					break;
+				case Operation::DUP:
+				case Operation::DUP2: {
+					// 复制出的值与原来的相同, 但不能单独删除
+					std::vector<Abstract> top(_stack.end() - effect.first, _stack.end());
+					_out.push_back(ins);
+					for (auto& a : top)
+						a.pos = -1;
+					_stack.resize(_stack.size() - effect.first);
+					for (int time = 0; time < 2; time++)
+						_stack.insert(_stack.end(), top.begin(), top.end());
+				} break;
+				case Operation::CALL:
+				case Operation::ISPAWN:
+				case Operation::IJOIN:
+				case Operation::IASTORE:
+				case Operation::AASTORE:
+				case Operation::IAFILL:
+				case Operation::IACOPY:
+					// 被调用的函数, 任务和通过数组参数的写入都可能改变全局变量
+					// 数组不会覆盖标量的 slot, 当前栈帧的值仍然有效
+					emit(ins, effect.first, effect.second);
+					_globals.clear();
+					break;
+				default:
+					emit(ins, effect.first, effect.second);
+					break;
+				}
+			}
+			block.code.swap(_out);
+			return changed;
+		}
+	}
+
+	std::unique_ptr<Pass> CreateConstPropPass() {
+		return std::make_unique<ConstPropPass>();
+	}
+}
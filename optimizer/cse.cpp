@@ -0,0 +1,465 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <map>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 有值编号, 且可以整棵删除的指令
+		bool numbered(Operation op) {
+			switch (op) {
+			case Operation::IPUSH:
+			case Operation::BIPUSH:
+			case Operation::LOADC:
+			case Operation::LOADA:
+			case Operation::ILOAD:
+			case Operation::ALOAD:
+			case Operation::IADD:
+			case Operation::ISUB:
+			case Operation::IMUL:
+			case Operation::IDIV:
+			case Operation::INEG:
+			case Operation::ICMP:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool leaf(Operation op) {
+			return op == Operation::IPUSH || op == Operation::BIPUSH || op == Operation::LOADC || op == Operation::LOADA;
+		}
+
+		// 被替换的计算至少要有这么多条指令
+		const int32_t MinDupSize = 2;	// dup
+		const int32_t MinSlotSize = 3;	// loada 0, k; iload
+		const int32_t MinTempSize = 6;	// 另外在第一次计算处存入临时 slot 要 4 条指令
+
+		// 扩展基本块 (只有一个前驱的块接在前驱后面) 内的值编号:
+		//     栈上的每一项 (也就是栈帧的每个 slot) 和全局变量记录当前的值编号,
+		//     读变量得到变量的值编号, 所以重复的读取和重复的运算都能发现.
+		// 重复计算的值按顺序选择:
+		//     就在栈顶时换成 dup; 还在栈上 (或全局变量中) 时换成读那个 slot;
+		//     否则在第一次计算处存入临时 slot, 再读临时 slot. 临时 slot 在函数入口处用 snew 分配,
+		//     排在参数之后, 其余 slot 的编号相应后移. .start 的 slot 是全局变量, 不分配临时 slot.
+		// 写入更新对应 slot 的值编号; 数组的写入, 调用, spawn 和 join 使全局变量和
+		// 地址被传出的 slot 以上的所有 slot 失效; scan 和数组元素的读取每次都得到新的值编号
+		class CsePass final : public Pass {
+		public:
+			const char* Name() const override { return "cse"; }
+			int Level() const override { return 2; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				_module = &m;
+				_stats = &stats;
+				bool changed = runOn(m.start, true);
+				for (auto& f : m.functions)
+					changed = runOn(f, false) || changed;
+				return changed;
+			}
+		private:
+			// 一次计算: 块 block 中的指令 [begin, end], end 压入它的值
+			struct Occurrence {
+				int32_t block;
+				int32_t begin;
+				int32_t end;
+			};
+			// 扩展基本块中一条路径上的状态
+			struct State {
+				std::vector<int32_t> stack;	// 栈上每一项的值编号
+				std::map<int32_t, int32_t> globals;	// loada 1, k 的值编号
+				std::map<int32_t, Occurrence> available;	// 可以存入临时 slot 的值
+			};
+			// 对一个块的修改
+			struct Edit {
+				// begin -> (end, 替换成的指令), slot 的编号是后移前的
+				std::map<int32_t, std::pair<int32_t, std::vector<Instruction>>> replaced;
+				// 存入临时 slot 的计算: end -> (begin, 临时 slot)
+				std::map<int32_t, std::pair<int32_t, int32_t>> saved;
+			};
+
+			bool runOn(IRFunction& f, bool start);
+			// 分析块 b, 结束时 st 为块出口的状态
+			void analyse(IRFunction& f, int32_t b, State& st);
+			void apply(IRFunction& f, int32_t temps);
+
+			int32_t fresh() { return _next++; }
+			int32_t number(const std::array<int32_t, 4>& key) {
+				auto it = _numbers.find(key);
+				if (it != _numbers.end())
+					return it->second;
+				return _numbers[key] = fresh();
+			}
+			// 地址可能被传出的 slot 以及它们上面的 slot 失效
+			void clobber(State& st) {
+				for (std::size_t i = std::max(_escaped, 0); i < st.stack.size(); i++)
+					st.stack[i] = fresh();
+				st.globals.clear();
+			}
+		private:
+			IRModule* _module = nullptr;
+			PassStatistics* _stats = nullptr;
+			bool _start = false;
+			int32_t _escaped = INT_MAX;	// 地址被传出的最低的 slot
+			int32_t _next = 0;
+			std::map<std::array<int32_t, 4>, int32_t> _numbers;
+			std::vector<Edit> _edits;
+			std::vector<std::int32_t> _depths;
+			// 存入临时 slot 的计算 (块, end) -> 临时 slot
+			std::map<std::pair<int32_t, int32_t>, int32_t> _temps;
+		};
+
+		bool CsePass::runOn(IRFunction& f, bool start) {
+			if (f.unbalanced)
+				return false;
+			_start = start;
+			_next = 0;
+			_numbers.clear();
+			_temps.clear();
+			_edits.assign(f.blocks.size(), Edit());
+			_depths = _module->EntryDepths(f);
+
+			// 地址被传出的 slot, 即不是直接被 load/store 使用的 loada 0, k
+			_escaped = INT_MAX;
+			for (auto b : f.layout) {
+				if (_depths[b] < 0)
+					continue;
+				auto& code = f.blocks[b].code;
+				BlockValues bv(*_module, f.blocks[b], _depths[b]);
+				const auto escape = [&](const BlockValues::Value& v) {
+					if (v.def >= 0)
+						if (auto slot = ir::SlotOf(code[v.def]); slot.has_value() && slot->level == 0)
+							_escaped = std::min(_escaped, slot->offset);
+				};
+				for (std::size_t k = 0; k < code.size(); k++) {
+					auto op = code[k].GetOperation();
+					bool direct = op == Operation::ILOAD || op == Operation::ALOAD || op == Operation::ISTORE || op == Operation::ASTORE;
+					for (std::size_t j = 0; j < bv.operands[k].size(); j++)
+						if (!(direct && j == 0))
+							escape(bv.operands[k][j]);
+				}
+				for (auto& v : bv.exitStack)
+					escape(v);
+			}
+
+			// 扩展基本块的根: 入口和前驱不止一个的块
+			auto preds = f.Predecessors();
+			auto entry = f.layout.front();
+			std::vector<std::pair<int32_t, State>> worklist;
+			for (auto it = f.layout.rbegin(); it != f.layout.rend(); ++it) {
+				auto b = *it;
+				if (_depths[b] < 0 || (b != entry && preds[b].size() == 1))
+					continue;
+				State st;
+				for (int32_t i = 0; i < _depths[b]; i++)
+					st.stack.push_back(fresh());
+				worklist.emplace_back(b, std::move(st));
+			}
+			while (!worklist.empty()) {
+				auto [b, st] = std::move(worklist.back());
+				worklist.pop_back();
+				analyse(f, b, st);
+				for (auto s : f.blocks[b].Successors())
+					if (s != entry && preds[s].size() == 1 && _depths[s] >= 0)
+						worklist.emplace_back(s, st);
+			}
+
+			int32_t temps = 0;
+			for (auto& t : _temps)
+				temps = std::max(temps, t.second + 1);
+			bool changed = temps > 0;
+			for (auto& e : _edits)
+				changed = changed || !e.replaced.empty();
+			if (!changed)
+				return false;
+			apply(f, temps);
+			return true;
+		}
+
+		void CsePass::analyse(IRFunction& f, int32_t b, State& st) {
+			auto& code = f.blocks[b].code;
+			int32_t size = code.size();
+			BlockValues bv(*_module, f.blocks[b], _depths[b]);
+			std::vector<int32_t> uses(size, 0);
+			for (auto& operands : bv.operands)
+				for (auto& v : operands)
+					if (v.def >= 0)
+						uses[v.def]++;
+			for (auto& v : bv.exitStack)
+				if (v.def >= 0)
+					uses[v.def]++;
+
+			// 每条指令压入的值的编号, 它所在的计算的范围和指令数 (不能整棵删除时 begin 为 -1)
+			std::vector<int32_t> vn(size, -1), begin(size, -1), count(size, 0);
+			// 重复的计算可以换成的指令
+			std::vector<std::vector<Instruction>> reuse(size);
+			std::vector<std::optional<Occurrence>> source(size);
+			std::vector<Occurrence> registered;
+
+			for (int32_t k = 0; k < size; k++) {
+				auto& ins = code[k];
+				auto op = ins.GetOperation();
+				auto effect = _module->StackEffect(ins);
+				auto& operands = bv.operands[k];
+				std::vector<int32_t> in(st.stack.end() - effect.first, st.stack.end());
+				st.stack.resize(st.stack.size() - effect.first);
+				// 地址是 loada 时的 (level, offset)
+				const auto slotOf = [&](std::size_t j) -> std::optional<ir::Slot> {
+					if (operands[j].def < 0)
+						return {};
+					return ir::SlotOf(code[operands[j].def]);
+				};
+
+				int32_t v = -1;
+				switch (op) {
+				case Operation::IPUSH:
+				case Operation::BIPUSH:
+					v = number({ static_cast<int32_t>(Operation::IPUSH), ins.GetX(), 0, 0 });
+					break;
+				case Operation::LOADC:
+					v = number({ static_cast<int32_t>(op), ins.GetX(), 0, 0 });
+					break;
+				case Operation::LOADA:
+					v = number({ static_cast<int32_t>(op), ins.GetX(), ins.GetY(), 0 });
+					break;
+				case Operation::ILOAD:
+				case Operation::ALOAD: {
+					auto slot = slotOf(0);
+					if (slot.has_value() && slot->level == 0 && slot->offset >= 0 && slot->offset < static_cast<int32_t>(st.stack.size()))
+						v = st.stack[slot->offset];
+					else if (slot.has_value() && slot->level == 1 && !_start) {
+						auto it = st.globals.find(slot->offset);
+						v = it != st.globals.end() ? it->second : (st.globals[slot->offset] = fresh());
+					}
+					else
+						v = fresh();
+				} break;
+				case Operation::INEG:
+					v = number({ static_cast<int32_t>(op), in[0], 0, 0 });
+					break;
+				case Operation::IADD:
+				case Operation::IMUL:
+					v = number({ static_cast<int32_t>(op), std::min(in[0], in[1]), std::max(in[0], in[1]), 0 });
+					break;
+				case Operation::ISUB:
+				case Operation::IDIV:
+				case Operation::ICMP:
+					v = number({ static_cast<int32_t>(op), in[0], in[1], 0 });
+					break;
+				case Operation::ISTORE:
+				case Operation::ASTORE: {
+					auto slot = slotOf(0);
+					if (slot.has_value() && slot->level == 0 && slot->offset >= 0 && slot->offset < static_cast<int32_t>(st.stack.size()))
+						st.stack[slot->offset] = in[1];
+					else if (slot.has_value() && slot->level == 1 && !_start)
+						st.globals[slot->offset] = in[1];
+					else {
+						for (auto& s : st.stack)
+							s = fresh();
+						st.globals.clear();
+					}
+				} break;
+				case Operation::IINC:
+				case Operation::IINCS:
+					if (ins.GetX() >= 0 && ins.GetX() < static_cast<int32_t>(st.stack.size()))
+						st.stack[ins.GetX()] = fresh();
+					break;
+				case Operation::IASTORE:
+				case Operation::AASTORE:
+				case Operation::IAFILL:
+				case Operation::IACOPY:
+					clobber(st);
+					break;
+				case Operation::CALL:
+				case Operation::ISPAWN:
+				case Operation::IJOIN:
+					// 被调用的函数可以写 .start 的所有 slot
+					if (_start)
+						for (auto& s : st.stack)
+							s = fresh();
+					clobber(st);
+					break;
+				default:
+					break;
+				}
+
+				if (op == Operation::DUP || op == Operation::DUP2) {
+					for (int time = 0; time < 2; time++)
+						st.stack.insert(st.stack.end(), in.begin(), in.end());
+					continue;
+				}
+				if (!numbered(op)) {
+					for (int32_t i = 0; i < effect.second; i++)
+						st.stack.push_back(fresh());
+					continue;
+				}
+
+				vn[k] = v;
+				if (leaf(op)) {
+					begin[k] = k;
+					count[k] = 1;
+				}
+				else {
+					begin[k] = k;
+					count[k] = 1;
+					for (auto& o : operands) {
+						if (o.def < 0 || uses[o.def] != 1 || begin[o.def] < 0) {
+							begin[k] = -1;
+							break;
+						}
+						begin[k] = std::min(begin[k], begin[o.def]);
+						count[k] += count[o.def];
+					}
+					if (begin[k] >= 0 && k - begin[k] + 1 != count[k])
+						begin[k] = -1;
+				}
+				if (begin[k] >= 0) {
+					// 此时的栈就是这次计算开始前的栈
+					int32_t n = count[k];
+					int32_t top = static_cast<int32_t>(st.stack.size()) - 1;
+					int32_t p = top;
+					while (p >= 0 && st.stack[p] != v)
+						p--;
+					auto global = std::find_if(st.globals.begin(), st.globals.end(), [&](const std::pair<const int32_t, int32_t>& g) { return g.second == v; });
+					auto it = st.available.find(v);
+					// 变量的 slot 不用 dup 复制, 否则其他的遍看不到对变量的读取
+					if (n >= MinDupSize && p == top && p >= f.frameSize)
+						reuse[k] = { Instruction(0, Operation::DUP, 0, 0) };
+					else if (n >= MinSlotSize && p >= 0)
+						reuse[k] = { Instruction(0, Operation::LOADA, 0, p), Instruction(0, Operation::ILOAD, 0, 0) };
+					else if (n >= MinSlotSize && global != st.globals.end())
+						reuse[k] = { Instruction(0, Operation::LOADA, 1, global->first), Instruction(0, Operation::ILOAD, 0, 0) };
+					else if (n >= MinTempSize && !_start && it != st.available.end())
+						source[k] = it->second;
+					else if (n >= MinTempSize && !_start) {
+						st.available[v] = Occurrence{ b, begin[k], k };
+						registered.push_back(st.available[v]);
+					}
+				}
+				st.stack.push_back(v);
+			}
+
+			// 从后往前选出最大的重复计算, 被选中的范围内的不再考虑
+			auto& edit = _edits[b];
+			int32_t cover = size;
+			for (int32_t k = size - 1; k >= 0; k--) {
+				if (k >= cover || (reuse[k].empty() && !source[k].has_value()))
+					continue;
+				if (!reuse[k].empty())
+					edit.replaced[begin[k]] = { k, std::move(reuse[k]) };
+				else
+					edit.replaced[begin[k]] = { k, {} };
+				cover = begin[k];
+			}
+			// 不会执行的计算不能作为临时 slot 的来源
+			const auto executed = [&](const Occurrence& o) {
+				auto& replaced = _edits[o.block].replaced;
+				auto it = replaced.upper_bound(o.begin);
+				if (it == replaced.begin())
+					return true;
+				--it;
+				return it->second.first < o.end;
+			};
+			for (auto& o : registered) {
+				auto it = st.available.find(vn[o.end]);
+				if (!executed(o) && it != st.available.end() && it->second.block == o.block && it->second.end == o.end)
+					st.available.erase(it);
+			}
+			for (int32_t k = 0; k < size; k++) {
+				if (!source[k].has_value())
+					continue;
+				auto it = edit.replaced.find(begin[k]);
+				if (it == edit.replaced.end() || it->second.first != k)
+					continue;
+				auto& o = source[k].value();
+				if (!executed(o)) {
+					edit.replaced.erase(it);
+					continue;
+				}
+				auto key = std::make_pair(o.block, o.end);
+				auto t = _temps.find(key);
+				if (t == _temps.end()) {
+					t = _temps.emplace(key, static_cast<int32_t>(_temps.size())).first;
+					_edits[o.block].saved[o.end] = { o.begin, t->second };
+					_stats->Add("temporaries allocated");
+				}
+				// 临时 slot 的编号在 apply 时确定
+				it->second.second = { Instruction(0, Operation::LOADA, 0, -1 - t->second), Instruction(0, Operation::ILOAD, 0, 0) };
+			}
+			for (auto& r : edit.replaced) {
+				auto& code = r.second.second;
+				if (code.size() == 1)
+					_stats->Add("values reused with dup");
+				else if (code[0].GetY() < 0)
+					_stats->Add("values reused from temporaries");
+				else
+					_stats->Add("values reused from slots");
+			}
+		}
+
+		void CsePass::apply(IRFunction& f, int32_t temps) {
+			// 参数以上的 slot 后移 temps 个, 临时 slot 为 params ... params + temps - 1
+			const auto slot = [&](int32_t k) {
+				if (k < 0)
+					return f.params - 1 - k;
+				return k >= f.params ? k + temps : k;
+			};
+			const auto renumber = [&](Instruction ins) {
+				auto op = ins.GetOperation();
+				if (op == Operation::LOADA && ins.GetX() == 0)
+					ins.SetY(slot(ins.GetY()));
+				else if (op == Operation::IINC || op == Operation::IINCS)
+					ins.SetX(slot(ins.GetX()));
+				return ins;
+			};
+			for (auto b : f.layout) {
+				auto& edit = _edits[b];
+				auto& code = f.blocks[b].code;
+				int32_t size = code.size();
+				// begin -> 在这里开始的存入临时 slot 的计算, 外层的在前
+				std::map<int32_t, std::vector<std::pair<int32_t, int32_t>>> before;
+				for (auto& s : edit.saved)
+					before[s.second.first].emplace_back(s.first, s.second.second);
+				for (auto& s : before)
+					std::sort(s.second.begin(), s.second.end(), std::greater<std::pair<int32_t, int32_t>>());
+				std::vector<Instruction> out;
+				out.reserve(size + 4 * edit.saved.size());
+				for (int32_t i = 0; i < size; i++) {
+					if (auto it = before.find(i); it != before.end())
+						for (auto& s : it->second)
+							out.emplace_back(0, Operation::LOADA, 0, slot(-1 - s.second));
+					auto r = edit.replaced.find(i);
+					if (r != edit.replaced.end()) {
+						for (auto& ins : r->second.second)
+							out.push_back(renumber(ins));
+						i = r->second.first;
+					}
+					else
+						out.push_back(renumber(code[i]));
+					if (auto it = edit.saved.find(i); it != edit.saved.end()) {
+						auto t = slot(-1 - it->second.second);
+						out.emplace_back(0, Operation::ISTORE, 0, 0);
+						out.emplace_back(0, Operation::LOADA, 0, t);
+						out.emplace_back(0, Operation::ILOAD, 0, 0);
+					}
+				}
+				code.swap(out);
+			}
+			if (temps > 0) {
+				// 入口块可能是循环头, snew 放在只执行一次的入口块
+				auto& entry = f.blocks[f.SplitEntry()].code;
+				entry.emplace(entry.begin(), 0, Operation::SNEW, temps, 0);
+			}
+			f.frameSize += temps;
+		}
+	}
+
+	std::unique_ptr<Pass> CreateCsePass() {
+		return std::make_unique<CsePass>();
+	}
+}
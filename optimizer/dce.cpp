@@ -0,0 +1,329 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 除了压入一个值以外没有作用, 也不会出错
+		bool pure(Operation op) {
+			switch (op) {
+			case Operation::IPUSH:
+			case Operation::BIPUSH:
+			case Operation::LOADC:
+			case Operation::LOADA:
+			case Operation::ILOAD:
+			case Operation::ALOAD:
+			case Operation::IADD:
+			case Operation::ISUB:
+			case Operation::IMUL:
+			case Operation::INEG:
+			case Operation::ICMP:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// 删除不可达的块, nop, 对不再读取的局部变量的写入和没有被调用的函数
+		// 局部变量只考虑地址仅被 loada 0, k 直接用于 load/store 的 slot (以及 iinc/iincs),
+		// 地址被传出的 slot (数组) 与 const-prop 一样认为不会被其他 slot 上的访问覆盖.
+		// .start 的 slot 是全局变量, 不做写入的删除
+		class DeadCodePass final : public Pass {
+		public:
+			const char* Name() const override { return "dce"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				_module = &m;
+				_stats = &stats;
+				bool changed = removeUnreachable(m.start);
+				changed = removeNops(m.start) || changed;
+				for (auto& f : m.functions) {
+					if (f.unbalanced)
+						continue;
+					changed = removeUnreachable(f) || changed;
+					changed = removeNops(f) || changed;
+					// 删掉的值里可能有读取, 使更多的写入变成死的
+					while (removeDeadStores(f))
+						changed = true;
+				}
+				return removeFunctions(m) || changed;
+			}
+		private:
+			bool removeUnreachable(IRFunction& f) {
+				auto reachable = f.Reachable();
+				bool changed = false;
+				for (auto b : f.layout) {
+					if (reachable[b])
+						continue;
+					auto& block = f.blocks[b];
+					_stats->Add("unreachable instructions removed", block.code.size());
+					_stats->Add("unreachable blocks removed");
+					block.code.clear();
+					block.next = -1;
+					block.dead = true;
+					changed = true;
+				}
+				f.CompactLayout();
+				return changed;
+			}
+
+			bool removeNops(IRFunction& f) {
+				bool changed = false;
+				for (auto b : f.layout) {
+					auto& code = f.blocks[b].code;
+					auto it = std::remove_if(code.begin(), code.end(), [](const Instruction& ins) { return ins.GetOperation() == Operation::NOP; });
+					if (it == code.end())
+						continue;
+					_stats->Add("nops removed", code.end() - it);
+					code.erase(it, code.end());
+					changed = true;
+				}
+				return changed;
+			}
+
+			bool removeDeadStores(IRFunction& f);
+
+			// main 和从 .start 可以调用到的函数以外的函数
+			bool removeFunctions(IRModule& m) {
+				std::int32_t size = m.functions.size();
+				std::vector<bool> used(size, false);
+				std::vector<std::int32_t> worklist;
+				const auto use = [&](const IRFunction& f) {
+					for (auto b : f.layout)
+						for (auto& ins : f.blocks[b].code)
+							if ((ins.GetOperation() == Operation::CALL || ins.GetOperation() == Operation::ISPAWN) && !used[ins.GetX()]) {
+								used[ins.GetX()] = true;
+								worklist.push_back(ins.GetX());
+							}
+				};
+				// 分离编译时别的文件可以调用任何定义了的函数
+				for (std::int32_t i = 0; i < size; i++)
+					if (m.functions[i].name == "main" || (m.relocatable && !m.functions[i].imported)) {
+						used[i] = true;
+						worklist.push_back(i);
+					}
+				use(m.start);
+				while (!worklist.empty()) {
+					auto i = worklist.back();
+					worklist.pop_back();
+					use(m.functions[i]);
+				}
+				if (std::find(used.begin(), used.end(), false) == used.end())
+					return false;
+
+				// 新的下标
+				std::vector<std::int32_t> index(size, -1);
+				std::vector<IRFunction> functions;
+				for (std::int32_t i = 0; i < size; i++) {
+					if (!used[i]) {
+						_stats->Add("functions removed");
+						continue;
+					}
+					index[i] = functions.size();
+					functions.push_back(std::move(m.functions[i]));
+					functions.back().index = index[i];
+				}
+				m.functions = std::move(functions);
+				const auto renumber = [&](IRFunction& f) {
+					for (auto b : f.layout)
+						for (auto& ins : f.blocks[b].code)
+							if (ins.GetOperation() == Operation::CALL || ins.GetOperation() == Operation::ISPAWN)
+								ins.SetX(index[ins.GetX()]);
+				};
+				renumber(m.start);
+				for (auto& f : m.functions)
+					renumber(f);
+				return true;
+			}
+		private:
+			IRModule* _module = nullptr;
+			PassStatistics* _stats = nullptr;
+		};
+
+		bool DeadCodePass::removeDeadStores(IRFunction& f) {
+			const auto& blocks = f.blocks;
+			auto depths = _module->EntryDepths(f);
+			// 不在 layout 中的块都已删除, 按空块处理
+			std::vector<BlockValues> values;
+			values.reserve(blocks.size());
+			for (std::size_t b = 0; b < blocks.size(); b++)
+				values.emplace_back(*_module, depths[b] < 0 ? BasicBlock() : blocks[b], std::max(depths[b], 0));
+
+			// 只被直接读写的 slot
+			std::vector<bool> tracked(f.frameSize, true);
+			// 第 k 条指令的第 j 个操作数是 loada 0, slot 时返回 slot, 否则为 -1
+			const auto slotOf = [&](std::int32_t b, std::size_t k, std::size_t j) {
+				auto v = values[b].operands[k][j];
+				if (v.def < 0)
+					return -1;
+				auto slot = ir::SlotOf(blocks[b].code[v.def]);
+				if (!slot.has_value() || slot->level != 0 || slot->offset < 0 || slot->offset >= f.frameSize)
+					return -1;
+				return slot->offset;
+			};
+			for (auto b : f.layout) {
+				auto& code = blocks[b].code;
+				for (std::size_t k = 0; k < code.size(); k++) {
+					auto op = code[k].GetOperation();
+					bool direct = op == Operation::ILOAD || op == Operation::ALOAD || op == Operation::ISTORE || op == Operation::ASTORE;
+					for (std::size_t j = 0; j < values[b].operands[k].size(); j++) {
+						auto slot = slotOf(b, k, j);
+						if (slot >= 0 && !(direct && j == 0))
+							tracked[slot] = false;
+					}
+				}
+				// 留给后继的地址
+				for (auto& v : values[b].exitStack)
+					if (v.def >= 0)
+						if (auto slot = ir::SlotOf(code[v.def]); slot.has_value() && slot->level == 0 && slot->offset >= 0 && slot->offset < f.frameSize)
+							tracked[slot->offset] = false;
+			}
+
+			// 指令读 (use) 和写 (def) 的被跟踪的 slot, 没有则为 -1
+			const auto access = [&](std::int32_t b, std::size_t k, std::int32_t& use, std::int32_t& def) {
+				use = def = -1;
+				auto& ins = blocks[b].code[k];
+				std::int32_t slot = -1;
+				switch (ins.GetOperation()) {
+				case Operation::ILOAD:
+				case Operation::ALOAD:
+					slot = slotOf(b, k, 0);
+					if (slot >= 0 && tracked[slot])
+						use = slot;
+					break;
+				case Operation::ISTORE:
+				case Operation::ASTORE:
+					slot = slotOf(b, k, 0);
+					if (slot >= 0 && tracked[slot])
+						def = slot;
+					break;
+				case Operation::IINC:
+				case Operation::IINCS:
+					slot = ins.GetX();
+					if (slot >= 0 && slot < f.frameSize && tracked[slot])
+						use = def = slot;
+					break;
+				default:
+					break;
+				}
+			};
+
+			// 块入口处活跃的 slot
+			std::vector<std::vector<bool>> liveIn(blocks.size(), std::vector<bool>(f.frameSize, false));
+			const auto liveOut = [&](std::int32_t b) {
+				std::vector<bool> live(f.frameSize, false);
+				for (auto s : blocks[b].Successors())
+					for (std::int32_t i = 0; i < f.frameSize; i++)
+						live[i] = live[i] || liveIn[s][i];
+				return live;
+			};
+			for (bool changed = true; changed; ) {
+				changed = false;
+				for (auto it = f.layout.rbegin(); it != f.layout.rend(); ++it) {
+					auto b = *it;
+					auto live = liveOut(b);
+					for (auto k = blocks[b].code.size(); k-- > 0; ) {
+						std::int32_t use, def;
+						access(b, k, use, def);
+						// iinc/iincs 只在结果活跃时读
+						if (def >= 0 && !live[def])
+							continue;
+						if (def >= 0)
+							live[def] = false;
+						if (use >= 0)
+							live[use] = true;
+					}
+					if (live != liveIn[b]) {
+						liveIn[b] = std::move(live);
+						changed = true;
+					}
+				}
+			}
+
+			bool changed = false;
+			for (auto b : f.layout) {
+				auto& block = f.blocks[b];
+				auto& bv = values[b];
+				std::size_t size = block.code.size();
+				// 每个值被使用的次数, dup 出的值和留在栈上的值不能删除
+				std::vector<std::int32_t> uses(size, 0);
+				for (auto& operands : bv.operands)
+					for (auto& v : operands)
+						if (v.def >= 0)
+							uses[v.def]++;
+				for (auto& v : bv.exitStack)
+					if (v.def >= 0)
+						uses[v.def]++;
+				std::vector<bool> removed(size, false);
+				std::vector<bool> popped(size, false);
+				// 删除产生值 v 的无副作用的指令, 不能删除时返回 false
+				const auto removable = [&](const BlockValues::Value& v) {
+					if (v.def < 0 || uses[v.def] != 1 || !pure(block.code[v.def].GetOperation()))
+						return false;
+					std::vector<std::int32_t> stack = { v.def };
+					std::vector<std::int32_t> tree;
+					while (!stack.empty()) {
+						auto d = stack.back();
+						stack.pop_back();
+						tree.push_back(d);
+						for (auto& o : bv.operands[d]) {
+							if (o.def < 0 || uses[o.def] != 1 || !pure(block.code[o.def].GetOperation()))
+								return false;
+							stack.push_back(o.def);
+						}
+					}
+					for (auto d : tree)
+						removed[d] = true;
+					return true;
+				};
+
+				auto live = liveOut(b);
+				for (auto k = size; k-- > 0; ) {
+					if (removed[k])
+						continue;
+					std::int32_t use, def;
+					access(b, k, use, def);
+					if (def >= 0 && !live[def]) {
+						// loada 0, k; <值>; istore  =>  <值>; pop
+						// iinc 没有值, iincs 只有值
+						auto op = block.code[k].GetOperation();
+						auto& operands = bv.operands[k];
+						if (op == Operation::ISTORE || op == Operation::ASTORE)
+							removed[operands[0].def] = true;
+						if (op != Operation::IINC && !removable(operands.back()))
+							popped[k] = true;
+						else
+							removed[k] = true;
+						_stats->Add("dead stores removed");
+						changed = true;
+						continue;
+					}
+					if (def >= 0)
+						live[def] = false;
+					if (use >= 0)
+						live[use] = true;
+				}
+				if (std::find(removed.begin(), removed.end(), true) == removed.end() && std::find(popped.begin(), popped.end(), true) == popped.end())
+					continue;
+				std::vector<Instruction> code;
+				code.reserve(size);
+				for (std::size_t k = 0; k < size; k++) {
+					if (popped[k])
+						code.emplace_back(0, Operation::POP, 0, 0);
+					else if (!removed[k])
+						code.push_back(block.code[k]);
+				}
+				block.code.swap(code);
+			}
+			return changed;
+		}
+	}
+
+	std::unique_ptr<Pass> CreateDeadCodePass() {
+		return std::make_unique<DeadCodePass>();
+	}
+}
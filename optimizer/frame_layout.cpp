@@ -0,0 +1,378 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 入口块开头创建局部变量的一段指令: [begin, end] 压入 slot [lo, hi)
+		struct Segment {
+			int32_t begin;
+			int32_t end;
+			int32_t lo;
+			int32_t hi;
+		};
+
+		// 重新安排函数的栈帧:
+		//     生存期不重叠的局部变量 (和参数) 共用一个 slot, 按创建的顺序贪心着色;
+		//     地址被传出的 slot (数组) 及以上的 slot 保持相对位置, 紧接在参数之后;
+		//     数组, 没有初值的变量和与之前的变量共用 slot 的变量在入口处用一条 snew 一起分配,
+		//     它们的初值改为 store; 其余有初值的变量仍然按顺序压入.
+		// 栈帧以上的 slot (操作数栈) 随栈帧的大小平移.
+		// 创建局部变量的代码不全在入口块中, 或者之后的代码会弹出栈帧中的 slot 时不做修改
+		class FrameLayoutPass final : public Pass {
+		public:
+			const char* Name() const override { return "frame-layout"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				_module = &m;
+				_stats = &stats;
+				bool changed = false;
+				for (auto& f : m.functions)
+					changed = runOn(f) || changed;
+				return changed;
+			}
+		private:
+			// 按顺序找出创建每个局部变量的代码, 不是这种形式时返回 false
+			bool prologue(const IRFunction& f, std::vector<Segment>& segments, int32_t& last) const;
+			// 地址被传出的最低的 slot
+			int32_t lowestEscaped(const IRFunction& f, const std::vector<int32_t>& depths) const;
+			// slot [0, count) 之间的冲突
+			std::vector<std::vector<bool>> interference(const IRFunction& f, const std::vector<int32_t>& depths,
+				const std::vector<Segment>& segments, int32_t count) const;
+			bool runOn(IRFunction& f);
+		private:
+			IRModule* _module = nullptr;
+			PassStatistics* _stats = nullptr;
+		};
+
+		bool FrameLayoutPass::prologue(const IRFunction& f, std::vector<Segment>& segments, int32_t& last) const {
+			auto& code = f.blocks[f.layout.front()].code;
+			int32_t size = code.size();
+			// 每条指令执行前的栈高度, 和执行中弹出操作数后的最低高度
+			std::vector<int32_t> before(size + 1), low(size);
+			int32_t h = f.params;
+			for (int32_t i = 0; i < size; i++) {
+				auto effect = _module->StackEffect(code[i]);
+				before[i] = h;
+				low[i] = h - effect.first;
+				h += effect.second - effect.first;
+			}
+			before[size] = h;
+			// 最后一条会碰到栈帧中 slot 的指令, 之后栈帧已经建好
+			last = -1;
+			for (int32_t i = 0; i < size; i++)
+				if (low[i] < f.frameSize)
+					last = i;
+			if (last < 0 || before[last + 1] != f.frameSize)
+				return false;
+
+			// slot k 由最低高度不超过 k 的最后一条指令压入
+			segments.clear();
+			int32_t begin = 0;
+			for (int32_t k = f.params; k < f.frameSize; ) {
+				int32_t end = last;
+				while (end >= begin && low[end] > k)
+					end--;
+				if (end < begin || before[begin] != k)
+					return false;
+				int32_t hi = before[end + 1];
+				if (hi <= k || hi > f.frameSize)
+					return false;
+				// 没有初值的变量和数组由一条 snew 创建, 其余的每段压入一个值
+				if (code[end].GetOperation() == Operation::SNEW ? end != begin : hi != k + 1)
+					return false;
+				for (int32_t i = begin; i <= end; i++) {
+					// 不弹出已经建好的 slot, 也不按位置访问这一段自己压入的值
+					if (low[i] < k)
+						return false;
+					auto& ins = code[i];
+					if (ins.GetOperation() == Operation::LOADA && ins.GetX() == 0 && ins.GetY() >= k)
+						return false;
+					if ((ins.GetOperation() == Operation::IINC || ins.GetOperation() == Operation::IINCS) && ins.GetX() >= k)
+						return false;
+				}
+				segments.push_back(Segment{ begin, end, k, hi });
+				begin = end + 1;
+				k = hi;
+			}
+			return true;
+		}
+
+		int32_t FrameLayoutPass::lowestEscaped(const IRFunction& f, const std::vector<int32_t>& depths) const {
+			int32_t rtv = INT_MAX;
+			for (auto b : f.layout) {
+				if (depths[b] < 0)
+					continue;
+				auto& code = f.blocks[b].code;
+				BlockValues bv(*_module, f.blocks[b], depths[b]);
+				const auto escape = [&](const BlockValues::Value& v) {
+					if (v.def >= 0)
+						if (auto slot = ir::SlotOf(code[v.def]); slot.has_value() && slot->level == 0)
+							rtv = std::min(rtv, slot->offset);
+				};
+				for (std::size_t k = 0; k < code.size(); k++) {
+					auto op = code[k].GetOperation();
+					bool direct = op == Operation::ILOAD || op == Operation::ALOAD || op == Operation::ISTORE || op == Operation::ASTORE;
+					for (std::size_t j = 0; j < bv.operands[k].size(); j++)
+						if (!(direct && j == 0))
+							escape(bv.operands[k][j]);
+				}
+				for (auto& v : bv.exitStack)
+					escape(v);
+			}
+			return rtv;
+		}
+
+		std::vector<std::vector<bool>> FrameLayoutPass::interference(const IRFunction& f, const std::vector<int32_t>& depths,
+			const std::vector<Segment>& segments, int32_t count) const {
+			auto& blocks = f.blocks;
+			auto entry = f.layout.front();
+			std::vector<BlockValues> values;
+			values.reserve(blocks.size());
+			for (std::size_t b = 0; b < blocks.size(); b++)
+				values.emplace_back(*_module, depths[b] < 0 ? BasicBlock() : blocks[b], std::max(depths[b], 0));
+			// 第 k 条指令读和写的 slot
+			const auto access = [&](int32_t b, std::size_t k, std::vector<int32_t>& uses, std::vector<int32_t>& defs) {
+				uses.clear();
+				defs.clear();
+				auto& ins = blocks[b].code[k];
+				const auto slotOf = [&]() {
+					auto v = values[b].operands[k][0];
+					if (v.def < 0)
+						return -1;
+					auto slot = ir::SlotOf(blocks[b].code[v.def]);
+					if (!slot.has_value() || slot->level != 0 || slot->offset < 0 || slot->offset >= count)
+						return -1;
+					return slot->offset;
+				};
+				switch (ins.GetOperation()) {
+				case Operation::ILOAD:
+				case Operation::ALOAD:
+					if (auto slot = slotOf(); slot >= 0)
+						uses.push_back(slot);
+					break;
+				case Operation::ISTORE:
+				case Operation::ASTORE:
+					if (auto slot = slotOf(); slot >= 0)
+						defs.push_back(slot);
+					break;
+				case Operation::IINC:
+				case Operation::IINCS:
+					if (ins.GetX() >= 0 && ins.GetX() < count) {
+						uses.push_back(ins.GetX());
+						defs.push_back(ins.GetX());
+					}
+					break;
+				default:
+					break;
+				}
+				// 压入局部变量也是写入
+				if (b == entry)
+					for (auto& s : segments)
+						if (s.end == static_cast<int32_t>(k))
+							for (auto slot = s.lo; slot < std::min(s.hi, count); slot++)
+								defs.push_back(slot);
+			};
+
+			std::vector<int32_t> uses, defs;
+			std::vector<std::vector<bool>> liveIn(blocks.size(), std::vector<bool>(count, false));
+			const auto liveOut = [&](int32_t b) {
+				std::vector<bool> live(count, false);
+				for (auto s : blocks[b].Successors())
+					for (int32_t i = 0; i < count; i++)
+						live[i] = live[i] || liveIn[s][i];
+				return live;
+			};
+			for (bool changed = true; changed; ) {
+				changed = false;
+				for (auto it = f.layout.rbegin(); it != f.layout.rend(); ++it) {
+					auto b = *it;
+					auto live = liveOut(b);
+					for (auto k = blocks[b].code.size(); k-- > 0; ) {
+						access(b, k, uses, defs);
+						for (auto d : defs)
+							live[d] = false;
+						for (auto u : uses)
+							live[u] = true;
+					}
+					if (live != liveIn[b]) {
+						liveIn[b] = std::move(live);
+						changed = true;
+					}
+				}
+			}
+
+			// 写入时活跃的其他 slot 与它冲突
+			std::vector<std::vector<bool>> rtv(count, std::vector<bool>(count, false));
+			const auto conflict = [&](int32_t a, int32_t b) {
+				if (a != b)
+					rtv[a][b] = rtv[b][a] = true;
+			};
+			for (auto b : f.layout) {
+				auto live = liveOut(b);
+				for (auto k = blocks[b].code.size(); k-- > 0; ) {
+					access(b, k, uses, defs);
+					for (auto d : defs)
+						for (int32_t s = 0; s < count; s++)
+							if (live[s])
+								conflict(d, s);
+					for (auto d : defs)
+						live[d] = false;
+					for (auto u : uses)
+						live[u] = true;
+				}
+			}
+			// 参数在入口处写入
+			for (int32_t p = 0; p < std::min(f.params, count); p++)
+				for (int32_t s = 0; s < count; s++)
+					if (liveIn[entry][s])
+						conflict(p, s);
+			for (int32_t p = 0; p < std::min(f.params, count); p++)
+				for (int32_t q = 0; q < std::min(f.params, count); q++)
+					conflict(p, q);
+			return rtv;
+		}
+
+		bool FrameLayoutPass::runOn(IRFunction& f) {
+			if (f.unbalanced)
+				return false;
+			if (f.frameSize <= f.params || f.layout.empty())
+				return false;
+			std::vector<Segment> segments;
+			int32_t last;
+			if (!prologue(f, segments, last))
+				return false;
+			auto depths = _module->EntryDepths(f);
+			for (auto b : f.layout) {
+				if (depths[b] < 0 || b == f.layout.front())
+					continue;
+				auto h = depths[b];
+				for (auto& ins : f.blocks[b].code) {
+					auto effect = _module->StackEffect(ins);
+					if (h - effect.first < f.frameSize)
+						return false;
+					h += effect.second - effect.first;
+				}
+			}
+
+			// [0, pinned) 中的 slot 参与着色, 其余的 slot 保持相对位置
+			auto pinned = std::min(lowestEscaped(f, depths), f.frameSize);
+			if (pinned < f.params)
+				return false;
+			for (auto& s : segments)
+				if (s.lo < pinned && pinned < s.hi)
+					pinned = s.lo;
+			auto conflicts = interference(f, depths, segments, pinned);
+
+			// 每个 slot 的颜色, 参数各自一种颜色; classes[c] 为颜色 c 的 slot
+			std::vector<int32_t> color(pinned, -1);
+			std::vector<std::vector<int32_t>> classes;
+			for (int32_t p = 0; p < f.params; p++) {
+				color[p] = p;
+				classes.push_back({ p });
+			}
+			for (int32_t k = f.params; k < pinned; k++) {
+				for (std::size_t c = 0; c < classes.size() && color[k] < 0; c++)
+					if (std::none_of(classes[c].begin(), classes[c].end(), [&](int32_t s) { return conflicts[k][s]; }))
+						color[k] = c;
+				if (color[k] < 0) {
+					color[k] = classes.size();
+					classes.emplace_back();
+				}
+				classes[color[k]].push_back(k);
+			}
+
+			auto& entry = f.blocks[f.layout.front()].code;
+			// 创建 slot k 的那一段
+			std::vector<const Segment*> segmentOf(f.frameSize, nullptr);
+			for (auto& s : segments)
+				for (auto k = s.lo; k < s.hi; k++)
+					segmentOf[k] = &s;
+			// 新的栈帧: 参数, 地址被传出的 slot 及以上, 用 snew 分配的颜色, 压入的颜色
+			int32_t rest = f.frameSize - pinned;
+			std::vector<int32_t> index(classes.size(), -1);
+			std::vector<bool> pushed(classes.size(), false);
+			int32_t next = f.params + rest;
+			for (std::size_t c = f.params; c < classes.size(); c++)
+				if (entry[segmentOf[classes[c].front()]->end].GetOperation() == Operation::SNEW)
+					index[c] = next++;
+			int32_t allocated = next - f.params;
+			for (std::size_t c = f.params; c < classes.size(); c++)
+				if (index[c] < 0) {
+					index[c] = next++;
+					pushed[c] = true;
+				}
+			for (int32_t p = 0; p < f.params; p++)
+				index[p] = p;
+			int32_t frameSize = next;
+
+			int32_t allocations = 0;
+			for (auto& s : segments)
+				if (entry[s.end].GetOperation() == Operation::SNEW)
+					allocations++;
+			if (frameSize == f.frameSize && allocations <= 1)
+				return false;
+
+			const auto slot = [&](int32_t k) {
+				if (k < 0)
+					return k;
+				if (k < pinned)
+					return index[color[k]];
+				if (k < f.frameSize)
+					return f.params + k - pinned;
+				return k - f.frameSize + frameSize;
+			};
+			const auto renumber = [&](Instruction ins) {
+				auto op = ins.GetOperation();
+				if (op == Operation::LOADA && ins.GetX() == 0)
+					ins.SetY(slot(ins.GetY()));
+				else if (op == Operation::IINC || op == Operation::IINCS)
+					ins.SetX(slot(ins.GetX()));
+				return ins;
+			};
+
+			std::vector<Instruction> out;
+			out.reserve(entry.size() + 2 * segments.size() + 1);
+			if (allocated > 0)
+				out.emplace_back(0, Operation::SNEW, allocated, 0);
+			for (auto& s : segments) {
+				if (entry[s.end].GetOperation() == Operation::SNEW)
+					continue;
+				// 第一个使用这种颜色的变量压入, 其余的写入
+				bool push = s.lo < pinned && pushed[color[s.lo]] && classes[color[s.lo]].front() == s.lo;
+				if (!push)
+					out.emplace_back(0, Operation::LOADA, 0, slot(s.lo));
+				for (auto i = s.begin; i <= s.end; i++)
+					out.push_back(renumber(entry[i]));
+				if (!push) {
+					out.emplace_back(0, Operation::ISTORE, 0, 0);
+					_stats->Add("initialisations turned into stores");
+				}
+			}
+			for (std::size_t i = last + 1; i < entry.size(); i++)
+				out.push_back(renumber(entry[i]));
+			entry.swap(out);
+			for (auto b : f.layout) {
+				if (b == f.layout.front())
+					continue;
+				for (auto& ins : f.blocks[b].code)
+					ins = renumber(ins);
+			}
+			if (frameSize < f.frameSize)
+				_stats->Add("slots saved", f.frameSize - frameSize);
+			if (allocations > 1)
+				_stats->Add("allocations merged", allocations - 1);
+			f.frameSize = frameSize;
+			return true;
+		}
+	}
+
+	std::unique_ptr<Pass> CreateFrameLayoutPass() {
+		return std::make_unique<FrameLayoutPass>();
+	}
+}
@@ -0,0 +1,271 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 内联后的函数不超过这么多条指令
+		const std::size_t MaxCallerSize = 8192;
+		// 执行次数不少于最常执行的调用的 1 / HotSiteShare 的调用是热的
+		const std::int64_t HotSiteShare = 16;
+
+		// 把小函数的调用换成函数体:
+		//     调用前栈上的参数就是被调用函数的前 params 个 slot, 被调用函数的 slot j 变为调用者的 slot base+j,
+		//     局部变量和操作数栈在参数之上照常压入;
+		//     iret 把返回值存入 slot base 后弹出其余的 slot, ret 弹出所有 slot, 然后跳到调用之后.
+		// 被调用函数的指令数不超过 limit, 或者它只在一处被调用且不超过 4 * limit 时内联.
+		// 有 profile 时, 训练运行中没有执行过的调用不内联, 热的调用处的被调用函数不超过 4 * limit 时内联.
+		// 按调用图自底向上处理, 递归 (调用图的环) 中的函数不内联, .start 中的调用不内联
+		class InlinePass final : public Pass {
+		public:
+			InlinePass(int32_t limit) : _limit(limit) {}
+
+			const char* Name() const override { return "inline"; }
+			int Level() const override { return 2; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				if (_limit <= 0 || m.functions.empty())
+					return false;
+				_module = &m;
+				_stats = &stats;
+				_sites.assign(m.functions.size(), 0);
+				const auto count = [&](const IRFunction& f) {
+					for (auto b : f.layout)
+						for (auto& ins : f.blocks[b].code)
+							if (ins.GetOperation() == Operation::CALL)
+								_sites[ins.GetX()]++;
+				};
+				count(m.start);
+				for (auto& f : m.functions)
+					count(f);
+				_hottest = 0;
+				for (auto& f : m.functions)
+					for (auto b : f.layout)
+						for (auto& ins : f.blocks[b].code)
+							if (ins.GetOperation() == Operation::CALL)
+								_hottest = std::max(_hottest, f.blocks[b].count);
+				bool changed = false;
+				for (auto i : bottomUp())
+					changed = runOn(m.functions[i]) || changed;
+				return changed;
+			}
+		private:
+			// 被调用者在调用者之前, 同时标记出递归的函数
+			std::vector<int32_t> bottomUp();
+			bool runOn(IRFunction& f);
+			// count 为调用处执行的次数, 不知道时为 -1
+			bool inlinable(const IRFunction& callee, std::int64_t count) const;
+			// 把 f 的块 b 中第 k 条指令 (call) 换成函数体, 返回调用之后的代码所在的块
+			int32_t expand(IRFunction& f, int32_t b, std::size_t k, int32_t base, const IRFunction& callee);
+		private:
+			int32_t _limit;
+			IRModule* _module = nullptr;
+			PassStatistics* _stats = nullptr;
+			std::vector<int32_t> _sites;	// 每个函数被调用的次数
+			std::vector<bool> _recursive;
+			std::int64_t _hottest = 0;	// 最常执行的调用执行的次数
+		};
+
+		std::vector<int32_t> InlinePass::bottomUp() {
+			auto& functions = _module->functions;
+			int32_t size = functions.size();
+			std::vector<std::vector<int32_t>> callees(size);
+			for (int32_t i = 0; i < size; i++) {
+				auto& f = functions[i];
+				for (auto b : f.layout)
+					for (auto& ins : f.blocks[b].code)
+						if (ins.GetOperation() == Operation::CALL)
+							callees[i].push_back(ins.GetX());
+			}
+			// Tarjan 算法, 强连通分量按逆拓扑序 (被调用者在前) 得出
+			std::vector<int32_t> order, index(size, -1), low(size, 0), stack;
+			std::vector<bool> onStack(size, false);
+			_recursive.assign(size, false);
+			int32_t counter = 0;
+			// (函数, 下一个要访问的被调用者)
+			std::vector<std::pair<int32_t, std::size_t>> dfs;
+			for (int32_t root = 0; root < size; root++) {
+				if (index[root] >= 0)
+					continue;
+				dfs.emplace_back(root, 0);
+				while (!dfs.empty()) {
+					auto& [v, next] = dfs.back();
+					if (next == 0 && index[v] < 0) {
+						index[v] = low[v] = counter++;
+						stack.push_back(v);
+						onStack[v] = true;
+					}
+					if (next < callees[v].size()) {
+						auto w = callees[v][next++];
+						if (w == v)
+							_recursive[v] = true;
+						if (index[w] < 0)
+							dfs.emplace_back(w, 0);
+						else if (onStack[w])
+							low[v] = std::min(low[v], index[w]);
+						continue;
+					}
+					auto done = v;
+					dfs.pop_back();
+					if (!dfs.empty())
+						low[dfs.back().first] = std::min(low[dfs.back().first], low[done]);
+					if (low[done] != index[done])
+						continue;
+					std::vector<int32_t> component;
+					while (true) {
+						auto w = stack.back();
+						stack.pop_back();
+						onStack[w] = false;
+						component.push_back(w);
+						if (w == done)
+							break;
+					}
+					for (auto w : component) {
+						if (component.size() > 1)
+							_recursive[w] = true;
+						order.push_back(w);
+					}
+				}
+			}
+			return order;
+		}
+
+		bool InlinePass::inlinable(const IRFunction& callee, std::int64_t count) const {
+			if (_recursive[callee.index] || callee.imported || callee.unbalanced)
+				return false;
+			if (count == 0) {
+				_stats->Add("cold calls not inlined");
+				return false;
+			}
+			auto size = static_cast<int32_t>(callee.Size());
+			bool hot = count > 0 && count * HotSiteShare >= _hottest;
+			if (size > _limit && !((_sites[callee.index] == 1 || hot) && size <= 4 * _limit))
+				return false;
+			// 落出函数末尾的代码没有返回到调用处的办法
+			for (auto b : callee.layout) {
+				auto& block = callee.blocks[b];
+				if (block.Terminator() == nullptr && block.next < 0)
+					return false;
+			}
+			return true;
+		}
+
+		bool InlinePass::runOn(IRFunction& f) {
+			if (f.unbalanced)
+				return false;
+			auto depths = _module->EntryDepths(f);
+			bool changed = false;
+			// 新加入的块 (已经处理过的被调用者的函数体) 不再扫描
+			std::vector<int32_t> worklist(f.layout.rbegin(), f.layout.rend());
+			while (!worklist.empty()) {
+				auto b = worklist.back();
+				worklist.pop_back();
+				if (depths[b] < 0)
+					continue;
+				auto h = depths[b];
+				for (std::size_t k = 0; k < f.blocks[b].code.size(); k++) {
+					auto& ins = f.blocks[b].code[k];
+					auto effect = _module->StackEffect(ins);
+					if (ins.GetOperation() == Operation::CALL) {
+						auto& callee = _module->functions[ins.GetX()];
+						if (&callee != &f && inlinable(callee, f.blocks[b].count) && f.Size() + callee.Size() <= MaxCallerSize) {
+							_stats->Add("calls inlined");
+							_stats->Add("inlined " + callee.name + " into " + f.name);
+							auto c = expand(f, b, k, h - callee.params, callee);
+							// 调用后的代码在调用者中的栈高度不变
+							depths.resize(f.blocks.size(), -1);
+							depths[c] = h - effect.first + effect.second;
+							worklist.push_back(c);
+							changed = true;
+							break;
+						}
+					}
+					h += effect.second - effect.first;
+				}
+			}
+			return changed;
+		}
+
+		int32_t InlinePass::expand(IRFunction& f, int32_t b, std::size_t k, int32_t base, const IRFunction& callee) {
+			auto c = f.AddBlock();
+			f.blocks[c].code.assign(f.blocks[b].code.begin() + k + 1, f.blocks[b].code.end());
+			f.blocks[c].next = f.blocks[b].next;
+			f.blocks[c].count = f.blocks[b].count;
+			f.blocks[c].taken = f.blocks[b].taken;
+			f.blocks[b].taken = -1;
+			f.blocks[b].code.resize(k);
+			// 被调用函数的计数按这次调用占所有调用的比例分过来
+			auto calls = callee.blocks[callee.layout.front()].count;
+			auto site = f.blocks[b].count;
+
+			auto depths = _module->EntryDepths(callee);
+			std::vector<int32_t> id(callee.blocks.size(), -1);
+			std::vector<int32_t> cloned;
+			for (auto cb : callee.layout)
+				if (depths[cb] >= 0) {
+					id[cb] = f.AddBlock();
+					cloned.push_back(id[cb]);
+				}
+			for (auto cb : callee.layout) {
+				if (id[cb] < 0)
+					continue;
+				auto& source = callee.blocks[cb];
+				auto& block = f.blocks[id[cb]];
+				block.next = source.next >= 0 ? id[source.next] : -1;
+				if (calls > 0 && site >= 0 && source.count >= 0) {
+					auto share = static_cast<double>(site) / calls;
+					block.count = std::llround(source.count * share);
+					if (source.taken >= 0)
+						block.taken = std::llround(source.taken * share);
+				}
+				// 相对被调用者栈帧的高度
+				auto h = depths[cb];
+				for (auto ins : source.code) {
+					auto op = ins.GetOperation();
+					if (op == Operation::IRET) {
+						// slot 0 = 返回值, 再弹出 slot 1 及以上
+						if (h > 1) {
+							block.code.emplace_back(0, Operation::LOADA, 0, base);
+							block.code.emplace_back(0, Operation::IPUSH, 0, 0);
+							block.code.emplace_back(0, Operation::ISTORE, 0, 0);
+							block.code.emplace_back(0, Operation::IINCS, base, 0);
+							if (h > 2)
+								block.code.emplace_back(0, Operation::POPN, h - 2, 0);
+						}
+						block.next = c;
+						break;
+					}
+					if (op == Operation::RET) {
+						if (h > 0)
+							block.code.emplace_back(0, Operation::POPN, h, 0);
+						block.next = c;
+						break;
+					}
+					auto effect = _module->StackEffect(ins);
+					h += effect.second - effect.first;
+					if (op == Operation::LOADA && ins.GetX() == 0)
+						ins.SetY(ins.GetY() + base);
+					else if (op == Operation::IINC || op == Operation::IINCS)
+						ins.SetX(ins.GetX() + base);
+					else if (ir::IsJump(op))
+						ins.SetX(id[ins.GetX()]);
+					block.code.push_back(ins);
+				}
+			}
+			f.blocks[b].next = id[callee.layout.front()];
+
+			auto at = std::find(f.layout.begin(), f.layout.end(), b) + 1;
+			cloned.push_back(c);
+			f.layout.insert(at, cloned.begin(), cloned.end());
+			return c;
+		}
+	}
+
+	std::unique_ptr<Pass> CreateInlinePass(std::int32_t limit) {
+		return std::make_unique<InlinePass>(limit);
+	}
+}
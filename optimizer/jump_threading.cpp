@@ -0,0 +1,98 @@
+#include "optimizer/passes.h"
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 跳转 (和顺序执行) 到只有 jmp 的块或空块时, 直接到它最终去的块:
+		//     jmp A; A: jmp B        =>  jmp B
+		//     jcc A; A: jmp B        =>  jcc B
+		// 两个后继相同的条件跳转换成 pop, 之后不可达的块被删除
+		class JumpThreadingPass final : public Pass {
+		public:
+			const char* Name() const override { return "jump-threading"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				bool changed = runOn(m.start, stats);
+				for (auto& f : m.functions)
+					changed = runOn(f, stats) || changed;
+				return changed;
+			}
+		private:
+			// 只是转到另一个块的块转到的块, 不是则为 -1
+			static int32_t forwardOf(const IRFunction& f, int32_t b) {
+				if (b == f.layout.front())
+					return -1;
+				auto& block = f.blocks[b];
+				if (block.code.empty())
+					return block.next;
+				if (block.code.size() == 1 && block.code[0].GetOperation() == Operation::JMP)
+					return block.code[0].GetX();
+				return -1;
+			}
+
+			// 沿着只有 jmp 的块走到底, 空的死循环停在环上
+			static int32_t follow(const IRFunction& f, int32_t b) {
+				std::vector<bool> seen(f.blocks.size(), false);
+				while (!seen[b]) {
+					seen[b] = true;
+					auto next = forwardOf(f, b);
+					if (next < 0)
+						break;
+					b = next;
+				}
+				return b;
+			}
+
+			bool runOn(IRFunction& f, PassStatistics& stats) {
+				if (f.unbalanced)
+					return false;
+				bool changed = false;
+				for (auto b : f.layout) {
+					auto& block = f.blocks[b];
+					if (!block.code.empty() && ir::IsJump(block.code.back().GetOperation())) {
+						auto& jump = block.code.back();
+						auto target = follow(f, jump.GetX());
+						if (target != jump.GetX()) {
+							jump.SetX(target);
+							stats.Add("jumps threaded");
+							changed = true;
+						}
+					}
+					if (block.next >= 0) {
+						auto next = follow(f, block.next);
+						if (next != block.next) {
+							block.next = next;
+							stats.Add("jumps threaded");
+							changed = true;
+						}
+					}
+					// 条件跳转弹出条件, 换成 pop
+					if (!block.code.empty() && ir::IsBranch(block.code.back().GetOperation()) && block.code.back().GetX() == block.next) {
+						block.code.back() = Instruction(0, Operation::POP, 0, 0);
+						stats.Add("branches removed");
+						changed = true;
+					}
+				}
+				if (!changed)
+					return false;
+				auto reachable = f.Reachable();
+				for (auto b : f.layout)
+					if (!reachable[b]) {
+						stats.Add("unreachable blocks removed");
+						f.blocks[b].code.clear();
+						f.blocks[b].next = -1;
+						f.blocks[b].dead = true;
+					}
+				f.CompactLayout();
+				return true;
+			}
+		};
+	}
+
+	std::unique_ptr<Pass> CreateJumpThreadingPass() {
+		return std::make_unique<JumpThreadingPass>();
+	}
+}
@@ -0,0 +1,377 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <map>
+#include <set>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 外提的计算至少要有这么多条指令, 循环里换成 loada 0, t; iload
+		const int32_t MinHoistSize = 3;
+
+		// 一组指令可能写入的位置
+		struct Writes {
+			std::set<int32_t> slots;	// 当前函数栈帧的 slot
+			std::set<int32_t> globals;
+			bool escaped = false;	// 地址被传出的 slot 及以上
+			bool allSlots = false;
+			bool allGlobals = false;
+			std::set<int32_t> callees;
+		};
+
+		// 循环不变量外提:
+		//     找出自然循环, 外层的先处理. 循环中只读取循环里没有写入的变量的计算 (一棵完整的表达式树)
+		//     移到循环头前新加的前置块中计算一次, 存入临时 slot, 循环中换成读临时 slot.
+		// 变量的写入包括 store, iinc/iincs, 数组的写入 (写地址被传出的 slot 以上, 或全局变量),
+		//     调用 (被调用的函数及它调用的函数写入的全局变量, 以及地址被传出的 slot),
+		//     spawn 和 join 使其他任务的写入可见, 按写入所有全局变量处理.
+		// 前置块的计算总会执行, 所以只外提不会出错的计算: 除数只能是不为 0 和 -1 的常量.
+		// 临时 slot 与 cse 一样在入口处用 snew 分配, 入口块是外层循环的头时放在它前面新加的入口块中.
+		// .start 中没有循环, 不处理
+		class LicmPass final : public Pass {
+		public:
+			const char* Name() const override { return "licm"; }
+			int Level() const override { return 2; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				_module = &m;
+				_stats = &stats;
+				summarize();
+				bool changed = false;
+				for (auto& f : m.functions)
+					changed = runOn(f) || changed;
+				return changed;
+			}
+		private:
+			// 块中的写入, 调用只记下被调用的函数
+			void collect(const IRFunction& f, int32_t b, const std::vector<int32_t>& depths, Writes& w) const;
+			// 每个函数 (包括它调用的函数) 写入的全局变量
+			void summarize();
+			// 把 w 中调用的函数写入的全局变量并入 w
+			void addCallees(Writes& w) const;
+			bool runOn(IRFunction& f);
+			bool hoist(IRFunction& f, const Loop& loop);
+		private:
+			IRModule* _module = nullptr;
+			PassStatistics* _stats = nullptr;
+			std::vector<Writes> _summaries;
+			int32_t _escaped = INT_MAX;	// 地址被传出的最低的 slot
+			int32_t _temps = 0;
+		};
+
+		void LicmPass::collect(const IRFunction& f, int32_t b, const std::vector<int32_t>& depths, Writes& w) const {
+			auto& code = f.blocks[b].code;
+			BlockValues bv(*_module, f.blocks[b], depths[b]);
+			// 第 j 个操作数是 loada 时的位置
+			const auto slotOf = [&](std::size_t k, std::size_t j) -> std::optional<ir::Slot> {
+				auto v = bv.operands[k][j];
+				if (v.def < 0)
+					return {};
+				return ir::SlotOf(code[v.def]);
+			};
+			for (std::size_t k = 0; k < code.size(); k++) {
+				auto& ins = code[k];
+				switch (ins.GetOperation()) {
+				case Operation::ISTORE:
+				case Operation::ASTORE: {
+					auto slot = slotOf(k, 0);
+					if (slot.has_value() && slot->level == 0)
+						w.slots.insert(slot->offset);
+					else if (slot.has_value() && slot->level == 1)
+						w.globals.insert(slot->offset);
+					else
+						w.allSlots = w.allGlobals = true;
+				} break;
+				case Operation::IINC:
+				case Operation::IINCS:
+					w.slots.insert(ins.GetX());
+					break;
+				case Operation::IASTORE:
+				case Operation::AASTORE:
+				case Operation::IAFILL:
+				case Operation::IACOPY: {
+					// 局部数组只能写地址被传出的 slot, 其他的数组可能是全局数组
+					auto slot = slotOf(k, 0);
+					if (!slot.has_value() || slot->level != 1)
+						w.escaped = true;
+					if (!slot.has_value() || slot->level != 0)
+						w.allGlobals = true;
+				} break;
+				case Operation::CALL:
+					w.callees.insert(ins.GetX());
+					w.escaped = true;
+					break;
+				case Operation::ISPAWN:
+				case Operation::IJOIN:
+					w.escaped = w.allGlobals = true;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		void LicmPass::summarize() {
+			auto& functions = _module->functions;
+			_summaries.assign(functions.size(), Writes());
+			for (std::size_t i = 0; i < functions.size(); i++) {
+				auto& f = functions[i];
+				// 没有分析的函数可能写任何地方
+				if (f.unbalanced) {
+					_summaries[i].escaped = _summaries[i].allSlots = _summaries[i].allGlobals = true;
+					continue;
+				}
+				auto depths = _module->EntryDepths(f);
+				for (auto b : f.layout)
+					if (depths[b] >= 0)
+						collect(f, b, depths, _summaries[i]);
+				// 被调用者的栈帧对调用者没有意义, 写不知道的地址可能写到全局变量;
+				// 别的文件中的函数可能调用这个文件中的任何函数
+				if (_summaries[i].allSlots || f.imported)
+					_summaries[i].allGlobals = true;
+			}
+			for (bool changed = true; changed; ) {
+				changed = false;
+				for (auto& s : _summaries) {
+					auto allGlobals = s.allGlobals;
+					auto size = s.globals.size();
+					addCallees(s);
+					changed = changed || s.allGlobals != allGlobals || s.globals.size() != size;
+				}
+			}
+		}
+
+		void LicmPass::addCallees(Writes& w) const {
+			for (auto c : w.callees) {
+				auto& s = _summaries[c];
+				w.allGlobals = w.allGlobals || s.allGlobals;
+				w.globals.insert(s.globals.begin(), s.globals.end());
+			}
+		}
+
+		bool LicmPass::runOn(IRFunction& f) {
+			if (f.unbalanced)
+				return false;
+			auto loops = f.Loops();
+			if (loops.empty())
+				return false;
+			_stats->Add("loops found", loops.size());
+
+			// 地址被传出的 slot, 即不是直接被 load/store 使用的 loada 0, k
+			_escaped = INT_MAX;
+			auto depths = _module->EntryDepths(f);
+			for (auto b : f.layout) {
+				if (depths[b] < 0)
+					continue;
+				auto& code = f.blocks[b].code;
+				BlockValues bv(*_module, f.blocks[b], depths[b]);
+				const auto escape = [&](const BlockValues::Value& v) {
+					if (v.def >= 0)
+						if (auto slot = ir::SlotOf(code[v.def]); slot.has_value() && slot->level == 0)
+							_escaped = std::min(_escaped, slot->offset);
+				};
+				for (std::size_t k = 0; k < code.size(); k++) {
+					auto op = code[k].GetOperation();
+					bool direct = op == Operation::ILOAD || op == Operation::ALOAD || op == Operation::ISTORE || op == Operation::ASTORE;
+					for (std::size_t j = 0; j < bv.operands[k].size(); j++)
+						if (!(direct && j == 0))
+							escape(bv.operands[k][j]);
+				}
+				for (auto& v : bv.exitStack)
+					escape(v);
+			}
+
+			_temps = 0;
+			bool changed = false;
+			for (auto& loop : loops)
+				changed = hoist(f, loop) || changed;
+			if (_temps == 0)
+				return changed;
+
+			// 参数以上的 slot 后移 _temps 个, 临时 slot 为 params ... params + _temps - 1
+			const auto slot = [&](int32_t k) {
+				if (k < 0)
+					return f.params - 1 - k;
+				return k >= f.params ? k + _temps : k;
+			};
+			for (auto b : f.layout)
+				for (auto& ins : f.blocks[b].code) {
+					auto op = ins.GetOperation();
+					if (op == Operation::LOADA && ins.GetX() == 0)
+						ins.SetY(slot(ins.GetY()));
+					else if (op == Operation::IINC || op == Operation::IINCS)
+						ins.SetX(slot(ins.GetX()));
+				}
+			auto& entry = f.blocks[f.SplitEntry()].code;
+			entry.emplace(entry.begin(), 0, Operation::SNEW, _temps, 0);
+			f.frameSize += _temps;
+			return true;
+		}
+
+		bool LicmPass::hoist(IRFunction& f, const Loop& loop) {
+			auto h = loop.header;
+			// 前置块要排在入口之后
+			if (h == f.layout.front())
+				return false;
+			auto depths = _module->EntryDepths(f);
+			Writes w;
+			// 外层循环的前置块是后加的, 不在 loop.body 中
+			const auto inLoop = [&](int32_t b) { return b < static_cast<int32_t>(loop.body.size()) && loop.body[b]; };
+			for (auto b : f.layout)
+				if (inLoop(b))
+					collect(f, b, depths, w);
+			addCallees(w);
+
+			// 循环中和前置块中读取都得到同一个值的 slot
+			const auto invariant = [&](const ir::Slot& slot) {
+				if (slot.level == 1)
+					return !w.allGlobals && w.globals.count(slot.offset) == 0;
+				if (slot.level != 0)
+					return false;
+				// 外层循环的临时 slot 只在前置块中写入
+				if (slot.offset < 0)
+					return true;
+				if (w.allSlots || slot.offset >= depths[h] || w.slots.count(slot.offset) != 0)
+					return false;
+				return !(w.escaped && slot.offset >= _escaped);
+			};
+
+			// 相同的计算共用一个临时 slot
+			std::map<std::vector<std::array<int32_t, 3>>, int32_t> temps;
+			std::vector<Instruction> preheader;
+			for (auto b : f.layout) {
+				if (!inLoop(b))
+					continue;
+				auto& code = f.blocks[b].code;
+				int32_t size = code.size();
+				BlockValues bv(*_module, f.blocks[b], depths[b]);
+				std::vector<int32_t> uses(size, 0);
+				for (auto& operands : bv.operands)
+					for (auto& v : operands)
+						if (v.def >= 0)
+							uses[v.def]++;
+				for (auto& v : bv.exitStack)
+					if (v.def >= 0)
+						uses[v.def]++;
+
+				// 以第 k 条指令为根的不变的计算的起点和指令数, 不是连续的不变的计算时 begin 为 -1
+				std::vector<int32_t> begin(size, -1), count(size, 0);
+				for (int32_t k = 0; k < size; k++) {
+					auto& ins = code[k];
+					auto& operands = bv.operands[k];
+					bool ok = false;
+					switch (ins.GetOperation()) {
+					case Operation::IPUSH:
+					case Operation::BIPUSH:
+					case Operation::LOADC:
+					case Operation::LOADA:
+						ok = true;
+						break;
+					case Operation::ILOAD:
+					case Operation::ALOAD:
+						if (operands[0].def >= 0)
+							if (auto slot = ir::SlotOf(code[operands[0].def]); slot.has_value())
+								ok = invariant(slot.value());
+						break;
+					case Operation::IDIV: {
+						auto d = operands[1].def;
+						if (d < 0)
+							break;
+						auto op = code[d].GetOperation();
+						ok = (op == Operation::IPUSH || op == Operation::BIPUSH) && code[d].GetX() != 0 && code[d].GetX() != -1;
+					} break;
+					case Operation::IADD:
+					case Operation::ISUB:
+					case Operation::IMUL:
+					case Operation::INEG:
+					case Operation::ICMP:
+						ok = true;
+						break;
+					default:
+						break;
+					}
+					if (!ok)
+						continue;
+					begin[k] = k;
+					count[k] = 1;
+					for (auto& o : operands) {
+						if (o.def < 0 || uses[o.def] != 1 || begin[o.def] < 0) {
+							begin[k] = -1;
+							break;
+						}
+						begin[k] = std::min(begin[k], begin[o.def]);
+						count[k] += count[o.def];
+					}
+					if (begin[k] >= 0 && k - begin[k] + 1 != count[k])
+						begin[k] = -1;
+				}
+
+				// 从后往前选出最大的树
+				std::map<int32_t, std::pair<int32_t, int32_t>> replaced;	// begin -> (end, 临时 slot)
+				int32_t cover = size;
+				for (int32_t k = size - 1; k >= 0; k--) {
+					if (k >= cover || begin[k] < 0 || count[k] < MinHoistSize)
+						continue;
+					std::vector<std::array<int32_t, 3>> key;
+					for (int32_t i = begin[k]; i <= k; i++)
+						key.push_back({ static_cast<int32_t>(code[i].GetOperation()), code[i].GetX(), code[i].GetY() });
+					auto it = temps.find(key);
+					if (it == temps.end()) {
+						it = temps.emplace(std::move(key), _temps++).first;
+						preheader.emplace_back(0, Operation::LOADA, 0, -1 - it->second);
+						preheader.insert(preheader.end(), code.begin() + begin[k], code.begin() + k + 1);
+						preheader.emplace_back(0, Operation::ISTORE, 0, 0);
+						_stats->Add("temporaries allocated");
+					}
+					replaced[begin[k]] = { k, it->second };
+					cover = begin[k];
+					_stats->Add("expressions hoisted");
+				}
+				if (replaced.empty())
+					continue;
+				std::vector<Instruction> out;
+				out.reserve(size);
+				for (int32_t i = 0; i < size; i++) {
+					auto r = replaced.find(i);
+					if (r == replaced.end()) {
+						out.push_back(code[i]);
+						continue;
+					}
+					out.emplace_back(0, Operation::LOADA, 0, -1 - r->second.second);
+					out.emplace_back(0, Operation::ILOAD, 0, 0);
+					i = r->second.first;
+				}
+				code.swap(out);
+			}
+			if (preheader.empty())
+				return false;
+
+			// 从循环外进入循环头的边改为进入前置块
+			auto preds = f.Predecessors();
+			auto p = f.AddBlock();
+			f.blocks[p].code = std::move(preheader);
+			f.blocks[p].next = h;
+			for (auto b : preds[h]) {
+				if (inLoop(b))
+					continue;
+				auto& block = f.blocks[b];
+				if (!block.code.empty() && ir::IsJump(block.code.back().GetOperation()) && block.code.back().GetX() == h)
+					block.code.back().SetX(p);
+				if (block.next == h)
+					block.next = p;
+			}
+			f.layout.insert(std::find(f.layout.begin(), f.layout.end(), h), p);
+			_stats->Add("preheaders inserted");
+			return true;
+		}
+	}
+
+	std::unique_ptr<Pass> CreateLicmPass() {
+		return std::make_unique<LicmPass>();
+	}
+}
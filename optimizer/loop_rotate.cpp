@@ -0,0 +1,87 @@
+#include "optimizer/passes.h"
+
+#include <cmath>
+
+namespace cc0 {
+
+	namespace {
+
+		using int32_t = std::int32_t;
+
+		// 复制到循环末尾的循环头不超过这么多条指令
+		const std::size_t MaxHeaderSize = 16;
+
+		// 把 while 循环的条件复制到循环末尾:
+		//     H: <cond>; jcc E           H: <cond>; jcc E
+		//     B: ...                     B: ...
+		//     L: ...; jmp H          =>  L: ...; <cond>; jcc E
+		// 每次迭代从一个不跳转的条件跳转加一个 jmp 变成一个条件跳转, 循环头只在进入循环时执行一次.
+		// 条件跳转的方向由之后的 block-layout 按布局调整.
+		// 有 profile 时, 没有执行过或平均每次进入时循环体执行不到一次的循环不复制
+		class LoopRotatePass final : public Pass {
+		public:
+			const char* Name() const override { return "loop-rotate"; }
+			int Level() const override { return 2; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				bool changed = false;
+				for (auto& f : m.functions)
+					changed = runOn(f, stats) || changed;
+				return changed;
+			}
+		private:
+			bool runOn(IRFunction& f, PassStatistics& stats) {
+				if (f.unbalanced)
+					return false;
+				bool changed = false;
+				auto preds = f.Predecessors();
+				for (auto& loop : f.Loops()) {
+					auto h = loop.header;
+					auto& header = f.blocks[h];
+					if (h == f.layout.front() || header.code.size() > MaxHeaderSize)
+						continue;
+					// 循环头以条件跳转结束, 一个后继在循环中, 另一个在循环外
+					if (header.code.empty() || !ir::IsBranch(header.code.back().GetOperation()) || header.next < 0)
+						continue;
+					if (loop.body[header.code.back().GetX()] == loop.body[header.next])
+						continue;
+					if (header.count >= 0 && header.taken >= 0) {
+						// 留在循环里的次数, 每次离开循环对应一次进入
+						auto stays = loop.body[header.code.back().GetX()] ? header.taken : header.count - header.taken;
+						if (header.count == 0 || 2 * stays < header.count) {
+							stats.Add("cold loops not rotated");
+							continue;
+						}
+					}
+					for (auto l : preds[h]) {
+						if (!loop.body[l])
+							continue;
+						auto& latch = f.blocks[l];
+						auto t = latch.Terminator();
+						if (t != nullptr && t->GetOperation() == Operation::JMP)
+							latch.code.pop_back();
+						else if (t != nullptr || latch.next != h)
+							continue;
+						latch.code.insert(latch.code.end(), header.code.begin(), header.code.end());
+						latch.next = header.next;
+						// 从循环末尾执行循环头的次数移到末尾的条件跳转上, 跳转的比例与循环头相同.
+						// 要四舍五入: 只进入一次的循环截断后离开循环的那次会算到循环头上, 让 block-layout 把出口排在前面
+						latch.taken = -1;
+						if (header.count > 0 && header.taken >= 0 && latch.count >= 0 && latch.count <= header.count) {
+							latch.taken = std::llround(static_cast<double>(header.taken) * latch.count / header.count);
+							header.count -= latch.count;
+							header.taken -= latch.taken;
+						}
+						stats.Add("loops rotated");
+						stats.Add("instructions duplicated", header.code.size());
+						changed = true;
+					}
+				}
+				return changed;
+			}
+		};
+	}
+
+	std::unique_ptr<Pass> CreateLoopRotatePass() {
+		return std::make_unique<LoopRotatePass>();
+	}
+}
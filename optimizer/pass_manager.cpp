@@ -0,0 +1,59 @@
+#include "optimizer/pass_manager.h"
+#include "optimizer/passes.h"
+
+#include <utility>
+
+namespace cc0 {
+
+	namespace {
+
+		// 运行顺序
+		std::vector<std::unique_ptr<Pass>> createPasses(const OptimizeOptions& options) {
+			std::vector<std::unique_ptr<Pass>> rtv;
+			if (options.profile)
+				rtv.push_back(CreateProfileUsePass(options.profile));
+			rtv.push_back(CreateInlinePass(options.inlineLimit));
+			rtv.push_back(CreateConstPropPass());
+			rtv.push_back(CreateLicmPass());
+			rtv.push_back(CreateCsePass());
+			rtv.push_back(CreateDeadCodePass());
+			rtv.push_back(CreateFrameLayoutPass());
+			rtv.push_back(CreateJumpThreadingPass());
+			rtv.push_back(CreateLoopRotatePass());
+			rtv.push_back(CreateSimplifyCfgPass());
+			rtv.push_back(CreateBlockLayoutPass());
+			return rtv;
+		}
+	}
+
+	std::vector<std::string> PassNames() {
+		std::vector<std::string> rtv;
+		for (auto& pass : createPasses(OptimizeOptions()))
+			rtv.emplace_back(pass->Name());
+		return rtv;
+	}
+
+	PassManager::PassManager(OptimizeOptions options)
+		: _options(std::move(options)), _passes(), _reports({}) {
+		for (auto& pass : createPasses(_options)) {
+			std::string name = pass->Name();
+			if (_options.disabled.count(name))
+				continue;
+			if (pass->Level() <= _options.level || _options.enabled.count(name))
+				_passes.push_back(std::move(pass));
+		}
+	}
+
+	Program PassManager::Run(Program p) {
+		if (_passes.empty())
+			return p;
+		auto module = Lift(p);
+		for (auto& pass : _passes) {
+			PassReport report{ pass->Name(), module.Size(), 0, {} };
+			pass->Run(module, report.stats);
+			report.after = module.Size();
+			_reports.push_back(std::move(report));
+		}
+		return Lower(module);
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "instruction/instruction.h"
+#include "ir/ir.h"
+#include "src/profile.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef> // for std::size_t
+
+namespace cc0 {
+
+	// 一个遍的计数器, 如 "blocks merged" -> 3
+	class PassStatistics final {
+	public:
+		void Add(const std::string& counter, std::int64_t n = 1) { _counters[counter] += n; }
+		const std::map<std::string, std::int64_t>& Counters() const { return _counters; }
+	private:
+		std::map<std::string, std::int64_t> _counters;
+	};
+
+	struct OptimizeOptions {
+		// -O0 | -O1 | -O2
+		int level = 0;
+		// 不论级别都运行 / 都不运行的遍
+		std::set<std::string> enabled;
+		std::set<std::string> disabled;
+		// 内联的被调用函数的指令数上限, 0 为不内联
+		std::int32_t inlineLimit = 20;
+		// -fprofile-use 读入的训练运行的计数, 没有时为空
+		std::shared_ptr<const vm::Profile> profile;
+	};
+
+	// 在 IRModule 上工作的优化遍
+	class Pass {
+	public:
+		virtual ~Pass() = default;
+		virtual const char* Name() const = 0;
+		// 在这个 -O 级别及以上默认运行
+		virtual int Level() const = 0;
+		// 返回是否修改了模块
+		virtual bool Run(IRModule&, PassStatistics&) = 0;
+	};
+
+	// 运行过的一个遍
+	struct PassReport {
+		std::string name;
+		std::size_t before;	// 运行前后的指令数
+		std::size_t after;
+		PassStatistics stats;
+	};
+
+	// 按固定的顺序运行选中的遍: Program -> IRModule -> 各个遍 -> Program
+	// 没有选中任何遍时原样返回, 不经过 IR
+	class PassManager final {
+	public:
+		PassManager(OptimizeOptions options);
+		PassManager(PassManager&&) = delete;
+		PassManager(const PassManager&) = delete;
+		PassManager& operator=(PassManager) = delete;
+
+		// 唯一接口
+		Program Run(Program p);
+
+		const std::vector<PassReport>& Reports() const { return _reports; }
+	private:
+		OptimizeOptions _options;
+		std::vector<std::unique_ptr<Pass>> _passes;
+		std::vector<PassReport> _reports;
+	};
+
+	// 所有遍的名字, 按运行顺序
+	std::vector<std::string> PassNames();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "optimizer/pass_manager.h"
+
+#include <memory>
+#include <cstdint>
+
+namespace cc0 {
+
+	// 把 -fprofile-use 的计数记到块上
+	std::unique_ptr<Pass> CreateProfileUsePass(std::shared_ptr<const vm::Profile> profile);
+	// 内联不超过 limit 条指令的函数
+	std::unique_ptr<Pass> CreateInlinePass(std::int32_t limit);
+	// 块内的常量传播和折叠
+	std::unique_ptr<Pass> CreateConstPropPass();
+	// 把循环中不变的计算移到循环之前
+	std::unique_ptr<Pass> CreateLicmPass();
+	// 扩展基本块内的值编号, 复用重复计算的值
+	std::unique_ptr<Pass> CreateCsePass();
+	// 删除不可达的代码, 死的写入和没有用到的函数
+	std::unique_ptr<Pass> CreateDeadCodePass();
+	// 生存期不重叠的局部变量共用 slot, 栈帧在入口处一次分配
+	std::unique_ptr<Pass> CreateFrameLayoutPass();
+	// 跳过只有 jmp 的块
+	std::unique_ptr<Pass> CreateJumpThreadingPass();
+	// 把循环条件复制到循环末尾, 每次迭代只有一个条件跳转
+	std::unique_ptr<Pass> CreateLoopRotatePass();
+	// 合并只有一条边相连的块
+	std::unique_ptr<Pass> CreateSimplifyCfgPass();
+	// 按更可能执行的路径排列块
+	std::unique_ptr<Pass> CreateBlockLayoutPass();
+}
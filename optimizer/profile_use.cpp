@@ -0,0 +1,52 @@
+#include "optimizer/passes.h"
+
+namespace cc0 {
+
+	namespace {
+
+		// 把 profile 的计数记到块上, 供之后的遍使用.
+		// profile 按指令下标记录, 只对得上分析器的输出, 所以训练用的是同一份源代码的 -O0 程序,
+		// 这个遍总是第一个运行. 名字或指令数对不上的函数 (源代码改过了) 不使用 profile
+		class ProfileUsePass final : public Pass {
+		public:
+			ProfileUsePass(std::shared_ptr<const vm::Profile> profile) : _profile(std::move(profile)) {}
+
+			const char* Name() const override { return "profile-use"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				for (auto& f : m.functions) {
+					if (f.index >= static_cast<std::int32_t>(_profile->functions.size())) {
+						stats.Add("functions not in the profile");
+						continue;
+					}
+					auto& counters = _profile->functions[f.index];
+					if (counters.name != f.name || counters.counts.size() != f.Size()) {
+						stats.Add("functions not in the profile");
+						continue;
+					}
+					// 刚从 Program 得到的块按顺序排列
+					std::size_t ip = 0;
+					for (auto b : f.layout) {
+						auto& block = f.blocks[b];
+						if (block.code.empty())
+							continue;
+						block.count = counters.counts[ip];
+						ip += block.code.size();
+						if (ir::IsBranch(block.code.back().GetOperation()))
+							block.taken = counters.taken[ip - 1];
+					}
+					stats.Add("functions profiled");
+					if (counters.counts.empty() || counters.counts[0] == 0)
+						stats.Add("functions never called");
+				}
+				return false;
+			}
+		private:
+			std::shared_ptr<const vm::Profile> _profile;
+		};
+	}
+
+	std::unique_ptr<Pass> CreateProfileUsePass(std::shared_ptr<const vm::Profile> profile) {
+		return std::make_unique<ProfileUsePass>(std::move(profile));
+	}
+}
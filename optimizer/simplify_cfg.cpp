@@ -0,0 +1,69 @@
+#include "optimizer/passes.h"
+
+#include <algorithm>
+
+namespace cc0 {
+
+	namespace {
+
+		// 块 b 只有一个后继 t, 且 t 只有 b 一个前驱时, 把 t 接到 b 的后面
+		class SimplifyCfgPass final : public Pass {
+		public:
+			const char* Name() const override { return "simplify-cfg"; }
+			int Level() const override { return 1; }
+			bool Run(IRModule& m, PassStatistics& stats) override {
+				bool changed = runOn(m.start, stats);
+				for (auto& f : m.functions)
+					changed = runOn(f, stats) || changed;
+				return changed;
+			}
+		private:
+			bool runOn(IRFunction& f, PassStatistics& stats) {
+				if (f.unbalanced)
+					return false;
+				auto preds = f.Predecessors();
+				bool changed = false;
+				for (auto b : f.layout) {
+					auto& block = f.blocks[b];
+					if (block.dead)
+						continue;
+					while (true) {
+						// 唯一的后继
+						auto t = block.Terminator();
+						std::int32_t succ = -1;
+						if (t == nullptr)
+							succ = block.next;
+						else if (t->GetOperation() == Operation::JMP)
+							succ = t->GetX();
+						if (succ < 0 || succ == b || succ == f.layout.front() || preds[succ].size() != 1)
+							break;
+						auto& merged = f.blocks[succ];
+						// 落出函数末尾的块要留在最后
+						if (merged.Terminator() == nullptr && merged.next < 0)
+							break;
+						if (t != nullptr) {
+							block.code.pop_back();
+							stats.Add("jumps removed");
+						}
+						block.code.insert(block.code.end(), merged.code.begin(), merged.code.end());
+						block.next = merged.next;
+						block.taken = merged.taken;
+						for (auto s : merged.Successors())
+							std::replace(preds[s].begin(), preds[s].end(), succ, b);
+						merged.code.clear();
+						merged.next = -1;
+						merged.dead = true;
+						stats.Add("blocks merged");
+						changed = true;
+					}
+				}
+				f.CompactLayout();
+				return changed;
+			}
+		};
+	}
+
+	std::unique_ptr<Pass> CreateSimplifyCfgPass() {
+		return std::make_unique<SimplifyCfgPass>();
+	}
+}
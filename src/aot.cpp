@@ -0,0 +1,863 @@
+#include "./aot.h"
+#include "./type.h"
+#include "./opcode.h"
+#include "./instruction.h"
+#include "./constant.h"
+#include "./function.h"
+#include "./exception.h"
+#include "./util/print.hpp"
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace vm {
+
+namespace {
+
+// types, memory and helper macros, same layout and limits as vm.cpp
+const char* const runtimeHead = R"(/* cc -O2 program.c -o program -lm -pthread */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_STACK_ADDR 0x00ffffff
+#define MIN_HEAP_ADDR  0x01000000
+#define MAX_HEAP_ADDR  0x01ffffff
+
+static int32_t S[MAX_STACK_ADDR];
+static int32_t H[MAX_HEAP_ADDR - MIN_HEAP_ADDR];
+static int32_t rt_sp;
+
+typedef struct { int32_t first, count; } rt_record;
+static rt_record* rt_heap;
+static size_t rt_heapCount, rt_heapCapacity;
+
+/* one context of the VM */
+typedef struct rt_frame {
+    const struct rt_frame* prev;
+    const struct rt_frame* link;
+    int fn;        /* -1 for .start of the program or of a task */
+    int task;
+    int level;
+    int depth;     /* contexts of the task up to this one */
+    int32_t bp;
+    int32_t pc;
+} rt_frame;
+static const rt_frame* rt_top;
+/* every call is a C call: the C stack starts at rt_stackBase and may grow down by rt_stackSize */
+static const char* rt_stackBase;
+static size_t rt_stackSize;
+#define RT_STACK_MARGIN ((size_t)1 << 20)
+
+typedef struct { int fn; int32_t* params; int32_t count; int joined; } rt_task;
+static rt_task* rt_tasks;
+static int32_t rt_tasksCount, rt_tasksCapacity;
+
+static _Noreturn void rt_fail(const char* msg);
+static int32_t* rt_addr(int32_t addr, int32_t count, int32_t sp);
+
+#define FAIL(k, msg)  (fr.pc = (k), rt_fail(msg))
+#define REST(k, n)    do { if (sp + (n) > MAX_STACK_ADDR) FAIL(k, "stack overflow"); } while (0)
+#define USED(k, n)    do { if (bp + (n) > sp) FAIL(k, "tried to modify important stack info"); } while (0)
+#define ADDR(k, a, n) (((uint32_t)(a) < (uint32_t)sp && (n) <= sp - (a)) ? S + (a) : (fr.pc = (k), rt_addr((a), (n), sp)))
+
+static inline double rt_getd(const int32_t* p) { double d; memcpy(&d, p, sizeof d); return d; }
+static inline void rt_setd(int32_t* p, double d) { memcpy(p, &d, sizeof d); }
+)";
+
+// checks, tasks and error reporting, after the tables of the program
+const char* const runtimeBody = R"(
+static const char* rt_text(const rt_frame* f, int32_t pc) {
+    static char call[32];
+    if (f->fn >= 0) {
+        return rt_texts[f->fn][pc];
+    }
+    if (f->task) {
+        snprintf(call, sizeof call, "call %d", f->task - 1);
+        return call;
+    }
+    return rt_startText[pc];
+}
+
+static int32_t rt_size(const rt_frame* f) {
+    return f->fn >= 0 ? rt_sizes[f->fn] : f->task ? 1 : rt_startSize;
+}
+
+static const char* rt_name(const rt_frame* f) {
+    return f->fn >= 0 ? rt_names[f->fn] : "__START__";
+}
+
+/* the message and stack trace VM::run prints, a task adds its own trace to the message */
+static _Noreturn void rt_fail(const char* msg) {
+    const rt_frame* f = rt_top;
+    fflush(stdout);
+    fprintf(stderr, "runtime error: %s", msg);
+    while (1) {
+        const rt_frame* bottom = f;
+        while (bottom->fn != -1) {
+            bottom = bottom->prev;
+        }
+        fputs(bottom->task ? " in spawned task\n" : " !\noccurred at:\n", stderr);
+        if (f->pc >= rt_size(f)) {
+            fprintf(stderr, "          control reaches the end of function %s without return", rt_name(f));
+        }
+        else {
+            fprintf(stderr, "          function %s at instruction %d : %s", rt_name(f), f->pc, rt_text(f, f->pc));
+        }
+        while (f != bottom) {
+            f = f->prev;
+            if (f->fn == -1) {
+                fprintf(stderr, "\ncalled by .start at instruction %d : %s", f->pc, rt_text(f, f->pc));
+            }
+            else {
+                fprintf(stderr, "\ncalled by function %s at instruction %d : %s", rt_name(f), f->pc, rt_text(f, f->pc));
+            }
+        }
+        if (!bottom->task) {
+            fputs("\n", stderr);
+            break;
+        }
+        f = bottom->prev;
+    }
+    exit(1);
+}
+
+/* the ranges are checked as count > limit - addr, since addr + count may overflow */
+static int32_t* rt_addr(int32_t addr, int32_t count, int32_t sp) {
+    size_t i;
+    if (count < 0) {
+        rt_fail("tried to access a negative range of memory");
+    }
+    if (0 <= addr && addr < sp) {
+        if (count > sp - addr) {
+            rt_fail("tried to access unused stack memory");
+        }
+        return S + addr;
+    }
+    if (MIN_HEAP_ADDR <= addr && addr < MAX_HEAP_ADDR) {
+        for (i = 0; i < rt_heapCount; ++i) {
+            if (rt_heap[i].first <= addr && count <= rt_heap[i].first + rt_heap[i].count - addr) {
+                return H + (addr - MIN_HEAP_ADDR);
+            }
+        }
+        rt_fail("tried to access unused or constant heap memory");
+    }
+    rt_fail("tried to access unexistent memory");
+}
+
+static int32_t rt_new(int32_t count) {
+    int32_t st = MIN_HEAP_ADDR;
+    if (rt_heapCount) {
+        st = rt_heap[rt_heapCount - 1].first + rt_heap[rt_heapCount - 1].count;
+    }
+    if (st + count >= MAX_HEAP_ADDR) {
+        rt_fail("heap overflow");
+    }
+    if (rt_heapCount == rt_heapCapacity) {
+        rt_heapCapacity = rt_heapCapacity ? 2 * rt_heapCapacity : 16;
+        rt_heap = realloc(rt_heap, rt_heapCapacity * sizeof *rt_heap);
+    }
+    rt_heap[rt_heapCount].first = st;
+    rt_heap[rt_heapCount].count = count;
+    ++rt_heapCount;
+    return st;
+}
+
+/* what CALL checks before the callee gets its context */
+static void rt_enter(rt_frame* f, int fn, int level, int32_t params, int64_t need) {
+    const rt_frame* caller = rt_top;
+    const rt_frame* link = caller;
+    if (level <= caller->level) {
+        int l;
+        link = caller->link;
+        for (l = caller->level; l > level; --l) {
+            link = link->link;
+        }
+    }
+    else if (level != caller->level + 1) {
+        rt_fail("invalid control transfer");
+    }
+    if (caller->bp + params > rt_sp) {
+        rt_fail("tried to modify important stack info");
+    }
+    if (need >= 0 && need > (int64_t)MAX_STACK_ADDR - rt_sp) {
+        static char msg[256];
+        snprintf(msg, sizeof msg, "stack overflow: calling %s at call depth %d needs %lld slots, %lld left",
+            rt_names[fn], caller->depth, (long long)need, (long long)MAX_STACK_ADDR - rt_sp);
+        rt_fail(msg);
+    }
+    /* the slots may outlast the C stack when the frames of the C functions are large */
+    if ((size_t)(rt_stackBase - (const char*)f) > rt_stackSize - RT_STACK_MARGIN) {
+        static char msg[256];
+        snprintf(msg, sizeof msg, "stack overflow: calling %s at call depth %d exceeds the native stack",
+            rt_names[fn], caller->depth);
+        rt_fail(msg);
+    }
+    f->prev = caller;
+    f->link = link;
+    f->fn = fn;
+    f->task = 0;
+    f->level = level;
+    f->depth = caller->depth + 1;
+    f->bp = rt_sp - params;
+    f->pc = 0;
+    rt_top = f;
+}
+
+static inline int32_t rt_spawn(int fn, const int32_t* params, int32_t count) {
+    rt_task* t;
+    if (rt_tasksCount == rt_tasksCapacity) {
+        rt_tasksCapacity = rt_tasksCapacity ? 2 * rt_tasksCapacity : 16;
+        rt_tasks = realloc(rt_tasks, rt_tasksCapacity * sizeof *rt_tasks);
+    }
+    t = &rt_tasks[rt_tasksCount++];
+    t->fn = fn;
+    t->count = count;
+    t->joined = 0;
+    t->params = malloc((count ? count : 1) * sizeof(int32_t));
+    memcpy(t->params, params, count * sizeof(int32_t));
+    return rt_tasksCount;
+}
+
+/* runs the task above the joiner's stack, as its own .start */
+static inline int32_t rt_join(int32_t handle) {
+    rt_frame fr;
+    rt_task* t;
+    int32_t base = rt_sp;
+    int32_t result = 0;
+    if (handle < 1 || handle > rt_tasksCount || rt_tasks[handle - 1].joined) {
+        rt_fail("invalid task handle");
+    }
+    t = &rt_tasks[handle - 1];
+    t->joined = 1;
+    fr.prev = rt_top;
+    fr.link = &fr;
+    fr.fn = -1;
+    fr.task = t->fn + 1;
+    fr.level = 0;
+    fr.depth = 1;
+    fr.bp = 0;
+    fr.pc = 0;
+    rt_top = &fr;
+    if (base + t->count > MAX_STACK_ADDR) {
+        rt_fail("stack overflow");
+    }
+    memcpy(S + base, t->params, t->count * sizeof(int32_t));
+    rt_sp = base + t->count;
+    free(t->params);
+    t->params = NULL;
+    rt_functions[t->fn]();
+    if (rt_sp > base) {
+        result = S[rt_sp - 1];
+    }
+    rt_sp = base;
+    rt_top = fr.prev;
+    return result;
+}
+
+static void rt_drain(void) {
+    int32_t handle;
+    for (handle = 1; handle <= rt_tasksCount; ++handle) {
+        if (!rt_tasks[handle - 1].joined) {
+            rt_join(handle);
+        }
+    }
+}
+
+static inline int32_t rt_scani(int32_t k, rt_frame* f) {
+    int v;
+    fflush(stdout);
+    if (scanf("%d", &v) != 1) {
+        f->pc = k;
+        rt_fail("I/O error");
+    }
+    return v;
+}
+
+static inline double rt_scand(int32_t k, rt_frame* f) {
+    double v;
+    fflush(stdout);
+    if (scanf("%lf", &v) != 1) {
+        f->pc = k;
+        rt_fail("I/O error");
+    }
+    return v;
+}
+
+static inline int32_t rt_scanc(int32_t k, rt_frame* f) {
+    unsigned char v;
+    fflush(stdout);
+    if (scanf(" %c", &v) != 1) {
+        f->pc = k;
+        rt_fail("I/O error");
+    }
+    return v;
+}
+
+static inline int32_t rt_dcmp(double lhs, double rhs) {
+    if (isnan(lhs) || isnan(rhs)) {
+        return 0;
+    }
+    if (isinf(lhs) && isinf(rhs) && lhs * rhs > 0) {
+        return 0;
+    }
+    return lhs > rhs ? 1 : lhs < rhs ? -1 : 0;
+}
+)";
+
+std::string quote(const std::string& s) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char ch : s) {
+        if (('0' <= ch && ch <= '9') || ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ch == ' ' || ch == '_') {
+            out << ch;
+        }
+        else {
+            // octal escapes never swallow the following character
+            out << '\\' << static_cast<char>('0' + (ch >> 6)) << static_cast<char>('0' + ((ch >> 3) & 7)) << static_cast<char>('0' + (ch & 7));
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+std::string textOf(const Instruction& ins) {
+    std::ostringstream out;
+    print(out, ins);
+    return out.str();
+}
+
+class CTranslator {
+public:
+    CTranslator(const File& file, std::ostream& out) : _file(file), _out(out) {}
+
+    void translate() {
+        // the same two instructions make_vm appends to .start
+        std::vector<Instruction> start = _file.start;
+        u4 mainIndex = 0;
+        for (; mainIndex < _file.functions.size(); ++mainIndex) {
+            if (nameOf(_file.functions[mainIndex]) == "main") {
+                break;
+            }
+        }
+        if (mainIndex == _file.functions.size()) {
+            throw InvalidFile("main not found");
+        }
+        start.push_back(Instruction{OpCode::snew, _file.functions[mainIndex].paramSize, 0});
+        start.push_back(Instruction{OpCode::call, mainIndex, 0});
+
+        _out << runtimeHead << "\n";
+        for (size_t i = 0; i < _file.functions.size(); ++i) {
+            _out << "static void F" << i << "(void);\n";
+        }
+        outputTables(start);
+        _out << runtimeBody << "\n";
+        outputStrings();
+        for (size_t i = 0; i < _file.functions.size(); ++i) {
+            outputFunction(static_cast<int>(i));
+        }
+        outputStart(start);
+        outputMain();
+    }
+
+private:
+    std::string nameOf(const Function& fun) {
+        auto& constant = _file.constants.at(fun.nameIndex);
+        if (constant.type != Constant::Type::STRING) {
+            throw InvalidFile("function name not found");
+        }
+        return std::get<str_t>(constant.value);
+    }
+
+    void outputTexts(const std::string& name, const std::vector<Instruction>& code) {
+        _out << "static const char* const " << name << "[] = {";
+        for (auto& ins : code) {
+            _out << "\n    " << quote(textOf(ins)) << ",";
+        }
+        if (code.empty()) {
+            _out << " 0";
+        }
+        _out << "\n};\n";
+    }
+
+    void outputTables(const std::vector<Instruction>& start) {
+        auto& functions = _file.functions;
+        _out << "\nstatic void (* const rt_functions[])(void) = {";
+        for (size_t i = 0; i < functions.size(); ++i) {
+            _out << " F" << i << ",";
+        }
+        _out << " 0 };\n";
+        _out << "static const char* const rt_names[] = {";
+        for (auto& fun : functions) {
+            _out << " " << quote(nameOf(fun)) << ",";
+        }
+        _out << " 0 };\n";
+        _out << "static const int32_t rt_sizes[] = {";
+        for (auto& fun : functions) {
+            _out << " " << fun.instructions.size() << ",";
+        }
+        _out << " 0 };\n";
+        for (size_t i = 0; i < functions.size(); ++i) {
+            outputTexts("rt_text" + std::to_string(i), functions[i].instructions);
+        }
+        _out << "static const char* const* const rt_texts[] = {";
+        for (size_t i = 0; i < functions.size(); ++i) {
+            _out << " rt_text" << i << ",";
+        }
+        _out << " 0 };\n";
+        outputTexts("rt_startText", start);
+        _out << "static const int32_t rt_startSize = " << start.size() << ";\n";
+    }
+
+    void outputStrings() {
+        // string literals, placed on the heap in the order buildStringLiteralPool uses
+        _out << "static int32_t rt_strings[" << (_file.constants.size() + 1) << "];\n";
+        _out << "static void rt_buildStrings(void) {\n";
+        for (size_t i = 0; i < _file.constants.size(); ++i) {
+            auto& constant = _file.constants[i];
+            if (constant.type != Constant::Type::STRING) {
+                continue;
+            }
+            auto& str = std::get<str_t>(constant.value);
+            _out << "    rt_strings[" << i << "] = rt_new(" << str.length() + 1 << ");\n";
+            _out << "    { static const char s[] = " << quote(str) << "; int32_t i;\n";
+            _out << "      for (i = 0; i <= " << str.length() << "; ++i) H[rt_strings[" << i << "] - MIN_HEAP_ADDR + i] = (unsigned char)s[i]; }\n";
+        }
+        _out << "}\n";
+    }
+
+    void outputFunction(int index) {
+        auto& fun = _file.functions.at(index);
+        bool checked = fun.maxDepth == Function::UNBOUNDED;
+        long long need = checked ? -1 : static_cast<long long>(fun.maxDepth) - fun.paramSize;
+        _out << "\n/* " << nameOf(fun) << " */\n";
+        _out << "static void F" << index << "(void) {\n";
+        _out << "    rt_frame fr;\n";
+        _out << "    int32_t sp, bp;\n";
+        _out << "    rt_enter(&fr, " << index << ", " << fun.level << ", " << fun.paramSize << ", " << need << ");\n";
+        _out << "    sp = rt_sp;\n";
+        _out << "    bp = fr.bp;\n";
+        _out << "    (void)bp;\n";
+        outputCode(fun.instructions, checked, false);
+        _out << "    fr.pc = " << fun.instructions.size() << ";\n";
+        _out << "    rt_fail(\"invalid control transfer\");\n";
+        _out << "}\n";
+    }
+
+    void outputStart(const std::vector<Instruction>& start) {
+        _out << "\nstatic void rt_start(void) {\n";
+        _out << "    rt_frame fr;\n";
+        _out << "    int32_t sp = 0, bp = 0;\n";
+        _out << "    fr.prev = 0;\n";
+        _out << "    fr.link = &fr;\n";
+        _out << "    fr.fn = -1;\n";
+        _out << "    fr.task = 0;\n";
+        _out << "    fr.level = 0;\n";
+        _out << "    fr.depth = 1;\n";
+        _out << "    fr.bp = 0;\n";
+        _out << "    fr.pc = 0;\n";
+        _out << "    rt_top = &fr;\n";
+        outputCode(start, true, true);
+        _out << "    fr.pc = " << start.size() << ";\n";
+        _out << "    rt_sp = sp;\n";
+        _out << "    rt_drain();\n";
+        _out << "    (void)bp;\n";
+        _out << "}\n";
+    }
+
+    void outputMain() {
+        // every call is a C call, so deep recursion needs far more than the default stack:
+        // a call takes at least one slot, the stack is sized for MAX_STACK_ADDR calls of 256 bytes
+        // when the system allows it, so the slots usually run out first as in the VM
+        _out << "\nstatic void* rt_run(void* arg) {\n";
+        _out << "    char base;\n";
+        _out << "    rt_stackBase = &base;\n";
+        _out << "    rt_start();\n";
+        _out << "    return arg;\n";
+        _out << "}\n";
+        _out << "\nint main(void) {\n";
+        _out << "    pthread_attr_t attr;\n";
+        _out << "    pthread_t thread;\n";
+        _out << "    int started = 0;\n";
+        _out << "    rt_buildStrings();\n";
+        _out << "    for (rt_stackSize = (size_t)MAX_STACK_ADDR * 256; !started && rt_stackSize >= ((size_t)1 << 28); ) {\n";
+        _out << "        pthread_attr_init(&attr);\n";
+        _out << "        if (pthread_attr_setstacksize(&attr, rt_stackSize) == 0 && pthread_create(&thread, &attr, rt_run, 0) == 0) {\n";
+        _out << "            pthread_join(thread, 0);\n";
+        _out << "            started = 1;\n";
+        _out << "        }\n";
+        _out << "        else {\n";
+        _out << "            rt_stackSize /= 2;\n";
+        _out << "        }\n";
+        _out << "        pthread_attr_destroy(&attr);\n";
+        _out << "    }\n";
+        _out << "    if (!started) {\n";
+        _out << "        rt_stackSize = (size_t)8 << 20;\n";
+        _out << "        rt_run(0);\n";
+        _out << "    }\n";
+        _out << "    fflush(stdout);\n";
+        _out << "    return 0;\n";
+        _out << "}\n";
+    }
+
+    void outputCode(const std::vector<Instruction>& code, bool checked, bool isStart) {
+        std::set<u2> targets;
+        for (auto& ins : code) {
+            switch (ins.op) {
+            case OpCode::jmp: case OpCode::je:  case OpCode::jne:
+            case OpCode::jl:  case OpCode::jge: case OpCode::jg: case OpCode::jle:
+                targets.insert(static_cast<u2>(ins.x));
+                break;
+            default:
+                break;
+            }
+        }
+        for (size_t k = 0; k < code.size(); ++k) {
+            if (targets.count(static_cast<u2>(k))) {
+                _out << "L" << k << ":\n";
+            }
+            _out << "    /* " << k << " " << textOf(code[k]) << " */\n";
+            outputInstruction(code[k], static_cast<int>(k), code.size(), checked, isStart);
+        }
+    }
+
+    void outputInstruction(const Instruction& ins, int k, size_t size, bool checked, bool isStart) {
+        std::ostream& o = _out;
+        const auto used = [&](int n) {
+            if (checked) {
+                o << "    USED(" << k << ", " << n << ");\n";
+            }
+        };
+        const auto rest = [&](const std::string& n) {
+            if (checked) {
+                o << "    REST(" << k << ", " << n << ");\n";
+            }
+        };
+        const auto fail = [&](const char* msg) {
+            o << "    FAIL(" << k << ", \"" << msg << "\");\n";
+        };
+        const auto binary = [&](const char* expr) {
+            used(2);
+            o << "    { uint32_t r = (uint32_t)S[--sp], l = (uint32_t)S[--sp]; S[sp++] = (int32_t)(" << expr << "); }\n";
+        };
+        const auto binaryd = [&](const char* expr) {
+            used(4);
+            o << "    { double r, l; sp -= 2; r = rt_getd(S + sp); sp -= 2; l = rt_getd(S + sp); rt_setd(S + sp, " << expr << "); sp += 2; }\n";
+        };
+        const auto jump = [&](const char* cond) {
+            u2 target = static_cast<u2>(ins.x);
+            if (cond) {
+                used(1);
+                o << "    if (S[--sp] " << cond << ") ";
+            }
+            else {
+                o << "    ";
+            }
+            if (target >= size) {
+                o << "FAIL(" << k << ", \"invalid control transfer\");\n";
+            }
+            else {
+                o << "goto L" << target << ";\n";
+            }
+        };
+        const auto callCheck = [&](u2 index) {
+            if (index >= _file.functions.size()) {
+                fail("invalid control transfer");
+                return false;
+            }
+            return true;
+        };
+        int32_t x = static_cast<int32_t>(ins.x);
+        int32_t y = static_cast<int32_t>(ins.y);
+
+        switch (ins.op) {
+        case OpCode::nop: break;
+        case OpCode::bipush:
+        case OpCode::ipush:
+            rest("1");
+            o << "    S[sp++] = " << x << ";\n";
+            break;
+        case OpCode::pop:  used(1); o << "    sp -= 1;\n"; break;
+        case OpCode::pop2: used(2); o << "    sp -= 2;\n"; break;
+        case OpCode::popn:
+            if (checked) {
+                o << "    USED(" << k << ", " << x << ");\n";
+            }
+            o << "    sp -= " << x << ";\n";
+            break;
+        case OpCode::dup:
+            used(1); rest("1");
+            o << "    S[sp] = S[sp - 1]; sp += 1;\n";
+            break;
+        case OpCode::dup2:
+            used(2); rest("2");
+            o << "    S[sp] = S[sp - 2]; S[sp + 1] = S[sp - 1]; sp += 2;\n";
+            break;
+        case OpCode::loadc: {
+            u2 index = static_cast<u2>(ins.x);
+            if (index >= _file.constants.size()) {
+                fail("invalid instruction");
+                break;
+            }
+            auto& constant = _file.constants[index];
+            switch (constant.type) {
+            case Constant::Type::STRING:
+                rest("1");
+                o << "    S[sp++] = rt_strings[" << index << "];\n";
+                break;
+            case Constant::Type::INT:
+                rest("1");
+                o << "    S[sp++] = " << std::get<int_t>(constant.value) << ";\n";
+                break;
+            case Constant::Type::DOUBLE: {
+                union { double_t d; u8 bits; } v;
+                v.d = std::get<double_t>(constant.value);
+                rest("2");
+                o << "    { uint64_t b = " << v.bits << "ULL; memcpy(S + sp, &b, sizeof b); sp += 2; }\n";
+            } break;
+            default:
+                fail("invalid instruction");
+                break;
+            }
+        } break;
+        case OpCode::loada: {
+            u2 levelDiff = static_cast<u2>(ins.x);
+            rest("1");
+            if (levelDiff == 0) {
+                o << "    S[sp++] = bp + " << y << ";\n";
+            }
+            else {
+                o << "    { const rt_frame* f = &fr; int l; for (l = 0; l < " << levelDiff << "; ++l) f = f->link; S[sp++] = f->bp + " << y << "; }\n";
+            }
+        } break;
+        case OpCode::_new:
+            used(1);
+            o << "    fr.pc = " << k << "; S[sp - 1] = rt_new(S[sp - 1]);\n";
+            break;
+        case OpCode::snew:
+            rest(std::to_string(x));
+            o << "    sp += " << x << ";\n";
+            break;
+        case OpCode::iinc:
+            o << "    { int32_t a = bp + " << x << "; *ADDR(" << k << ", a, 1) += " << y << "; }\n";
+            break;
+        case OpCode::iincs:
+            used(1);
+            o << "    { int32_t v = S[--sp]; int32_t a = bp + " << x << "; *ADDR(" << k << ", a, 1) += v; }\n";
+            break;
+
+        case OpCode::iload:
+        case OpCode::aload:
+            used(1);
+            o << "    { int32_t a = S[--sp]; int32_t v = *ADDR(" << k << ", a, 1);\n";
+            rest("1");
+            o << "      S[sp++] = v; }\n";
+            break;
+        case OpCode::dload:
+            used(1);
+            o << "    { int32_t a = S[--sp]; double v = rt_getd(ADDR(" << k << ", a, 2));\n";
+            rest("2");
+            o << "      rt_setd(S + sp, v); sp += 2; }\n";
+            break;
+        case OpCode::iaload:
+        case OpCode::aaload:
+            used(2);
+            o << "    { int32_t a = S[--sp]; int32_t v; a += S[--sp]; v = *ADDR(" << k << ", a, 1);\n";
+            rest("1");
+            o << "      S[sp++] = v; }\n";
+            break;
+        case OpCode::daload:
+            used(2);
+            o << "    { int32_t a = 2 * S[--sp]; double v; a += S[--sp]; v = rt_getd(ADDR(" << k << ", a, 2));\n";
+            rest("2");
+            o << "      rt_setd(S + sp, v); sp += 2; }\n";
+            break;
+
+        case OpCode::istore:
+        case OpCode::astore:
+            used(2);
+            o << "    { int32_t v = S[--sp]; int32_t a = S[--sp]; *ADDR(" << k << ", a, 1) = v; }\n";
+            break;
+        case OpCode::dstore:
+            used(3);
+            o << "    { double v; int32_t a; sp -= 2; v = rt_getd(S + sp); a = S[--sp]; rt_setd(ADDR(" << k << ", a, 2), v); }\n";
+            break;
+        case OpCode::iastore:
+        case OpCode::aastore:
+            used(3);
+            o << "    { int32_t v = S[--sp]; int32_t a = S[--sp]; a += S[--sp]; *ADDR(" << k << ", a, 1) = v; }\n";
+            break;
+        case OpCode::dastore:
+            used(4);
+            o << "    { double v; int32_t a; sp -= 2; v = rt_getd(S + sp); a = 2 * S[--sp]; a += S[--sp]; rt_setd(ADDR(" << k << ", a, 2), v); }\n";
+            break;
+        case OpCode::iafill:
+            used(3);
+            o << "    { int32_t v = S[--sp]; int32_t n = S[--sp]; int32_t a = S[--sp];\n";
+            o << "      if (n < 0) FAIL(" << k << ", \"negative array length\");\n";
+            o << "      if (n > 0) { int32_t* p = ADDR(" << k << ", a, n); int32_t i; for (i = 0; i < n; ++i) p[i] = v; } }\n";
+            break;
+        case OpCode::iacopy:
+            used(3);
+            o << "    { int32_t n = S[--sp]; int32_t src = S[--sp]; int32_t dst = S[--sp];\n";
+            o << "      if (n < 0) FAIL(" << k << ", \"negative array length\");\n";
+            o << "      if (n > 0) { int32_t* from = ADDR(" << k << ", src, n); int32_t* to = ADDR(" << k << ", dst, n); memmove(to, from, n * sizeof(int32_t)); } }\n";
+            break;
+        case OpCode::iacmp:
+            used(3);
+            o << "    { int32_t n = S[--sp]; int32_t rhs = S[--sp]; int32_t lhs = S[--sp]; int32_t c = 0;\n";
+            o << "      if (n < 0) FAIL(" << k << ", \"negative array length\");\n";
+            o << "      if (n > 0) { int32_t* l = ADDR(" << k << ", lhs, n); int32_t* r = ADDR(" << k << ", rhs, n); int32_t i;\n";
+            o << "        for (i = 0; i < n; ++i) if (l[i] != r[i]) { c = l[i] < r[i] ? -1 : 1; break; } }\n";
+            o << "      S[sp++] = c; }\n";
+            break;
+        case OpCode::iachk:
+            used(2);
+            o << "    { int32_t n = S[--sp]; if (S[sp - 1] < 0 || S[sp - 1] >= n) FAIL(" << k << ", \"array index out of range\"); }\n";
+            break;
+
+        case OpCode::iadd: binary("l + r"); break;
+        case OpCode::isub: binary("l - r"); break;
+        case OpCode::imul: binary("l * r"); break;
+        case OpCode::idiv:
+            used(2);
+            o << "    { int32_t r = S[--sp], l = S[--sp]; if (r == 0) FAIL(" << k << ", \"divide integer by zero\");\n";
+            o << "      if (r == -1 && l == INT32_MIN) FAIL(" << k << ", \"integer division overflow\"); S[sp++] = l / r; }\n";
+            break;
+        case OpCode::dadd: binaryd("l + r"); break;
+        case OpCode::dsub: binaryd("l - r"); break;
+        case OpCode::dmul: binaryd("l * r"); break;
+        case OpCode::ddiv: binaryd("l / r"); break;
+        case OpCode::ineg:
+            used(1);
+            o << "    S[sp - 1] = (int32_t)(0u - (uint32_t)S[sp - 1]);\n";
+            break;
+        case OpCode::dneg:
+            used(2);
+            o << "    rt_setd(S + sp - 2, -rt_getd(S + sp - 2));\n";
+            break;
+        case OpCode::icmp:
+            used(2);
+            o << "    { int32_t r = S[--sp], l = S[--sp]; S[sp++] = l > r ? 1 : l < r ? -1 : 0; }\n";
+            break;
+        case OpCode::dcmp:
+            used(4);
+            o << "    { double r, l; sp -= 2; r = rt_getd(S + sp); sp -= 2; l = rt_getd(S + sp); S[sp++] = rt_dcmp(l, r); }\n";
+            break;
+
+        case OpCode::i2d:
+            used(1);
+            o << "    { double v = S[--sp];\n";
+            rest("2");
+            o << "      rt_setd(S + sp, v); sp += 2; }\n";
+            break;
+        case OpCode::d2i:
+            used(2);
+            o << "    { double v; sp -= 2; v = rt_getd(S + sp); S[sp++] = (int32_t)v; }\n";
+            break;
+        case OpCode::i2c:
+            used(1);
+            o << "    S[sp - 1] &= 0xff;\n";
+            break;
+
+        case OpCode::jmp: jump(nullptr); break;
+        case OpCode::je:  jump("== 0"); break;
+        case OpCode::jne: jump("!= 0"); break;
+        case OpCode::jl:  jump("< 0");  break;
+        case OpCode::jge: jump(">= 0"); break;
+        case OpCode::jg:  jump("> 0");  break;
+        case OpCode::jle: jump("<= 0"); break;
+
+        case OpCode::call: {
+            u2 index = static_cast<u2>(ins.x);
+            if (callCheck(index)) {
+                o << "    fr.pc = " << k << "; rt_sp = sp; F" << index << "(); sp = rt_sp;\n";
+            }
+        } break;
+        case OpCode::spawn: {
+            u2 index = static_cast<u2>(ins.x);
+            if (callCheck(index)) {
+                int n = _file.functions[index].paramSize;
+                used(n);
+                o << "    { int32_t h = rt_spawn(" << index << ", S + sp - " << n << ", " << n << "); sp -= " << n << ";\n";
+                rest("1");
+                o << "      S[sp++] = h; }\n";
+            }
+        } break;
+        case OpCode::join:
+            used(1);
+            o << "    fr.pc = " << k << "; rt_sp = sp - 1; S[sp - 1] = rt_join(S[sp - 1]);\n";
+            break;
+        case OpCode::ret:
+        case OpCode::iret:
+        case OpCode::aret:
+        case OpCode::dret: {
+            if (isStart) {
+                fail("invalid control transfer");
+                break;
+            }
+            int n = ins.op == OpCode::ret ? 0 : ins.op == OpCode::dret ? 2 : 1;
+            used(n);
+            o << "    rt_top = fr.prev;";
+            if (n) {
+                o << " memmove(S + bp, S + sp - " << n << ", " << n << " * sizeof(int32_t));";
+            }
+            o << " rt_sp = bp + " << n << "; return;\n";
+        } break;
+
+        case OpCode::iprint:
+            used(1);
+            o << "    printf(\"%d\", S[--sp]);\n";
+            break;
+        case OpCode::dprint:
+            used(2);
+            o << "    sp -= 2; printf(\"%f\", rt_getd(S + sp));\n";
+            break;
+        case OpCode::cprint:
+            used(1);
+            o << "    putchar((unsigned char)S[--sp]);\n";
+            break;
+        case OpCode::sprint:
+            used(1);
+            o << "    { int32_t a = S[--sp]; unsigned char ch; while ((ch = 0xff & *ADDR(" << k << ", a, 1)) != 0) { putchar(ch); ++a; } }\n";
+            break;
+        case OpCode::printl:
+            o << "    putchar('\\n'); fflush(stdout);\n";
+            break;
+        case OpCode::iscan:
+            o << "    { int32_t v = rt_scani(" << k << ", &fr);\n";
+            rest("1");
+            o << "      S[sp++] = v; }\n";
+            break;
+        case OpCode::dscan:
+            o << "    { double v = rt_scand(" << k << ", &fr);\n";
+            rest("2");
+            o << "      rt_setd(S + sp, v); sp += 2; }\n";
+            break;
+        case OpCode::cscan:
+            o << "    { int32_t v = rt_scanc(" << k << ", &fr);\n";
+            rest("1");
+            o << "      S[sp++] = v; }\n";
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    const File& _file;
+    std::ostream& _out;
+};
+
+}
+
+void translateToC(const File& file, std::ostream& out) {
+    CTranslator(file, out).translate();
+}
+
+}
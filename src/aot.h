@@ -0,0 +1,21 @@
+#ifndef AOT_H_INCLUDED
+#define AOT_H_INCLUDED
+
+#include "./file.h"
+
+#include <iostream>
+
+namespace vm {
+
+// Translates the program into one standalone C translation unit.
+//
+// Every function becomes a C function working on an explicit slot array
+// with the same addresses as the VM, jumps become gotos. The runtime checks,
+// their messages and the stack traces are those of the VM, so a program
+// prints the same when interpreted and when compiled by a C compiler.
+// Spawned tasks are run by the thread that joins them.
+void translateToC(const File& file, std::ostream& out);
+
+}
+
+#endif
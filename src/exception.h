@@ -38,11 +38,14 @@ private:
 
 class StackOverflow : public std::exception {
 public:
-    StackOverflow() {}
+    StackOverflow() : msg("stack overflow") {}
+    StackOverflow(std::string msg) : msg(std::move(msg)) {}
     virtual ~StackOverflow() {}
     virtual const char* what() const noexcept {
-        return "stack overflow";
+        return msg.c_str();
     }
+private:
+    std::string msg;
 };
 
 class HeapOverflow : public std::exception {
@@ -72,6 +75,24 @@ public:
     }
 };
 
+class DivideOverflow : public std::exception {
+public:
+    DivideOverflow() {}
+    virtual ~DivideOverflow() {}
+    virtual const char* what() const noexcept {
+        return "integer division overflow";
+    }
+};
+
+class ArrayIndexOutOfRange : public std::exception {
+public:
+    ArrayIndexOutOfRange() {}
+    virtual ~ArrayIndexOutOfRange() {}
+    virtual const char* what() const noexcept {
+        return "array index out of range";
+    }
+};
+
 class InvalidControlTransfer : public std::exception {
 public:
     InvalidControlTransfer() {}
@@ -81,6 +102,17 @@ public:
     }
 };
 
+class TaskError : public std::exception {
+public:
+    TaskError(std::string msg) : msg(std::move(msg)) {}
+    virtual ~TaskError() {}
+    virtual const char* what() const noexcept {
+        return msg.c_str();
+    }
+private:
+    std::string msg;
+};
+
 class IOError : public std::exception {
 public:
     IOError() {}
@@ -44,7 +44,8 @@ void File::output_text(std::ostream& out) {
     for (auto& fun : functions) {
         std::string name = std::get<std::string>(constants.at(fun.nameIndex).value);
         names.push_back(name);
-        println(out, i++, fun.nameIndex, fun.paramSize, fun.level, "#", name);
+        // the name is only given on the header of the code below, parse_file_text takes no comments here
+        println(out, i++, fun.nameIndex, fun.paramSize, fun.level, fun.frameSize);
     }
     
     i = 0;
@@ -73,7 +74,7 @@ void File::output_binary(std::ofstream& out) {
     // magic
     out.write("\x43\x30\x3A\x29", 4);
     // version
-    out.write("\x00\x00\x00\x01", 4);
+    out.write("\x00\x00\x00\x02", 4);
     // constants_count
     vm::u2 constants_count = constants.size();
     writeNBytes(&constants_count, sizeof constants_count);
@@ -143,6 +144,10 @@ void File::output_binary(std::ofstream& out) {
         v = fun.nameIndex; writeNBytes(&v, sizeof v);
         v = fun.paramSize; writeNBytes(&v, sizeof v);
         v = fun.level;     writeNBytes(&v, sizeof v);
+        // since version 2
+        vm::u4 u;
+        u = fun.frameSize; writeNBytes(&u, sizeof u);
+        u = fun.maxDepth;  writeNBytes(&u, sizeof u);
         to_binary(fun.instructions);
     }
 }
@@ -282,6 +287,11 @@ File File::parse_file_binary(std::ifstream& in) {
         }
         fun.paramSize = read2bytes();
         fun.level = read2bytes();
+        fun.frameSize = fun.paramSize;
+        if (version >= 2) {
+            fun.frameSize = read4bytes();
+            fun.maxDepth = read4bytes();
+        }
         auto instructionsCount = read2bytes();
         for (int k = 0; k < instructionsCount; ++k) {
             fun.instructions.push_back(std::move(readInstruction()));
@@ -297,7 +307,19 @@ File File::parse_file_binary(std::ifstream& in) {
         throw InvalidFile("invalid binary file: unused content");
     }
 
-    return File{version, std::move(constants), std::move(start), std::move(functions)};
+    File file{version, std::move(constants), std::move(start), std::move(functions)};
+    // the VM trusts maxDepth instead of checking each push, so it is verified
+    std::vector<vm::u4> recorded;
+    for (auto& fun : file.functions) {
+        recorded.push_back(fun.maxDepth);
+    }
+    file.compute_stack_depth();
+    for (size_t j = 0; version >= 2 && j < recorded.size(); ++j) {
+        if (recorded[j] < file.functions[j].maxDepth) {
+            throw InvalidFile("invalid binary file: max stack depth of function too small");
+        }
+    }
+    return file;
 }
 
 File File::parse_file_text(std::ifstream& in) {
@@ -509,7 +531,7 @@ File File::parse_file_text(std::ifstream& in) {
     if (str == ".functions:") {
         ensureNoMoreInput();
         while (true) {
-            // {index} {nameIndex} {paramSize} {level}
+            // {index} {nameIndex} {paramSize} {level} [{frameSize}]
             readLine();
             vm::Function function;
             std::string temp;
@@ -539,6 +561,12 @@ File File::parse_file_text(std::ifstream& in) {
             errorIfNot(ss >> temp, "level expected");
             errorIfAssignFailed(function.level, try_to_int(temp), "invalid level");
             errorIf(function.level > U2_MAX, "too high the level");
+            // optional
+            function.frameSize = function.paramSize;
+            if (ss >> temp) {
+                errorIfAssignFailed(function.frameSize, try_to_int(temp), "invalid frame_size");
+                errorIf(function.frameSize < function.paramSize, "frame_size less than param_size");
+            }
             functions.push_back(std::move(function));
             ensureNoMoreInput();
         }
@@ -587,5 +615,124 @@ File File::parse_file_text(std::ifstream& in) {
 
     errorIf(in >> str, "unused content");
 
-    return File{0x00000001, std::move(constants), std::move(start), std::move(functions)};
+    File file{0x00000002, std::move(constants), std::move(start), std::move(functions)};
+    file.compute_stack_depth();
+    return file;
+}
+
+// walks every path of a function once and records the highest stack it reaches;
+// a function whose height at some instruction depends on the path is left UNBOUNDED
+void File::compute_stack_depth() {
+    // slots pushed onto the caller's stack by the return of each function, -1 if unknown
+    std::vector<int> retSlots;
+    for (auto& fun : functions) {
+        int slots = -1;
+        bool consistent = true;
+        for (auto& ins : fun.instructions) {
+            int n = -1;
+            switch (ins.op) {
+            case vm::OpCode::ret:  n = 0; break;
+            case vm::OpCode::iret:
+            case vm::OpCode::aret: n = 1; break;
+            case vm::OpCode::dret: n = 2; break;
+            default: continue;
+            }
+            consistent = consistent && (slots == -1 || slots == n);
+            slots = n;
+        }
+        retSlots.push_back(consistent ? slots : -1);
+    }
+
+    for (auto& fun : functions) {
+        const auto& code = fun.instructions;
+        const long paramSize = fun.paramSize;
+        std::vector<long> height(code.size(), -1);
+        std::vector<size_t> worklist;
+        long maxDepth = std::max<long>(paramSize, fun.frameSize);
+        bool bounded = true;
+
+        const auto reach = [&](long target, long h) {
+            if (target < 0 || target >= static_cast<long>(code.size())) {
+                bounded = false;
+            }
+            else if (height[target] == -1) {
+                height[target] = h;
+                worklist.push_back(target);
+            }
+            else if (height[target] != h) {
+                bounded = false;
+            }
+        };
+
+        if (!code.empty()) {
+            reach(0, paramSize);
+        }
+        while (bounded && !worklist.empty()) {
+            auto i = worklist.back();
+            worklist.pop_back();
+            auto& ins = code[i];
+            long h = height[i];
+            long pops = 0, pushes = 0;
+            bool fallThrough = true;
+            switch (ins.op) {
+            case vm::OpCode::popn: pops = ins.x; break;
+            case vm::OpCode::snew: pushes = ins.x; break;
+            case vm::OpCode::loadc:
+                if (ins.x >= constants.size()) {
+                    bounded = false;
+                    continue;
+                }
+                pushes = constants.at(ins.x).type == vm::Constant::Type::DOUBLE ? 2 : 1;
+                break;
+            case vm::OpCode::call:
+            case vm::OpCode::spawn:
+                if (ins.x >= functions.size()) {
+                    bounded = false;
+                    continue;
+                }
+                pops = functions.at(ins.x).paramSize;
+                pushes = ins.op == vm::OpCode::spawn ? 1 : retSlots.at(ins.x);
+                bounded = pushes >= 0;
+                break;
+            case vm::OpCode::ret:  fallThrough = false; break;
+            case vm::OpCode::iret:
+            case vm::OpCode::aret: pops = 1; fallThrough = false; break;
+            case vm::OpCode::dret: pops = 2; fallThrough = false; break;
+            default:
+                if (auto it = vm::stackEffectOfOpCode.find(ins.op); it != vm::stackEffectOfOpCode.end()) {
+                    pops = it->second.first;
+                    pushes = it->second.second;
+                }
+                else {
+                    bounded = false;
+                }
+                break;
+            }
+            // operands must not be taken from the params
+            if (!bounded || h - pops < paramSize) {
+                bounded = false;
+                break;
+            }
+            h = h - pops + pushes;
+            maxDepth = std::max(maxDepth, h);
+            switch (ins.op) {
+            case vm::OpCode::jmp:
+                reach(ins.x, h);
+                fallThrough = false;
+                break;
+            case vm::OpCode::je:  case vm::OpCode::jne:
+            case vm::OpCode::jl:  case vm::OpCode::jge:
+            case vm::OpCode::jg:  case vm::OpCode::jle:
+                reach(ins.x, h);
+                break;
+            default:
+                break;
+            }
+            // running off the end is reported by the VM when it happens
+            if (fallThrough && i + 1 < code.size()) {
+                reach(i + 1, h);
+            }
+        }
+        fun.maxDepth = bounded && maxDepth < vm::Function::UNBOUNDED ? static_cast<vm::u4>(maxDepth) : vm::Function::UNBOUNDED;
+    }
 }
@@ -22,6 +22,8 @@ struct File
 
     static File parse_file_text(std::ifstream& in);
     static File parse_file_binary(std::ifstream& in);
+    // fills maxDepth of every function
+    void compute_stack_depth();
     void output_text(std::ostream& out);
     void output_binary(std::ofstream& out);
 };
@@ -11,9 +11,16 @@
 namespace vm {
 
 struct Function {
+    // the stack height of the function depends on the path taken
+    static const u4 UNBOUNDED = U4_MAX;
+
     u2 nameIndex;
     u2 paramSize;
     u2 level;
+    // slots of params and locals, as declared by the compiler
+    u4 frameSize = 0;
+    // max slots above bp, params and locals included
+    u4 maxDepth = UNBOUNDED;
     std::vector<vm::Instruction> instructions;
 };
 
@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <utility>
 
 namespace vm {
 
@@ -49,6 +50,17 @@ enum class OpCode : u1 {
     // ...
     // ..., value
     snew = 0x0c,
+
+    // iinc offset(4), value(4)
+    // ...
+    // ...
+    // slot(bp+offset) += value
+    iinc = 0x0d,
+    // iincs offset(4)
+    // ..., value
+    // ...
+    // slot(bp+offset) += value
+    iincs = 0x0e,
     
     // Tload
     // ..., addr
@@ -66,6 +78,22 @@ enum class OpCode : u1 {
     // ..., array, index, value
     // ...
     iastore = 0x28, dastore = 0x29, aastore = 0x2a,
+    // iafill
+    // ..., array, count, value
+    // ...
+    iafill = 0x2c,
+    // iacopy
+    // ..., dst, src, count
+    // ...
+    iacopy = 0x2d,
+    // iacmp
+    // ..., lhs, rhs, count
+    // ..., result
+    iacmp = 0x2e,
+    // iachk
+    // ..., index, length
+    // ..., index
+    iachk = 0x2f,
     
     // Tadd
     // ..., lhs, rhs
@@ -109,6 +137,14 @@ enum class OpCode : u1 {
     // ..., params
     // ...
     call = 0x80,
+    // spawn index(2)
+    // ..., params
+    // ..., handle
+    spawn = 0x81,
+    // join
+    // ..., handle
+    // ..., result
+    join = 0x82,
     
     // ret
     ret = 0x88,
@@ -139,11 +175,13 @@ const std::unordered_map<OpCode, const char*> nameOfOpCode = {
     NAME(loadc),  NAME(loada),
     {OpCode::_new, "new"},
     NAME(snew),
+    NAME(iinc),   NAME(iincs),
         
     NAME(iload),   NAME(dload),   NAME(aload),
     NAME(iaload),  NAME(daload),  NAME(aaload),
     NAME(istore),  NAME(dstore),  NAME(astore),
     NAME(iastore), NAME(dastore), NAME(aastore),
+    NAME(iafill),  NAME(iacopy),  NAME(iacmp),  NAME(iachk),
         
     NAME(iadd), NAME(dadd),
     NAME(isub), NAME(dsub),
@@ -157,7 +195,7 @@ const std::unordered_map<OpCode, const char*> nameOfOpCode = {
     NAME(jmp),
     NAME(je), NAME(jne), NAME(jl), NAME(jge), NAME(jg), NAME(jle),
 
-    NAME(call),
+    NAME(call),   NAME(spawn),  NAME(join),
     NAME(ret),
     NAME(iret), NAME(dret), NAME(aret),
 
@@ -172,11 +210,49 @@ const std::unordered_map<OpCode, std::vector<int>> paramSizeOfOpCode = {
     { OpCode::popn, {4} },
     { OpCode::loadc, {2} },    { OpCode::loada, {2, 4} },
     { OpCode::snew, {4} },
+    { OpCode::iinc, {4, 4} },  { OpCode::iincs, {4} },
     
     { OpCode::jmp, {2} },
     { OpCode::je, {2} }, { OpCode::jne, {2} }, { OpCode::jl, {2} }, { OpCode::jge, {2} }, { OpCode::jg, {2} }, { OpCode::jle, {2} },
 
-    { OpCode::call, {2} },
+    { OpCode::call, {2} },     { OpCode::spawn, {2} },
+};
+
+// {popped slots, pushed slots}
+// popn, snew, loadc, call, spawn and Tret depend on the params or the file
+const std::unordered_map<OpCode, std::pair<int, int>> stackEffectOfOpCode = {
+    { OpCode::nop, {0, 0} },
+    { OpCode::bipush, {0, 1} },  { OpCode::ipush, {0, 1} },
+    { OpCode::pop, {1, 0} },     { OpCode::pop2, {2, 0} },
+    { OpCode::dup, {1, 2} },     { OpCode::dup2, {2, 4} },
+    { OpCode::loada, {0, 1} },
+    { OpCode::_new, {1, 1} },
+    { OpCode::iinc, {0, 0} },    { OpCode::iincs, {1, 0} },
+
+    { OpCode::iload, {1, 1} },   { OpCode::dload, {1, 2} },   { OpCode::aload, {1, 1} },
+    { OpCode::iaload, {2, 1} },  { OpCode::daload, {2, 2} },  { OpCode::aaload, {2, 1} },
+    { OpCode::istore, {2, 0} },  { OpCode::dstore, {3, 0} },  { OpCode::astore, {2, 0} },
+    { OpCode::iastore, {3, 0} }, { OpCode::dastore, {4, 0} }, { OpCode::aastore, {3, 0} },
+    { OpCode::iafill, {3, 0} },  { OpCode::iacopy, {3, 0} },  { OpCode::iacmp, {3, 1} },
+    { OpCode::iachk, {2, 1} },
+
+    { OpCode::iadd, {2, 1} },    { OpCode::dadd, {4, 2} },
+    { OpCode::isub, {2, 1} },    { OpCode::dsub, {4, 2} },
+    { OpCode::imul, {2, 1} },    { OpCode::dmul, {4, 2} },
+    { OpCode::idiv, {2, 1} },    { OpCode::ddiv, {4, 2} },
+    { OpCode::ineg, {1, 1} },    { OpCode::dneg, {2, 2} },
+    { OpCode::icmp, {2, 1} },    { OpCode::dcmp, {4, 1} },
+
+    { OpCode::i2d, {1, 2} },     { OpCode::d2i, {2, 1} },     { OpCode::i2c, {1, 1} },
+
+    { OpCode::jmp, {0, 0} },
+    { OpCode::je, {1, 0} }, { OpCode::jne, {1, 0} }, { OpCode::jl, {1, 0} }, { OpCode::jge, {1, 0} }, { OpCode::jg, {1, 0} }, { OpCode::jle, {1, 0} },
+
+    { OpCode::join, {1, 1} },
+
+    { OpCode::iprint, {1, 0} },  { OpCode::dprint, {2, 0} },  { OpCode::cprint, {1, 0} },  { OpCode::sprint, {1, 0} },
+    { OpCode::printl, {0, 0} },
+    { OpCode::iscan, {0, 1} },   { OpCode::dscan, {0, 2} },   { OpCode::cscan, {0, 1} },
 };
 
 #define NAME(op) { #op, OpCode::op }
@@ -189,11 +265,13 @@ const std::unordered_map<std::string, OpCode> opCodeOfName = {
     NAME(loadc),  NAME(loada),
     {"new", OpCode::_new},
     NAME(snew),
+    NAME(iinc),   NAME(iincs),
         
     NAME(iload),   NAME(dload),   NAME(aload),
     NAME(iaload),  NAME(daload),  NAME(aaload),
     NAME(istore),  NAME(dstore),  NAME(astore),
     NAME(iastore), NAME(dastore), NAME(aastore),
+    NAME(iafill),  NAME(iacopy),  NAME(iacmp),  NAME(iachk),
         
     NAME(iadd), NAME(dadd),
     NAME(isub), NAME(dsub),
@@ -207,7 +285,7 @@ const std::unordered_map<std::string, OpCode> opCodeOfName = {
     NAME(jmp),
     NAME(je), NAME(jne), NAME(jl), NAME(jge), NAME(jg), NAME(jle),
 
-    NAME(call),
+    NAME(call),   NAME(spawn),  NAME(join),
     NAME(ret),
     NAME(iret), NAME(dret), NAME(aret),
 
@@ -0,0 +1,132 @@
+#include "./peephole.h"
+#include "./type.h"
+#include "./opcode.h"
+#include "./instruction.h"
+#include "./constant.h"
+#include "./function.h"
+
+#include <algorithm>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace vm {
+
+namespace {
+
+bool isJump(OpCode op) {
+    switch (op) {
+    case OpCode::jmp:
+    case OpCode::je:  case OpCode::jne:
+    case OpCode::jl:  case OpCode::jge:
+    case OpCode::jg:  case OpCode::jle:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isZero(const Instruction& ins) {
+    return (ins.op == OpCode::ipush || ins.op == OpCode::bipush) && ins.x == 0;
+}
+
+// a, b together leave the stack and everything else as they found it
+bool cancels(const Instruction& a, const Instruction& b) {
+    return (isZero(a) && b.op == OpCode::iadd)
+        || (a.op == OpCode::dup  && b.op == OpCode::pop)
+        || (a.op == OpCode::dup2 && b.op == OpCode::pop2)
+        || (a.op == OpCode::ineg && b.op == OpCode::ineg)
+        || (a.op == OpCode::dneg && b.op == OpCode::dneg);
+}
+
+void optimize(std::vector<Instruction>& code) {
+    const size_t n = code.size();
+    for (auto& ins : code) {
+        if (isJump(ins.op) && ins.x >= n) {
+            return;
+        }
+    }
+
+    std::vector<bool> kept(n, true);
+    // next[i]: the first kept instruction at or after i, n if none
+    std::vector<size_t> next(n + 1, n);
+    // entered[i]: some jump lands on the kept instruction i
+    std::vector<bool> entered(n);
+    const auto update = [&]() {
+        for (size_t i = n; i-- > 0; ) {
+            next[i] = kept[i] ? i : next[i + 1];
+        }
+        std::fill(entered.begin(), entered.end(), false);
+        for (size_t i = 0; i < n; ++i) {
+            if (kept[i] && isJump(code[i].op) && next[code[i].x] < n) {
+                entered[next[code[i].x]] = true;
+            }
+        }
+    };
+
+    // removing an instruction only moves the jumps landing on it forward, onto the
+    // first instruction of what is matched next, so one scan can remove several;
+    // the last instruction is always kept so that every jump still has a target
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        update();
+        for (size_t i = next[0]; i < n; ) {
+            size_t j = next[i + 1];
+            if (j == n) {
+                break;
+            }
+            const auto& a = code[i];
+            if (a.op == OpCode::nop || (a.op == OpCode::jmp && next[a.x] == j)) {
+                kept[i] = false;
+                changed = true;
+                i = j;
+                continue;
+            }
+            size_t k = next[j + 1];
+            if (k != n && !entered[j] && cancels(a, code[j])) {
+                kept[i] = kept[j] = false;
+                changed = true;
+                i = k;
+                continue;
+            }
+            i = j;
+        }
+    }
+
+    update();
+    std::vector<size_t> index(n);
+    std::vector<Instruction> result;
+    result.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (kept[i]) {
+            index[i] = result.size();
+            result.push_back(code[i]);
+        }
+    }
+    for (auto& ins : result) {
+        if (isJump(ins.op)) {
+            ins.x = static_cast<u4>(index[next[ins.x]]);
+        }
+    }
+    code.swap(result);
+}
+
+}
+
+std::vector<PeepholeReport> peephole(File& file) {
+    std::vector<PeepholeReport> reports;
+    const auto run = [&](std::string name, std::vector<Instruction>& code) {
+        size_t before = code.size();
+        optimize(code);
+        reports.push_back(PeepholeReport{ std::move(name), before, code.size() });
+    };
+    run(".start", file.start);
+    for (auto& fun : file.functions) {
+        run(std::get<str_t>(file.constants.at(fun.nameIndex).value), fun.instructions);
+    }
+    file.compute_stack_depth();
+    return reports;
+}
+
+}
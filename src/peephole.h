@@ -0,0 +1,33 @@
+#ifndef PEEPHOLE_H_INCLUDED
+#define PEEPHOLE_H_INCLUDED
+
+#include "./file.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace vm {
+
+// instruction counts of .start or of one function
+struct PeepholeReport {
+    std::string name;
+    size_t before;
+    size_t after;
+};
+
+// Rewrites the instructions of a loaded File in place, whoever produced it:
+//     nop                          =>
+//     bipush 0 | ipush 0; iadd     =>
+//     jmp to the next instruction  =>
+//     dup; pop | dup2; pop2        =>
+//     ineg; ineg | dneg; dneg      =>
+// The stack height before every remaining instruction is unchanged. Jumps are
+// relocated to the new indices, a jump into a removed sequence goes to the
+// instruction following it. Code with a jump outside of it is left untouched.
+// maxDepth is recomputed afterwards.
+std::vector<PeepholeReport> peephole(File& file);
+
+}
+
+#endif
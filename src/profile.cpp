@@ -0,0 +1,132 @@
+#include "./profile.h"
+#include "./exception.h"
+#include "./util/print.hpp"
+
+#include <sstream>
+#include <string>
+#include <variant>
+
+namespace vm {
+
+Profile::Profile(const File& file) {
+    for (auto& fun : file.functions) {
+        Function f;
+        if (fun.nameIndex < file.constants.size() && file.constants.at(fun.nameIndex).type == Constant::Type::STRING) {
+            f.name = std::get<str_t>(file.constants.at(fun.nameIndex).value);
+        }
+        f.counts.assign(fun.instructions.size(), 0);
+        f.taken.assign(fun.instructions.size(), 0);
+        functions.push_back(std::move(f));
+    }
+}
+
+void Profile::merge(const Profile& other) {
+    if (other.functions.size() != functions.size()) {
+        throw InvalidFile("merging profiles of different files");
+    }
+    for (std::size_t i = 0; i < functions.size(); ++i) {
+        auto& to = functions[i];
+        auto& from = other.functions[i];
+        if (from.counts.size() != to.counts.size()) {
+            throw InvalidFile("merging profiles of different files");
+        }
+        for (std::size_t ip = 0; ip < to.counts.size(); ++ip) {
+            to.counts[ip] += from.counts[ip];
+            to.taken[ip] += from.taken[ip];
+        }
+    }
+}
+
+void Profile::output(std::ostream& out) const {
+    int i = 0;
+    for (auto& f : functions) {
+        printfmt(out, ".F{} {} {}", i++, f.name, f.counts.size()); println(out);
+        u8 last = 0;
+        for (std::size_t ip = 0; ip < f.counts.size(); ++ip) {
+            if (f.counts[ip] != last) {
+                println(out, ip, f.counts[ip]);
+                last = f.counts[ip];
+            }
+            if (f.taken[ip] != 0) {
+                println(out, "j", ip, f.taken[ip]);
+            }
+        }
+    }
+}
+
+Profile Profile::parse(std::istream& in) {
+    Profile profile;
+    Function* f = nullptr;
+    // the count of the instructions from `from` on, set when the next run starts
+    std::size_t from = 0;
+    u8 count = 0;
+    const auto fill = [&](std::size_t to) {
+        for (; from < to; ++from) {
+            f->counts[from] = count;
+        }
+    };
+    std::string line;
+    int line_count = 0;
+    while (std::getline(in, line)) {
+        ++line_count;
+        std::istringstream ss(line);
+        std::string head;
+        if (!(ss >> head)) {
+            continue;
+        }
+        const auto error = [&]() {
+            throw InvalidFile(strfmt("invalid profile at line {}", line_count));
+        };
+        if (head[0] == '.') {
+            if (f != nullptr) {
+                fill(f->counts.size());
+            }
+            std::size_t size = 0;
+            Function next;
+            if (head != ".F" + std::to_string(profile.functions.size()) || !(ss >> next.name >> size)) {
+                error();
+            }
+            next.counts.assign(size, 0);
+            next.taken.assign(size, 0);
+            profile.functions.push_back(std::move(next));
+            f = &profile.functions.back();
+            from = 0;
+            count = 0;
+        }
+        else if (f == nullptr) {
+            error();
+        }
+        else if (head == "j") {
+            std::size_t ip = 0;
+            u8 n = 0;
+            if (!(ss >> ip >> n) || ip >= f->taken.size()) {
+                error();
+            }
+            f->taken[ip] = n;
+        }
+        else {
+            std::size_t ip = 0;
+            u8 n = 0;
+            try {
+                ip = std::stoull(head);
+            }
+            catch (const std::exception&) {
+                error();
+            }
+            if (!(ss >> n) || ip < from || ip >= f->counts.size()) {
+                error();
+            }
+            fill(ip);
+            count = n;
+        }
+        if (std::string rest; ss >> rest) {
+            error();
+        }
+    }
+    if (f != nullptr) {
+        fill(f->counts.size());
+    }
+    return profile;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+
+#include "./type.h"
+#include "./file.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace vm {
+
+// execution counts of a run, keyed by function index and instruction index
+// text format, one function per header line followed by its counters:
+//     .F<index> <name> <instructions count>
+//     <ip> <count>     instructions from ip up to the next such line were executed count times
+//     j <ip> <count>   the jump at ip was taken count times
+// instructions before the first line and functions without lines were never executed.
+// the call count of a function is the count of its instruction 0, a loop runs
+// (taken count of its backward jump) / (count of its header - that) times per entry.
+struct Profile {
+    struct Function {
+        std::string name;
+        std::vector<u8> counts;
+        std::vector<u8> taken;
+    };
+    std::vector<Function> functions;
+
+    Profile() = default;
+    // zeroed counters for every function of the file
+    explicit Profile(const File& file);
+
+    void merge(const Profile& other);
+    void output(std::ostream& out) const;
+    static Profile parse(std::istream& in);
+};
+
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include "./scheduler.h"
+#include "./exception.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace vm {
+
+// stacks of tasks are placed above the heap, one segment after another
+const addr_t Scheduler::MIN_SEGMENT_ADDR = 0x02000000;
+const addr_t Scheduler::SEGMENT_SIZE     = 0x00100000;
+const int    Scheduler::MAX_SEGMENTS     = 1024;
+
+// index of the deque the current thread pushes to, the main thread owns 0
+static thread_local int currentWorker = 0;
+
+Scheduler::Scheduler(Runner runner)
+    : _runner(std::move(runner)),
+      _workersCount(std::max(1u, std::thread::hardware_concurrency())),
+      _nextHandle(1),
+      _segments(std::make_unique<std::atomic<slot_t*>[]>(MAX_SEGMENTS)),
+      _generations(std::make_unique<std::atomic<unsigned>[]>(MAX_SEGMENTS)),
+      _tops(std::make_unique<std::atomic<addr_t>[]>(MAX_SEGMENTS)),
+      _segmentsMemory(MAX_SEGMENTS) {
+    for (unsigned i = 0; i < _workersCount; ++i) {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < MAX_SEGMENTS; ++i) {
+        _segments[i].store(nullptr);
+        _generations[i].store(0);
+        _tops[i].store(MIN_SEGMENT_ADDR + i * SEGMENT_SIZE);
+    }
+    for (int i = MAX_SEGMENTS - 1; i >= 0; --i) {
+        _freeSegments.push_back(i);
+    }
+}
+
+Scheduler::~Scheduler() {
+    _stop = true;
+    _idle.notify_all();
+    for (auto& t : _threads) {
+        t.join();
+    }
+}
+
+void Scheduler::startWorkers() {
+    // worker 0 is the main thread, it only runs tasks while joining
+    for (unsigned i = 1; i < _workersCount; ++i) {
+        _threads.emplace_back(&Scheduler::workerLoop, this, i);
+    }
+}
+
+int_t Scheduler::spawn(std::shared_ptr<Task> task) {
+    std::call_once(_started, &Scheduler::startWorkers, this);
+    int_t handle;
+    {
+        std::lock_guard<std::mutex> lock(_handlesMutex);
+        handle = _nextHandle++;
+        _handles.emplace(handle, task);
+    }
+    {
+        auto& worker = *_workers.at(currentWorker);
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    ++_queued;
+    _idle.notify_one();
+    return handle;
+}
+
+slot_t Scheduler::join(int_t handle) {
+    std::shared_ptr<Task> task;
+    {
+        std::lock_guard<std::mutex> lock(_handlesMutex);
+        auto it = _handles.find(handle);
+        if (it == _handles.end()) {
+            throw TaskError("invalid task handle");
+        }
+        task = std::move(it->second);
+        _handles.erase(it);
+    }
+    while (task->state.load(std::memory_order_acquire) != Task::DONE) {
+        // not started yet: run it right here
+        int expected = Task::PENDING;
+        if (task->state.compare_exchange_strong(expected, Task::RUNNING)) {
+            execute(*task);
+            break;
+        }
+        // running elsewhere: help with other work meanwhile
+        if (auto other = findWork(currentWorker)) {
+            execute(*other);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    if (task->error) {
+        std::rethrow_exception(task->error);
+    }
+    return task->result;
+}
+
+void Scheduler::drain() {
+    while (true) {
+        int_t handle;
+        {
+            std::lock_guard<std::mutex> lock(_handlesMutex);
+            if (_handles.empty()) {
+                return;
+            }
+            handle = _handles.begin()->first;
+        }
+        join(handle);
+    }
+}
+
+void Scheduler::workerLoop(int index) {
+    currentWorker = index;
+    while (!_stop) {
+        if (auto task = findWork(index)) {
+            execute(*task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_idleMutex);
+        _idle.wait_for(lock, std::chrono::milliseconds(1), [this] { return _stop || _queued > 0; });
+    }
+}
+
+// pops from the own deque (newest first), then steals from the others (oldest first)
+std::shared_ptr<Task> Scheduler::findWork(int index) {
+    const auto claim = [this](std::shared_ptr<Task>& task) {
+        --_queued;
+        int expected = Task::PENDING;
+        return task->state.compare_exchange_strong(expected, Task::RUNNING);
+    };
+    {
+        auto& own = *_workers.at(index);
+        std::lock_guard<std::mutex> lock(own.mutex);
+        while (!own.tasks.empty()) {
+            auto task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            if (claim(task)) {
+                return task;
+            }
+        }
+    }
+    for (unsigned i = 1; i < _workersCount; ++i) {
+        auto& victim = *_workers.at((index + i) % _workersCount);
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        while (!victim.tasks.empty()) {
+            auto task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            if (claim(task)) {
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// the caller has moved the task into RUNNING
+void Scheduler::execute(Task& task) {
+    int segment = -1;
+    try {
+        segment = acquireSegment(task);
+        _runner(task, _segments[segment].load(), MIN_SEGMENT_ADDR + segment * SEGMENT_SIZE);
+    }
+    catch (...) {
+        task.error = std::current_exception();
+    }
+    if (segment >= 0) {
+        releaseSegment(segment);
+    }
+    task.params.clear();
+    task.state.store(Task::DONE, std::memory_order_release);
+}
+
+int Scheduler::acquireSegment(const Task& task) {
+    std::lock_guard<std::mutex> lock(_segmentsMutex);
+    auto free = std::find_if(_freeSegments.rbegin(), _freeSegments.rend(), [&](int segment) {
+        return std::none_of(task.visible.begin(), task.visible.end(), [&](auto& v) { return v.first == segment; });
+    });
+    if (free == _freeSegments.rend()) {
+        throw TaskError("too many running tasks");
+    }
+    int segment = *free;
+    _freeSegments.erase(std::next(free).base());
+    if (!_segmentsMemory[segment]) {
+        // left uninitialized so that untouched pages are never committed
+        _segmentsMemory[segment].reset(new slot_t[SEGMENT_SIZE]);
+        _segments[segment].store(_segmentsMemory[segment].get());
+    }
+    return segment;
+}
+
+void Scheduler::releaseSegment(int segment) {
+    std::lock_guard<std::mutex> lock(_segmentsMutex);
+    _tops[segment].store(MIN_SEGMENT_ADDR + segment * SEGMENT_SIZE, std::memory_order_relaxed);
+    _generations[segment].fetch_add(1, std::memory_order_relaxed);
+    _freeSegments.push_back(segment);
+}
+
+std::pair<int, unsigned> Scheduler::segmentOf(addr_t base) const {
+    int segment = (base - MIN_SEGMENT_ADDR) / SEGMENT_SIZE;
+    return { segment, _generations[segment].load(std::memory_order_relaxed) };
+}
+
+// the spawn publishing the top and the task reading it are ordered by the deque's mutex
+void Scheduler::publishTop(addr_t base, addr_t sp) {
+    _tops[(base - MIN_SEGMENT_ADDR) / SEGMENT_SIZE].store(sp, std::memory_order_relaxed);
+}
+
+slot_t* Scheduler::segmentPtr(addr_t addr, addr_t count, const std::vector<std::pair<int, unsigned>>& visible) const {
+    if (addr < MIN_SEGMENT_ADDR) {
+        return nullptr;
+    }
+    auto segment = (addr - MIN_SEGMENT_ADDR) / SEGMENT_SIZE;
+    auto offset = (addr - MIN_SEGMENT_ADDR) % SEGMENT_SIZE;
+    if (segment >= MAX_SEGMENTS) {
+        return nullptr;
+    }
+    auto seen = std::find_if(visible.begin(), visible.end(), [&](auto& v) { return v.first == segment; });
+    if (seen == visible.end() || seen->second != _generations[segment].load(std::memory_order_relaxed)
+        || count > _tops[segment].load(std::memory_order_relaxed) - addr) {
+        return nullptr;
+    }
+    slot_t* memory = _segments[segment].load();
+    return memory ? memory + offset : nullptr;
+}
+
+}
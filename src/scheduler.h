@@ -0,0 +1,132 @@
+#ifndef SCHEDULER_H_INCLUDED
+#define SCHEDULER_H_INCLUDED
+
+#include "./type.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vm {
+
+// Memory model of spawn/join
+//
+// A task runs one function call on its own stack segment with its own frames,
+// so parameters, locals and local arrays of different tasks never overlap.
+// Globals live in the frame of .start and are shared by every task; so is any
+// array whose address was passed to a task.
+//
+// - Everything a task did before `spawn` happens-before the first instruction
+//   of the spawned task.
+// - The last instruction of a task happens-before the `join` on its handle
+//   returns, in whichever task performs the join.
+// - There is no other synchronisation. If two tasks that are not ordered by
+//   spawn/join access the same slot and at least one of them writes it, the
+//   program has undefined behaviour. The VM accesses slots as plain memory
+//   from several threads without atomics, so this is a data race in the VM
+//   itself, not merely an unspecified value. (-a and -n run each task at its
+//   join, so there the race cannot happen, but programs must not rely on
+//   that.) Such programs must split their data per task and combine the
+//   results after `join`.
+// - An array passed to a task lives in the frame of the function that
+//   declared it. It may be used by the task only while that frame is live:
+//   the spawner must join the task before the function returns. A task may
+//   access the globals, its own stack, and the stacks of its spawners below
+//   their stack pointer at the last spawn or return; any other address, in
+//   particular one into a frame that has returned or into a segment that has
+//   since been given to another task, is reported as an invalid memory
+//   access. The check is made at each access, so a frame that returns while
+//   the task is using it is still a data race.
+// - print and scan are not atomic, output of concurrent tasks may interleave
+//   between single values.
+//
+// A task that is joined before any worker started it is run by the joiner
+// itself. A joiner waiting for a running task keeps executing other queued
+// tasks, so joins never block a worker while there is work to do.
+struct Task {
+    enum State : int { PENDING = 0, RUNNING = 1, DONE = 2 };
+
+    u2 functionIndex;
+    std::vector<slot_t> params;
+    std::atomic<int> state{PENDING};
+    slot_t result = 0;
+    std::exception_ptr error;
+    // the segments of the spawners, with the generation each had then,
+    // the only ones besides its own and the main stack the task may access
+    std::vector<std::pair<int, unsigned>> visible;
+};
+
+class Scheduler {
+public:
+    static const addr_t MIN_SEGMENT_ADDR;
+    static const addr_t SEGMENT_SIZE;
+    static const int    MAX_SEGMENTS;
+
+    // runs the task on the given stack segment, [base, base+SEGMENT_SIZE)
+    using Runner = std::function<void(Task&, slot_t* stack, addr_t base)>;
+
+    explicit Scheduler(Runner runner);
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    ~Scheduler();
+
+    int_t spawn(std::shared_ptr<Task> task);
+    slot_t join(int_t handle);
+    // joins every task which has not been joined yet
+    void drain();
+    // the segment and its current generation of a task running at base
+    std::pair<int, unsigned> segmentOf(addr_t base) const;
+    // slots below sp on the segment at base may be accessed by the tasks it spawned
+    void publishTop(addr_t base, addr_t sp);
+    // memory of a segment in visible which still has the same generation and
+    // whose range is below its published top, or nullptr
+    slot_t* segmentPtr(addr_t addr, addr_t count, const std::vector<std::pair<int, unsigned>>& visible) const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Task>> tasks;
+    };
+
+    void startWorkers();
+    void workerLoop(int index);
+    std::shared_ptr<Task> findWork(int index);
+    void execute(Task& task);
+    // never one of the task's visible segments, whose old addresses would look like its own
+    int acquireSegment(const Task& task);
+    void releaseSegment(int segment);
+
+private:
+    Runner _runner;
+    unsigned _workersCount;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::once_flag _started;
+    std::atomic<bool> _stop{false};
+    std::atomic<int> _queued{0};
+    std::mutex _idleMutex;
+    std::condition_variable _idle;
+
+    std::mutex _handlesMutex;
+    int_t _nextHandle;
+    std::unordered_map<int_t, std::shared_ptr<Task>> _handles;
+
+    std::mutex _segmentsMutex;
+    std::unique_ptr<std::atomic<slot_t*>[]> _segments;
+    // incremented when a segment is released, so addresses kept from its previous task are rejected
+    std::unique_ptr<std::atomic<unsigned>[]> _generations;
+    std::unique_ptr<std::atomic<addr_t>[]> _tops;
+    std::vector<std::unique_ptr<slot_t[]>> _segmentsMemory;
+    std::vector<int> _freeSegments;
+};
+
+}
+
+#endif
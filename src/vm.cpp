@@ -6,6 +6,10 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <sstream>
 
 namespace vm {
 
@@ -17,7 +21,16 @@ const addr_t VM::MIN_HEAP_ADDR  = 0x01000000;
 const addr_t VM::MAX_HEAP_ADDR  = 0x01ffffff;
 const addr_t VM::MAX_HEAP_SIZE  = 0x01000000;
 
-VM::VM(File file) noexcept : _file(std::move(file)){
+VM::VM(File file) noexcept
+    : _shared(std::make_shared<Shared>(std::move(file))),
+      _stack(nullptr), _stackBase(MIN_STACK_ADDR), _stackLimit(MAX_STACK_ADDR) {
+    _start = _shared->file.start;
+    init();
+}
+
+VM::VM(std::shared_ptr<Shared> shared, slot_t* stack, addr_t base) noexcept
+    : _shared(std::move(shared)),
+      _stack(stack), _stackBase(base), _stackLimit(base + Scheduler::SEGMENT_SIZE - 1) {
     init();
 }
 
@@ -45,30 +58,32 @@ std::unique_ptr<VM> VM::make_vm(File file) {
         throw InvalidFile("main not found");
     }
     auto vm = std::make_unique<VM>(std::move(file));
-    vm->_stack = std::make_unique<slot_t[]>(MAX_STACK_ADDR-MIN_STACK_ADDR);
-    vm->_heap  = std::make_unique<slot_t[]>(MAX_HEAP_ADDR-MIN_HEAP_ADDR);
+    vm->_shared->stack = std::make_unique<slot_t[]>(MAX_STACK_ADDR-MIN_STACK_ADDR);
+    vm->_shared->heap  = std::make_unique<slot_t[]>(MAX_HEAP_ADDR-MIN_HEAP_ADDR);
+    vm->_stack = vm->_shared->stack.get();
     return std::move(vm);
 }
 
 void VM::init() noexcept {
     prepared = false;
-    _sp = 0;
-    _bp = 0;
+    _sp = _stackBase;
+    _bp = _stackBase;
     _ip = 0;
     _counterInstruction = 0;
+    _profiled = nullptr;
+    _checkEachPush = true;
     _contexts.clear();
-    _heapRecord.clear();
-    _stringLiteralPool.clear();
 }
 
 void VM::buildStringLiteralPool() {
     u2 i = 0;
-    for (auto it = _file.constants.begin(), ed = _file.constants.end(); it != ed; ++it) {
+    auto& constants = _shared->file.constants;
+    for (auto it = constants.begin(), ed = constants.end(); it != ed; ++it) {
         auto& c = *it;
         if (c.type == vm::Constant::Type::STRING) {
             str_t str = std::get<str_t>(c.value);
             addr_t addr = NEW(str.length()+1);
-            _stringLiteralPool[i] = addr;
+            _shared->stringLiteralPool[i] = addr;
             slot_t* dst =  toHeapPtr(addr);
             for (auto ch : str) {
                 *dst++ = ch & 0xff;
@@ -79,9 +94,7 @@ void VM::buildStringLiteralPool() {
     }
 }
 
-void VM::start() {
-    init();
-    buildStringLiteralPool();
+VM::Context VM::globalContext() {
     Context globalContext;
     globalContext.prevPC = 0;
     globalContext.prevSP = 0;
@@ -91,28 +104,106 @@ void VM::start() {
     globalContext.functionIndex = -1;
     globalContext.functionName = "__START__";
     globalContext.functionLevel = 0;
-    _currentInstructions = _file.start;
-    _contexts.push_back(globalContext);
+    return globalContext;
+}
+
+bool VM::start() {
+    init();
+    if (_shared->profile) {
+        _shared->profile = std::make_unique<Profile>(_shared->file);
+        _profile = std::make_unique<Profile>(_shared->file);
+    }
+    _shared->heapRecord.clear();
+    _shared->stringLiteralPool.clear();
+    buildStringLiteralPool();
+    _shared->scheduler = std::make_unique<Scheduler>([this](Task& task, slot_t* stack, addr_t base) {
+        runTask(_shared, task, stack, base);
+    });
+    _currentInstructions = _start;
+    _contexts.push_back(globalContext());
     prepared = true;
-    run();
+    auto ok = run();
+    // stops the workers before anything they use goes away
+    _shared->scheduler.reset();
+    mergeProfile();
+    return ok;
 }
 
-void VM::run() {
+void VM::enableProfile() {
+    _shared->profile = std::make_unique<Profile>(_shared->file);
+}
+
+const Profile* VM::profile() const {
+    return _shared->profile.get();
+}
+
+void VM::mergeProfile() {
+    if (!_profile) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_shared->profileMutex);
+    _shared->profile->merge(*_profile);
+    _profile.reset();
+}
+
+// runs one spawned call on its own stack segment, sharing globals and heap with the spawner
+void VM::runTask(std::shared_ptr<Shared> shared, Task& task, slot_t* stack, addr_t base) {
+    VM vm(std::move(shared), stack, base);
+    vm._start = { Instruction{OpCode::call, task.functionIndex, 0} };
+    vm._currentInstructions = vm._start;
+    vm._contexts.push_back(vm.globalContext());
+    vm.prepared = true;
+    vm._visible = std::move(task.visible);
+    if (vm._shared->profile) {
+        vm._profile = std::make_unique<Profile>(vm._shared->file);
+    }
     try {
-        while (_ip < _currentInstructions.size()) {
-            executeInstruction(_currentInstructions.at(_ip));
-            ++_ip;
-            ++_counterInstruction;
+        vm.ensureStackRest(task.params.size());
+        std::copy(task.params.begin(), task.params.end(), vm.toStackPtr(vm._sp));
+        vm._sp += task.params.size();
+        vm.execute();
+        vm.mergeProfile();
+    }
+    catch (const std::exception& e) {
+        vm.mergeProfile();
+        std::ostringstream trace;
+        vm.printStackTrace(trace);
+        auto where = trace.str();
+        if (!where.empty() && where.back() == '\n') {
+            where.pop_back();
         }
-        if (_contexts.size() != 1) {
-            // no ret at the end of funtion
-            throw InvalidControlTransfer();
+        throw TaskError(std::string(e.what()) + " in spawned task\n" + where);
+    }
+    task.result = vm._sp > base ? *vm.toStackPtr(vm._sp - 1) : 0;
+}
+
+void VM::execute() {
+    while (_ip < _currentInstructions.size()) {
+        if (_profiled) {
+            ++_profiled->counts[_ip];
         }
+        executeInstruction(_currentInstructions.at(_ip));
+        ++_ip;
+        ++_counterInstruction;
+    }
+    if (_contexts.size() != 1) {
+        // no ret at the end of funtion
+        throw InvalidControlTransfer();
+    }
+}
+
+bool VM::run() {
+    try {
+        execute();
+        // tasks nobody joined still finish before the program ends
+        _shared->scheduler->drain();
+        return true;
     }
     catch (const std::exception& e) {
         println(std::cerr, "runtime error:", e.what(), "!");
         println(std::cerr, "occurred at:");
         printStackTrace(std::cerr);
+        return false;
     }
 }
 
@@ -136,19 +227,26 @@ void VM::printStackTrace(std::ostream& out) {
             return;
         }
         if (rit->functionIndex == -1) {
-            println(out, "called by .start at instruction", pc, ":", _file.start.at(pc));
+            println(out, "called by .start at instruction", pc, ":", _start.at(pc));
             return;
         }
-        println(out, "called by function", rit->functionName, "at instruction", pc, ":", _file.functions.at(rit->functionIndex).instructions.at(pc));
+        println(out, "called by function", rit->functionName, "at instruction", pc, ":", _shared->file.functions.at(rit->functionIndex).instructions.at(pc));
     }
 }
 
 void VM::ensureStackRest(addr_t count) {
-    if (_sp + count > MAX_STACK_ADDR) {
+    if (_sp + count > _stackLimit) {
         throw StackOverflow();
     }
 }
 
+// functions with a known maxDepth were checked once at their call
+void VM::checkStackRest(addr_t count) {
+    if (_checkEachPush) {
+        ensureStackRest(count);
+    }
+}
+
 void VM::ensureStackUsed(addr_t count) {
     if (_bp + count > _sp) {
         throw InvalidMemoryAccess("tried to modify important stack info");
@@ -156,31 +254,58 @@ void VM::ensureStackUsed(addr_t count) {
 }
 
 slot_t* VM::toStackPtr(addr_t addr) {
-    return _stack.get() + addr;
+    return _stack + (addr - _stackBase);
 }
 slot_t* VM::toHeapPtr(addr_t addr) {
-    return _heap.get() + (addr-MIN_HEAP_ADDR);
+    return _shared->heap.get() + (addr-MIN_HEAP_ADDR);
 }
 
+// the ranges are checked as count > limit - addr, since addr + count may overflow
 slot_t* VM::checkAddr(addr_t addr, addr_t count) {
-    addr_t end = addr + count;
-    if (MIN_STACK_ADDR <= addr && addr < this->_sp) {
-        if (end > this->_sp) {
+    if (count < 0) {
+        throw InvalidMemoryAccess("tried to access a negative range of memory");
+    }
+    if (_stackBase <= addr && addr < this->_sp) {
+        if (count > this->_sp - addr) {
             throw InvalidMemoryAccess("tried to access unused stack memory");
         }
         return toStackPtr(addr);
     }
     if (MIN_HEAP_ADDR <= addr && addr < MAX_HEAP_ADDR) {
-        for (auto& p : _heapRecord) {
-            if (p.first <= addr && end <= p.first+p.second) {
+        std::lock_guard<std::mutex> lock(_shared->heapMutex);
+        for (auto& p : _shared->heapRecord) {
+            if (p.first <= addr && count <= p.first + p.second - addr) {
                 return toHeapPtr(addr);
             }
         }
         throw InvalidMemoryAccess("tried to access unused or constant heap memory");
     }
+    // stacks of the spawners: the globals, or an array passed to a spawned call
+    if (addr < _stackBase || addr > _stackLimit) {
+        if (_stackBase != MIN_STACK_ADDR && MIN_STACK_ADDR <= addr && addr < MAX_STACK_ADDR) {
+            if (count > _shared->mainTop.load(std::memory_order_relaxed) - addr) {
+                throw InvalidMemoryAccess("tried to access unused stack memory of another task");
+            }
+            return _shared->stack.get() + addr;
+        }
+        if (slot_t* p = _shared->scheduler ? _shared->scheduler->segmentPtr(addr, count, _visible) : nullptr) {
+            return p;
+        }
+    }
     throw InvalidMemoryAccess("tried to access unexistent memory");
 }
 
+// tasks spawned by this VM may access its stack below _sp, so the top is published
+// at each spawn, and lowered at each return so that the frames left are rejected
+void VM::publishTop() {
+    if (_stackBase == MIN_STACK_ADDR) {
+        _shared->mainTop.store(_sp, std::memory_order_relaxed);
+    }
+    else if (_shared->scheduler) {
+        _shared->scheduler->publishTop(_stackBase, _sp);
+    }
+}
+
 
 void VM::DEC_SP(addr_t count) {
     ensureStackUsed(count);
@@ -188,48 +313,50 @@ void VM::DEC_SP(addr_t count) {
 }
 
 void VM::INC_SP(addr_t count) {
-    ensureStackRest(count);
+    checkStackRest(count);
     _sp += count;
 }
 
 addr_t VM::NEW(addr_t count) {
+    std::lock_guard<std::mutex> lock(_shared->heapMutex);
+    auto& heapRecord = _shared->heapRecord;
     addr_t st = MIN_HEAP_ADDR;
-    if (!_heapRecord.empty()) {
-        auto& last = _heapRecord.back();
+    if (!heapRecord.empty()) {
+        auto& last = heapRecord.back();
         st = last.first + last.second;
     }
     if (st + count >= MAX_HEAP_ADDR) {
         throw HeapOverflow();
     }
-    _heapRecord.emplace_back(st, count);
+    heapRecord.emplace_back(st, count);
     return st;
 }
 
 void VM::DUP() {
     ensureStackUsed(1);
-    ensureStackRest(1);
-    _stack[_sp] = _stack[_sp-1];
+    checkStackRest(1);
+    *toStackPtr(_sp) = *toStackPtr(_sp-1);
     ++_sp;
 }
 
 void VM::DUP2() {
     ensureStackUsed(2);
-    ensureStackRest(2);
-    _stack[_sp] = _stack[_sp-2];
-    _stack[_sp+1] = _stack[_sp-1];
+    checkStackRest(2);
+    *toStackPtr(_sp) = *toStackPtr(_sp-2);
+    *toStackPtr(_sp+1) = *toStackPtr(_sp-1);
     _sp += 2;
 }
 
 template<>
 char_t VM::POP<char_t>() {
     ensureStackUsed(1);
-    return static_cast<char_t>(_stack[--_sp]);
+    return static_cast<char_t>(*toStackPtr(--_sp));
 }
 
 template<>
 int_t VM::POP<int_t>() {
     ensureStackUsed(1);
-    return static_cast<int_t>(_stack[--_sp]);
+    return static_cast<int_t>(*toStackPtr(--_sp));
 }
 
 template<>
@@ -242,20 +369,20 @@ double_t VM::POP<double_t>() {
 
 template<>
 void VM::PUSH<char_t>(char_t value) {
-    ensureStackRest(1);
-    _stack[_sp++] = 0x000000ff & value;
+    checkStackRest(1);
+    *toStackPtr(_sp++) = 0x000000ff & value;
 }
 
 template<>
 void VM::PUSH<int_t>(int_t value) {
-    ensureStackRest(1);
-    _stack[_sp++] = value;
+    checkStackRest(1);
+    *toStackPtr(_sp++) = value;
 }
 
 template<>
 void VM::PUSH<double_t>(double_t val) {
-    ensureStackRest(2);
-    double_t* p = reinterpret_cast<double_t*>(_stack.get() + _sp);
+    checkStackRest(2);
+    double_t* p = reinterpret_cast<double_t*>(toStackPtr(_sp));
     *p = val;
     _sp += 2;
 }
@@ -295,17 +422,21 @@ void VM::JUMP(u2 offset) {
     if (0 > offset || offset >= _currentInstructions.size()) {
         throw InvalidControlTransfer();
     }
+    if (_profiled) {
+        ++_profiled->taken[_ip];
+    }
     this->_ip = offset - 1;
 }
 
 void VM::CALL(u2 index) {
-    if (0 > index || index >= this->_file.functions.size()) {
+    auto& file = _shared->file;
+    if (0 > index || index >= file.functions.size()) {
         throw InvalidControlTransfer();
     }
-    Function& calledFunction = this->_file.functions.at(index);
+    Function& calledFunction = file.functions.at(index);
     Context newContext;
     newContext.functionIndex = index;
-    newContext.functionName = std::get<str_t>(this->_file.constants.at(calledFunction.nameIndex).value);
+    newContext.functionName = std::get<str_t>(file.constants.at(calledFunction.nameIndex).value);
 
     newContext.functionLevel = calledFunction.level;
     int newLv = newContext.functionLevel;
@@ -326,12 +457,26 @@ void VM::CALL(u2 index) {
     newContext.prevBP = this->_bp;
     newContext.prevPC = this->_ip;
     ensureStackUsed(calledFunction.paramSize);
+    if (calledFunction.maxDepth == Function::UNBOUNDED) {
+        _checkEachPush = true;
+    }
+    else {
+        // the whole frame of the callee is checked here instead of on each push
+        long long need = static_cast<long long>(calledFunction.maxDepth) - calledFunction.paramSize;
+        long long rest = static_cast<long long>(_stackLimit) - _sp;
+        if (need > rest) {
+            throw StackOverflow(strfmt("stack overflow: calling {} at call depth {} needs {} slots, {} left",
+                newContext.functionName, _contexts.size(), need, rest));
+        }
+        _checkEachPush = false;
+    }
     this->_bp = this->_sp - calledFunction.paramSize;
     newContext.prevSP = this->_bp;
     newContext.BP = this->_bp;
     _contexts.push_back(newContext);
     this->_ip = -1;
     this->_currentInstructions = calledFunction.instructions;
+    _profiled = _profile ? &_profile->functions.at(index) : nullptr;
 }
 
 void VM::RET() {
@@ -343,11 +488,17 @@ void VM::RET() {
     this->_bp = curContext.prevBP;
     this->_ip = curContext.prevPC;
     _contexts.pop_back();
+    publishTop();
     if (_contexts.size() != 1) {
-        this->_currentInstructions = _file.functions.at(_contexts.back().functionIndex).instructions;
+        auto& function = _shared->file.functions.at(_contexts.back().functionIndex);
+        this->_currentInstructions = function.instructions;
+        _checkEachPush = function.maxDepth == Function::UNBOUNDED;
+        _profiled = _profile ? &_profile->functions.at(_contexts.back().functionIndex) : nullptr;
     }
     else {
-        this->_currentInstructions = _file.start;
+        this->_currentInstructions = _start;
+        _checkEachPush = true;
+        _profiled = nullptr;
     }
 }
 
@@ -368,13 +519,13 @@ void VM::dup2() {
 }
 
 void VM::loadc(u2 index) {
-    if (index < 0 || index >= _file.constants.size()) {
+    if (index < 0 || index >= _shared->file.constants.size()) {
         throw;
     }
-    auto& constant = _file.constants.at(index);
+    auto& constant = _shared->file.constants.at(index);
     switch (constant.type)
     {
-    case Constant::Type::STRING: PUSH(_stringLiteralPool.at(index)); break;
+    case Constant::Type::STRING: PUSH(_shared->stringLiteralPool.at(index)); break;
     case Constant::Type::INT:    PUSH(std::get<int_t>(constant.value));    break;
     case Constant::Type::DOUBLE: PUSH(std::get<double_t>(constant.value)); break;
     default: throw; break;
@@ -398,6 +549,15 @@ void VM::snew(addr_t count) {
     INC_SP(count);
 }
 
+void VM::iinc(addr_t offset, int_t value) {
+    *checkAddr(_bp+offset, 1) += value;
+}
+
+void VM::iincs(addr_t offset) {
+    auto value = POP<int_t>();
+    *checkAddr(_bp+offset, 1) += value;
+}
+
 template <typename T>
 void VM::Tload() {
     PUSH(READ<T>(POP<addr_t>()));
@@ -425,6 +585,66 @@ void VM::Tastore() {
     WRITE(addr, value);
 }
 
+// bulk array operations check the whole range once, then run over raw slots
+void VM::iafill() {
+    auto value = POP<int_t>();
+    auto count = POP<int_t>();
+    auto addr = POP<addr_t>();
+    if (count < 0) {
+        throw InvalidMemoryAccess("negative array length");
+    }
+    if (count == 0) {
+        return;
+    }
+    std::fill_n(checkAddr(addr, count), count, value);
+}
+
+void VM::iacopy() {
+    auto count = POP<int_t>();
+    auto src = POP<addr_t>();
+    auto dst = POP<addr_t>();
+    if (count < 0) {
+        throw InvalidMemoryAccess("negative array length");
+    }
+    if (count == 0) {
+        return;
+    }
+    slot_t* from = checkAddr(src, count);
+    slot_t* to = checkAddr(dst, count);
+    std::memmove(to, from, count * sizeof(slot_t));
+}
+
+void VM::iacmp() {
+    auto count = POP<int_t>();
+    auto rhs = POP<addr_t>();
+    auto lhs = POP<addr_t>();
+    if (count < 0) {
+        throw InvalidMemoryAccess("negative array length");
+    }
+    if (count == 0) {
+        PUSH(0);
+        return;
+    }
+    slot_t* l = checkAddr(lhs, count);
+    slot_t* r = checkAddr(rhs, count);
+    if (std::memcmp(l, r, count * sizeof(slot_t)) == 0) {
+        PUSH(0);
+        return;
+    }
+    auto diff = std::mismatch(l, l + count, r);
+    PUSH(*diff.first < *diff.second ? -1 : 1);
+}
+
+// arrays live inline in frames, so an index past the end would reach the neighbouring slots
+void VM::iachk() {
+    auto length = POP<int_t>();
+    auto index = POP<int_t>();
+    if (index < 0 || index >= length) {
+        throw ArrayIndexOutOfRange();
+    }
+    PUSH(index);
+}
+
 template <typename T>
 void VM::Tadd() {
     static_assert(std::is_arithmetic_v<T>);
@@ -458,6 +678,10 @@ void VM::Tdiv() {
         if (rhs == 0) {
             throw DivideByZero();
         }
+        // the quotient does not fit, and x86 idiv would raise SIGFPE
+        if (rhs == -1 && lhs == std::numeric_limits<T>::min()) {
+            throw DivideOverflow();
+        }
     }
     PUSH(lhs/rhs);
 }
@@ -551,6 +775,30 @@ void VM::call(u2 index) {
     CALL(index);
 }
 
+// the params are moved off the stack into the task, its stack starts with them
+void VM::spawn(u2 index) {
+    auto& functions = _shared->file.functions;
+    if (index >= functions.size()) {
+        throw InvalidControlTransfer();
+    }
+    addr_t paramSize = functions.at(index).paramSize;
+    ensureStackUsed(paramSize);
+    auto task = std::make_shared<Task>();
+    task->functionIndex = index;
+    task->params.assign(toStackPtr(_sp - paramSize), toStackPtr(_sp));
+    DEC_SP(paramSize);
+    task->visible = _visible;
+    if (_stackBase != MIN_STACK_ADDR) {
+        task->visible.push_back(_shared->scheduler->segmentOf(_stackBase));
+    }
+    publishTop();
+    PUSH(_shared->scheduler->spawn(std::move(task)));
+}
+
+void VM::join() {
+    PUSH<int_t>(_shared->scheduler->join(POP<int_t>()));
+}
+
 template <typename T>
 void VM::Tret() {
     auto rtv = POP<T>();
@@ -613,6 +861,8 @@ void VM::executeInstruction(const Instruction& ins) {
     case OpCode::loada:   loada(ins.x, ins.y);break;
     case OpCode::_new:    _new();       break;
     case OpCode::snew:    snew(ins.x);  break;
+    case OpCode::iinc:    iinc(ins.x, ins.y); break;
+    case OpCode::iincs:   iincs(ins.x); break;
     
     case OpCode::iload:   Tload<int_t>();      break;
     case OpCode::dload:   Tload<double_t>();   break;
@@ -627,6 +877,10 @@ void VM::executeInstruction(const Instruction& ins) {
     case OpCode::iastore: Tastore<int_t>();    break;
     case OpCode::dastore: Tastore<double_t>(); break;
     case OpCode::aastore: Tastore<addr_t>();   break;
+    case OpCode::iafill:  iafill();            break;
+    case OpCode::iacopy:  iacopy();            break;
+    case OpCode::iacmp:   iacmp();             break;
+    case OpCode::iachk:   iachk();             break;
     
     case OpCode::iadd:    Tadd<int_t>();       break;
     case OpCode::dadd:    Tadd<double_t>();    break;
@@ -655,6 +909,8 @@ void VM::executeInstruction(const Instruction& ins) {
     case OpCode::jle:     jle(ins.x);   break;
 
     case OpCode::call:    call(ins.x);      break;
+    case OpCode::spawn:   spawn(ins.x);     break;
+    case OpCode::join:    join();           break;
     case OpCode::ret:     Tret<void>();     break;
     case OpCode::iret:    Tret<int_t>();    break;
     case OpCode::dret:    Tret<double_t>(); break;
@@ -6,8 +6,13 @@
 #include "./constant.h"
 #include "./function.h"
 #include "./file.h"
+#include "./scheduler.h"
+#include "./profile.h"
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -24,17 +29,44 @@ private:
     static const addr_t MAX_HEAP_ADDR;
     static const addr_t MAX_HEAP_SIZE;
 
+private:
+    // everything the main program and its spawned tasks have in common
+    struct Shared {
+        explicit Shared(File file) : file(std::move(file)) {}
+        File file;
+        // the stack of the main program, which also holds the globals
+        std::unique_ptr<slot_t[]> stack;
+        // slots of the main stack below this may be accessed by tasks, see publishTop()
+        std::atomic<addr_t> mainTop{0};
+        std::unique_ptr<slot_t[]> heap;
+        std::vector<std::pair<addr_t, addr_t>> heapRecord;
+        std::mutex heapMutex;
+        std::unordered_map<vm::u2, addr_t> stringLiteralPool;
+        std::unique_ptr<Scheduler> scheduler;
+        // counters of all finished VMs, null when not profiling
+        std::unique_ptr<Profile> profile;
+        std::mutex profileMutex;
+    };
+
 private:
     bool prepared;
-    File _file;
-    //std::vector<std::shared_ptr<Stack>> stacks;
-    std::unique_ptr<slot_t[]> _stack;
-    std::unique_ptr<slot_t[]> _heap;
-    std::vector<std::pair<addr_t, addr_t>> _heapRecord;
+    std::shared_ptr<Shared> _shared;
+    // the stack this VM runs on, [_stackBase, _stackLimit]
+    slot_t* _stack;
+    addr_t _stackBase;
+    addr_t _stackLimit;
     addr_t _sp;
+    // the segments of the spawners of a task, see Task::visible
+    std::vector<std::pair<int, unsigned>> _visible;
+    // false while running a function whose maxDepth was checked at the call
+    bool _checkEachPush;
     addr_t _bp;
     addr_t _ip;
     int _counterInstruction;
+    // counters of this VM, merged into the shared profile when it stops
+    std::unique_ptr<Profile> _profile;
+    // counters of the running function, null in .start or when not profiling
+    Profile::Function* _profiled;
     // int _counterMicroIns;
     
     struct Context {
@@ -48,8 +80,8 @@ private:
         vm::u2 functionLevel;
     };
     std::vector<Context> _contexts;
+    std::vector<Instruction> _start;
     std::vector<Instruction> _currentInstructions;
-    std::unordered_map<vm::u2, addr_t> _stringLiteralPool;
     
 public:
     VM(File) noexcept;
@@ -59,15 +91,29 @@ public:
 
 public:
     static std::unique_ptr<VM> make_vm(File file);
-    void start();
+    // returns false after reporting a runtime error
+    bool start();
+    // counts executed instructions and taken jumps of the following start()s
+    void enableProfile();
+    // null unless enableProfile() was called
+    const Profile* profile() const;
 
 private: 
+    // a spawned task, running on a segment of the scheduler
+    VM(std::shared_ptr<Shared> shared, slot_t* stack, addr_t base) noexcept;
+    static void runTask(std::shared_ptr<Shared> shared, Task& task, slot_t* stack, addr_t base);
+
     void init() noexcept;
+    void mergeProfile();
     void buildStringLiteralPool();
-    void run();
+    Context globalContext();
+    bool run();
+    void execute();
     void ensureStackRest(addr_t count);
+    void checkStackRest(addr_t count);
     void ensureStackUsed(addr_t count);
     slot_t* checkAddr(addr_t addr, addr_t count);
+    void publishTop();
     slot_t* toHeapPtr(addr_t);
     slot_t* toStackPtr(addr_t);
     void printStackTrace(std::ostream&);
@@ -101,6 +147,8 @@ private:
     
     void _new();
     void snew(addr_t count);
+    void iinc(addr_t offset, int_t value);
+    void iincs(addr_t offset);
     
     template<typename T>
     void Tload();
@@ -110,6 +158,10 @@ private:
     void Tstore();
     template<typename T>
     void Tastore();
+    void iafill();
+    void iacopy();
+    void iacmp();
+    void iachk();
 
     template <typename T>
     void Tadd();
@@ -133,6 +185,8 @@ private:
     void jg(u2 offset); void jle(u2 offset);
 
     void call(u2 index);
+    void spawn(u2 index);
+    void join();
     template <typename T>
     void Tret();
     
@@ -0,0 +1,43 @@
+#!/bin/sh
+# 把 testcase/ 下的每个 c0 程序分别在 VM 中解释执行, 翻译为 C (-a) 和 x86-64 汇编 (-n) 编译后运行, 比较输出和退出码
+# 用法: tests/aot_vs_vm.sh <cc0> [-O0|-O1|-O2]
+# 运行时错误的报告 (包括栈溢出) 也必须一致. 有不一致时退出码为 1
+set -e
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2]}
+level=${2:--O0}
+cc=${CC:-cc}
+dir=$(dirname "$0")/../testcase
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# 读输入的程序都从这里读
+input='20\n3\n5\n1\n2\n-3\n'
+
+status=0
+for src in "$dir"/c[0-9] "$dir"/*.c0; do
+	name=$(basename "$src" .c0)
+	"$cc0" -c $level "$src" -o "$work/$name.o0"
+	"$cc0" -a $level "$src" -o "$work/$name.c"
+	"$cc0" -n $level "$src" -o "$work/$name.s"
+	$cc -O2 "$work/$name.c" -o "$work/$name.aot" -pthread
+	$cc "$work/$name.s" -o "$work/$name.native" -pthread
+	printf "$input" | "$cc0" --run "$work/$name.o0" > "$work/vm.out" 2>&1 && rc=0 || rc=$?
+	echo "exit $rc" >> "$work/vm.out"
+	ok=true
+	for other in aot native; do
+		printf "$input" | "$work/$name.$other" > "$work/$other.out" 2>&1 && rc=0 || rc=$?
+		echo "exit $rc" >> "$work/$other.out"
+		if ! cmp -s "$work/vm.out" "$work/$other.out"; then
+			echo "$name: $other output differs from the VM"
+			diff "$work/vm.out" "$work/$other.out" | head -20
+			ok=false
+		fi
+	done
+	if $ok; then
+		echo "$name: OK"
+	else
+		echo "$name: FAILED"
+		status=1
+	fi
+done
+exit $status
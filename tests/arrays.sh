@@ -0,0 +1,97 @@
+#!/bin/sh
+# 数组下标越界: VM, 翻译为 C (-a) 和 x86-64 汇编 (-n) 的程序都在越界的访问处报告运行时错误, 之前的输出不变
+# 用法: tests/arrays.sh <cc0> [-O0|-O1|-O2]
+# 有失败的检查时退出码为 1
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2]}
+level=${2:--O0}
+cc=${CC:-cc}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+# 读输入的程序都从这里读
+input='20\n3\n5\n1\n2\n-3\n'
+
+status=0
+pass() { echo "$1: OK"; }
+fail() { echo "$1: FAILED"; status=1; }
+
+# expect <名字> <越界之前的输出>: 标准输入中的程序在三种后端中都先输出这些, 再报告越界, 退出码为 1
+expect() {
+	cat > "$1.c0"
+	ok=true
+	"$cc0" -c $level "$1.c0" -o "$1.o0" && "$cc0" -a $level "$1.c0" -o "$1.c" && "$cc0" -n $level "$1.c0" -o "$1.s" \
+		&& $cc -O2 "$1.c" -o "$1.aot" -pthread && $cc "$1.s" -o "$1.native" -pthread || ok=false
+	for backend in vm aot native; do
+		$ok || break
+		case $backend in
+			vm) printf "$input" | "$cc0" --run "$1.o0" > "$1.out" 2>&1 && rc=0 || rc=$? ;;
+			*) printf "$input" | "./$1.$backend" > "$1.out" 2>&1 && rc=0 || rc=$? ;;
+		esac
+		if [ $rc -ne 1 ] || [ "$(sed -n '/^runtime error: /q;p' "$1.out")" != "$2" ] \
+			|| ! grep -qx "runtime error: array index out of range !" "$1.out"; then
+			echo "$1: $backend:"
+			head -5 "$1.out"
+			ok=false
+		fi
+	done
+	if $ok; then pass "$1"; else fail "$1"; fi
+}
+
+# 读入的下标超过局部数组的长度
+expect local_past_end "1 0" <<'EOF'
+int main() {
+	int a[4] = 1, i;
+	scan(i);
+	print(a[0], a[3] - 1);
+	a[i] = 7;
+	print(a[0]);
+	return 0;
+}
+EOF
+# 负的下标, 数组参数的长度是调用者传入的长度
+expect parameter_negative "3 8" <<'EOF'
+int get(int a[], int i) {
+	return a[i];
+}
+int main() {
+	int a[3] = 8, n, k;
+	scan(n);
+	scan(k);
+	print(k, get(a, k - 1));
+	scan(n);
+	scan(n);
+	scan(n);
+	scan(n);
+	print(get(a, n));
+	return 0;
+}
+EOF
+# 全局数组, 复合赋值
+expect global_element "5" <<'EOF'
+int g[5];
+int main() {
+	int n;
+	scan(n);
+	g[n / 5] = 5;
+	print(g[4]);
+	g[n / 4] += 1;
+	print(g[0]);
+	return 0;
+}
+EOF
+# 整个数组复制和比较时, 数组参数的长度至少是访问的元素个数
+expect parameter_too_short "6" <<'EOF'
+int first(int a[]) {
+	int t[4];
+	t = a;
+	return t[0];
+}
+int main() {
+	int a[4] = 6, b[3] = 2;
+	print(first(a));
+	print(first(b));
+	return 0;
+}
+EOF
+exit $status
@@ -0,0 +1,57 @@
+#!/bin/sh
+# 编译错误: 报告的位置和信息
+# 用法: tests/errors.sh <cc0>
+# 有失败的检查时退出码为 1
+cc0=${1:?usage: $0 <cc0>}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+status=0
+pass() { echo "$1: OK"; }
+fail() { echo "$1: FAILED"; status=1; }
+
+# expect <名字> <报告中应有的内容>: 标准输入中的程序编译失败, 并报告这些内容
+expect() {
+	cat > "$1.c0"
+	if "$cc0" -c "$1.c0" -o "$1.o0" > "$1.err" 2>&1; then
+		fail "$1"
+	elif grep -qF "$2" "$1.err"; then
+		pass "$1"
+	else
+		fail "$1"
+		cat "$1.err"
+	fi
+}
+
+# 取最长的运算符: a--2 和 a++2 中的 -- 和 ++ 后面不能跟操作数, 报告指向 -- 和 ++ (行列都从 0 开始)
+message="'++' or '--' cannot be followed by an operand here; write '- -' or '+ +' for two signs, e.g. a - -2."
+expect minus_minus_operand "Line: 2 Column: 8 Error: $message" <<'EOF'
+int main() {
+	int a = 1;
+	print(a--2);
+	return 0;
+}
+EOF
+expect plus_plus_operand "Line: 3 Column: 12 Error: $message" <<'EOF'
+int main() {
+	int a = 1, b;
+	b = 4;
+	print(b, a ++2);
+	return 0;
+}
+EOF
+# 分开写的两个符号照旧是减去 (加上) 一个负数 (正数)
+cat > two_signs.c0 <<'EOF'
+int main() {
+	int a = 1;
+	print(a - -2, a+ +2, a - - 2);
+	return 0;
+}
+EOF
+if "$cc0" -c two_signs.c0 -o two_signs.o0 && [ "$("$cc0" --run two_signs.o0)" = "3 3 3" ]; then
+	pass two_signs
+else
+	fail two_signs
+fi
+exit $status
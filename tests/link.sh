@@ -0,0 +1,139 @@
+#!/bin/sh
+# 分离编译和链接: 分开编译再链接的程序与整个编译的程序输出一致, 链接错误都能报告
+# 用法: tests/link.sh <cc0> [-O0|-O1|-O2]
+# 有失败的检查时退出码为 1
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2]}
+level=${2:--O0}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+status=0
+pass() { echo "$1: OK"; }
+fail() { echo "$1: FAILED"; status=1; }
+
+# 两个文件互相调用, 各有全局变量, .start 都有代码
+cat > a.c0 <<'EOF'
+int counter = 5;
+int fib(int n);
+void bump(int k);
+int twice(int x) {
+	counter = counter + x;
+	return x * 2;
+}
+int main() {
+	int i = 0;
+	while (i < 10) {
+		print(fib(i), twice(i));
+		i = i + 1;
+	}
+	bump(3);
+	print(counter);
+	return 0;
+}
+EOF
+cat > b.c0 <<'EOF'
+int g1 = 100, g2;
+int twice(int x);
+int fib(int n) {
+	if (n < 2) return n;
+	g2 = g2 + 1;
+	return fib(n - 1) + fib(n - 2);
+}
+void bump(int k) {
+	g1 = g1 + twice(k);
+	print(g1, g2);
+}
+EOF
+# 同样的程序放在一个文件里
+cat > all.c0 <<'EOF'
+int counter = 5;
+int g1 = 100, g2;
+int twice(int x) {
+	counter = counter + x;
+	return x * 2;
+}
+int fib(int n) {
+	if (n < 2) return n;
+	g2 = g2 + 1;
+	return fib(n - 1) + fib(n - 2);
+}
+void bump(int k) {
+	g1 = g1 + twice(k);
+	print(g1, g2);
+}
+int main() {
+	int i = 0;
+	while (i < 10) {
+		print(fib(i), twice(i));
+		i = i + 1;
+	}
+	bump(3);
+	print(counter);
+	return 0;
+}
+EOF
+
+# 全局变量和 .start 的跳转按文件重定位, 输出与整个编译的一致
+"$cc0" -c $level all.c0 -o all.o0 && "$cc0" --run all.o0 > all.out 2>&1
+if "$cc0" --object $level a.c0,b.c0 -j 2 && "$cc0" --link a.co,b.co -o ab.o0 \
+	&& "$cc0" --run ab.o0 > ab.out 2>&1 && cmp -s all.out ab.out; then
+	pass relocation
+else
+	fail relocation
+fi
+
+# 两个文件都用到的函数名只保留一个常量
+if "$cc0" --link a.co,b.co -o ab.s0 && [ "$(grep -c ' S "twice"' ab.s0)" = 1 ] && [ "$(grep -c ' S "fib"' ab.s0)" = 1 ]; then
+	pass dedup
+else
+	fail dedup
+fi
+
+# 同一个文件中先声明后定义, 声明之前的调用也用这个定义
+cat > rec.c0 <<'EOF'
+int rec(int n);
+int main() {
+	print(rec(4));
+	return 0;
+}
+int rec(int n) {
+	if (n == 0) return 0;
+	return rec(n - 1) + n;
+}
+EOF
+if "$cc0" --object $level rec.c0 && "$cc0" --link rec.co -o rec.o0 && [ "$("$cc0" --run rec.o0)" = 10 ]; then
+	pass prototype
+else
+	fail prototype
+fi
+
+# 与声明不一致的定义是编译错误
+printf 'int f(int a);\nint f(int a, int b) { return a; }\n' > conflict.c0
+if ! "$cc0" --object $level conflict.c0 2> conflict.err && grep -q "does not match its earlier declaration" conflict.err; then
+	pass "conflicting definition"
+else
+	fail "conflicting definition"
+fi
+
+# 链接错误
+expect_link_error() {
+	name=$1
+	message=$2
+	shift 2
+	if ! "$cc0" --link "$@" -o bad.o0 2> bad.err && grep -q "$message" bad.err; then
+		pass "$name"
+	else
+		fail "$name"
+	fi
+}
+printf 'int fib(int n) { return n; }\n' > dup.c0
+printf 'int fib(int n, int m);\nint main() { print(fib(1, 2)); return 0; }\n' > params.c0
+printf 'void fib(int n);\nint main() { fib(1); return 0; }\n' > ret.c0
+"$cc0" --object $level dup.c0,params.c0,ret.c0
+expect_link_error duplicate "duplicate definition of function fib" a.co,b.co,dup.co
+expect_link_error undefined "undefined function fib" a.co
+expect_link_error "undefined main" "undefined function main" b.co
+expect_link_error "conflicting params" "conflicting declarations of function fib" params.co,b.co
+expect_link_error "conflicting return" "conflicting declarations of function fib" ret.co,b.co
+exit $status
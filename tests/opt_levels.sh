@@ -0,0 +1,400 @@
+#!/bin/sh
+# 优化不改变程序的输出: 每个程序分别用 -O0, -O2 和 -O0 只开一个遍编译, 在 VM 中运行, 比较输出和退出码.
+# 给了统计项时, 还检查只开这个遍时 --pass-stats 中有这些项, 即这个遍确实改了程序
+# 用法: tests/opt_levels.sh <cc0>
+# 有不一致时退出码为 1
+cc0=${1:?usage: $0 <cc0>}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+status=0
+# fires <名字> <遍> <统计项> ...: 只开 <遍> 编译 <名字>.c0 时 --pass-stats 中有所有的统计项
+fires() {
+	name=$1
+	pass=$2
+	shift 2
+	"$cc0" -c -O0 --enable-passes "$pass" --pass-stats "$name.c0" -o "$name.o0" 2> "$name.stats"
+	for stat in "$@"; do
+		if ! grep -q "^    $stat: " "$name.stats"; then
+			echo "$name ($pass does not report '$stat'): FAILED"
+			cat "$name.stats"
+			return 1
+		fi
+	done
+}
+
+# check <名字> <遍> [<统计项> ...]: 比较 <名字>.c0 在 -O0, -O2 和 -O0 --enable-passes <遍> 下的运行结果
+check() {
+	if [ $# -gt 2 ] && ! fires "$@"; then
+		status=1
+		return
+	fi
+	for opt in "-O0" "-O2" "-O0 --enable-passes $2"; do
+		if "$cc0" -c $opt "$1.c0" -o "$1.o0" > "$1.out" 2>&1; then
+			"$cc0" --run "$1.o0" > "$1.out" 2>&1 && rc=0 || rc=$?
+		else
+			rc=compile
+		fi
+		echo "exit $rc" >> "$1.out"
+		if [ "$opt" = -O0 ]; then
+			if [ "$rc" = compile ]; then
+				echo "$1: FAILED"
+				cat "$1.out"
+				status=1
+				return
+			fi
+			mv "$1.out" "$1.expected"
+		elif ! cmp -s "$1.expected" "$1.out"; then
+			echo "$1 ($opt): FAILED"
+			diff "$1.expected" "$1.out" | head -10
+			status=1
+			return
+		fi
+	done
+	echo "$1: OK"
+}
+
+# 没有局部变量的函数以循环开始时, 入口块就是循环头, cse 的临时 slot 不能在循环中分配
+cat > cse_entry_loop.c0 <<'X'
+int s;
+int f(int a, int b) {
+	while (a > 0) {
+		print(a * b + b);
+		if (a > 2) print(a * b + b);
+		a = a - 1;
+	}
+	return 0;
+}
+int g(int a, int b) {
+	while (a > 0) {
+		s = s + (a * b + b);
+		if (a > 5) s = s - (a * b + b);
+		a = a - 1;
+	}
+	return s;
+}
+int main() {
+	f(5, 3);
+	print(g(20000000, 3));
+	return 0;
+}
+X
+check cse_entry_loop cse
+
+# 同样, 入口块是外层循环的头时, licm 的临时 slot 也不能在外层循环中分配
+cat > licm_entry_loop.c0 <<'X'
+int g = 7;
+int f(int a, int b) {
+	while (a > 0) {
+		while (b < a * g + 3) {
+			b = b + 1;
+		}
+		b = 0;
+		a = a - 1;
+	}
+	return b;
+}
+int h(int a, int b) {
+	while (a > 0) {
+		while (b < g * 3) {
+			b = b + 1;
+		}
+		b = b - g * 3;
+		a = a - 1;
+	}
+	return b;
+}
+int main() {
+	print(f(3, 0));
+	print(h(20000000, 0));
+	return 0;
+}
+X
+check licm_entry_loop licm
+
+# 常量和常量表达式折叠, 由常量决定的分支去掉一边
+cat > const_prop.c0 <<'Y'
+const int N = 6, M = N * 7 - 2;
+int g = 3;
+int f(int x) {
+	const int k = M / N + 1;
+	int a[4] = 2;
+	int i = 0;
+	if (k > 100) print(-1);
+	else print(k);
+	while (i < N) {
+		x = x + k * 2 - (N - 6) + a[3];
+		i += k - 6;
+	}
+	x -= 0 - M;
+	return x * 1 + g / (N - 5);
+}
+int main() {
+	print(M, -N, N / 4, M - 50);
+	print(f(1), f(-7));
+	return 0;
+}
+Y
+check const_prop const-prop "branches folded"
+
+# 返回之后和永远不成立的分支中的代码, 之后不再读的写入, 没有调用的函数都去掉
+cat > dce.c0 <<'Y'
+int g;
+int unused(int x) {
+	return x * 2;
+}
+int alsoUnused() {
+	return unused(3);
+}
+int f(int x) {
+	int dead = x * 3;
+	int y = x + 1;
+	dead = y;
+	if (x > 5) {
+		return y;
+		print(-1);
+		y = 7;
+	}
+	while (0 > 1) {
+		print(-2);
+	}
+	g = y;
+	return y * 2;
+	print(-3);
+}
+int main() {
+	print(f(2), f(9), g);
+	return 0;
+	print(-4);
+}
+Y
+check dce dce "unreachable blocks removed" "dead stores removed" "functions removed"
+
+# 小函数在调用处展开: 有返回值的, void 的, 结果被丢弃的, 有多个 return 的, 修改全局变量的; 递归函数不展开
+cat > inline.c0 <<'Y'
+int g = 1;
+int sq(int x) {
+	return x * x;
+}
+int sign(int x) {
+	if (x < 0) return -1;
+	if (x == 0) return 0;
+	return 1;
+}
+void bump(int k) {
+	g = g + k;
+}
+int next() {
+	g = g * 2;
+	return g;
+}
+int fact(int n) {
+	if (n < 2) return 1;
+	return n * fact(n - 1);
+}
+int main() {
+	int i = -2;
+	while (i <= 2) {
+		print(sq(i) + sq(i + 1), sign(i), sign(sq(i)));
+		bump(i);
+		next();
+		i = i + 1;
+	}
+	print(g, next(), fact(6));
+	return 0;
+}
+Y
+check inline inline "calls inlined" "inlined sq into main" "inlined bump into main"
+
+# 重复的读取和相同的子表达式只算一次; 中间有写入或调用时重新读取
+cat > cse.c0 <<'Y'
+int g = 5;
+int a[4] = 2;
+void touch() {
+	g = g + 1;
+	a[1] = a[1] * 3;
+}
+int f(int x, int y) {
+	int s = (x * y + g) + (x * y + g);
+	int t = g * g;
+	print(x * y - 1);
+	print(x * y - 1);
+	print(s, t, a[1] + a[1]);
+	touch();
+	print(x * y + g, g * g, a[1] + a[1]);
+	g = x;
+	s = s + (x * y + g) * (x * y + g);
+	a[y] = 9;
+	return s + a[1] + a[y] + a[1];
+}
+int main() {
+	print(f(3, 1), f(-2, 2));
+	return 0;
+}
+Y
+check cse cse "values reused with dup" "values reused from temporaries" "values reused from slots"
+
+# 循环中不变的表达式移到循环之前; 循环中写入的变量, 以及调用之后的表达式不移
+cat > licm.c0 <<'Y'
+int g = 4;
+int h(int x) {
+	g = g + x;
+	return g;
+}
+int f(int n, int k) {
+	int s = 0;
+	int i = 0;
+	while (i < n) {
+		s = s + (k * g + 3) - i;
+		if (i > 2) s = s - k * k;
+		i = i + 1;
+	}
+	i = 0;
+	while (i < n) {
+		s = s + g * 2;
+		if (i == 1) h(1);
+		i = i + 1;
+	}
+	while (n > 0) {
+		s = s + 100 / k;
+		n = n - 1;
+	}
+	return s;
+}
+int main() {
+	print(f(5, 3), f(0, 7), g);
+	print(f(3, -2));
+	return 0;
+}
+Y
+check licm licm "expressions hoisted" "preheaders inserted"
+
+# 跳到只有 jmp 的块的跳转直接跳到目的地, 循环条件复制到循环末尾, 块按更可能的后继排列.
+# 空的 if/else, 嵌套循环中的 return, 以及两个后继相同的条件跳转
+cat > jumps.c0 <<'Y'
+int g;
+int find(int n, int k) {
+	int i = 0, j;
+	while (i < n) {
+		j = 0;
+		while (j < i) {
+			if (i * j == k) return i * 100 + j;
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+	return -1;
+}
+int classify(int x) {
+	int r = 0;
+	if (x > 0) {
+		if (x > 10) {
+			if (x > 100) r = 3;
+			else r = 2;
+		} else {
+		}
+		r = r + 1;
+	} else if (x == 0) {
+	} else {
+		r = -1;
+	}
+	if (x == 7) {
+	}
+	while (x > 1000) x = x / 2;
+	return r + x;
+}
+int main() {
+	int i = -3;
+	print(find(10, 12), find(5, 100), find(0, 0));
+	while (i < 200) {
+		g = g + classify(i);
+		i = i + 13;
+	}
+	print(g, classify(5000));
+	return 0;
+}
+Y
+cp jumps.c0 jump_threading.c0
+cp jumps.c0 loop_rotate.c0
+cp jumps.c0 block_layout.c0
+check jump_threading jump-threading "jumps threaded" "branches removed"
+check loop_rotate loop-rotate "loops rotated"
+check block_layout block-layout "layouts changed" "branches inverted"
+
+# && 和 || 短路求值: 右边有副作用 (打印, 修改全局变量, 除以 0) 时, 不需要时不求值; ! 取反整个条件
+cat > short_circuit.c0 <<'Y'
+int calls;
+int t(int v) {
+	calls = calls + 1;
+	print(v);
+	return v;
+}
+int main() {
+	int x = 0;
+	if (x != 0 && 10 / x > 1) print(-1);
+	if (x == 0 || 10 / x > 1) print(1);
+	if (t(0) && t(11)) print(-2);
+	if (t(12) || t(13)) print(2);
+	if (t(14) && t(0) || t(15)) print(3);
+	if (!(t(0) || t(16) && t(0))) print(4);
+	if (!(x < 1) || !!(x == 0) && !(calls > 100)) print(5);
+	while (x < 10 && t(x) != 3) x = x + 1;
+	print(x, calls);
+	return 0;
+}
+Y
+"$cc0" -c -O0 short_circuit.c0 -o short_circuit.o0 && "$cc0" --run short_circuit.o0 > short_circuit.out 2>&1
+if [ "$(tr '\n' ' ' < short_circuit.out)" = "1 0 12 2 14 0 15 3 0 16 0 4 5 0 1 2 3 3 12 " ]; then
+	check short_circuit block-layout "layouts changed"
+else
+	echo "short_circuit (-O0 evaluates the wrong operands): FAILED"
+	cat short_circuit.out
+	status=1
+fi
+
+# 生存期不重叠的局部变量共用 slot, 数组和没有初值的变量在入口处一起分配; 数组的地址传出时保持数组的位置
+cat > frame_layout.c0 <<'EOF'
+int sum(int a[], int n) {
+	int s = 0;
+	while (n > 0) {
+		n = n - 1;
+		s = s + a[n];
+	}
+	return s;
+}
+int local(int x) {
+	int a = x * 2;
+	int c;
+	int d = 5;
+	int arr[4];
+	int e;
+	c = a * d;
+	arr[1] = c + x;
+	e = arr[1] - a;
+	print(c, e);
+	return e;
+}
+int passed(int x) {
+	int y = x + 1;
+	int z;
+	int arr[3] = 2;
+	int w = 4;
+	arr[0] = y;
+	z = sum(arr, 3);
+	return z + y + w;
+}
+int main() {
+	int i = 0;
+	int unused;
+	int k = 7;
+	while (i < 3) {
+		print(local(i + k), passed(i));
+		i = i + 1;
+	}
+	return 0;
+}
+EOF
+check frame_layout frame-layout "slots saved" "allocations merged" "initialisations turned into stores"
+
+exit $status
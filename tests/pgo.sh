@@ -0,0 +1,129 @@
+#!/bin/sh
+# profile 引导的优化: 用不用 -fprofile-use 输出都一样, 过期的 profile 不起作用, spawn 的任务的计数都合并到 profile 中
+# 用法: tests/pgo.sh <cc0>
+# 有失败的检查时退出码为 1
+cc0=${1:?usage: $0 <cc0>}
+dir=$(dirname "$0")/..
+dir=$(cd "$dir" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+# 读输入的程序都从这里读
+input='20\n3\n5\n1\n2\n-3\n'
+
+status=0
+pass() { echo "$1: OK"; }
+fail() { echo "$1: FAILED"; status=1; }
+
+# 运行 $2 并把输出和退出码写入 $1
+run() {
+	out=$1
+	shift
+	printf "$input" | "$@" > "$out" 2>&1 && rc=0 || rc=$?
+	echo "exit $rc" >> "$out"
+}
+
+# 用 -O0 的程序训练, 再用 -O1 和 -O2 分别编译有和没有 profile 的程序, 输出和退出码都一致
+for src in "$dir"/testcase/c[0-9] "$dir"/testcase/*.c0 "$dir"/bench/*.c0; do
+	name=$(basename "$src" .c0)
+	ok=true
+	# 出错的运行也写出 profile, 所以不看训练运行的退出码
+	"$cc0" -c -O0 "$src" -o "$name.o0" && printf "$input" | "$cc0" --run "$name.o0" -fprofile-generate "$name.prof" > /dev/null 2>&1
+	if [ -s "$name.prof" ]; then
+		for level in -O1 -O2; do
+			"$cc0" -c $level "$src" -o plain.o0 && "$cc0" -c $level -fprofile-use "$name.prof" "$src" -o pgo.o0 || { ok=false; break; }
+			run plain.out "$cc0" --run plain.o0
+			run pgo.out "$cc0" --run pgo.o0
+			cmp -s plain.out pgo.out || { ok=false; diff plain.out pgo.out | head -10; break; }
+		done
+	else
+		ok=false
+	fi
+	if $ok; then pass "$name"; else fail "$name"; fi
+done
+
+# 源代码改过之后, 指令数对不上的函数不使用 profile: 编译结果与没有 profile 时相同
+cat > old.c0 <<'EOF'
+int f(int n) {
+	int s = 0;
+	while (n > 0) {
+		if (n / 3 * 3 == n) s = s + n;
+		n = n - 1;
+	}
+	return s;
+}
+int main() {
+	print(f(1000));
+	return 0;
+}
+EOF
+cat > new.c0 <<'EOF'
+int f(int n) {
+	int s = 0;
+	while (n > 0) {
+		if (n / 3 * 3 == n) s = s + n;
+		else s = s - 1;
+		n = n - 1;
+	}
+	return s;
+}
+int main() {
+	print(f(1000));
+	print(f(10));
+	return 0;
+}
+EOF
+"$cc0" -c -O0 old.c0 -o old.o0 && "$cc0" --run old.o0 -fprofile-generate old.prof > /dev/null
+"$cc0" -s -O2 new.c0 -o plain.s0
+if "$cc0" -s -O2 --pass-stats -fprofile-use old.prof new.c0 -o stale.s0 2> stale.err \
+	&& grep -q "functions not in the profile: 2" stale.err && ! grep -q "functions profiled" stale.err \
+	&& cmp -s plain.s0 stale.s0; then
+	pass "stale profile"
+else
+	fail "stale profile"
+fi
+
+# spawn 的任务有自己的计数, 结束时合并: 与直接调用的程序中同一个函数的计数相同
+task_program() {
+	cat <<EOF
+int work(int k) {
+	int i = 0, s = 0;
+	while (i < k) {
+		if (i / 2 * 2 == i) s = s + i;
+		i = i + 1;
+	}
+	return s;
+}
+int main() {
+	int h[16];
+	int i = 0;
+	while (i < 16) {
+		h[i] = $1 work(1000 * i);
+		i = i + 1;
+	}
+	i = 0;
+	while (i < 16) {
+		print($2);
+		i = i + 1;
+	}
+	return 0;
+}
+EOF
+}
+task_program spawn 'join(h[i])' > par.c0
+task_program '' 'h[i]' > seq.c0
+# .F0 work 的计数, 到下一个函数为止
+work_counts() {
+	awk '/^\.F/ { on = ($2 == "work") } on' "$1"
+}
+for p in par seq; do
+	"$cc0" -c -O0 $p.c0 -o $p.o0 && "$cc0" --run $p.o0 -fprofile-generate $p.prof > $p.out
+done
+if [ -s par.prof ] && cmp -s par.out seq.out && [ -n "$(work_counts par.prof)" ] \
+	&& [ "$(work_counts par.prof)" = "$(work_counts seq.prof)" ] && grep -qx "0 16" par.prof; then
+	pass "task profiles merged"
+else
+	fail "task profiles merged"
+fi
+exit $status
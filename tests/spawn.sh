@@ -0,0 +1,185 @@
+#!/bin/sh
+# spawn/join: 并行计算的结果与顺序计算一致, 任务的错误在 join 时报告, 没有 join 的任务也会执行
+# 用法: tests/spawn.sh <cc0> [-O0|-O1|-O2]
+# 每个程序都在 VM 中解释执行, 并翻译为 C (-a) 编译后运行. 有失败的检查时退出码为 1
+cc0=${1:?usage: $0 <cc0> [-O0|-O1|-O2]}
+level=${2:--O0}
+cc=${CC:-cc}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+status=0
+pass() { echo "$1: OK"; }
+fail() { echo "$1: FAILED"; status=1; }
+
+# 编译 $1.c0 为 $1.o0 和可执行文件 $1
+build() {
+	"$cc0" -c $level "$1.c0" -o "$1.o0" && "$cc0" -a $level "$1.c0" -o "$1.c" \
+		&& $cc -O2 "$1.c" -o "$1" -pthread
+}
+
+# 运行 $2 并把输出和退出码写入 $1
+run() {
+	out=$1
+	shift
+	"$@" > "$out" 2>&1 && rc=0 || rc=$?
+	echo "exit $rc" >> "$out"
+}
+
+# 分治的 fib 和数组求和, 并行的结果与顺序的一致
+cat > par.c0 <<'EOF'
+int fib(int n) {
+	if (n < 2) return n;
+	return fib(n - 1) + fib(n - 2);
+}
+int pfib(int n) {
+	int a, b;
+	if (n < 12) return fib(n);
+	a = spawn pfib(n - 1);
+	b = spawn pfib(n - 2);
+	return join(a) + join(b);
+}
+int sum(int a[], int lo, int hi) {
+	int s = 0;
+	while (lo < hi) {
+		s = s + a[lo] * lo;
+		lo = lo + 1;
+	}
+	return s;
+}
+int psum(int a[], int lo, int hi) {
+	int mid, h;
+	if (hi - lo <= 64) return sum(a, lo, hi);
+	mid = (lo + hi) / 2;
+	h = spawn psum(a, lo, mid);
+	return psum(a, mid, hi) + join(h);
+}
+int main() {
+	int arr[1000] = 3;
+	int i = 0;
+	while (i < 22) {
+		print(i, fib(i), pfib(i));
+		i = i + 1;
+	}
+	print(sum(arr, 0, 1000), psum(arr, 0, 1000));
+	return 0;
+}
+EOF
+build par && run vm.out "$cc0" --run par.o0 && run aot.out ./par
+if awk 'NF == 3 && $2 != $3 { bad = 1 } END { exit bad }' vm.out \
+	&& grep -qx "1498500 1498500" vm.out && grep -qx "exit 0" vm.out && cmp -s vm.out aot.out; then
+	pass "parallel = sequential"
+else
+	fail "parallel = sequential"
+fi
+
+# 任务中的错误在 join 时报告, join 之前的输出保留, 之后的不执行, 退出码非 0
+cat > fault.c0 <<'EOF'
+int div(int a, int b) {
+	return a / b;
+}
+int main() {
+	int h = spawn div(6, 0);
+	print(1);
+	print(join(h));
+	print(2);
+	return 0;
+}
+EOF
+build fault && run vm.out "$cc0" --run fault.o0 && run aot.out ./fault
+if grep -q "divide integer by zero in spawned task" vm.out && grep -q "function div at instruction" vm.out \
+	&& grep -q "function main at instruction .* : join" vm.out \
+	&& [ "$(head -1 vm.out)" = 1 ] && ! grep -qx 2 vm.out && ! grep -qx "exit 0" vm.out \
+	&& cmp -s vm.out aot.out; then
+	pass "fault at join"
+else
+	fail "fault at join"
+fi
+
+# 没有 join 的任务在程序结束前执行完, 它们再 spawn 的任务也一样
+cat > unjoined.c0 <<'EOF'
+int g = 0;
+void leaf(int k) {
+	print(k);
+}
+void add(int k) {
+	g = g + k;
+	spawn leaf(k + 1);
+}
+int main() {
+	spawn add(7);
+	return 0;
+}
+EOF
+build unjoined && run vm.out "$cc0" --run unjoined.o0 && run aot.out ./unjoined
+if [ "$(cat vm.out)" = "$(printf '8\nexit 0')" ] && cmp -s vm.out aot.out; then
+	pass "unjoined"
+else
+	fail "unjoined"
+fi
+
+# 传给任务的数组只在声明它的函数返回之前可用: 返回后的栈帧, 和已结束的任务的栈段 (可能已经给了别的任务) 都不能再访问,
+# 函数返回之前 join 的任务可以读写. 只有 VM 检查
+cat > lifetime.c0 <<'EOF'
+int use(int a[]) {
+	int i = 0;
+	while (i < 3000000) i = i + 1;
+	a[1] = 5;
+	return a[0];
+}
+void returned() {
+	int a[4] = 1;
+	spawn use(a);
+}
+int finished(int n) {
+	int a[4] = 1;
+	spawn use(a);
+	return n;
+}
+int joined(int n) {
+	int a[4] = 7;
+	int h = spawn use(a);
+	return join(h) + a[1] + n;
+}
+int main() {
+	int which;
+	int b[2] = 3;
+	scan(which);
+	if (which == 1) returned();
+	if (which == 2) print(join(spawn finished(1)), join(spawn finished(2)));
+	print(join(spawn joined(1)), join(spawn use(b)), b[1]);
+	return 0;
+}
+EOF
+"$cc0" -c $level lifetime.c0 -o lifetime.o0
+echo 0 | run live.out "$cc0" --run lifetime.o0
+echo 1 | run frame.out "$cc0" --run lifetime.o0
+echo 2 | run segment.out "$cc0" --run lifetime.o0
+if [ "$(cat live.out)" = "$(printf '13 3 5\nexit 0')" ] \
+	&& grep -q "tried to access unused stack memory of another task in spawned task" frame.out && ! grep -qx "exit 0" frame.out \
+	&& grep -q "tried to access unexistent memory in spawned task" segment.out && ! grep -qx "exit 0" segment.out; then
+	pass "array lifetime"
+else
+	fail "array lifetime"
+fi
+
+# 同时运行的任务数有上限: 每一层都在 join 里运行下一层, 栈段用完时报告错误 (只有 VM 有这个限制)
+cat > chain.c0 <<'EOF'
+int chain(int n) {
+	if (n == 0) return 0;
+	return join(spawn chain(n - 1)) + 1;
+}
+int main() {
+	print(chain(100));
+	print(chain(2000));
+	return 0;
+}
+EOF
+"$cc0" -c $level chain.c0 -o chain.o0 && run vm.out "$cc0" --run chain.o0
+if [ "$(head -1 vm.out)" = 100 ] && grep -q "too many running tasks" vm.out && ! grep -qx "exit 0" vm.out; then
+	pass "too many running tasks"
+else
+	fail "too many running tasks"
+fi
+exit $status
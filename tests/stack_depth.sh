@@ -0,0 +1,96 @@
+#!/bin/sh
+# .o0 中每个函数的最大栈深度: 版本 2 的文件记录正确的深度, 记录得太小的文件被拒绝, 栈溢出在调用处报告,
+# 没有记录深度的版本 1 的文件 (testcase/*.o0) 照旧可以运行
+# 用法: tests/stack_depth.sh <cc0>
+# 有失败的检查时退出码为 1
+cc0=${1:?usage: $0 <cc0>}
+cc=${CC:-cc}
+dir=$(dirname "$0")/..
+dir=$(cd "$dir" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work" || exit 1
+
+# 读输入的程序都从这里读
+input='20\n3\n5\n1\n2\n-3\n'
+
+status=0
+pass() { echo "$1: OK"; }
+fail() { echo "$1: FAILED"; status=1; }
+
+# 运行 $2 并把输出和退出码写入 $1
+run() {
+	out=$1
+	shift
+	printf "$input" | "$@" > "$out" 2>&1 && rc=0 || rc=$?
+	echo "exit $rc" >> "$out"
+}
+
+# 文件的十六进制内容
+hex() {
+	xxd -p "$1" | tr -d '\n'
+}
+
+# f 的栈帧有 3 个 slot (参数 n, a, b), 计算 a * b 时栈上再多 3 个值, 所以最大深度是 6
+cat > deep.c0 <<'EOF'
+int f(int n) {
+	int a = n, b = n + 1;
+	if (n == 0) return 0;
+	return f(n - 1) + a * b - n * n;
+}
+int main() {
+	int n;
+	scan(n);
+	print(f(n * 1000));
+	scan(n);
+	print(f(n * 10000000));
+	return 0;
+}
+EOF
+"$cc0" -c -O0 deep.c0 -o deep.o0
+"$cc0" -s -O0 deep.c0 -o deep.s0
+# 魔数, 版本 2
+if [ "$(hex deep.o0 | cut -c1-16)" = "43303a2900000002" ]; then pass "version 2"; else fail "version 2"; fi
+# f: 名字是常量 0, 1 个参数, 层次 1, 栈帧 3, 最大深度 6
+record=0000000100010000000300000006
+if hex deep.o0 | grep -q "$record"; then pass "recorded depth"; else fail "recorded depth"; fi
+# VM 只检查调用处, 所以加载时重新计算深度, 记录得比它小的文件不能运行
+hex deep.o0 | sed "s/$record/0000000100010000000300000005/" | xxd -r -p > small.o0
+run small.out "$cc0" --run small.o0
+if grep -q "invalid binary file: max stack depth of function too small" small.out && ! grep -qx "exit 0" small.out; then
+	pass "depth too small"
+else
+	fail "depth too small"
+fi
+
+# 3 个 slot 的栈帧在第 5592405 层用完 0xffffff 个 slot, 此时还剩 4 个, 调用需要 6 - 1 个.
+# .o0 中记录的深度, .s0 加载时计算的深度和翻译为 C 的程序都给出同样的报告
+"$cc0" -a -O0 deep.c0 -o deep.c && $cc -O2 deep.c -o deep -pthread
+run o0.out "$cc0" --run deep.o0
+run s0.out "$cc0" --run deep.s0
+run aot.out ./deep
+for out in o0 s0 aot; do
+	if [ "$(sed -n 1,2p $out.out)" = "$(printf '200010000\nruntime error: stack overflow: calling f at call depth 5592405 needs 5 slots, 4 left !')" ] \
+		&& grep -qx "exit 1" $out.out; then
+		pass "stack overflow ($out)"
+	else
+		fail "stack overflow ($out)"
+		head -3 $out.out
+	fi
+done
+
+# 版本 1 的文件没有栈帧大小和最大深度, 运行结果与现在编译源文件的相同.
+# c4.o0 是 c4 改动之前编译的, 不比较
+for name in c1 c2 c3 c5 c6 c7; do
+	src=$dir/testcase/$name
+	[ -f "$src" ] || src=$src.c0
+	"$cc0" -c "$src" -o $name.o0
+	run v1.out "$cc0" --run "$dir/testcase/$name.o0"
+	run v2.out "$cc0" --run $name.o0
+	if [ "$(hex "$dir/testcase/$name.o0" | cut -c1-16)" = "43303a2900000001" ] && cmp -s v1.out v2.out; then
+		pass "version 1 $name"
+	else
+		fail "version 1 $name"
+	fi
+done
+exit $status
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef> // for std::size_t
+
+namespace cc0 {
+
+	// 标识符的编号, 比较和复制都是整数操作
+	using Symbol = std::uint32_t;
+
+	// 字符串驻留: 同一个名字只存一份
+	// 一次编译中 Tokenizer 和 Analyser 共用一个, 它必须比所有 Token 活得久
+	class Interner final {
+	public:
+		Interner() : _names(), _symbols() {}
+		Interner(Interner&&) = delete;
+		Interner(const Interner&) = delete;
+		Interner& operator=(Interner) = delete;
+
+		// 返回name的编号, 第一次出现时分配
+		Symbol Intern(const std::string& name) {
+			auto it = _symbols.find(name);
+			if (it != _symbols.end())
+				return it->second;
+			Symbol symbol = static_cast<Symbol>(_names.size());
+			_names.push_back(name);
+			_symbols.emplace(_names.back(), symbol);
+			return symbol;
+		}
+		const std::string& Name(Symbol symbol) const { return _names[symbol]; }
+		std::size_t Size() const { return _names.size(); }
+	private:
+		// deque 尾部插入不移动已有元素, _symbols 的键直接引用这里的字符串
+		std::deque<std::string> _names;
+		std::unordered_map<std::string_view, Symbol> _symbols;
+	};
+}
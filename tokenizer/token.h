@@ -1,9 +1,11 @@
 #pragma once
 
 #include "error/error.h"
+#include "tokenizer/interner.h"
 
 #include <any>
 #include <string>
+#include <typeinfo>
 #include <cstdint>
 
 namespace cc0 {
@@ -52,14 +54,44 @@ namespace cc0 {
 		BREAK,
 		CONTINUE,
 		SCAN,
+		SPAWN,
+		JOIN,
 
 		NOT_EQUAL,			// !=
 		EQUAL_EQUAL,		// ==
 		LESS_OR_EQUAL,		// <=
 		GREATER_OR_EQUAL,	// >=
+
+		PLUS_PLUS,				// ++
+		MINUS_MINUS,			// --
+		PLUS_EQUAL,				// +=
+		MINUS_EQUAL,			// -=
+		MULTIPLICATION_EQUAL,	// *=
+		DIVISION_EQUAL,			// /=
+
+		AND_AND,				// &&
+		OR_OR,					// ||
 					//{}表示未实现
 	};
 
+	// SPECIFIER 的值
+	enum C0Type {
+		TYPE_VOID,
+		TYPE_INT,
+		TYPE_CHAR,
+		TYPE_DOUBLE,
+	};
+
+	inline const char* C0TypeName(C0Type type) {
+		switch (type) {
+		case TYPE_VOID:   return "void";
+		case TYPE_INT:    return "int";
+		case TYPE_CHAR:   return "char";
+		case TYPE_DOUBLE: return "double";
+		}
+		return "Invalid";
+	}
+
 	class Token final {
 	private:
 		using uint64_t = std::uint64_t;
@@ -74,7 +106,10 @@ namespace cc0 {
 			: _type(type), _value(std::move(value)), _start_pos(start_line, start_column), _end_pos(end_line, end_column) {}
 		Token(TokenType type, std::any value, std::pair<uint64_t, uint64_t> start, std::pair<uint64_t, uint64_t> end)
 			: Token(type, value, start.first, start.second, end.first, end.second) {}
-		Token(const Token& t) { _type = t._type;  _value = t._value; _start_pos = t._start_pos; _end_pos = t._end_pos; }
+		// 标识符只保存它在 interner 中的编号
+		Token(Symbol symbol, const Interner& interner, std::pair<uint64_t, uint64_t> start, std::pair<uint64_t, uint64_t> end)
+			: Token(TokenType::IDENTIFIER, symbol, start, end) { _interner = &interner; }
+		Token(const Token& t) { _type = t._type;  _value = t._value; _start_pos = t._start_pos; _end_pos = t._end_pos; _interner = t._interner; }
 		Token(Token&& t) : Token(TokenType::NULL_TOKEN, nullptr, 0, 0, 0, 0) { swap(*this, t); }
 		Token& operator=(Token t) { swap(*this, t); return *this; }
 		bool operator==(const Token& rhs) const { 
@@ -88,26 +123,25 @@ namespace cc0 {
 		std::any GetValue() const { return _value; };
 		std::pair<uint64_t, uint64_t> GetStartPos() const { return _start_pos; }
 		std::pair<uint64_t, uint64_t> GetEndPos() const { return _end_pos; }
+		// IDENTIFIER 的编号
+		Symbol GetSymbol() const { return std::any_cast<Symbol>(_value); }
+		// SPECIFIER 的类型
+		C0Type GetC0Type() const { return std::any_cast<C0Type>(_value); }
 		std::string GetValueString() const {
-			try {
+			auto& type = _value.type();
+			if (type == typeid(Symbol) && _interner != nullptr)
+				return _interner->Name(std::any_cast<Symbol>(_value));
+			if (type == typeid(C0Type))
+				return C0TypeName(std::any_cast<C0Type>(_value));
+			if (type == typeid(std::string))
 				return std::any_cast<std::string>(_value);
-			}
-			catch (const std::bad_any_cast&) {}
-			try {
+			if (type == typeid(char))
 				return std::string(1, std::any_cast<char>(_value));
-			}
-			catch (const std::bad_any_cast&) {}
-			try {
+			if (type == typeid(int32_t))
 				return std::to_string(std::any_cast<int32_t>(_value));
-			}
-			////
-			catch (const std::bad_any_cast&) {}
-			try {
+			if (type == typeid(const char*))
 				return std::string(std::any_cast<const char*>(_value));
-			}
-			catch (const std::bad_any_cast&) {
-				DieAndPrint("No suitable cast for token value.");
-			}
+			DieAndPrint("No suitable cast for token value.");
 			return "Invalid";
 		}
 	private:
@@ -115,6 +149,7 @@ namespace cc0 {
 		std::any _value;
 		std::pair<uint64_t, uint64_t> _start_pos;
 		std::pair<uint64_t, uint64_t> _end_pos;
+		const Interner* _interner = nullptr;
 	};
 
 	inline void swap(Token& lhs, Token& rhs) {
@@ -123,5 +158,6 @@ namespace cc0 {
 		swap(lhs._value, rhs._value);
 		swap(lhs._start_pos, rhs._start_pos);
 		swap(lhs._end_pos, rhs._end_pos);
+		swap(lhs._interner, rhs._interner);
 	}
 }
\ No newline at end of file
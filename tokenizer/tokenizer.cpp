@@ -2,6 +2,7 @@
 
 #include <cctype>
 #include <sstream>
+#include <unordered_map>
 
 namespace cc0 {
 
@@ -139,6 +140,12 @@ namespace cc0 {
 					case ',':
 						current_state = DFAState::COMMA_STATE;
 						break;
+					case '&':
+						current_state = DFAState::AMPERSAND_STATE;
+						break;
+					case '|':
+						current_state = DFAState::VERTICAL_BAR_STATE;
+						break;
 					// 不接受的字符导致的不合法的状态
 					default:
 						invalid = true;
@@ -268,36 +275,7 @@ namespace cc0 {
 				// 如果当前已经读到了文件尾，则解析已经读到的字符串
 				if (!current_char.has_value()){
 				//     如果解析结果是关键字，那么返回对应关键字的token，否则返回标识符的token
-					if( ss.str() == "scan")
-						return std::make_pair(std::make_optional<Token>(TokenType::SCAN, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "void" || ss.str() == "int" || ss.str() == "char" || ss.str() == "double")
-						return std::make_pair(std::make_optional<Token>(TokenType::SPECIFIER, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "struct")
-						return std::make_pair(std::make_optional<Token>(TokenType::STRUCT, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "if" )
-						return std::make_pair(std::make_optional<Token>(TokenType::IF, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "else")
-						return std::make_pair(std::make_optional<Token>(TokenType::ELSE, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "switch" || ss.str() == "case" || ss.str() == "default")
-						return std::make_pair(std::make_optional<Token>(TokenType::LABELED, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "while")
-						return std::make_pair(std::make_optional<Token>(TokenType::WHILE, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "for")
-						return std::make_pair(std::make_optional<Token>(TokenType::FOR, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "do")
-						return std::make_pair(std::make_optional<Token>(TokenType::DO, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "return")
-						return std::make_pair(std::make_optional<Token>(TokenType::RETURN, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "break")
-						return std::make_pair(std::make_optional<Token>(TokenType::BREAK, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "continue")
-						return std::make_pair(std::make_optional<Token>(TokenType::CONTINUE, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "const")
-						return std::make_pair(std::make_optional<Token>(TokenType::CONST, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "print")
-						return std::make_pair(std::make_optional<Token>(TokenType::PRINT, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else 
-						return std::make_pair(std::make_optional<Token>(TokenType::IDENTIFIER, ss.str(), pos, currentPos()), std::optional<CompilationError>());
+					return std::make_pair(std::make_optional<Token>(wordToken(ss.str(), pos)), std::optional<CompilationError>());
 				}
 				auto ch = current_char.value();
 				// 如果读到的是字符或字母，则存储读到的字符
@@ -307,36 +285,7 @@ namespace cc0 {
 				else {
 					unreadLast();
 				//     如果解析结果是关键字，那么返回对应关键字的token，否则返回标识符的token
-					if( ss.str() == "scan")
-						return std::make_pair(std::make_optional<Token>(TokenType::SCAN, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "void" || ss.str() == "int" || ss.str() == "char" || ss.str() == "double")
-						return std::make_pair(std::make_optional<Token>(TokenType::SPECIFIER, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "struct")
-						return std::make_pair(std::make_optional<Token>(TokenType::STRUCT, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "if" )
-						return std::make_pair(std::make_optional<Token>(TokenType::IF, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "else" )
-						return std::make_pair(std::make_optional<Token>(TokenType::ELSE, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "switch" || ss.str() == "case" || ss.str() == "default")
-						return std::make_pair(std::make_optional<Token>(TokenType::LABELED, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "while")
-						return std::make_pair(std::make_optional<Token>(TokenType::WHILE, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "for")
-						return std::make_pair(std::make_optional<Token>(TokenType::FOR, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "do")
-						return std::make_pair(std::make_optional<Token>(TokenType::DO, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "return")
-						return std::make_pair(std::make_optional<Token>(TokenType::RETURN, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "break")
-						return std::make_pair(std::make_optional<Token>(TokenType::BREAK, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "continue")
-						return std::make_pair(std::make_optional<Token>(TokenType::CONTINUE, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "const")
-						return std::make_pair(std::make_optional<Token>(TokenType::CONST, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else if( ss.str() == "print")
-						return std::make_pair(std::make_optional<Token>(TokenType::PRINT, ss.str(), pos, currentPos()), std::optional<CompilationError>());
-					else 
-						return std::make_pair(std::make_optional<Token>(TokenType::IDENTIFIER, ss.str(), pos, currentPos()), std::optional<CompilationError>());
+					return std::make_pair(std::make_optional<Token>(wordToken(ss.str(), pos)), std::optional<CompilationError>());
 				}
 				break;
 			}
@@ -345,12 +294,26 @@ namespace cc0 {
 			case PLUS_SIGN_STATE: {
 				// 请思考这里为什么要回退，在其他地方会不会需要
 				// 回退是因为初始态切换到plus态的时候，通过break回到了while开头，多读了一个字符。
+				if ( ! current_char.has_value())
+					return std::make_pair(std::make_optional<Token>(TokenType::PLUS_SIGN, '+', pos, currentPos()), std::optional<CompilationError>());
+				auto ch = current_char.value();
+				if (ch == '+')
+					return std::make_pair(std::make_optional<Token>(TokenType::PLUS_PLUS, "++", pos, currentPos()), std::optional<CompilationError>());
+				if (ch == '=')
+					return std::make_pair(std::make_optional<Token>(TokenType::PLUS_EQUAL, "+=", pos, currentPos()), std::optional<CompilationError>());
 				unreadLast(); // Yes, we unread last char even if it's an EOF.
 				return std::make_pair(std::make_optional<Token>(TokenType::PLUS_SIGN, '+', pos, currentPos()), std::optional<CompilationError>());
 			}
 								  // 当前状态为减号的状态
 			case MINUS_SIGN_STATE: {
 				// 请填空：回退，并返回减号token
+				if ( ! current_char.has_value())
+					return std::make_pair(std::make_optional<Token>(TokenType::MINUS_SIGN, '-', pos, currentPos()), std::optional<CompilationError>());
+				auto ch = current_char.value();
+				if (ch == '-')
+					return std::make_pair(std::make_optional<Token>(TokenType::MINUS_MINUS, "--", pos, currentPos()), std::optional<CompilationError>());
+				if (ch == '=')
+					return std::make_pair(std::make_optional<Token>(TokenType::MINUS_EQUAL, "-=", pos, currentPos()), std::optional<CompilationError>());
 				unreadLast();
 				return std::make_pair(std::make_optional<Token>(TokenType::MINUS_SIGN, '-', pos, currentPos()), std::optional<CompilationError>());
 			}
@@ -359,11 +322,15 @@ namespace cc0 {
 								   // 对于其他的合法状态，进行合适的操作
 								   // 比如进行解析、返回token、返回编译错误
 			case DIVISION_SIGN_STATE: {
+				if (current_char.has_value() && current_char.value() == '=')
+					return std::make_pair(std::make_optional<Token>(TokenType::DIVISION_EQUAL, "/=", pos, currentPos()), std::optional<CompilationError>());
 				unreadLast();
 				return std::make_pair(std::make_optional<Token>(TokenType::DIVISION_SIGN, '/', pos, currentPos()), std::optional<CompilationError>());
 			}
 			
 			case MULTIPLICATION_SIGN_STATE: {
+				if (current_char.has_value() && current_char.value() == '=')
+					return std::make_pair(std::make_optional<Token>(TokenType::MULTIPLICATION_EQUAL, "*=", pos, currentPos()), std::optional<CompilationError>());
 				unreadLast();
 				return std::make_pair(std::make_optional<Token>(TokenType::MULTIPLICATION_SIGN, '*', pos, currentPos()), std::optional<CompilationError>());
 			}
@@ -454,6 +421,19 @@ namespace cc0 {
 			case COMMA_STATE: {
 				unreadLast();
 				return std::make_pair(std::make_optional<Token>(TokenType::COMMA, ',', pos, currentPos()), std::optional<CompilationError>());
+			}
+			// 没有位运算, 单独的 & 和 | 不合法
+			case AMPERSAND_STATE: {
+				if (current_char.has_value() && current_char.value() == '&')
+					return std::make_pair(std::make_optional<Token>(TokenType::AND_AND, "&&", pos, currentPos()), std::optional<CompilationError>());
+				unreadLast();
+				return std::make_pair(std::optional<Token>(), std::make_optional<CompilationError>(pos, ErrorCode::ErrInvalidInput));
+			}
+			case VERTICAL_BAR_STATE: {
+				if (current_char.has_value() && current_char.value() == '|')
+					return std::make_pair(std::make_optional<Token>(TokenType::OR_OR, "||", pos, currentPos()), std::optional<CompilationError>());
+				unreadLast();
+				return std::make_pair(std::optional<Token>(), std::make_optional<CompilationError>(pos, ErrorCode::ErrInvalidInput));
 			}
 								   // 预料之外的状态，如果执行到了这里，说明程序异常
 			default:
@@ -465,6 +445,42 @@ namespace cc0 {
 		return std::make_pair(std::optional<Token>(), std::optional<CompilationError>());
 	}
 
+	// 关键字和类型修饰符之外的单词都是标识符, 标识符驻留后只保存编号
+	Token Tokenizer::wordToken(const std::string& word, std::pair<uint64_t, uint64_t> pos) {
+		static const std::unordered_map<std::string, TokenType> keywords = {
+			{ "scan", TokenType::SCAN },
+			{ "struct", TokenType::STRUCT },
+			{ "if", TokenType::IF },
+			{ "else", TokenType::ELSE },
+			{ "switch", TokenType::LABELED },
+			{ "case", TokenType::LABELED },
+			{ "default", TokenType::LABELED },
+			{ "while", TokenType::WHILE },
+			{ "for", TokenType::FOR },
+			{ "do", TokenType::DO },
+			{ "return", TokenType::RETURN },
+			{ "break", TokenType::BREAK },
+			{ "continue", TokenType::CONTINUE },
+			{ "const", TokenType::CONST },
+			{ "print", TokenType::PRINT },
+			{ "spawn", TokenType::SPAWN },
+			{ "join", TokenType::JOIN },
+		};
+		static const std::unordered_map<std::string, C0Type> specifiers = {
+			{ "void", C0Type::TYPE_VOID },
+			{ "int", C0Type::TYPE_INT },
+			{ "char", C0Type::TYPE_CHAR },
+			{ "double", C0Type::TYPE_DOUBLE },
+		};
+		auto keyword = keywords.find(word);
+		if (keyword != keywords.end())
+			return Token(keyword->second, word, pos, currentPos());
+		auto specifier = specifiers.find(word);
+		if (specifier != specifiers.end())
+			return Token(TokenType::SPECIFIER, specifier->second, pos, currentPos());
+		return Token(_interner.Intern(word), _interner, pos, currentPos());
+	}
+
 	std::optional<CompilationError> Tokenizer::checkToken(const Token& t) {
 		switch (t.GetType()) {
 			case IDENTIFIER: {
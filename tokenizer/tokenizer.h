@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tokenizer/token.h"
+#include "tokenizer/interner.h"
 #include "tokenizer/utils.hpp"
 #include "error/error.h"
 
@@ -42,6 +43,8 @@ namespace cc0 {
 
 			EXCLAMATION_STATE,			// !
 			COMMA_STATE,				// ,
+			AMPERSAND_STATE,			// &, 只能是 &&
+			VERTICAL_BAR_STATE,			// |, 只能是 ||
 
 			ZERO_STATE,
 			HEX_X_STATE,				// 16进制xX
@@ -56,8 +59,8 @@ namespace cc0 {
 			// FLOATING_DOT_STATE,			//'.'
 		};
 	public:
-		Tokenizer(std::istream& ifs)
-			: _rdr(ifs), _initialized(false), _ptr(0, 0),_lines_buffer() {}
+		Tokenizer(std::istream& ifs, Interner& interner)
+			: _rdr(ifs), _interner(interner), _initialized(false), _ptr(0, 0),_lines_buffer() {}
 		Tokenizer(Tokenizer&& tkz) = delete;
 		Tokenizer(const Tokenizer&) = delete;
 		Tokenizer& operator=(const Tokenizer&) = delete;
@@ -74,6 +77,8 @@ namespace cc0 {
 		//
 		// 返回下一个 token，是 NextToken 实际实现部分
 		std::pair<std::optional<Token>, std::optional<CompilationError>> nextToken();
+		// 由读到的单词构造关键字, 类型修饰符或标识符的 token
+		Token wordToken(const std::string&, std::pair<uint64_t, uint64_t>);
 
 		// 从这里开始其实是一个基于行号的缓冲区的实现
 		// 为了简单起见，我们没有单独拿出一个类实现
@@ -104,6 +109,8 @@ namespace cc0 {
 		void unreadLast();
 	private:
 		std::istream& _rdr;
+		// 标识符的驻留表
+		Interner& _interner;
 		// 如果没有初始化，那么就 readAll
 		bool _initialized;
 		// 指向下一个要读取的字符